@@ -0,0 +1,159 @@
+/**
+  ******************************************************************************
+  * @file           : bench_bignum.cpp
+  * @brief          : Bignum throughput at 100, 1k and 10k decimal digits
+  * @author         : STM32 Calculator Project
+  * @date           : 2024
+  ******************************************************************************
+  *
+  * Host only. Multiplication is measured with each algorithm forced above the
+  * schoolbook cutoff (via BigInt::set_multiply_thresholds) and with the
+  * default dispatch, so the Karatsuba / Toom-3 crossovers can be re-tuned.
+  */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include "bignum.h"
+
+static const size_t digit_sizes[] = {100, 1000, 10000};
+static const size_t SIZE_COUNT = sizeof(digit_sizes) / sizeof(digit_sizes[0]);
+
+// Minimum wall time per measurement
+static const double MIN_SECONDS = 0.2;
+
+// Keeps results observable so the loops are not optimised away
+static volatile size_t sink;
+
+enum BenchOp {
+    BENCH_ADD = 0,
+    BENCH_MUL_SCHOOL,
+    BENCH_MUL_KARATSUBA,
+    BENCH_MUL_TOOM3,
+    BENCH_MUL,
+    BENCH_DIV,
+    BENCH_DECIMAL_DIV,
+    BENCH_POW,
+    BENCH_TO_STRING,
+    BENCH_OP_COUNT
+};
+
+static const char* const op_names[BENCH_OP_COUNT] = {
+    "add", "mul (schoolbook)", "mul (karatsuba)", "mul (toom-3)", "mul (auto)",
+    "div 2n/n", "decimal div", "pow (x^7)", "to_string"
+};
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ull;
+
+static uint32_t rng_next() {
+    // xorshift64*
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (uint32_t)((rng_state * 0x2545F4914F6CDD1Dull) >> 32);
+}
+
+static BigInt random_bigint(size_t digits) {
+    std::string text;
+    text += (char)('1' + rng_next() % 9);
+    for (size_t i = 1; i < digits; i++) {
+        text += (char)('0' + rng_next() % 10);
+    }
+    BigInt value;
+    BigInt::parse(text.data(), text.size(), value);
+    return value;
+}
+
+static void run_op(BenchOp op, const BigInt& a, const BigInt& b, const BigInt& wide,
+                   const BigDecimal& da, const BigDecimal& db) {
+    switch (op) {
+        case BENCH_ADD:
+            sink = sink + BigInt::add(a, b).limb_count();
+            break;
+        case BENCH_MUL_SCHOOL:
+        case BENCH_MUL_KARATSUBA:
+        case BENCH_MUL_TOOM3:
+        case BENCH_MUL:
+            sink = sink + BigInt::mul(a, b).limb_count();
+            break;
+        case BENCH_DIV: {
+            BigInt q, r;
+            BigInt::divmod(wide, b, q, r);
+            sink = sink + q.limb_count();
+            break;
+        }
+        case BENCH_DECIMAL_DIV: {
+            BigDecimal q;
+            BigDecimal::div(da, db, q);
+            sink = sink + q.scale_value();
+            break;
+        }
+        case BENCH_POW:
+            sink = sink + BigInt::pow(a, 7).limb_count();
+            break;
+        case BENCH_TO_STRING:
+            sink = sink + a.to_string().size();
+            break;
+        default:
+            break;
+    }
+}
+
+static void select_algorithm(BenchOp op) {
+    const size_t never = (size_t)1 << 30;
+    switch (op) {
+        case BENCH_MUL_SCHOOL: BigInt::set_multiply_thresholds(never, never); break;
+        case BENCH_MUL_KARATSUBA: BigInt::set_multiply_thresholds(0, never); break;
+        case BENCH_MUL_TOOM3: BigInt::set_multiply_thresholds(0, 9); break;
+        default: BigInt::set_multiply_thresholds(0, 0); break;
+    }
+}
+
+// Returns operations per second
+static double bench_op(BenchOp op, size_t digits) {
+    BigInt a = random_bigint(digits);
+    BigInt b = random_bigint(digits);
+    BigInt wide = BigInt::mul(a, random_bigint(digits));
+    BigDecimal da(a, (uint32_t)(digits / 2));
+    BigDecimal db(b, (uint32_t)(digits / 3));
+
+    select_algorithm(op);
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point start = Clock::now();
+    double elapsed = 0.0;
+    uint64_t iterations = 0;
+    uint64_t batch = 1;
+    while (elapsed < MIN_SECONDS) {
+        for (uint64_t i = 0; i < batch; i++) {
+            run_op(op, a, b, wide, da, db);
+        }
+        iterations += batch;
+        batch *= 2;
+        elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    }
+    BigInt::set_multiply_thresholds(0, 0);
+    return (double)iterations / elapsed;
+}
+
+int main() {
+    printf("Bignum benchmark (operations per second, 32-bit limbs)\n");
+    printf("Thresholds: karatsuba >= %d limbs, toom-3 >= %d limbs, decimal div keeps %d digits\n\n",
+           BIGNUM_KARATSUBA_THRESHOLD, BIGNUM_TOOM3_THRESHOLD, BIGNUM_DIV_DIGITS);
+
+    printf("%-18s", "operation");
+    for (size_t s = 0; s < SIZE_COUNT; s++) {
+        printf(" %10zu dig", digit_sizes[s]);
+    }
+    printf("\n");
+
+    for (int op = 0; op < BENCH_OP_COUNT; op++) {
+        printf("%-18s", op_names[op]);
+        for (size_t s = 0; s < SIZE_COUNT; s++) {
+            printf(" %14.1f", bench_op((BenchOp)op, digit_sizes[s]));
+            fflush(stdout);
+        }
+        printf("\n");
+    }
+    return 0;
+}
@@ -0,0 +1,167 @@
+/**
+  ******************************************************************************
+  * @file           : bench_harness.h
+  * @brief          : Microbenchmark harness: warmup, samples, percentiles, JSON
+  * @author         : STM32 Calculator Project
+  * @date           : 2024
+  ******************************************************************************
+  *
+  * Host only. Each benchmark is warmed up, then timed as a number of samples;
+  * a sample runs the operation enough times (calibrated during warmup) to be
+  * well above the clock resolution. Per-sample ns/op give the percentiles.
+  */
+
+#ifndef __BENCH_HARNESS_H
+#define __BENCH_HARNESS_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+struct BenchConfig {
+    double warmup_ms;           // Untimed runs before sampling
+    uint32_t samples;           // Timed samples per benchmark
+    double min_sample_us;       // Batch size is doubled until a sample takes this long
+};
+
+struct BenchResult {
+    std::string name;
+    uint64_t batch;             // Operations per sample
+    uint32_t samples;
+    double ns_min;
+    double ns_p50;
+    double ns_p90;
+    double ns_p99;
+    double ns_max;
+    double ns_mean;
+    double ops_per_sec;         // From the mean
+};
+
+class BenchRunner {
+public:
+    explicit BenchRunner(const BenchConfig& config) : config(config) {}
+
+    // fn() performs one operation; it must leave its state ready for the next
+    template <typename Fn>
+    const BenchResult& run(const char* name, Fn fn) {
+        uint64_t batch = calibrate(fn);
+        std::vector<double> ns_per_op(config.samples);
+        for (uint32_t i = 0; i < config.samples; i++) {
+            ns_per_op[i] = time_batch(fn, batch) / (double)batch;
+        }
+        std::sort(ns_per_op.begin(), ns_per_op.end());
+
+        BenchResult result;
+        result.name = name;
+        result.batch = batch;
+        result.samples = config.samples;
+        result.ns_min = ns_per_op.front();
+        result.ns_p50 = percentile(ns_per_op, 0.50);
+        result.ns_p90 = percentile(ns_per_op, 0.90);
+        result.ns_p99 = percentile(ns_per_op, 0.99);
+        result.ns_max = ns_per_op.back();
+        double total = 0;
+        for (size_t i = 0; i < ns_per_op.size(); i++) {
+            total += ns_per_op[i];
+        }
+        result.ns_mean = total / ns_per_op.size();
+        result.ops_per_sec = result.ns_mean > 0 ? 1e9 / result.ns_mean : 0;
+        results.push_back(result);
+        print_row(result);
+        return results.back();
+    }
+
+    static void print_header() {
+        printf("%-42s %10s %10s %10s %10s %14s\n",
+               "benchmark", "p50 ns", "p90 ns", "p99 ns", "mean ns", "ops/s");
+    }
+
+    // One object per benchmark; config echoed so runs can be compared
+    bool write_json(const char* path, const char* suite) const {
+        FILE* file = fopen(path, "w");
+        if (file == nullptr) {
+            return false;
+        }
+        fprintf(file, "{\n  \"suite\": \"%s\",\n", suite);
+        fprintf(file, "  \"config\": {\"warmup_ms\": %.1f, \"samples\": %u, \"min_sample_us\": %.1f},\n",
+                config.warmup_ms, (unsigned)config.samples, config.min_sample_us);
+        fprintf(file, "  \"results\": [\n");
+        for (size_t i = 0; i < results.size(); i++) {
+            const BenchResult& r = results[i];
+            fprintf(file, "    {\"name\": \"%s\", \"batch\": %llu, \"samples\": %u, "
+                          "\"ns_min\": %.3f, \"ns_p50\": %.3f, \"ns_p90\": %.3f, \"ns_p99\": %.3f, "
+                          "\"ns_max\": %.3f, \"ns_mean\": %.3f, \"ops_per_sec\": %.1f}%s\n",
+                    json_escape(r.name).c_str(), (unsigned long long)r.batch, (unsigned)r.samples,
+                    r.ns_min, r.ns_p50, r.ns_p90, r.ns_p99, r.ns_max, r.ns_mean, r.ops_per_sec,
+                    i + 1 < results.size() ? "," : "");
+        }
+        fprintf(file, "  ]\n}\n");
+        return fclose(file) == 0;
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    BenchConfig config;
+    std::vector<BenchResult> results;
+
+    template <typename Fn>
+    static double time_batch(Fn& fn, uint64_t batch) {
+        Clock::time_point start = Clock::now();
+        for (uint64_t i = 0; i < batch; i++) {
+            fn();
+        }
+        return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    }
+
+    // Warms up while doubling the batch until one sample is long enough
+    template <typename Fn>
+    uint64_t calibrate(Fn& fn) const {
+        uint64_t batch = 1;
+        double warmed_ns = 0;
+        double sample_ns = 0;
+        while (warmed_ns < config.warmup_ms * 1e6 || sample_ns < config.min_sample_us * 1e3) {
+            sample_ns = time_batch(fn, batch);
+            warmed_ns += sample_ns;
+            if (sample_ns < config.min_sample_us * 1e3) {
+                batch *= 2;
+            }
+        }
+        return batch;
+    }
+
+    static std::string json_escape(const std::string& text) {
+        std::string escaped;
+        for (size_t i = 0; i < text.size(); i++) {
+            char c = text[i];
+            if (c == '"' || c == '\\') {
+                escaped += '\\';
+                escaped += c;
+            } else if ((unsigned char)c < 0x20) {
+                char code[8];
+                snprintf(code, sizeof(code), "\\u%04x", (unsigned)c);
+                escaped += code;
+            } else {
+                escaped += c;
+            }
+        }
+        return escaped;
+    }
+
+    // Nearest-rank percentile of sorted values
+    static double percentile(const std::vector<double>& sorted, double fraction) {
+        size_t rank = (size_t)(fraction * sorted.size() + 0.5);
+        rank = std::min(std::max(rank, (size_t)1), sorted.size());
+        return sorted[rank - 1];
+    }
+
+    static void print_row(const BenchResult& r) {
+        printf("%-42s %10.1f %10.1f %10.1f %10.1f %14.0f\n",
+               r.name.c_str(), r.ns_p50, r.ns_p90, r.ns_p99, r.ns_mean, r.ops_per_sec);
+    }
+};
+
+#endif // __BENCH_HARNESS_H
@@ -0,0 +1,169 @@
+/**
+  ******************************************************************************
+  * @file           : bench_hotpaths.cpp
+  * @brief          : Calculator, display and keypad hot paths on the mock HAL
+  * @author         : STM32 Calculator Project
+  * @date           : 2024
+  ******************************************************************************
+  *
+  * Host only. Times the per-key work of the firmware: arithmetic, keypad
+  * sequences through process_input, number formatting into the display and
+  * matrix scans against the simulated keypad. Results go to stdout and, with
+  * --json, to a file that later runs can be diffed against.
+  *
+  * Usage: bench_hotpaths [--json file] [--samples n] [--warmup-ms n]
+  */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "bench_harness.h"
+#include "calculator.h"
+#include "display.h"
+#include "keypad.h"
+
+// Keeps results observable so the loops are not optimised away
+static volatile double sink;
+static volatile uint32_t key_sink;
+
+static UART_HandleTypeDef huart1;
+static I2C_HandleTypeDef hi2c1;
+
+static const uint16_t row_pins[4] = {GPIO_PIN_0, GPIO_PIN_1, GPIO_PIN_2, GPIO_PIN_3};
+static const uint16_t col_pins[4] = {GPIO_PIN_4, GPIO_PIN_5, GPIO_PIN_6, GPIO_PIN_7};
+
+// Operand pool, so the arithmetic is not constant-folded or branch-trained
+static const size_t OPERAND_COUNT = 64;
+static double operands[OPERAND_COUNT];
+
+static void bench_calculator(BenchRunner& runner) {
+    static Calculator calc;
+    for (size_t i = 0; i < OPERAND_COUNT; i++) {
+        operands[i] = (double)(i * 37 % 1000) / 7.0 + 1.0;
+    }
+    size_t index = 0;
+    runner.run("calculator.add", [&]() {
+        sink = CalcNum::to_double(calc.add(operands[index % OPERAND_COUNT], operands[(index + 1) % OPERAND_COUNT]));
+        index++;
+    });
+    runner.run("calculator.multiply", [&]() {
+        sink = CalcNum::to_double(calc.multiply(operands[index % OPERAND_COUNT], operands[(index + 1) % OPERAND_COUNT]));
+        index++;
+    });
+    runner.run("calculator.divide", [&]() {
+        sink = CalcNum::to_double(calc.divide(operands[index % OPERAND_COUNT], operands[(index + 1) % OPERAND_COUNT]));
+        index++;
+    });
+    runner.run("calculator.square_root", [&]() {
+        sink = CalcNum::to_double(calc.square_root(operands[index % OPERAND_COUNT]));
+        index++;
+    });
+}
+
+// One operation is the whole key sequence, clear included
+static void bench_process_input(BenchRunner& runner) {
+    static Calculator calc;
+    static const struct {
+        const char* name;
+        const char* keys;
+    } sequences[] = {
+        {"process_input \"123+456=\"", "C123+456="},
+        {"process_input \"2+3*4-5/2=\"", "C2+3*4-5/2="},
+        {"process_input \"(1.5+2.25)*4=\"", "C(1.5+2.25)*4="},
+    };
+    for (size_t s = 0; s < sizeof(sequences) / sizeof(sequences[0]); s++) {
+        const char* keys = sequences[s].keys;
+        runner.run(sequences[s].name, [&]() {
+            for (const char* k = keys; *k != '\0'; k++) {
+                calc.process_input(*k);
+            }
+            sink = CalcNum::to_double(calc.get_last_result());
+        });
+    }
+}
+
+static void bench_display(BenchRunner& runner) {
+    // UART only: shortest round-trip digits, queued and sent by poll()
+    static Display uart_display(&huart1);
+    size_t index = 0;
+    runner.run("display.print_number (uart) + poll", [&]() {
+        uart_display.print_number(operands[index++ % OPERAND_COUNT]);
+        uart_display.poll();
+    });
+
+    // LCD: rounded to the row width into the shadow framebuffer
+    static Hd44780I2cBus lcd_bus(&hi2c1);
+    static Hd44780 lcd(lcd_bus);
+    static Display lcd_display(&huart1, &lcd);
+    mock_lcd_attach_i2c(HD44780_I2C_ADDRESS);
+    if (!lcd_display.init_lcd()) {
+        printf("(simulated LCD did not answer, LCD benchmark skipped)\n");
+        return;
+    }
+    runner.run("display.print_number (lcd frame)", [&]() {
+        lcd_display.print_number(operands[index++ % OPERAND_COUNT]);
+    });
+}
+
+static void bench_keypad(BenchRunner& runner) {
+    mock_keypad_attach(GPIOA, row_pins, 4, GPIOA, col_pins, 4);
+    static Keypad keypad;
+    keypad.init(KEYPAD_MODE_POLLING);
+
+    // Last key of the matrix held: the scan visits every row
+    mock_keypad_press(3, 3);
+    runner.run("keypad.scan_key (port, last key held)", [&]() {
+        key_sink = keypad.scan_key();
+    });
+    runner.run("keypad.scan_keys (port, NKRO bitmap)", [&]() {
+        key_sink = keypad.scan_keys();
+    });
+    keypad.set_scan_method(KEYPAD_SCAN_PINS);
+    runner.run("keypad.scan_key (per pin, last key held)", [&]() {
+        key_sink = keypad.scan_key();
+    });
+    keypad.set_scan_method(KEYPAD_SCAN_PORT);
+    mock_keypad_release(3, 3);
+    runner.run("keypad.scan_key (port, idle)", [&]() {
+        key_sink = keypad.scan_key();
+    });
+}
+
+int main(int argc, char** argv) {
+    BenchConfig config = {50.0, 200, 20.0};
+    const char* json_path = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json_path = argv[++i];
+        } else if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc) {
+            config.samples = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--warmup-ms") == 0 && i + 1 < argc) {
+            config.warmup_ms = strtod(argv[++i], nullptr);
+        } else {
+            fprintf(stderr, "usage: %s [--json file] [--samples n] [--warmup-ms n]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (config.samples == 0) {
+        config.samples = 1;
+    }
+
+    // UART text would otherwise be echoed to stdout on every transfer
+    mock_set_console_echo(false);
+
+    BenchRunner runner(config);
+    BenchRunner::print_header();
+    bench_calculator(runner);
+    bench_process_input(runner);
+    bench_display(runner);
+    bench_keypad(runner);
+
+    if (json_path != nullptr) {
+        if (!runner.write_json(json_path, "hotpaths")) {
+            fprintf(stderr, "cannot write %s\n", json_path);
+            return 1;
+        }
+        printf("Results written to %s\n", json_path);
+    }
+    return 0;
+}
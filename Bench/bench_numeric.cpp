@@ -0,0 +1,152 @@
+/**
+  ******************************************************************************
+  * @file           : bench_numeric.cpp
+  * @brief          : Cycles per operation: double vs fixed-point backend
+  * @author         : STM32 Calculator Project
+  * @date           : 2024
+  ******************************************************************************
+  *
+  * Builds on the host (rdtsc / steady_clock) and on a Cortex-M3 (DWT CYCCNT),
+  * so the same table can be produced where double really is soft-float.
+  */
+
+#include <cstdio>
+#include <cstdint>
+#include <cmath>
+#include <cstring>
+#include "calc_number.h"
+
+#if defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__)
+// Cortex-M3/M4 DWT cycle counter
+#define DEMCR       (*(volatile uint32_t*)0xE000EDFCu)
+#define DWT_CTRL    (*(volatile uint32_t*)0xE0001000u)
+#define DWT_CYCCNT  (*(volatile uint32_t*)0xE0001004u)
+
+static void cycles_init() {
+    DEMCR |= (1u << 24);    // TRCENA
+    DWT_CYCCNT = 0;
+    DWT_CTRL |= 1u;         // CYCCNTENA
+}
+
+static uint64_t cycles_now() {
+    return DWT_CYCCNT;
+}
+static const char* cycles_unit = "cycles";
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+
+static void cycles_init() {
+}
+
+static uint64_t cycles_now() {
+    return __rdtsc();
+}
+static const char* cycles_unit = "TSC ticks";
+#else
+#include <chrono>
+
+static void cycles_init() {
+}
+
+static uint64_t cycles_now() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+static const char* cycles_unit = "ns";
+#endif
+
+static const int OPERAND_COUNT = 256;
+#if defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__)
+static const int ITERATIONS = 1 << 10;
+#else
+static const int ITERATIONS = 1 << 16;
+#endif
+
+enum BenchOp {
+    BENCH_ADD = 0,
+    BENCH_SUB,
+    BENCH_MUL,
+    BENCH_DIV,
+    BENCH_SQRT,
+    BENCH_POW_INT,
+    BENCH_POW_FRAC,
+    BENCH_FROM_DECIMAL,
+    BENCH_OP_COUNT
+};
+
+static const char* const op_names[BENCH_OP_COUNT] = {
+    "add", "sub", "mul", "div", "sqrt", "pow (int exp)", "pow (frac exp)", "entry parse"
+};
+
+// Keeps results observable so the loops are not optimised away
+static volatile int64_t sink;
+
+template <typename T>
+static void consume(T value);
+
+template <>
+void consume<double>(double value) {
+    int64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    sink = sink + bits;
+}
+
+template <>
+void consume<Fixed>(Fixed value) {
+    sink = sink + value.raw_value();
+}
+
+template <typename T>
+static double bench_op(BenchOp op, const T* a, const T* b, const T* e) {
+    typedef NumTraits<T> Num;
+    T r = Num::zero();
+
+    uint64_t start = cycles_now();
+    for (int i = 0; i < ITERATIONS; i++) {
+        int k = i & (OPERAND_COUNT - 1);
+        switch (op) {
+            case BENCH_ADD: r = Num::add(a[k], b[k]); break;
+            case BENCH_SUB: r = Num::sub(a[k], b[k]); break;
+            case BENCH_MUL: r = Num::mul(a[k], b[k]); break;
+            case BENCH_DIV: r = Num::div(a[k], b[k]); break;
+            case BENCH_SQRT: Num::sqrt(a[k], r); break;
+            case BENCH_POW_INT: Num::pow(b[k], Num::from_int(3), r); break;
+            case BENCH_POW_FRAC: Num::pow(b[k], e[k], r); break;
+            case BENCH_FROM_DECIMAL: r = Num::from_decimal(123456 + k, 3); break;
+            default: break;
+        }
+        consume(r);
+    }
+    uint64_t elapsed = cycles_now() - start;
+    return (double)elapsed / ITERATIONS;
+}
+
+int main() {
+    static double da[OPERAND_COUNT], db[OPERAND_COUNT], de[OPERAND_COUNT];
+    static Fixed fa[OPERAND_COUNT], fb[OPERAND_COUNT], fe[OPERAND_COUNT];
+
+    // Calculator-typical magnitudes; b stays positive and non-zero
+    for (int i = 0; i < OPERAND_COUNT; i++) {
+        da[i] = (i * 37 % 1000) + 0.125 * (i % 7);
+        db[i] = 1.5 + (i * 13 % 97) * 0.25;
+        de[i] = 0.5 + (i % 5) * 0.3;
+        fa[i] = Fixed::from_double(da[i]);
+        fb[i] = Fixed::from_double(db[i]);
+        fe[i] = Fixed::from_double(de[i]);
+    }
+
+    cycles_init();
+
+    printf("Numeric backend benchmark (%d iterations, %s per op)\n", ITERATIONS, cycles_unit);
+    printf("Fixed format: Q%d.%d\n\n", 63 - Fixed::FRAC_BITS, Fixed::FRAC_BITS);
+    printf("%-16s %12s %12s %10s\n", "operation", "double", "fixed", "ratio");
+
+    for (int op = 0; op < BENCH_OP_COUNT; op++) {
+        double d = bench_op<double>((BenchOp)op, da, db, de);
+        double f = bench_op<Fixed>((BenchOp)op, fa, fb, fe);
+        printf("%-16s %12.1f %12.1f %9.2fx\n", op_names[op], d, f, f > 0.0 ? d / f : 0.0);
+    }
+
+    printf("\nratio > 1 means the fixed-point backend is faster.\n");
+    return 0;
+}
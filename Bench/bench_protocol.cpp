@@ -0,0 +1,341 @@
+/**
+  ******************************************************************************
+  * @file           : bench_protocol.cpp
+  * @brief          : Loopback of the binary calculation protocol over the mock UART
+  * @author         : STM32 Calculator Project
+  * @date           : 2024
+  ******************************************************************************
+  *
+  * Host only. The host client (Tools/calc_client) talks to the firmware's
+  * RX task, wired as in main.cpp, through the virtual-time mock UART in
+  * both directions at the chosen baud rate. Full batches are pipelined a
+  * few frames deep; every result is checked against the same arithmetic
+  * done on the host, and operations per second of virtual time are
+  * reported per operand format.
+  *
+  * Usage: bench_protocol [operations per format] [--baud n] [--window n]
+  */
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <vector>
+#include "calculator.h"
+#include "calc_protocol.h"
+#include "display.h"
+#include "scheduler.h"
+#include "uart_rx_channel.h"
+#include "calc_client.h"
+
+// No response for this long: the rest are not coming
+static const uint64_t STALL_US = 1000000;
+
+// Room a text reply needs in the TX queue, as APP_RX_REPLY_MAX in main.h
+static const size_t REPLY_MAX = 48;
+
+// Firmware objects, wired as in main.cpp
+static UART_HandleTypeDef huart1;
+static Calculator calculator;
+static Display display(&huart1);
+static UartRxChannel uart_rx(&huart1);
+static CalcFrameDecoder frame_decoder;
+static uint8_t frame_reply[CALC_FRAME_MAX];
+static Scheduler scheduler;
+static int8_t task_uart_rx;
+static int8_t task_display;
+
+static void notify_uart_rx(void* context) {
+    (void)context;
+    scheduler.notify((uint8_t)task_uart_rx);
+}
+
+static bool read_frame_bytes() {
+    uint8_t bytes[32];
+    size_t wanted = frame_decoder.wanted();
+    size_t count = uart_rx.read(bytes, wanted < sizeof(bytes) ? wanted : sizeof(bytes));
+    for (size_t i = 0; i < count; i++) {
+        frame_decoder.push(bytes[i]);
+    }
+    return count > 0;
+}
+
+static void handle_frame() {
+    size_t length = calc_protocol_serve(calculator, frame_decoder.payload(), frame_decoder.payload_length(),
+                                        frame_reply, sizeof(frame_reply));
+    frame_decoder.release();
+    if (length != 0) {
+        display.write_uart(frame_reply, length);
+    }
+}
+
+static void handle_line(const char* line) {
+    calc_value_t result = calculator.evaluate(line);
+    if (calculator.is_error()) {
+        display.print_uart_error(calculator.get_last_error());
+    } else {
+        display.print_uart_result(result);
+    }
+}
+
+static void uart_rx_task(void* context) {
+    (void)context;
+    char line[UART_RX_LINE_MAX + 1];
+    uint8_t byte;
+    for (;;) {
+        if (frame_decoder.is_ready()) {
+            if (display.tx_free_space() <
+                calc_protocol_reply_max(frame_decoder.payload(), frame_decoder.payload_length())) {
+                break;
+            }
+            handle_frame();
+        } else if (frame_decoder.in_frame() || (uart_rx.peek(byte) && byte == CALC_FRAME_SYNC)) {
+            if (!read_frame_bytes()) {
+                return;
+            }
+            continue;
+        } else if (!uart_rx.has_data()) {
+            return;
+        } else if (display.tx_free_space() < REPLY_MAX) {
+            break;
+        } else if (uart_rx.read_line(line, sizeof(line))) {
+            handle_line(line);
+        } else if (uart_rx.peek(byte) && (byte & 0x80) != 0) {
+            uart_rx.read(&byte, 1);
+            continue;
+        } else {
+            return;
+        }
+        scheduler.notify((uint8_t)task_display);
+    }
+    scheduler.wake_after((uint8_t)task_uart_rx, 1);
+}
+
+static void display_task(void* context) {
+    (void)context;
+    display.poll();
+}
+
+// Tickless idle as in main.cpp: sleep until the next deadline or interrupt
+static void enter_idle(uint32_t sleep_ms) {
+    mock_wfi_tickless(sleep_ms);
+}
+
+// Host side of the line: requests go onto the wire, responses come back
+static void client_write(const uint8_t* data, size_t length, void* context) {
+    (void)context;
+    mock_uart_receive(&huart1, data, length);
+}
+
+static void client_receive(UART_HandleTypeDef* huart, const uint8_t* data, size_t length, void* context) {
+    (void)huart;
+    static_cast<CalcClient*>(context)->receive(data, length);
+}
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ull;
+
+static uint32_t rng_next() {
+    // xorshift64*
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (uint32_t)((rng_state * 0x2545F4914F6CDD1Dull) >> 32);
+}
+
+// Request sent, with what its response must hold
+struct Expected {
+    uint16_t request_id;
+    std::vector<double> results;
+    std::vector<uint8_t> lane_status;
+};
+
+// A value as it reads after a trip through the wire format
+static double on_wire(CalcOperandFormat format, double value) {
+    uint8_t bytes[8];
+    calc_operand_put(format, value, bytes);
+    return calc_operand_get(format, bytes);
+}
+
+static Expected make_batch(CalcClient& client, CalcOpcode opcode, CalcOperandFormat format) {
+    size_t lanes = calc_batch_lanes_max(format);
+    std::vector<double> a(lanes), b(lanes);
+    Expected expected;
+    expected.lane_status.assign(lanes, CALC_LANE_OK);
+    bool failed = false;
+    for (size_t i = 0; i < lanes; i++) {
+        // Q16.16 holds +/-32768: keep products in range
+        a[i] = on_wire(format, (int32_t)(rng_next() % 20000 - 10000) / 64.0);
+        b[i] = on_wire(format, (int32_t)(rng_next() % 2000 - 1000) / 64.0);
+        if (opcode == CALC_OP_DIVIDE && rng_next() % 64 == 0) {
+            b[i] = 0;
+        }
+        double value;
+        switch (opcode) {
+            case CALC_OP_ADD: value = a[i] + b[i]; break;
+            case CALC_OP_SUBTRACT: value = a[i] - b[i]; break;
+            case CALC_OP_MULTIPLY: value = a[i] * b[i]; break;
+            default: value = b[i] != 0 ? a[i] / b[i] : 0; break;
+        }
+        if (opcode == CALC_OP_DIVIDE && b[i] == 0) {
+            expected.lane_status[i] = CALC_LANE_DIVISION_BY_ZERO;
+            failed = true;
+        }
+        expected.results.push_back(on_wire(format, value));
+    }
+    if (!failed) {
+        expected.lane_status.clear();
+    }
+    expected.request_id = (uint16_t)client.send_batch(opcode, format, a.data(), b.data(), lanes);
+    return expected;
+}
+
+static Expected make_eval(CalcClient& client, CalcOperandFormat format) {
+    char text[32];
+    uint32_t a = rng_next() % 1000;
+    uint32_t b = rng_next() % 1000;
+    uint32_t c = rng_next() % 100;
+    snprintf(text, sizeof(text), "%u+%u*%u", (unsigned)a, (unsigned)b, (unsigned)c);
+    Expected expected;
+    expected.results.push_back(on_wire(format, a + (double)b * c));
+    expected.request_id = (uint16_t)client.send_eval(text, format);
+    return expected;
+}
+
+struct RunResult {
+    uint64_t operations;
+    uint64_t wrong;
+    uint64_t bytes_to_device;
+    uint64_t bytes_from_device;
+    double virtual_seconds;
+    double wall_seconds;
+};
+
+// Keeps window requests in flight until operations results have come back
+static RunResult run(CalcOperandFormat format, bool eval, uint64_t operations, size_t window) {
+    static const CalcOpcode opcodes[4] = {CALC_OP_ADD, CALC_OP_SUBTRACT, CALC_OP_MULTIPLY, CALC_OP_DIVIDE};
+    CalcClient client(client_write, nullptr);
+    mock_uart_set_tx_sink(client_receive, &client);
+    std::deque<Expected> outstanding;
+    RunResult result = {0, 0, 0, 0, 0, 0};
+    uint32_t tx_start = mock_uart_tx_bytes();
+    uint64_t start_us = mock_clock_now_us();
+    uint64_t last_progress_us = start_us;
+    uint64_t requested = 0;
+    std::chrono::steady_clock::time_point wall_start = std::chrono::steady_clock::now();
+
+    while (result.operations < operations) {
+        while (outstanding.size() < window && requested < operations) {
+            Expected expected = eval ? make_eval(client, format)
+                                     : make_batch(client, opcodes[rng_next() % 4], format);
+            requested += expected.results.size();
+            outstanding.push_back(expected);
+        }
+        scheduler.run_once();
+        CalcResponse response;
+        while (client.next_response(response)) {
+            last_progress_us = mock_clock_now_us();
+            if (outstanding.empty()) {
+                result.wrong++;
+                continue;
+            }
+            const Expected& expected = outstanding.front();
+            if (response.request_id != expected.request_id || response.results != expected.results ||
+                response.lane_status != expected.lane_status) {
+                result.wrong++;
+            }
+            result.operations += expected.results.size();
+            outstanding.pop_front();
+        }
+        if (mock_clock_now_us() - last_progress_us > STALL_US) {
+            break;  // Responses went missing
+        }
+    }
+
+    result.virtual_seconds = (mock_clock_now_us() - start_us) / 1e6;
+    result.wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+    result.bytes_to_device = client.bytes_sent();
+    result.bytes_from_device = mock_uart_tx_bytes() - tx_start;
+    if (result.operations < operations || client.get_frame_stats().crc_errors != 0) {
+        result.wrong += operations - result.operations + client.get_frame_stats().crc_errors;
+    }
+    mock_uart_set_tx_sink(nullptr, nullptr);
+    return result;
+}
+
+int main(int argc, char** argv) {
+    uint64_t operations = 200000;
+    uint32_t baud = 115200;
+    size_t window = 3;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--baud") == 0 && i + 1 < argc) {
+            baud = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--window") == 0 && i + 1 < argc) {
+            window = (size_t)strtoul(argv[++i], nullptr, 10);
+        } else if (argv[i][0] != '-') {
+            operations = strtoull(argv[i], nullptr, 10);
+        } else {
+            fprintf(stderr, "usage: %s [operations per format] [--baud n] [--window n]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (window == 0) {
+        window = 1;
+    }
+
+    mock_set_console_echo(false);
+    mock_clock_set_mode(MOCK_CLOCK_VIRTUAL);
+    mock_uart_set_tx_mode(MOCK_UART_TX_TIMED);
+    mock_uart_set_baud(baud);
+
+    calculator.clear();
+    task_uart_rx = scheduler.add_task("uart_rx", uart_rx_task, nullptr);
+    task_display = scheduler.add_task("display", display_task, nullptr);
+    scheduler.set_idle_hook(enter_idle);
+    uart_rx.set_notify(notify_uart_rx, nullptr);
+    if (!uart_rx.start()) {
+        fprintf(stderr, "reception did not start\n");
+        return 1;
+    }
+
+    static const struct {
+        CalcOperandFormat format;
+        bool eval;
+        const char* name;
+    } modes[] = {
+        {CALC_FORMAT_F64, false, "f64"},
+        {CALC_FORMAT_F32, false, "f32"},
+        {CALC_FORMAT_Q16_16, false, "q16.16"},
+        {CALC_FORMAT_F64, true, "eval f64"},
+    };
+
+    printf("Protocol loopback at %u baud, %u requests in flight\n", (unsigned)baud, (unsigned)window);
+    // Bytes per operation: both directions, frames included
+    printf("%-10s %6s %10s %8s %12s %10s %10s %12s %10s\n",
+           "format", "lanes", "ops", "wrong", "virtual s", "ops/s", "B/op in", "B/op out", "wall s");
+    int status = 0;
+    for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+        // Expressions are one operation each: fewer of them
+        uint64_t count = modes[i].eval ? operations / 20 : operations;
+        RunResult result = run(modes[i].format, modes[i].eval, count, window);
+        printf("%-10s %6u %10llu %8llu %12.2f %10.0f %10.2f %12.2f %10.3f\n",
+               modes[i].name, modes[i].eval ? 1u : (unsigned)calc_batch_lanes_max(modes[i].format),
+               (unsigned long long)result.operations, (unsigned long long)result.wrong,
+               result.virtual_seconds, result.operations / result.virtual_seconds,
+               (double)result.bytes_to_device / result.operations,
+               (double)result.bytes_from_device / result.operations, result.wall_seconds);
+        if (result.wrong != 0) {
+            status = 1;
+        }
+    }
+    UartRxStats rx = uart_rx.get_stats();
+    CalcFrameStats frames = frame_decoder.get_stats();
+    printf("Device: %u frames, %u CRC errors, %u overruns, %u bytes lost\n",
+           (unsigned)frames.frames, (unsigned)frames.crc_errors, (unsigned)rx.overruns, (unsigned)rx.bytes_lost);
+    if (rx.overruns != 0 || rx.bytes_lost != 0 || frames.crc_errors != 0) {
+        status = 1;
+    }
+    return status;
+}
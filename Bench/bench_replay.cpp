@@ -0,0 +1,274 @@
+/**
+  ******************************************************************************
+  * @file           : bench_replay.cpp
+  * @brief          : Replays scripted keypad sessions on the virtual-time mock HAL
+  * @author         : STM32 Calculator Project
+  * @date           : 2024
+  ******************************************************************************
+  *
+  * Host only. The firmware's keypad, scheduler, calculator and display run
+  * as in main.cpp against the simulated key matrix; the mock clock is
+  * virtual, so debounce and scan periods cost no wall time. Every session
+  * types random "a op b =" sums and checks each result.
+  *
+  * UART transfers take their wire time at 115200 baud. With --trace, a build
+  * with CALC_TRACE writes one trace dump per mode for Tools/trace_decode.
+  *
+  * Usage: bench_replay [expressions per mode] [--trace file]
+  */
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include "calculator.h"
+#include "display.h"
+#include "keypad.h"
+#include "scheduler.h"
+#include "trace.h"
+
+// Human-like typing: held past the debounce time, then released as long
+static const uint32_t HOLD_MS = 60;
+static const uint32_t GAP_MS = 60;
+
+// Expressions scripted at a time, so the script stays small
+static const uint32_t BATCH_EXPRESSIONS = 1000;
+
+static const uint16_t row_pins[4] = {GPIO_PIN_0, GPIO_PIN_1, GPIO_PIN_2, GPIO_PIN_3};
+static const uint16_t col_pins[4] = {GPIO_PIN_4, GPIO_PIN_5, GPIO_PIN_6, GPIO_PIN_7};
+
+// Firmware objects, wired as in main.cpp
+static UART_HandleTypeDef huart1;
+static TIM_HandleTypeDef htim2;
+static Calculator calculator;
+static Display display(&huart1);
+static Keypad keypad;
+static Scheduler* scheduler = nullptr;
+static int8_t task_keypad;
+static int8_t task_display;
+
+// Session bookkeeping
+static uint32_t keys_typed = 0;
+static uint32_t results_checked = 0;
+static uint32_t results_wrong = 0;
+static double expected_result = 0;
+
+extern "C" void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef* htim) {
+    (void)htim;
+    keypad.timer_callback();
+    if (scheduler != nullptr && keypad.has_events()) {
+        scheduler->notify((uint8_t)task_keypad);
+    }
+}
+
+extern "C" void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin) {
+    keypad.on_column_interrupt(GPIO_Pin);
+    if (scheduler != nullptr) {
+        scheduler->notify((uint8_t)task_keypad);
+    }
+}
+
+static void handle_key(KeyCode key, void* context) {
+    (void)context;
+    TRACE_EVENT(TRACE_KEY_DISPATCH, key);
+    keys_typed++;
+    calculator.process_input((char)key);
+    if (key >= '0' && key <= '9') {
+        display.print_number(calculator.get_current_value());
+    } else if (key == '+' || key == '-' || key == '*' || key == '/') {
+        display.print_operation((char)key);
+    } else if (key == '=') {
+        double result = CalcNum::to_double(calculator.get_last_result());
+        results_checked++;
+        if (std::fabs(result - expected_result) > 1e-6 * (1 + std::fabs(expected_result))) {
+            results_wrong++;
+        }
+        display.print_result(calculator.get_last_result());
+    } else if (key == 'C') {
+        display.clear();
+        display.show_calculator_mode();
+    }
+    scheduler->notify((uint8_t)task_display);
+}
+
+static void keypad_task(void* context) {
+    (void)context;
+    keypad.handle_key_event();
+}
+
+static void display_task(void* context) {
+    (void)context;
+    display.poll();
+}
+
+// Tickless idle as in main.cpp: sleep until the next deadline or interrupt
+static void enter_idle(uint32_t sleep_ms) {
+    mock_wfi_tickless(sleep_ms);
+}
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ull;
+
+static uint32_t rng_next() {
+    // xorshift64*
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (uint32_t)((rng_state * 0x2545F4914F6CDD1Dull) >> 32);
+}
+
+// Schedules one key stroke at at_us; returns the time of the next one
+static uint64_t script_key(char key, uint64_t at_us) {
+    for (uint8_t row = 0; row < 4; row++) {
+        for (uint8_t col = 0; col < 4; col++) {
+            if (keypad.key_at(row, col) == (KeyCode)key) {
+                mock_keypad_schedule(at_us, row, col, true);
+                mock_keypad_schedule(at_us + HOLD_MS * 1000, row, col, false);
+                return at_us + (HOLD_MS + GAP_MS) * 1000;
+            }
+        }
+    }
+    return at_us;
+}
+
+static uint64_t script_number(uint32_t value, uint64_t at_us) {
+    char digits[12];
+    int length = snprintf(digits, sizeof(digits), "%u", (unsigned)value);
+    for (int i = 0; i < length; i++) {
+        at_us = script_key(digits[i], at_us);
+    }
+    return at_us;
+}
+
+// Runs the firmware until the script is typed and the keypad is quiet
+static void run_until_typed(uint64_t quiet_us) {
+    while (mock_keypad_scheduled() > 0) {
+        scheduler->run_once();
+    }
+    // Last release still has to pass the debounce
+    uint64_t end_us = mock_clock_now_us() + quiet_us;
+    while (mock_clock_now_us() < end_us) {
+        scheduler->run_once();
+    }
+}
+
+struct ReplayResult {
+    uint32_t keys_scripted;
+    uint64_t virtual_us;
+    double wall_seconds;
+};
+
+static ReplayResult replay(KeypadMode mode, uint32_t expressions) {
+    static const char ops[3] = {'+', '-', '*'};
+    Scheduler session;
+    scheduler = &session;
+    keys_typed = results_checked = results_wrong = 0;
+
+    keypad.set_timer(&htim2);
+    keypad.init(mode);
+    keypad.set_key_callback(handle_key);
+    calculator.clear();
+    task_keypad = session.add_task("keypad", keypad_task, nullptr);
+    task_display = session.add_task("display", display_task, nullptr);
+    session.set_idle_hook(enter_idle);
+    trace_reset();
+
+    ReplayResult result = {0, 0, 0};
+    uint64_t start_us = mock_clock_now_us();
+    std::chrono::steady_clock::time_point wall_start = std::chrono::steady_clock::now();
+    uint32_t done = 0;
+    while (done < expressions) {
+        for (uint32_t i = 0; i < BATCH_EXPRESSIONS && done < expressions; i++, done++) {
+            uint32_t a = rng_next() % 1000;
+            uint32_t b = rng_next() % 1000;
+            char op = ops[rng_next() % 3];
+            expected_result = op == '+' ? (double)a + b : op == '-' ? (double)a - b : (double)a * b;
+            uint64_t at_us = mock_clock_now_us() + GAP_MS * 1000;
+            at_us = script_number(a, at_us);
+            at_us = script_key(op, at_us);
+            at_us = script_number(b, at_us);
+            at_us = script_key('=', at_us);
+            script_key('C', at_us);
+            run_until_typed(KEYPAD_DEBOUNCE_MS * 1000);
+        }
+    }
+    result.wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+    result.virtual_us = mock_clock_now_us() - start_us;
+    result.keys_scripted = keys_typed;
+    scheduler = nullptr;
+    return result;
+}
+
+static void write_trace_line(const char* line, void* context) {
+    fprintf(static_cast<FILE*>(context), "%s\n", line);
+}
+
+int main(int argc, char** argv) {
+    uint32_t expressions = 20000;
+    const char* trace_path = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else if (argv[i][0] != '-') {
+            expressions = (uint32_t)strtoul(argv[i], nullptr, 10);
+        } else {
+            fprintf(stderr, "usage: %s [expressions per mode] [--trace file]\n", argv[0]);
+            return 2;
+        }
+    }
+    FILE* trace_file = nullptr;
+    if (trace_path != nullptr) {
+        trace_file = fopen(trace_path, "w");
+        if (trace_file == nullptr) {
+            fprintf(stderr, "cannot write %s\n", trace_path);
+            return 1;
+        }
+#ifndef CALC_TRACE
+        fprintf(stderr, "built without CALC_TRACE: the dumps will be empty\n");
+#endif
+    }
+
+    mock_set_console_echo(false);
+    mock_clock_set_mode(MOCK_CLOCK_VIRTUAL);
+    mock_uart_set_tx_mode(MOCK_UART_TX_TIMED);
+    trace_init();
+    mock_keypad_attach(GPIOA, row_pins, 4, GPIOA, col_pins, 4);
+
+    static const struct {
+        KeypadMode mode;
+        const char* name;
+    } modes[] = {
+        {KEYPAD_MODE_TIMER, "timer"},
+        {KEYPAD_MODE_INTERRUPT, "interrupt"},
+    };
+
+    printf("Replay of %u expressions per keypad mode (%u ms hold, %u ms gap)\n",
+           (unsigned)expressions, (unsigned)HOLD_MS, (unsigned)GAP_MS);
+    // Key events: the press and release of each stroke, as applied to the matrix
+    printf("%-10s %10s %8s %12s %10s %12s %14s %12s\n",
+           "mode", "keys", "wrong", "virtual s", "wall s", "keys/s", "key events/s", "x real time");
+    int status = 0;
+    for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+        ReplayResult result = replay(modes[i].mode, expressions);
+        double virtual_seconds = result.virtual_us / 1e6;
+        printf("%-10s %10u %8u %12.1f %10.3f %12.0f %14.0f %12.0f\n",
+               modes[i].name, (unsigned)result.keys_scripted, (unsigned)results_wrong,
+               virtual_seconds, result.wall_seconds,
+               result.keys_scripted / result.wall_seconds,
+               2 * result.keys_scripted / result.wall_seconds,
+               virtual_seconds / result.wall_seconds);
+        if (results_wrong != 0 || results_checked != expressions) {
+            status = 1;
+        }
+        if (trace_file != nullptr) {
+            trace_dump(write_trace_line, trace_file);
+        }
+    }
+    if (trace_file != nullptr) {
+        fclose(trace_file);
+        printf("Trace dumps (timer, interrupt) written to %s\n", trace_path);
+    }
+    printf("UART bytes sent: %u\n", (unsigned)mock_uart_tx_bytes());
+    return status;
+}
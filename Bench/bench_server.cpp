@@ -0,0 +1,434 @@
+/**
+  ******************************************************************************
+  * @file           : bench_server.cpp
+  * @brief          : Load generator for the calculator server (Tools/calc_server)
+  * @author         : STM32 Calculator Project
+  * @date           : 2024
+  ******************************************************************************
+  *
+  * Host only (Linux). Opens every connection first, so the server holds
+  * them all at once, then drives them together from one epoll loop with
+  * a few requests in flight on each. Text connections store their own
+  * number in memory, evaluate expressions and read memory back at the
+  * end, which only works if each connection has its own Calculator;
+  * every tenth connection sends pipelined binary batches instead. Every
+  * reply is checked. Reports requests per second, client-side latency
+  * percentiles, and the server's own STATS.
+  *
+  * Usage: bench_server (--unix path | --tcp port) [--connections n]
+  *                     [--requests n] [--pipeline n]
+  */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <vector>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include "calc_client.h"
+#include "number_format.h"
+
+// The server may still be starting
+static const uint64_t CONNECT_RETRY_NS = 5000000000ull;
+
+// Nothing received for this long: give up on the rest
+static const uint64_t STALL_NS = 10000000000ull;
+
+static const size_t BINARY_LANES = 8;
+
+static const char* unix_path = nullptr;
+static int tcp_port = -1;
+
+struct Expected {
+    std::string reply;              // Text: the exact line; binary: unused
+    uint64_t sent_ns;
+};
+
+struct Connection {
+    int fd;
+    bool binary;
+    bool writable_wanted;
+    uint32_t number;                // Stored in and recalled from memory
+    size_t next_request;            // Script position
+    size_t total_requests;
+    std::string output;
+    size_t output_sent;
+    std::string input;
+    std::deque<Expected> in_flight;
+    CalcClient* client;
+};
+
+static uint64_t now_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static std::string result_line(double value) {
+    char number[NUMBER_FORMAT_MAX];
+    number_format_shortest(value, number, sizeof(number));
+    return std::string(" = ") + number;
+}
+
+// Blocking connect, so a full listen backlog waits instead of failing
+static int open_connection() {
+    int fd;
+    if (unix_path != nullptr) {
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        strncpy(address.sun_path, unix_path, sizeof(address.sun_path) - 1);
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd >= 0 && connect(fd, (sockaddr*)&address, sizeof(address)) != 0) {
+            close(fd);
+            return -1;
+        }
+    } else {
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_port = htons((uint16_t)tcp_port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd >= 0 && connect(fd, (sockaddr*)&address, sizeof(address)) != 0) {
+            close(fd);
+            return -1;
+        }
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    }
+    if (fd >= 0) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    }
+    return fd;
+}
+
+static void append_output(const uint8_t* data, size_t length, void* context) {
+    static_cast<Connection*>(context)->output.append((const char*)data, length);
+}
+
+// Text script: k*1, MS, expressions on k, MR
+static void queue_text_request(Connection& connection) {
+    size_t step = connection.next_request++;
+    uint32_t k = connection.number;
+    char line[64];
+    Expected expected;
+    if (step == 0) {
+        snprintf(line, sizeof(line), "%u*1", k);
+        expected.reply = result_line(k);
+    } else if (step == 1) {
+        snprintf(line, sizeof(line), "MS");
+        expected.reply = "OK";
+    } else if (step + 1 == connection.total_requests) {
+        snprintf(line, sizeof(line), "MR");
+        expected.reply = result_line(k);
+    } else {
+        snprintf(line, sizeof(line), "(%u+%u)*2-%u/4", k, (unsigned)step, k);
+        expected.reply = result_line((k + (double)step) * 2 - k / 4.0);
+    }
+    expected.sent_ns = now_ns();
+    connection.output += line;
+    connection.output += "\r\n";
+    connection.in_flight.push_back(expected);
+}
+
+static void queue_binary_request(Connection& connection) {
+    size_t step = connection.next_request++;
+    double a[BINARY_LANES];
+    double b[BINARY_LANES];
+    for (size_t i = 0; i < BINARY_LANES; i++) {
+        a[i] = connection.number + (double)i;
+        b[i] = (double)step;
+    }
+    connection.client->send_batch(CALC_OP_ADD, CALC_FORMAT_F64, a, b, BINARY_LANES);
+    Expected expected;
+    expected.sent_ns = now_ns();
+    connection.in_flight.push_back(expected);
+}
+
+// Checks the replies read so far; false on a wrong one
+static bool take_replies(Connection& connection, std::vector<uint64_t>& latencies, size_t& failures) {
+    uint64_t now = now_ns();
+    if (connection.binary) {
+        connection.client->receive((const uint8_t*)connection.input.data(), connection.input.size());
+        connection.input.clear();
+        CalcResponse response;
+        while (connection.client->next_response(response)) {
+            if (connection.in_flight.empty()) {
+                return false;
+            }
+            bool good = response.status == CALC_STATUS_OK && response.results.size() == BINARY_LANES;
+            for (size_t i = 0; good && i < BINARY_LANES; i++) {
+                good = response.results[i] == connection.number + (double)i + (double)response.request_id;
+            }
+            if (!good) {
+                failures++;
+            }
+            latencies.push_back(now - connection.in_flight.front().sent_ns);
+            connection.in_flight.pop_front();
+        }
+        return true;
+    }
+    size_t pos = 0;
+    for (;;) {
+        size_t end = connection.input.find("\r\n", pos);
+        if (end == std::string::npos) {
+            break;
+        }
+        if (connection.in_flight.empty()) {
+            return false;
+        }
+        if (connection.input.compare(pos, end - pos, connection.in_flight.front().reply) != 0) {
+            if (failures < 5) {
+                fprintf(stderr, "connection %u: expected \"%s\", got \"%s\"\n", connection.number,
+                        connection.in_flight.front().reply.c_str(),
+                        connection.input.substr(pos, end - pos).c_str());
+            }
+            failures++;
+        }
+        latencies.push_back(now - connection.in_flight.front().sent_ns);
+        connection.in_flight.pop_front();
+        pos = end + 2;
+    }
+    connection.input.erase(0, pos);
+    return true;
+}
+
+static bool flush(Connection& connection) {
+    while (connection.output_sent < connection.output.size()) {
+        ssize_t sent = send(connection.fd, connection.output.data() + connection.output_sent,
+                            connection.output.size() - connection.output_sent, MSG_NOSIGNAL);
+        if (sent > 0) {
+            connection.output_sent += (size_t)sent;
+        } else if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;
+        } else if (sent < 0 && errno == EINTR) {
+            continue;
+        } else {
+            return false;
+        }
+    }
+    connection.output.clear();
+    connection.output_sent = 0;
+    return true;
+}
+
+// One more connection asks the server for its latency histogram
+static bool print_server_stats() {
+    int fd = open_connection();
+    if (fd < 0) {
+        return false;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+    const char request[] = "STATS\r\n";
+    if (send(fd, request, sizeof(request) - 1, MSG_NOSIGNAL) != (ssize_t)(sizeof(request) - 1)) {
+        close(fd);
+        return false;
+    }
+    std::string reply;
+    char buffer[1024];
+    while (reply.find("END\r\n") == std::string::npos) {
+        ssize_t got = recv(fd, buffer, sizeof(buffer), 0);
+        if (got <= 0) {
+            break;
+        }
+        reply.append(buffer, (size_t)got);
+    }
+    close(fd);
+    printf("Server:\n");
+    size_t pos = 0;
+    size_t end;
+    while ((end = reply.find("\r\n", pos)) != std::string::npos) {
+        printf("  %s\n", reply.substr(pos, end - pos).c_str());
+        pos = end + 2;
+    }
+    return reply.find("END\r\n") != std::string::npos;
+}
+
+static uint64_t percentile(const std::vector<uint64_t>& sorted, double fraction) {
+    size_t index = (size_t)(fraction * (sorted.size() - 1) + 0.5);
+    return sorted[index];
+}
+
+int main(int argc, char** argv) {
+    size_t connection_count = 1000;
+    size_t requests = 20;
+    size_t pipeline = 4;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--unix") == 0 && i + 1 < argc) {
+            unix_path = argv[++i];
+        } else if (strcmp(argv[i], "--tcp") == 0 && i + 1 < argc) {
+            tcp_port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--connections") == 0 && i + 1 < argc) {
+            connection_count = strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--requests") == 0 && i + 1 < argc) {
+            requests = strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--pipeline") == 0 && i + 1 < argc) {
+            pipeline = strtoul(argv[++i], nullptr, 10);
+        } else {
+            fprintf(stderr, "usage: %s (--unix path | --tcp port) [--connections n] [--requests n] [--pipeline n]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+    if ((unix_path == nullptr) == (tcp_port < 0) || connection_count == 0 || requests < 3 || pipeline == 0) {
+        fprintf(stderr, "bench_server: need one of --unix or --tcp, at least 3 requests\n");
+        return 2;
+    }
+
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+        if (limit.rlim_cur < connection_count + 16) {
+            fprintf(stderr, "bench_server: %zu connections need more than the %llu descriptors allowed\n",
+                    connection_count, (unsigned long long)limit.rlim_cur);
+            return 1;
+        }
+    }
+
+    printf("Calculator server load: %zu connections, %zu requests each, %zu in flight\n",
+           connection_count, requests, pipeline);
+
+    // Open everything before sending anything
+    std::vector<Connection> connections(connection_count);
+    uint64_t started = now_ns();
+    for (size_t i = 0; i < connection_count; i++) {
+        Connection& connection = connections[i];
+        connection.fd = open_connection();
+        while (connection.fd < 0 && i == 0 && now_ns() - started < CONNECT_RETRY_NS) {
+            usleep(20000);
+            connection.fd = open_connection();
+        }
+        if (connection.fd < 0) {
+            fprintf(stderr, "bench_server: connection %zu: %s\n", i, strerror(errno));
+            return 1;
+        }
+        connection.binary = i % 10 == 9;
+        connection.writable_wanted = false;
+        connection.number = (uint32_t)i + 1;
+        connection.next_request = 0;
+        connection.total_requests = requests;
+        connection.output_sent = 0;
+        connection.client = connection.binary ? new CalcClient(append_output, &connection) : nullptr;
+    }
+    uint64_t connected = now_ns();
+    printf("  connected:   %zu in %.1f ms\n", connection_count, (connected - started) / 1e6);
+
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    for (size_t i = 0; i < connection_count; i++) {
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.ptr = &connections[i];
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, connections[i].fd, &event);
+    }
+
+    std::vector<uint64_t> latencies;
+    latencies.reserve(connection_count * requests);
+    size_t failures = 0;
+    size_t finished = 0;
+    size_t broken = 0;
+    uint64_t last_progress = now_ns();
+
+    // Fills the pipeline; the send loop below runs on every reply
+    std::vector<Connection*> to_fill;
+    for (size_t i = 0; i < connection_count; i++) {
+        to_fill.push_back(&connections[i]);
+    }
+    std::vector<epoll_event> events(1024);
+    while (finished + broken < connection_count) {
+        for (size_t i = 0; i < to_fill.size(); i++) {
+            Connection& connection = *to_fill[i];
+            while (connection.next_request < connection.total_requests && connection.in_flight.size() < pipeline) {
+                if (connection.binary) {
+                    queue_binary_request(connection);
+                } else {
+                    queue_text_request(connection);
+                }
+            }
+            if (!flush(connection)) {
+                broken++;
+                epoll_ctl(epoll_fd, EPOLL_CTL_DEL, connection.fd, nullptr);
+                continue;
+            }
+            bool want_write = connection.output_sent < connection.output.size();
+            if (want_write != connection.writable_wanted) {
+                epoll_event event = {};
+                event.events = EPOLLIN | (want_write ? EPOLLOUT : 0u);
+                event.data.ptr = &connection;
+                epoll_ctl(epoll_fd, EPOLL_CTL_MOD, connection.fd, &event);
+                connection.writable_wanted = want_write;
+            }
+        }
+        to_fill.clear();
+
+        int count = epoll_wait(epoll_fd, events.data(), (int)events.size(), 100);
+        if (count > 0) {
+            last_progress = now_ns();
+        } else if (now_ns() - last_progress > STALL_NS) {
+            fprintf(stderr, "bench_server: stalled with %zu connections unfinished\n",
+                    connection_count - finished - broken);
+            break;
+        }
+        for (int i = 0; i < count; i++) {
+            Connection& connection = *static_cast<Connection*>(events[i].data.ptr);
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                char buffer[4096];
+                ssize_t got = recv(connection.fd, buffer, sizeof(buffer), 0);
+                if (got <= 0 && !(got < 0 && (errno == EAGAIN || errno == EINTR))) {
+                    broken++;
+                    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, connection.fd, nullptr);
+                    continue;
+                }
+                if (got > 0) {
+                    connection.input.append(buffer, (size_t)got);
+                    if (!take_replies(connection, latencies, failures)) {
+                        failures++;
+                    }
+                }
+                if (connection.next_request == connection.total_requests && connection.in_flight.empty()) {
+                    finished++;
+                    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, connection.fd, nullptr);
+                    continue;
+                }
+            }
+            to_fill.push_back(&connection);
+        }
+    }
+    uint64_t done = now_ns();
+
+    double seconds = (done - connected) / 1e9;
+    printf("  requests:    %zu in %.3f s, %.0f requests/s\n", latencies.size(), seconds,
+           latencies.size() / seconds);
+    if (!latencies.empty()) {
+        std::sort(latencies.begin(), latencies.end());
+        printf("  latency us:  p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n",
+               percentile(latencies, 0.5) / 1e3, percentile(latencies, 0.9) / 1e3,
+               percentile(latencies, 0.99) / 1e3, percentile(latencies, 0.999) / 1e3,
+               latencies.back() / 1e3);
+    }
+    printf("  finished:    %zu, broken %zu, wrong replies %zu\n", finished, broken, failures);
+
+    // All connections are still open while the server reports
+    bool stats_ok = print_server_stats();
+    for (size_t i = 0; i < connection_count; i++) {
+        close(connections[i].fd);
+        delete connections[i].client;
+    }
+    close(epoll_fd);
+
+    bool passed = finished == connection_count && failures == 0 && stats_ok;
+    printf("%s\n", passed ? "PASS" : "FAIL");
+    return passed ? 0 : 1;
+}
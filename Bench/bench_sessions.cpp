@@ -0,0 +1,193 @@
+/**
+  ******************************************************************************
+  * @file           : bench_sessions.cpp
+  * @brief          : Benchmark of the session table against one Calculator per session
+  * @author         : STM32 Calculator Project
+  * @date           : 2024
+  ******************************************************************************
+  *
+  * Host only. A million keypad sessions, of which a slice is typing at any
+  * one time: the keys of the sessions in a slice arrive interleaved in a
+  * random order, each session finishing its expression with '=', then the
+  * next slice starts. The same key stream is fed to one Calculator per
+  * session and to a SessionTable with one stack block per active session;
+  * every session's state is compared at the end, and memory per session
+  * and keys per second (best of a few passes) are reported for both.
+  *
+  * Usage: bench_sessions [sessions] [--active n] [--batch n]
+  */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "calculator.h"
+#include "session_table.h"
+
+typedef std::chrono::steady_clock BenchClock;
+
+// Timed passes over the key stream; the machine's noise mostly goes away
+// in the best of them
+static const int PASSES = 5;
+
+static uint32_t rng_state = 12345;
+
+static uint32_t next_random() {
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return rng_state >> 8;
+}
+
+// One expression per session, varied by its id
+static std::string session_script(uint32_t session) {
+    static const char ops[] = "+-*/";
+    char text[48];
+    uint32_t a = session % 9973;
+    uint32_t b = session % 97 + 1;
+    uint32_t c = session % 13 + 2;
+    if (session % 32 == 31) {
+        snprintf(text, sizeof(text), "%u/0=", a);                      // Division by zero
+    } else if (session % 16 == 7) {
+        snprintf(text, sizeof(text), "(%u%c%u)*%u.5=", a, ops[session % 4], b, c);
+    } else {
+        snprintf(text, sizeof(text), "%u%c%u%c%u=", a, ops[session % 4], b, ops[(session / 4) % 4], c);
+    }
+    return text;
+}
+
+struct KeyStream {
+    std::vector<uint32_t> sessions;
+    std::vector<char> keys;
+};
+
+// Slice by slice: in round r every session of the slice types its r-th key,
+// the sessions in shuffled order
+static void build_stream(uint32_t session_count, uint32_t active, KeyStream& stream) {
+    std::vector<std::string> scripts(session_count);
+    for (uint32_t s = 0; s < session_count; s++) {
+        scripts[s] = session_script(s);
+    }
+    std::vector<uint32_t> order;
+    for (uint32_t first = 0; first < session_count; first += active) {
+        uint32_t last = first + active < session_count ? first + active : session_count;
+        size_t longest = 0;
+        for (uint32_t s = first; s < last; s++) {
+            longest = scripts[s].size() > longest ? scripts[s].size() : longest;
+        }
+        order.clear();
+        for (uint32_t s = first; s < last; s++) {
+            order.push_back(s);
+        }
+        for (size_t round = 0; round < longest; round++) {
+            for (size_t i = order.size(); i > 1; i--) {
+                size_t j = next_random() % i;
+                uint32_t swap = order[i - 1];
+                order[i - 1] = order[j];
+                order[j] = swap;
+            }
+            for (size_t i = 0; i < order.size(); i++) {
+                if (round < scripts[order[i]].size()) {
+                    stream.sessions.push_back(order[i]);
+                    stream.keys.push_back(scripts[order[i]][round]);
+                }
+            }
+        }
+    }
+}
+
+static double elapsed_ms(BenchClock::time_point start) {
+    return std::chrono::duration<double, std::milli>(BenchClock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+    uint32_t session_count = 1000000;
+    uint32_t active = 0;
+    size_t batch = 4096;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--active") == 0 && i + 1 < argc) {
+            active = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            batch = strtoul(argv[++i], nullptr, 10);
+        } else {
+            session_count = (uint32_t)strtoul(argv[i], nullptr, 10);
+        }
+    }
+    if (active == 0 || active > session_count) {
+        active = session_count / 8 > 0 ? session_count / 8 : session_count;
+    }
+    if (session_count == 0 || batch == 0) {
+        fprintf(stderr, "usage: %s [sessions] [--active n] [--batch n]\n", argv[0]);
+        return 2;
+    }
+
+    KeyStream stream;
+    build_stream(session_count, active, stream);
+    size_t key_count = stream.keys.size();
+    printf("Session table: %u sessions, %u typing at a time, %zu keys, batches of %zu\n",
+           session_count, active, key_count, batch);
+
+    // The same keys through one Calculator per session and through the
+    // table, alternating; the best pass of each counts
+    std::vector<Calculator> calculators;
+    size_t bytes = SessionTable::storage_size(session_count, active);
+    std::vector<uint64_t> storage((bytes + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+    SessionTable table;
+    double objects_ms = 0;
+    double table_ms = 0;
+    uint32_t peak_blocks = 0;
+    for (int pass = 0; pass < PASSES; pass++) {
+        calculators.assign(session_count, Calculator());
+        BenchClock::time_point start = BenchClock::now();
+        for (size_t i = 0; i < key_count; i++) {
+            calculators[stream.sessions[i]].process_input(stream.keys[i]);
+        }
+        double ms = elapsed_ms(start);
+        objects_ms = pass == 0 || ms < objects_ms ? ms : objects_ms;
+
+        if (!table.init(storage.data(), bytes, session_count, active)) {
+            fprintf(stderr, "bench_sessions: table init failed\n");
+            return 1;
+        }
+        start = BenchClock::now();
+        for (size_t first = 0; first < key_count; first += batch) {
+            size_t n = key_count - first < batch ? key_count - first : batch;
+            table.process_input(&stream.sessions[first], &stream.keys[first], n);
+            peak_blocks = table.blocks_in_use() > peak_blocks ? table.blocks_in_use() : peak_blocks;
+        }
+        ms = elapsed_ms(start);
+        table_ms = pass == 0 || ms < table_ms ? ms : table_ms;
+    }
+
+    size_t mismatches = 0;
+    size_t errors = 0;
+    for (uint32_t s = 0; s < session_count; s++) {
+        const Calculator& calculator = calculators[s];
+        bool same = CalcNum::to_double(calculator.get_current_value()) == CalcNum::to_double(table.get_current_value(s)) &&
+                    CalcNum::to_double(calculator.get_last_result()) == CalcNum::to_double(table.get_last_result(s)) &&
+                    calculator.get_error_code() == table.get_error_code(s) &&
+                    calculator.get_status_flags() == table.get_status_flags(s);
+        if (!same && mismatches++ < 5) {
+            fprintf(stderr, "session %u (\"%s\"): calculator %g/%d, table %g/%d\n", s, session_script(s).c_str(),
+                    CalcNum::to_double(calculator.get_last_result()), calculator.get_error_code(),
+                    CalcNum::to_double(table.get_last_result(s)), table.get_error_code(s));
+        }
+        errors += calculator.is_error() ? 1 : 0;
+    }
+
+    size_t idle_bytes = SessionTable::storage_size(session_count, 0);
+    double block_bytes = (double)(bytes - idle_bytes) / active;
+    printf("  %-22s %8s %12s %10s %10s\n", "", "B/session", "total MB", "ms", "Mkeys/s");
+    printf("  %-22s %8zu %12.1f %10.1f %10.2f\n", "Calculator objects", sizeof(Calculator),
+           (double)sizeof(Calculator) * session_count / 1e6, objects_ms, key_count / objects_ms / 1e3);
+    printf("  %-22s %8.1f %12.1f %10.1f %10.2f\n", "SessionTable", (double)bytes / session_count,
+           bytes / 1e6, table_ms, key_count / table_ms / 1e3);
+    printf("  idle session %.1f B, stack block %.1f B, blocks in use at most %u of %u\n",
+           (double)idle_bytes / session_count, block_bytes, peak_blocks, active);
+    printf("  sessions in error %zu, mismatches %zu\n", errors, mismatches);
+
+    bool passed = mismatches == 0 && table.blocks_in_use() == 0;
+    printf("%s\n", passed ? "PASS" : "FAIL");
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,212 @@
+/**
+  ******************************************************************************
+  * @file           : bench_uart_rx.cpp
+  * @brief          : Streams expression lines into the UART RX channel at line rate
+  * @author         : STM32 Calculator Project
+  * @date           : 2024
+  ******************************************************************************
+  *
+  * Host only. A host sends expression lines back to back at 115200 baud,
+  * as in main.cpp the RX task evaluates each one and queues its reply on
+  * the same UART. The mock clock is virtual; each evaluation is charged
+  * --eval-us of it, standing in for the MCU's time. Every result is
+  * checked, and no received byte may be lost.
+  *
+  * Usage: bench_uart_rx [lines] [--eval-us n] [--baud n]
+  */
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include "calculator.h"
+#include "display.h"
+#include "scheduler.h"
+#include "uart_rx_channel.h"
+
+// Lines handed to the mock UART at a time, so the wire stays short
+static const uint32_t BATCH_LINES = 64;
+
+// Expected results of the lines sent and not evaluated yet (power of two)
+static const uint32_t EXPECTED_SIZE = 256;
+
+// No line evaluated for this long: the rest are not coming
+static const uint64_t STALL_US = 1000000;
+
+// Room a reply needs in the TX queue, as APP_RX_REPLY_MAX in main.h
+static const size_t REPLY_MAX = 48;
+
+// Firmware objects, wired as in main.cpp
+static UART_HandleTypeDef huart1;
+static Calculator calculator;
+static Display display(&huart1);
+static UartRxChannel uart_rx(&huart1);
+static Scheduler scheduler;
+static int8_t task_uart_rx;
+static int8_t task_display;
+
+// Session bookkeeping
+static double expected[EXPECTED_SIZE];
+static uint32_t lines_sent = 0;
+static uint32_t results_checked = 0;
+static uint32_t results_wrong = 0;
+static uint32_t eval_us = 20;
+
+static void notify_uart_rx(void* context) {
+    (void)context;
+    scheduler.notify((uint8_t)task_uart_rx);
+}
+
+static void handle_line(const char* line) {
+    calc_value_t result = calculator.evaluate(line);
+    mock_clock_advance_us(eval_us);
+    double want = expected[results_checked % EXPECTED_SIZE];
+    results_checked++;
+    if (calculator.is_error()) {
+        results_wrong++;
+        display.print_uart_error(calculator.get_last_error());
+        return;
+    }
+    double got = CalcNum::to_double(result);
+    if (std::fabs(got - want) > 1e-6 * (1 + std::fabs(want))) {
+        results_wrong++;
+    }
+    display.print_uart_result(result);
+}
+
+static void uart_rx_task(void* context) {
+    (void)context;
+    char line[UART_RX_LINE_MAX + 1];
+    while (display.tx_free_space() >= REPLY_MAX) {
+        if (!uart_rx.read_line(line, sizeof(line))) {
+            return;
+        }
+        handle_line(line);
+        scheduler.notify((uint8_t)task_display);
+    }
+    if (uart_rx.has_data()) {
+        scheduler.wake_after((uint8_t)task_uart_rx, 1);
+    }
+}
+
+static void display_task(void* context) {
+    (void)context;
+    display.poll();
+}
+
+// Tickless idle as in main.cpp: sleep until the next deadline or interrupt
+static void enter_idle(uint32_t sleep_ms) {
+    mock_wfi_tickless(sleep_ms);
+}
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ull;
+
+static uint32_t rng_next() {
+    // xorshift64*
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (uint32_t)((rng_state * 0x2545F4914F6CDD1Dull) >> 32);
+}
+
+// Appends one "a op b op c" line with CR LF; its result goes to expected
+static size_t script_line(char* out, size_t size) {
+    static const char ops[3] = {'+', '-', '*'};
+    uint32_t a = rng_next() % 1000;
+    uint32_t b = rng_next() % 1000;
+    uint32_t c = rng_next() % 100;
+    char op1 = ops[rng_next() % 3];
+    char op2 = ops[rng_next() % 3];
+    // Precedence: the product binds first
+    double value;
+    if (op2 == '*') {
+        double bc = (double)b * c;
+        value = op1 == '+' ? a + bc : op1 == '-' ? a - bc : a * bc;
+    } else {
+        double ab = op1 == '+' ? (double)a + b : op1 == '-' ? (double)a - b : (double)a * b;
+        value = op2 == '+' ? ab + c : ab - c;
+    }
+    expected[lines_sent % EXPECTED_SIZE] = value;
+    lines_sent++;
+    return (size_t)snprintf(out, size, "%u%c%u%c%u\r\n", (unsigned)a, op1, (unsigned)b, op2, (unsigned)c);
+}
+
+int main(int argc, char** argv) {
+    uint32_t lines = 20000;
+    uint32_t baud = 115200;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--eval-us") == 0 && i + 1 < argc) {
+            eval_us = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--baud") == 0 && i + 1 < argc) {
+            baud = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        } else if (argv[i][0] != '-') {
+            lines = (uint32_t)strtoul(argv[i], nullptr, 10);
+        } else {
+            fprintf(stderr, "usage: %s [lines] [--eval-us n] [--baud n]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    mock_set_console_echo(false);
+    mock_clock_set_mode(MOCK_CLOCK_VIRTUAL);
+    mock_uart_set_tx_mode(MOCK_UART_TX_TIMED);
+    mock_uart_set_baud(baud);
+
+    calculator.clear();
+    task_uart_rx = scheduler.add_task("uart_rx", uart_rx_task, nullptr);
+    task_display = scheduler.add_task("display", display_task, nullptr);
+    scheduler.set_idle_hook(enter_idle);
+    uart_rx.set_notify(notify_uart_rx, nullptr);
+    if (!uart_rx.start()) {
+        fprintf(stderr, "reception did not start\n");
+        return 1;
+    }
+
+    uint64_t bytes_sent = 0;
+    uint64_t start_us = mock_clock_now_us();
+    std::chrono::steady_clock::time_point wall_start = std::chrono::steady_clock::now();
+    uint64_t last_progress_us = start_us;
+    char batch[BATCH_LINES * 24];
+    while (lines_sent < lines || results_checked < lines_sent) {
+        // Keep the wire busy: the next batch goes out before this one ends
+        if (lines_sent < lines && mock_uart_rx_pending(&huart1) < sizeof(batch) / 2) {
+            size_t used = 0;
+            for (uint32_t i = 0; i < BATCH_LINES && lines_sent < lines; i++) {
+                used += script_line(batch + used, sizeof(batch) - used);
+            }
+            mock_uart_receive(&huart1, (const uint8_t*)batch, used);
+            bytes_sent += used;
+        }
+        uint32_t checked = results_checked;
+        scheduler.run_once();
+        if (results_checked != checked) {
+            last_progress_us = mock_clock_now_us();
+        } else if (mock_clock_now_us() - last_progress_us > STALL_US) {
+            break;  // Lines went missing
+        }
+    }
+    display.flush(1000);
+    double wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+    double virtual_seconds = (mock_clock_now_us() - start_us) / 1e6;
+
+    UartRxStats stats = uart_rx.get_stats();
+    UartTxStats tx = display.get_tx_stats();
+    printf("UART RX of %u lines at %u baud, %u us per evaluation\n",
+           (unsigned)lines, (unsigned)baud, (unsigned)eval_us);
+    printf("%10s %8s %8s %10s %8s %12s %12s %12s %10s\n",
+           "lines", "wrong", "missing", "overruns", "lost", "virtual s", "lines/s", "bytes/s", "wall s");
+    printf("%10u %8u %8u %10u %8u %12.2f %12.0f %12.0f %10.3f\n",
+           (unsigned)stats.lines, (unsigned)results_wrong, (unsigned)(lines - results_checked),
+           (unsigned)stats.overruns, (unsigned)stats.bytes_lost, virtual_seconds,
+           stats.lines / virtual_seconds, stats.bytes_received / virtual_seconds, wall_seconds);
+    // 10 bits per byte: the share of the line rate the channel kept up with
+    printf("RX %llu bytes (%.1f%% of line rate), TX %u bytes, %u transfers\n",
+           (unsigned long long)bytes_sent, 100.0 * bytes_sent * 10 / baud / virtual_seconds,
+           (unsigned)mock_uart_tx_bytes(), (unsigned)tx.transfers);
+
+    bool ok = results_wrong == 0 && results_checked == lines && stats.overruns == 0 &&
+              stats.bytes_lost == 0 && stats.lines_too_long == 0;
+    return ok ? 0 : 1;
+}
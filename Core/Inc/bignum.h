@@ -0,0 +1,140 @@
+/**
+  ******************************************************************************
+  * @file           : bignum.h
+  * @brief          : Arbitrary-precision integer and decimal numbers (host)
+  * @author         : STM32 Calculator Project
+  * @date           : 2024
+  ******************************************************************************
+  */
+
+#ifndef __BIGNUM_H
+#define __BIGNUM_H
+
+#ifdef __cplusplus
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Limb counts where multiplication switches algorithm (32-bit limbs)
+#ifndef BIGNUM_KARATSUBA_THRESHOLD
+#define BIGNUM_KARATSUBA_THRESHOLD  48
+#endif
+
+#ifndef BIGNUM_TOOM3_THRESHOLD
+#define BIGNUM_TOOM3_THRESHOLD      256
+#endif
+
+// Fractional digits kept by BigDecimal division and square root
+#ifndef BIGNUM_DIV_DIGITS
+#define BIGNUM_DIV_DIGITS           32
+#endif
+
+// Refuse results larger than this many decimal digits (runaway powers)
+#ifndef BIGNUM_MAX_DIGITS
+#define BIGNUM_MAX_DIGITS           1000000
+#endif
+
+/**
+  * Signed integer of unbounded size: sign + magnitude stored as little-endian
+  * 32-bit limbs with no leading zero limbs (zero is the empty vector).
+  * Multiplication uses schoolbook, Karatsuba or Toom-3 by operand size,
+  * division is Knuth's algorithm D.
+  */
+class BigInt {
+public:
+    typedef uint32_t Limb;
+
+    // Constructors
+    BigInt();
+    BigInt(int64_t value);
+    static bool parse(const char* text, size_t length, BigInt& out);
+
+    // Conversion
+    std::string to_string() const;
+    double to_double() const;
+    size_t limb_count() const { return limbs.size(); }
+    size_t bit_length() const;
+    bool is_zero() const { return limbs.empty(); }
+    bool is_negative() const { return negative; }
+    bool is_even() const { return limbs.empty() || (limbs[0] & 1) == 0; }
+
+    // Arithmetic
+    static BigInt add(const BigInt& a, const BigInt& b);
+    static BigInt sub(const BigInt& a, const BigInt& b);
+    static BigInt mul(const BigInt& a, const BigInt& b);
+    static bool divmod(const BigInt& a, const BigInt& b, BigInt& quotient, BigInt& remainder);
+    static BigInt pow(const BigInt& base, uint32_t exponent);
+    static BigInt pow10(uint32_t exponent);
+    static BigInt isqrt(const BigInt& value);
+    static int compare(const BigInt& a, const BigInt& b);
+
+    // In-place helpers for hot paths
+    BigInt& mul_small(Limb factor);
+    Limb divmod_small(Limb divisor);
+    BigInt& shift_left(size_t bits);
+    BigInt operator-() const;
+
+    // Algorithm selection (for benchmarks); 0 restores the defaults
+    static void set_multiply_thresholds(size_t karatsuba, size_t toom3);
+
+    bool operator==(const BigInt& other) const { return compare(*this, other) == 0; }
+    bool operator!=(const BigInt& other) const { return compare(*this, other) != 0; }
+    bool operator<(const BigInt& other) const { return compare(*this, other) < 0; }
+
+private:
+    std::vector<Limb> limbs;
+    bool negative;
+};
+
+/**
+  * Exact decimal: unscaled * 10^-scale. Addition, subtraction and
+  * multiplication are exact; division and square root round half away from
+  * zero at max(BIGNUM_DIV_DIGITS, operand scales) fractional digits.
+  */
+class BigDecimal {
+public:
+    // Constructors
+    BigDecimal();
+    BigDecimal(int64_t value);
+    BigDecimal(const BigInt& unscaled, uint32_t scale);
+    static BigDecimal from_scientific(uint64_t mantissa, int32_t exponent);
+    static BigDecimal from_double(double value);
+    static bool parse(const char* text, size_t length, BigDecimal& out);
+
+    // Conversion
+    std::string to_string() const;
+    double to_double() const;
+    const BigInt& unscaled_value() const { return unscaled; }
+    uint32_t scale_value() const { return scale; }
+    bool is_zero() const { return unscaled.is_zero(); }
+    bool is_negative() const { return unscaled.is_negative(); }
+
+    // Arithmetic; the bool variants fail on domain errors or oversized results
+    static BigDecimal add(const BigDecimal& a, const BigDecimal& b);
+    static BigDecimal sub(const BigDecimal& a, const BigDecimal& b);
+    static BigDecimal mul(const BigDecimal& a, const BigDecimal& b);
+    static bool div(const BigDecimal& a, const BigDecimal& b, BigDecimal& out);
+    static bool sqrt(const BigDecimal& value, BigDecimal& out);
+    static bool pow(const BigDecimal& base, const BigDecimal& exponent, BigDecimal& out);
+    static int compare(const BigDecimal& a, const BigDecimal& b);
+
+    // Drops trailing fractional zeros (1.2500 -> 1.25)
+    void normalize();
+
+    bool operator==(const BigDecimal& other) const { return compare(*this, other) == 0; }
+    bool operator!=(const BigDecimal& other) const { return compare(*this, other) != 0; }
+    bool operator<(const BigDecimal& other) const { return compare(*this, other) < 0; }
+
+private:
+    BigInt unscaled;
+    uint32_t scale;
+
+    BigInt rescaled(uint32_t new_scale) const;
+    size_t digit_estimate() const;
+};
+
+#endif // __cplusplus
+
+#endif // __BIGNUM_H
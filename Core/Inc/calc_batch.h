@@ -0,0 +1,49 @@
+/**
+  ******************************************************************************
+  * @file           : calc_batch.h
+  * @brief          : Batch arithmetic kernels (SIMD on the host, scalar on MCU)
+  * @author         : STM32 Calculator Project
+  * @date           : 2024
+  ******************************************************************************
+  */
+
+#ifndef __CALC_BATCH_H
+#define __CALC_BATCH_H
+
+#ifdef __cplusplus
+
+#include <cstddef>
+#include <cstdint>
+#include "calc_error.h"
+
+// Per-lane status written by the batch kernels (a subset of CalcError)
+enum CalcLaneStatus : uint8_t {
+    CALC_LANE_OK = CALC_ERROR_NONE,
+    CALC_LANE_INVALID_NUMBER = CALC_ERROR_INVALID_NUMBER,       // NaN or Inf operand
+    CALC_LANE_DIVISION_BY_ZERO = CALC_ERROR_DIVISION_BY_ZERO
+};
+
+// Instruction set picked by the runtime dispatcher
+enum CalcBatchIsa : uint8_t {
+    CALC_BATCH_SCALAR = 0,
+    CALC_BATCH_SSE2,
+    CALC_BATCH_AVX2
+};
+
+/**
+  * Element-wise out[i] = a[i] op b[i] for i < n. Lanes that fail validation
+  * produce 0.0 in out[] and a non-zero CalcLaneStatus in lane_status[] (which
+  * may be nullptr). Returns the number of failed lanes. out may alias a or b.
+  */
+size_t calc_batch_add(const double* a, const double* b, double* out, size_t n, uint8_t* lane_status);
+size_t calc_batch_subtract(const double* a, const double* b, double* out, size_t n, uint8_t* lane_status);
+size_t calc_batch_multiply(const double* a, const double* b, double* out, size_t n, uint8_t* lane_status);
+size_t calc_batch_divide(const double* a, const double* b, double* out, size_t n, uint8_t* lane_status);
+
+// Dispatch control (mainly for benchmarks); forcing an unsupported ISA is ignored
+CalcBatchIsa calc_batch_active_isa();
+void calc_batch_force_isa(CalcBatchIsa isa);
+
+#endif // __cplusplus
+
+#endif // __CALC_BATCH_H
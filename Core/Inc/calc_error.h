@@ -0,0 +1,43 @@
+/**
+  ******************************************************************************
+  * @file           : calc_error.h
+  * @brief          : Calculator error codes and sticky status flags
+  * @author         : STM32 Calculator Project
+  * @date           : 2024
+  ******************************************************************************
+  */
+
+#ifndef __CALC_ERROR_H
+#define __CALC_ERROR_H
+
+#ifdef __cplusplus
+
+#include <cstdint>
+
+// Error code of the last failed operation (one byte, no heap)
+enum CalcError : uint8_t {
+    CALC_ERROR_NONE = 0,
+    CALC_ERROR_INVALID_NUMBER,
+    CALC_ERROR_DIVISION_BY_ZERO,
+    CALC_ERROR_INVALID_SQRT,
+    CALC_ERROR_INVALID_PERCENTAGE,
+    CALC_ERROR_SYNTAX,
+    CALC_ERROR_TOO_LONG,
+    CALC_ERROR_COUNT
+};
+
+// Sticky status flags in the style of IEEE 754 exception flags: raised by
+// operations, never cleared by a later successful one, only by the caller.
+enum CalcStatusFlag : uint8_t {
+    CALC_FLAG_INVALID         = 0x01,
+    CALC_FLAG_DIVIDE_BY_ZERO  = 0x02,
+    CALC_FLAG_OVERFLOW        = 0x04,
+    CALC_FLAG_SYNTAX          = 0x08
+};
+
+// Static, NUL-terminated description of an error code
+const char* calc_error_string(CalcError error);
+
+#endif // __cplusplus
+
+#endif // __CALC_ERROR_H
@@ -0,0 +1,191 @@
+/**
+  ******************************************************************************
+  * @file           : calc_number.h
+  * @brief          : Numeric backend selection for the calculator engine
+  * @author         : STM32 Calculator Project
+  * @date           : 2024
+  ******************************************************************************
+  */
+
+#ifndef __CALC_NUMBER_H
+#define __CALC_NUMBER_H
+
+#ifdef __cplusplus
+
+#include <cmath>
+#include <cstdint>
+#include "fixed_point.h"
+
+/**
+  * mantissa * 10^exponent in the floating type W. Exact whenever both the
+  * mantissa and the power of ten fit W (Clinger's fast path), pow() otherwise.
+  */
+template <typename W>
+inline W calc_scale_pow10(uint64_t mantissa, int32_t exponent) {
+    static const W exact_pow10[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    W m = (W)mantissa;
+    if (exponent == 0 || mantissa == 0) {
+        return m;
+    }
+    if (mantissa < (1ULL << 53) && exponent > 0 && exponent <= 22) {
+        return m * exact_pow10[exponent];
+    }
+    if (mantissa < (1ULL << 53) && exponent < 0 && exponent >= -22) {
+        return m / exact_pow10[-exponent];
+    }
+    return m * std::pow((W)10, (W)exponent);
+}
+
+/**
+  * Per-type arithmetic used by the calculator engine. Every backend provides
+  * the same static functions so BasicCalculator<T> is identical for float,
+  * double and Fixed; the bool-returning ones report domain errors (sqrt of a
+  * negative, ...).
+  */
+template <typename T>
+struct NumTraits;
+
+// IEEE backends; decimal conversions are done in W (>= F) to round only once
+template <typename F, typename W>
+struct FloatNumTraits {
+    static constexpr F zero() { return (F)0; }
+    static F from_int(int32_t value) { return (F)value; }
+    static F from_double(double value) { return (F)value; }
+    static double to_double(F value) { return (double)value; }
+
+    // mantissa / 10^decimals; exact in double for up to 15 digits
+    static F from_decimal(int64_t mantissa, uint8_t decimals) {
+        W magnitude = calc_scale_pow10<W>(mantissa < 0 ? 0 - (uint64_t)mantissa : (uint64_t)mantissa,
+                                          -(int32_t)decimals);
+        return (F)(mantissa < 0 ? -magnitude : magnitude);
+    }
+
+    static F from_scientific(uint64_t mantissa, int32_t exponent) {
+        return (F)calc_scale_pow10<W>(mantissa, exponent);
+    }
+
+    static bool is_valid(F value) { return !(std::isnan(value) || std::isinf(value)); }
+    static bool is_overflow(F value) { return std::isinf(value); }
+    static bool is_zero(F value) { return value == (F)0; }
+    static bool is_negative(F value) { return value < (F)0; }
+
+    static F add(F a, F b) { return a + b; }
+    static F sub(F a, F b) { return a - b; }
+    static F mul(F a, F b) { return a * b; }
+    static F div(F a, F b) { return a / b; }
+
+    static bool sqrt(F value, F& out) {
+        out = std::sqrt(value);
+        return value >= (F)0;
+    }
+
+    static bool pow(F base, F exponent, F& out) {
+        out = std::pow(base, exponent);
+        return !std::isnan(out);
+    }
+};
+
+template <>
+struct NumTraits<float> : FloatNumTraits<float, double> {};
+
+template <>
+struct NumTraits<double> : FloatNumTraits<double, double> {};
+
+template <>
+struct NumTraits<long double> : FloatNumTraits<long double, long double> {};
+
+template <>
+struct NumTraits<Fixed> {
+    static constexpr Fixed zero() { return Fixed(); }
+    static Fixed from_int(int32_t value) { return Fixed::from_int(value); }
+    static Fixed from_double(double value) { return Fixed::from_double(value); }
+    static double to_double(Fixed value) { return value.to_double(); }
+    static Fixed from_decimal(int64_t mantissa, uint8_t decimals) {
+        return Fixed::from_decimal(mantissa, decimals);
+    }
+    static Fixed from_scientific(uint64_t mantissa, int32_t exponent) {
+        return Fixed::from_scientific(mantissa, exponent);
+    }
+
+    // Fixed has no NaN/Inf; saturation is reported as overflow instead
+    static bool is_valid(Fixed) { return true; }
+    static bool is_overflow(Fixed value) { return value.is_saturated(); }
+    static bool is_zero(Fixed value) { return value.is_zero(); }
+    static bool is_negative(Fixed value) { return value.is_negative(); }
+
+    static Fixed add(Fixed a, Fixed b) { return Fixed::add(a, b); }
+    static Fixed sub(Fixed a, Fixed b) { return Fixed::sub(a, b); }
+    static Fixed mul(Fixed a, Fixed b) { return Fixed::mul(a, b); }
+    static Fixed div(Fixed a, Fixed b) { return a / b; }
+
+    static bool sqrt(Fixed value, Fixed& out) { return Fixed::sqrt(value, out); }
+    static bool pow(Fixed base, Fixed exponent, Fixed& out) { return Fixed::pow(base, exponent, out); }
+};
+
+#if defined(CALC_NUMERIC_BIGNUM) && !defined(CALC_ENABLE_BIGNUM)
+#define CALC_ENABLE_BIGNUM
+#endif
+
+#ifdef CALC_ENABLE_BIGNUM
+#include "bignum.h"
+
+// Host-only arbitrary precision; fractional powers are a domain error
+template <>
+struct NumTraits<BigDecimal> {
+    static BigDecimal zero() { return BigDecimal(); }
+    static BigDecimal from_int(int32_t value) { return BigDecimal(value); }
+    static BigDecimal from_double(double value) { return BigDecimal::from_double(value); }
+    static double to_double(const BigDecimal& value) { return value.to_double(); }
+    static BigDecimal from_decimal(int64_t mantissa, uint8_t decimals) {
+        return BigDecimal(BigInt(mantissa), decimals);
+    }
+    static BigDecimal from_scientific(uint64_t mantissa, int32_t exponent) {
+        return BigDecimal::from_scientific(mantissa, exponent);
+    }
+
+    static bool is_valid(const BigDecimal&) { return true; }
+    static bool is_overflow(const BigDecimal&) { return false; }
+    static bool is_zero(const BigDecimal& value) { return value.is_zero(); }
+    static bool is_negative(const BigDecimal& value) { return value.is_negative(); }
+
+    static BigDecimal add(const BigDecimal& a, const BigDecimal& b) { return BigDecimal::add(a, b); }
+    static BigDecimal sub(const BigDecimal& a, const BigDecimal& b) { return BigDecimal::sub(a, b); }
+    static BigDecimal mul(const BigDecimal& a, const BigDecimal& b) { return BigDecimal::mul(a, b); }
+    static BigDecimal div(const BigDecimal& a, const BigDecimal& b) {
+        BigDecimal out;
+        BigDecimal::div(a, b, out);
+        return out;
+    }
+
+    static bool sqrt(const BigDecimal& value, BigDecimal& out) { return BigDecimal::sqrt(value, out); }
+    static bool pow(const BigDecimal& base, const BigDecimal& exponent, BigDecimal& out) {
+        return BigDecimal::pow(base, exponent, out);
+    }
+};
+#endif // CALC_ENABLE_BIGNUM
+
+// Compile-time backend, normally chosen by the firmware Makefile from the
+// required precision: CALC_NUMERIC_FIXED for the integer-only Q-format path,
+// CALC_NUMERIC_FLOAT for single-precision soft-float, CALC_NUMERIC_LONG_DOUBLE
+// for extended precision on the host, CALC_NUMERIC_BIGNUM for exact decimals
+// on the host, otherwise double
+#if defined(CALC_NUMERIC_FIXED)
+typedef Fixed calc_value_t;
+#elif defined(CALC_NUMERIC_FLOAT)
+typedef float calc_value_t;
+#elif defined(CALC_NUMERIC_LONG_DOUBLE)
+typedef long double calc_value_t;
+#elif defined(CALC_NUMERIC_BIGNUM)
+typedef BigDecimal calc_value_t;
+#else
+typedef double calc_value_t;
+#endif
+
+typedef NumTraits<calc_value_t> CalcNum;
+
+#endif // __cplusplus
+
+#endif // __CALC_NUMBER_H
@@ -0,0 +1,153 @@
+/**
+  ******************************************************************************
+  * @file           : calc_protocol.h
+  * @brief          : Binary framed calculation protocol (frames, CRC16, server)
+  * @author         : STM32 Calculator Project
+  * @date           : 2024
+  ******************************************************************************
+  */
+
+#ifndef __CALC_PROTOCOL_H
+#define __CALC_PROTOCOL_H
+
+#ifdef __cplusplus
+
+#include <cstddef>
+#include <cstdint>
+#include "calculator.h"
+
+/**
+  * Frame, all multi-byte fields little-endian:
+  *   sync 0xA5 | length | payload (length bytes) | CRC16 of length and payload
+  * CRC16 is CCITT-FALSE (polynomial 0x1021, initial 0xFFFF). The sync byte
+  * has the top bit set, so frames and ASCII command lines share the UART.
+  *
+  * Request payload:   opcode | format | request id (2) | operands
+  * Response payload:  opcode | 0x80, format | request id (2) | status | results
+  *
+  * Batch opcodes take operand pairs a0 b0 a1 b1 ... and return one result
+  * per pair; CALC_STATUS_LANE_ERRORS appends one CalcLaneStatus byte per
+  * lane, failed lanes reading 0. CALC_OP_EVAL takes the expression text
+  * and returns one result, or CALC_STATUS_CALC_ERROR and a CalcError byte.
+  */
+#define CALC_FRAME_SYNC             0xA5
+// Payload bytes at most; a whole frame must fit the UART TX queue
+#ifndef CALC_FRAME_PAYLOAD_MAX
+#define CALC_FRAME_PAYLOAD_MAX      248
+#endif
+#define CALC_FRAME_OVERHEAD         4       // Sync, length, CRC16
+#define CALC_FRAME_MAX              (CALC_FRAME_PAYLOAD_MAX + CALC_FRAME_OVERHEAD)
+#define CALC_REQUEST_HEADER         4
+#define CALC_RESPONSE_HEADER        5
+#define CALC_RESPONSE_FLAG          0x80
+
+enum CalcOpcode : uint8_t {
+    CALC_OP_PING = 0x01,            // No operands; an empty OK response
+    CALC_OP_ADD = 0x10,
+    CALC_OP_SUBTRACT = 0x11,
+    CALC_OP_MULTIPLY = 0x12,
+    CALC_OP_DIVIDE = 0x13,
+    CALC_OP_EVAL = 0x20
+};
+
+// Operand and result encoding on the wire
+enum CalcOperandFormat : uint8_t {
+    CALC_FORMAT_F64 = 0,            // IEEE-754 binary64
+    CALC_FORMAT_F32,                // IEEE-754 binary32
+    CALC_FORMAT_Q16_16,             // int32, value * 65536, saturated
+    CALC_FORMAT_COUNT
+};
+
+enum CalcFrameStatus : uint8_t {
+    CALC_STATUS_OK = 0,
+    CALC_STATUS_LANE_ERRORS,
+    CALC_STATUS_CALC_ERROR,
+    CALC_STATUS_BAD_OPCODE,
+    CALC_STATUS_BAD_FORMAT,
+    CALC_STATUS_BAD_LENGTH
+};
+
+uint16_t calc_crc16(const uint8_t* data, size_t length, uint16_t crc = 0xFFFF);
+
+// Wraps a payload into frame; returns the frame length, 0 if it does not fit
+size_t calc_frame_encode(const uint8_t* payload, size_t length, uint8_t* frame, size_t size);
+
+// Operand encoding; size 0 for an unknown format
+size_t calc_operand_size(CalcOperandFormat format);
+void calc_operand_put(CalcOperandFormat format, double value, uint8_t* out);
+double calc_operand_get(CalcOperandFormat format, const uint8_t* in);
+
+// Operand pairs one request can carry
+size_t calc_batch_lanes_max(CalcOperandFormat format);
+
+// Result of CalcFrameDecoder::push()
+enum CalcFrameResult : uint8_t {
+    CALC_FRAME_NEED_MORE = 0,
+    CALC_FRAME_READY,
+    CALC_FRAME_BAD_CRC,             // Dropped; hunting for the next sync
+    CALC_FRAME_SKIPPED              // Byte outside a frame
+};
+
+struct CalcFrameStats {
+    uint32_t frames;
+    uint32_t crc_errors;
+    uint32_t bytes_skipped;
+};
+
+/**
+  * Reassembles frames from a byte stream, one byte at a time. A ready
+  * frame is held until release(); wanted() tells how many more bytes the
+  * current frame takes, so a reader never takes bytes past its end.
+  */
+class CalcFrameDecoder {
+public:
+    // Constructor
+    constexpr CalcFrameDecoder()
+        : state(STATE_SYNC)
+        , length(0)
+        , received(0)
+        , buffer{}
+        , stats() {
+    }
+
+    CalcFrameResult push(uint8_t byte);
+    size_t wanted() const;
+    bool in_frame() const { return state != STATE_SYNC; }
+    bool is_ready() const { return state == STATE_READY; }
+    const uint8_t* payload() const { return buffer + 1; }
+    size_t payload_length() const { return length; }
+    void release();
+    CalcFrameStats get_stats() const { return stats; }
+
+private:
+    enum State : uint8_t {
+        STATE_SYNC = 0,
+        STATE_LENGTH,
+        STATE_BODY,                 // Payload and CRC
+        STATE_READY
+    };
+
+    // Private member variables
+    State state;
+    uint8_t length;
+    uint16_t received;              // Bytes after the sync byte
+    uint8_t buffer[CALC_FRAME_MAX]; // Length, payload, CRC
+    CalcFrameStats stats;
+};
+
+/**
+  * Runs one request payload on calculator and writes the response frame;
+  * returns its length, 0 when the payload is too short to answer (no
+  * request id). Batch opcodes use the batch kernels and leave the
+  * calculator state alone; CALC_OP_EVAL sets it like evaluate().
+  */
+template <typename T>
+size_t calc_protocol_serve(BasicCalculator<T>& calculator, const uint8_t* request, size_t length,
+                           uint8_t* frame, size_t size);
+
+// Largest response frame a request payload can produce
+size_t calc_protocol_reply_max(const uint8_t* request, size_t length);
+
+#endif // __cplusplus
+
+#endif // __CALC_PROTOCOL_H
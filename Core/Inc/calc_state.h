@@ -0,0 +1,173 @@
+/**
+  ******************************************************************************
+  * @file           : calc_state.h
+  * @brief          : Calculator state as a value type, with pure transitions
+  * @author         : STM32 Calculator Project
+  * @date           : 2024
+  ******************************************************************************
+  */
+
+#ifndef __CALC_STATE_H
+#define __CALC_STATE_H
+
+#ifdef __cplusplus
+
+#include <cstdint>
+#include "calc_error.h"
+#include "calc_number.h"
+#include "expression.h"
+
+// Pending operand/operator depth for keypad input (bounds parenthesis nesting)
+#ifndef CALC_STACK_DEPTH
+#define CALC_STACK_DEPTH 8
+#endif
+
+template <typename T>
+class BasicSessionTable;
+
+/**
+  * Everything a calculator remembers between calls: the number being typed,
+  * the pending operands and operators, memory, the error code, the sticky
+  * status flags and the last result. It owns no pointers, so a copy is a
+  * complete snapshot. The non-const members change only this object and no
+  * global state; a state shared between threads is safe to read, and
+  * calc_next()/calc_apply() below work on a copy of it.
+  */
+template <typename T>
+class BasicCalcState {
+public:
+    // Constructor
+    constexpr BasicCalcState()
+        : current_value(Num::zero())
+        , entry_mantissa(0)
+        , entry_decimals(0)
+        , entry_point(false)
+        , entry_state(ENTRY_NONE)
+        , operand_stack()
+        , operator_stack()
+        , operand_count(0)
+        , operator_count(0)
+        , memory_value(Num::zero())
+        , error_code(CALC_ERROR_NONE)
+        , status_flags(0)
+        , last_result(Num::zero()) {
+    }
+
+    // Basic arithmetic operations: set last_result or the error and
+    // return the result, 0 on error
+    T add(T a, T b);
+    T subtract(T a, T b);
+    T multiply(T a, T b);
+    T divide(T a, T b);
+
+    // One of the operations by operator: '+', '-', '*', '/', '^' or '%'
+    // (a as a percentage of b)
+    T apply(char op, T a, T b);
+
+    // Advanced operations
+    T power(T base, T exponent);
+    T square_root(T value);
+    T percentage(T value, T total);
+
+    // Memory functions
+    void memory_store(T value);
+    T memory_recall() const;
+    void memory_clear();
+    void memory_add(T value);
+    void memory_subtract(T value);
+
+    // Utility functions
+    void clear();
+    bool is_error() const;
+    const char* get_last_error() const;
+    CalcError get_error_code() const;
+    uint8_t get_status_flags() const;
+    void clear_status_flags();
+    T get_last_result() const;
+    T get_current_value() const;
+
+    // Expression evaluation
+    T evaluate(const char* expression);
+    T evaluate(const BasicExpression<T>& expression, const T* variables = nullptr);
+
+    // Input processing
+    void process_input(char input);
+    void set_operation(char op);
+    void calculate_result();
+    // Replaces the number being typed with a finished value (memory recall,
+    // square root), which the next operator or '=' takes as its operand
+    void enter_value(T value);
+
+private:
+    typedef NumTraits<T> Num;
+
+    // Keypad state of many sessions is kept in columns and run through here
+    friend class BasicSessionTable<T>;
+
+    // Entry is capped at 15 significant digits (exact in every backend)
+    static constexpr int64_t ENTRY_MANTISSA_LIMIT = 1000000000000000LL;
+
+    // Entry state of the number currently being typed
+    enum EntryState : uint8_t {
+        ENTRY_NONE = 0,     // Nothing typed since the last operator
+        ENTRY_TYPING,       // Digits are being appended
+        ENTRY_VALUE         // Holds a finished value (result or closed group)
+    };
+
+    // Private member variables
+    T current_value;
+    int64_t entry_mantissa;
+    uint8_t entry_decimals;
+    bool entry_point;
+    EntryState entry_state;
+    T operand_stack[CALC_STACK_DEPTH];
+    char operator_stack[CALC_STACK_DEPTH];
+    uint8_t operand_count;
+    uint8_t operator_count;
+    T memory_value;
+    CalcError error_code;
+    uint8_t status_flags;
+    T last_result;
+
+    // Private helper methods
+    void set_error(CalcError error);
+    void clear_error();
+    bool validate_operation(T a, T b, char op);
+    T record_result(T result);
+    void append_digit(uint8_t digit);
+    void push_entry();
+    bool reduce_top();
+    void reduce_while(uint8_t precedence, bool right_associative);
+    void reset_input();
+    void set_expression_error(ExpressionBase::Status status);
+};
+
+// Instantiated in calc_state.cpp for every supported backend
+extern template class BasicCalcState<float>;
+extern template class BasicCalcState<double>;
+extern template class BasicCalcState<long double>;
+extern template class BasicCalcState<Fixed>;
+#ifdef CALC_ENABLE_BIGNUM
+extern template class BasicCalcState<BigDecimal>;
+#endif
+
+// State after key, as BasicCalculator::process_input(); state is unchanged
+template <typename T>
+inline BasicCalcState<T> calc_next(BasicCalcState<T> state, char key) {
+    state.process_input(key);
+    return state;
+}
+
+// State after op on a and b, as BasicCalcState::apply(): the result is in
+// get_last_result() unless is_error()
+template <typename T>
+inline BasicCalcState<T> calc_apply(BasicCalcState<T> state, char op, T a, T b) {
+    state.apply(op, a, b);
+    return state;
+}
+
+typedef BasicCalcState<calc_value_t> CalcState;
+
+#endif // __cplusplus
+
+#endif // __CALC_STATE_H
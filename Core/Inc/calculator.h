@@ -13,61 +13,90 @@
 #ifdef __cplusplus
 
 #include <cstdint>
-#include <string>
+#include "calc_state.h"
+#include "calc_batch.h"
 
-class Calculator {
+/**
+  * Calculator engine over the value type T (float, double, long double or
+  * Fixed); all arithmetic goes through NumTraits<T>. The firmware uses the
+  * Calculator typedef below, whose type the Makefile picks from the required
+  * precision. The state and its transitions are BasicCalcState<T>; this
+  * class holds one and adds the trace and profiling hooks.
+  */
+template <typename T>
+class BasicCalculator {
 public:
     // Constructor
-    Calculator();
-    
-    // Destructor
-    ~Calculator();
+    constexpr BasicCalculator()
+        : state() {
+    }
     
     // Basic arithmetic operations
-    double add(double a, double b);
-    double subtract(double a, double b);
-    double multiply(double a, double b);
-    double divide(double a, double b);
+    T add(T a, T b);
+    T subtract(T a, T b);
+    T multiply(T a, T b);
+    T divide(T a, T b);
+    
+    // Batch arithmetic: element-wise over n lanes, no shared state touched.
+    // Failed lanes yield 0.0 and a CalcLaneStatus in lane_status (optional);
+    // the return value is the number of failed lanes.
+    static size_t add(const double* a, const double* b, double* out, size_t n, uint8_t* lane_status = nullptr);
+    static size_t subtract(const double* a, const double* b, double* out, size_t n, uint8_t* lane_status = nullptr);
+    static size_t multiply(const double* a, const double* b, double* out, size_t n, uint8_t* lane_status = nullptr);
+    static size_t divide(const double* a, const double* b, double* out, size_t n, uint8_t* lane_status = nullptr);
     
     // Advanced operations
-    double power(double base, double exponent);
-    double square_root(double value);
-    double percentage(double value, double total);
+    T power(T base, T exponent);
+    T square_root(T value);
+    T percentage(T value, T total);
     
     // Memory functions
-    void memory_store(double value);
-    double memory_recall();
+    void memory_store(T value);
+    T memory_recall();
     void memory_clear();
-    void memory_add(double value);
-    void memory_subtract(double value);
+    void memory_add(T value);
+    void memory_subtract(T value);
     
     // Utility functions
     void clear();
     bool is_error() const;
-    std::string get_last_error() const;
-    double get_last_result() const;
+    const char* get_last_error() const;
+    CalcError get_error_code() const;
+    uint8_t get_status_flags() const;
+    void clear_status_flags();
+    T get_last_result() const;
+    T get_current_value() const;
+    
+    // Expression evaluation (parse once, evaluate many)
+    T evaluate(const char* expression);
+    T evaluate(const BasicExpression<T>& expression, const T* variables = nullptr);
     
     // Input processing
     void process_input(char input);
     void set_operation(char op);
     void calculate_result();
+    void enter_value(T value);
+    
+    // Snapshot of the whole state, and back
+    const BasicCalcState<T>& get_state() const { return state; }
+    void set_state(const BasicCalcState<T>& snapshot) { state = snapshot; }
     
 private:
     // Private member variables
-    double current_value;
-    double stored_value;
-    double memory_value;
-    char current_operation;
-    bool has_error;
-    std::string error_message;
-    double last_result;
-    
-    // Private helper methods
-    void set_error(const std::string& error);
-    void clear_error();
-    bool validate_operation(double a, double b, char op);
+    BasicCalcState<T> state;
 };
 
+// Instantiated in calculator.cpp for every supported backend
+extern template class BasicCalculator<float>;
+extern template class BasicCalculator<double>;
+extern template class BasicCalculator<long double>;
+extern template class BasicCalculator<Fixed>;
+#ifdef CALC_ENABLE_BIGNUM
+extern template class BasicCalculator<BigDecimal>;
+#endif
+
+typedef BasicCalculator<calc_value_t> Calculator;
+
 #endif // __cplusplus
 
 #endif // __CALCULATOR_H
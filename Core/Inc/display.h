@@ -12,25 +12,82 @@
 
 #ifdef __cplusplus
 
-#include <string>
 #include "stm32f1xx_hal.h"
+#include "fixed_point.h"
+#include "uart_tx_queue.h"
+#include "hd44780.h"
+#ifdef CALC_ENABLE_BIGNUM
+#include "bignum.h"
+#endif
 
+// Longest a print call waits for queue space before dropping output
+#ifndef DISPLAY_TX_TIMEOUT_MS
+#define DISPLAY_TX_TIMEOUT_MS   100
+#endif
+
+// Character LCD geometry
+#define DISPLAY_LCD_ROWS        2
+#define DISPLAY_LCD_COLS        16
+
+// Controller traffic of LCD refreshes
+struct LcdRefreshStats {
+    uint32_t refreshes;
+    uint32_t commands;          // Totals since construction
+    uint32_t data_bytes;
+    uint32_t last_commands;     // Sent by the latest refresh()
+    uint32_t last_data_bytes;
+};
+
+/**
+  * Text goes in as NUL-terminated strings and numbers are formatted into
+  * stack buffers: nothing allocates. The framebuffer is blanked by
+  * init_lcd(), not by the constructor.
+  */
 class Display {
 public:
     // Constructor
-    Display(UART_HandleTypeDef* huart);
-    
-    // Destructor
-    ~Display();
+    constexpr Display(UART_HandleTypeDef* huart, Hd44780* lcd = nullptr)
+        : uart_handle(huart)
+        , tx_queue(huart)
+        , lcd(lcd)
+        , lcd_available(false)
+        , lcd_frame()
+        , lcd_shown()
+        , cursor_row(0)
+        , cursor_col(0)
+        , lcd_address(LCD_ADDRESS_UNKNOWN)
+        , lcd_stats() {
+    }
     
     // Display functions
     void clear();
-    void print(const std::string& text);
-    void print_line(const std::string& text);
+    void print(const char* text);
+    void print_line(const char* text);
+    void print_number(float number);
     void print_number(double number);
-    void print_error(const std::string& error);
+    void print_number(long double number);
+    void print_number(Fixed number);
+#ifdef CALC_ENABLE_BIGNUM
+    void print_number(const BigDecimal& number);
+#endif
+    void print_error(const char* error);
+    void print_result(float result);
     void print_result(double result);
+    void print_result(long double result);
+    void print_result(Fixed result);
+#ifdef CALC_ENABLE_BIGNUM
+    void print_result(const BigDecimal& result);
+#endif
     void print_operation(char operation);
+    // Diagnostics: always to the UART, even while output is on the LCD
+    void print_uart(const char* text);
+    // Binary protocol frames, queued on the UART as they are
+    void write_uart(const uint8_t* data, size_t length);
+    // Replies to expressions received on the UART go back there, formatted
+    // as print_result() / print_error() would without an LCD
+    template <typename T>
+    void print_uart_result(const T& result);
+    void print_uart_error(const char* error);
     
     // Cursor control
     void set_cursor(uint8_t row, uint8_t col);
@@ -49,22 +106,76 @@ public:
     void show_memory_status(bool has_memory);
     void show_error_status(bool has_error);
     
+    // init_lcd() moves output to the LCD when the controller answers. It is
+    // drawn into a shadow framebuffer; refresh() sends only the cells that
+    // changed since the last refresh
+    bool init_lcd();
+    void refresh();
+    const char* get_lcd_row(uint8_t row) const;
+    LcdRefreshStats get_lcd_stats() const;
+    
+    // UART output is queued; poll() once per main loop iteration refreshes
+    // the LCD and sends held text, flush() waits until it has left the UART
+    void poll();
+    bool flush(uint32_t timeout_ms);
+    // Detaches the UART queue from its callbacks; needed before a Display
+    // on the stack goes out of scope
+    void stop();
+    size_t tx_free_space() const;
+    // Nothing queued or in flight: the UART clock may be stopped
+    bool is_tx_idle() const;
+    UartTxStats get_tx_stats() const;
+    
 private:
     // Private member variables
     UART_HandleTypeDef* uart_handle;
+    UartTxQueue tx_queue;
+    Hd44780* lcd;
     bool lcd_available;
     
+    // Shadow framebuffer: frame is what the LCD should show (rows are NUL
+    // terminated), shown what the controller holds; all NUL until init_lcd()
+    char lcd_frame[DISPLAY_LCD_ROWS][DISPLAY_LCD_COLS + 1];
+    char lcd_shown[DISPLAY_LCD_ROWS][DISPLAY_LCD_COLS];
+    uint8_t cursor_row;
+    uint8_t cursor_col;
+    uint8_t lcd_address;        // Controller address counter
+    LcdRefreshStats lcd_stats;
+    
+    static const uint8_t LCD_ADDRESS_UNKNOWN = 0xFF;
+    
+    // Where the formatting helpers write: print_uart_*() name the UART, the
+    // other print calls pass the active output
+    enum Sink : uint8_t {
+        SINK_UART = 0,
+        SINK_LCD
+    };
+    
     // Private helper methods
-    void send_uart_data(const std::string& data);
+    Sink active_sink() const;
+    void write_text(const char* text, Sink sink);
+    // The template takes the binary floating types; Fixed and BigDecimal
+    // match their own overloads
+    template <typename T>
+    void print_number_to(T number, Sink sink);
+    void print_number_to(Fixed number, Sink sink);
+#ifdef CALC_ENABLE_BIGNUM
+    void print_number_to(const BigDecimal& number, Sink sink);
+#endif
+    void print_error_to(const char* error, Sink sink);
+    template <typename T>
+    void print_result_to(const T& result, Sink sink);
     void send_uart_data(const char* data);
+    void send_uart_data(const uint8_t* data, size_t length);
     void send_uart_byte(uint8_t byte);
-    void delay_ms(uint32_t ms);
     
     // LCD specific methods (if available)
     void lcd_init();
     void lcd_send_command(uint8_t command);
     void lcd_send_data(uint8_t data);
-    void lcd_write_string(const std::string& text);
+    void lcd_write_string(const char* text);
+    void lcd_clear_row(uint8_t row);
+    static uint8_t lcd_row_address(uint8_t row);
 };
 
 #endif // __cplusplus
@@ -0,0 +1,135 @@
+/**
+  ******************************************************************************
+  * @file           : expression.h
+  * @brief          : Expression compiler (shunting-yard to postfix bytecode)
+  * @author         : STM32 Calculator Project
+  * @date           : 2024
+  ******************************************************************************
+  */
+
+#ifndef __EXPRESSION_H
+#define __EXPRESSION_H
+
+#ifdef __cplusplus
+
+#include <cstddef>
+#include <cstdint>
+#include "calc_number.h"
+
+// Capacity of a compiled program; raise on the host for very long formulas
+#ifndef EXPR_MAX_INSTRUCTIONS
+#define EXPR_MAX_INSTRUCTIONS   128
+#endif
+
+#ifndef EXPR_MAX_CONSTANTS
+#define EXPR_MAX_CONSTANTS      64
+#endif
+
+// Maximum evaluation stack depth (also bounds parenthesis nesting)
+#ifndef EXPR_MAX_DEPTH
+#define EXPR_MAX_DEPTH          32
+#endif
+
+/**
+  * Value-type independent part of the expression compiler: status codes,
+  * operator tables and the literal scanner, shared with the keypad input path.
+  */
+class ExpressionBase {
+public:
+    enum Status : uint8_t {
+        EXPR_OK = 0,
+        EXPR_EMPTY,
+        EXPR_SYNTAX_ERROR,
+        EXPR_TOO_LONG,
+        EXPR_TOO_DEEP,
+        EXPR_DIVISION_BY_ZERO,
+        EXPR_INVALID_NUMBER
+    };
+
+    // Number of variable slots ('a' .. 'z')
+    static const uint8_t VARIABLE_COUNT = 26;
+
+    // Operator helpers shared with the keypad input path
+    static uint8_t precedence(char op);
+    static bool is_right_associative(char op);
+    static bool is_binary_operator(char op);
+
+protected:
+    // Scans a decimal literal as mantissa * 10^exponent; returns the length
+    static size_t parse_number(const char* text, size_t length, uint64_t& mantissa, int32_t& exponent);
+};
+
+/**
+  * Compiles an infix formula such as "2+3*(4-x)^2" into postfix bytecode once,
+  * so it can be evaluated many times without re-parsing. Constants and the
+  * evaluation stack use the value type T (see NumTraits).
+  *
+  * Supported syntax: decimal literals (with optional exponent), single-letter
+  * variables a-z, binary + - * / ^, unary minus and parentheses. '^' is right
+  * associative and binds tighter than unary minus, so -2^2 == -4.
+  */
+template <typename T>
+class BasicExpression : public ExpressionBase {
+public:
+    // Constructor
+    BasicExpression();
+
+    // Compilation
+    Status compile(const char* text);
+    Status compile(const char* text, size_t length);
+    void reset();
+
+    // Evaluation; variables may be nullptr, in which case all read as 0
+    Status evaluate(T& result) const;
+    Status evaluate(const T* variables, T& result) const;
+
+    // Program inspection
+    bool is_compiled() const;
+    uint16_t size() const;
+    uint8_t max_depth() const;
+
+private:
+    typedef NumTraits<T> Num;
+
+    enum Opcode : uint8_t {
+        OP_CONST = 0,
+        OP_VAR,
+        OP_ADD,
+        OP_SUB,
+        OP_MUL,
+        OP_DIV,
+        OP_POW,
+        OP_NEG
+    };
+
+    struct Instruction {
+        uint8_t opcode;
+        uint8_t operand;
+    };
+
+    Instruction code[EXPR_MAX_INSTRUCTIONS];
+    T constants[EXPR_MAX_CONSTANTS];
+    uint16_t code_length;
+    uint8_t constant_count;
+    uint8_t stack_depth;
+    bool compiled;
+
+    // Private helper methods
+    bool emit(uint8_t opcode, uint8_t operand, int8_t depth_change, uint8_t& depth);
+    bool emit_operator(char op, uint8_t& depth);
+};
+
+// Instantiated in expression.cpp for every supported backend
+extern template class BasicExpression<float>;
+extern template class BasicExpression<double>;
+extern template class BasicExpression<long double>;
+extern template class BasicExpression<Fixed>;
+#ifdef CALC_ENABLE_BIGNUM
+extern template class BasicExpression<BigDecimal>;
+#endif
+
+typedef BasicExpression<calc_value_t> Expression;
+
+#endif // __cplusplus
+
+#endif // __EXPRESSION_H
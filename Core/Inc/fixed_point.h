@@ -0,0 +1,109 @@
+/**
+  ******************************************************************************
+  * @file           : fixed_point.h
+  * @brief          : 64-bit saturating fixed-point number (Q-format)
+  * @author         : STM32 Calculator Project
+  * @date           : 2024
+  ******************************************************************************
+  */
+
+#ifndef __FIXED_POINT_H
+#define __FIXED_POINT_H
+
+#ifdef __cplusplus
+
+#include <cstddef>
+#include <cstdint>
+
+// Fractional bits of the Q-format; the default Q31.32 keeps ~9 decimals
+// and an integer range of +/-2^31
+#ifndef CALC_FIXED_FRAC_BITS
+#define CALC_FIXED_FRAC_BITS 32
+#endif
+
+/**
+  * Signed Q(63-F).F number stored in an int64_t. All arithmetic is integer
+  * only (no soft-float on FPU-less cores) and saturates at the range limits
+  * instead of wrapping; is_saturated() reports a clamped value.
+  */
+class Fixed {
+    static_assert(CALC_FIXED_FRAC_BITS >= 16 && CALC_FIXED_FRAC_BITS <= 32,
+                  "Q-format must keep a 32-bit integer part and >= 16 fraction bits");
+
+public:
+    static const int FRAC_BITS = CALC_FIXED_FRAC_BITS;
+    static const int64_t RAW_ONE = (int64_t)1 << CALC_FIXED_FRAC_BITS;
+    static const int64_t RAW_MAX = INT64_MAX;
+    static const int64_t RAW_MIN = INT64_MIN;
+
+    // Constructors
+    constexpr Fixed() : raw(0) {}
+    static constexpr Fixed from_raw(int64_t value) { return Fixed(value, true); }
+    static constexpr Fixed from_int(int32_t value) { return Fixed((int64_t)value * RAW_ONE, true); }
+    static Fixed from_decimal(int64_t mantissa, uint8_t decimals);
+    static Fixed from_scientific(uint64_t mantissa, int32_t exponent);
+    static Fixed from_double(double value);
+
+    // Conversion
+    double to_double() const;
+    int64_t raw_value() const { return raw; }
+    int64_t integer_part() const { return raw >> FRAC_BITS; }
+    bool is_zero() const { return raw == 0; }
+    bool is_negative() const { return raw < 0; }
+    bool is_integer() const { return (raw & (RAW_ONE - 1)) == 0; }
+    bool is_saturated() const { return raw == RAW_MAX || raw == RAW_MIN; }
+
+    // Saturating arithmetic; the bool variants fail on domain errors
+    static Fixed add(Fixed a, Fixed b);
+    static Fixed sub(Fixed a, Fixed b);
+    static Fixed mul(Fixed a, Fixed b);
+    static bool div(Fixed a, Fixed b, Fixed& out);
+    static bool sqrt(Fixed value, Fixed& out);
+    static bool pow(Fixed base, Fixed exponent, Fixed& out);
+    static bool log2(Fixed value, Fixed& out);
+    static Fixed exp2(Fixed value);
+
+    // Text conversion without floating point or heap; returns the length
+    size_t format(char* buffer, size_t capacity, uint8_t decimals) const;
+
+    // Operators (division by zero saturates towards the dividend's sign)
+    Fixed operator+(Fixed other) const { return add(*this, other); }
+    Fixed operator-(Fixed other) const { return sub(*this, other); }
+    Fixed operator*(Fixed other) const { return mul(*this, other); }
+    Fixed operator/(Fixed other) const;
+    Fixed operator-() const { return sub(Fixed(), *this); }
+    Fixed& operator+=(Fixed other) { *this = add(*this, other); return *this; }
+    Fixed& operator-=(Fixed other) { *this = sub(*this, other); return *this; }
+
+    bool operator==(Fixed other) const { return raw == other.raw; }
+    bool operator!=(Fixed other) const { return raw != other.raw; }
+    bool operator<(Fixed other) const { return raw < other.raw; }
+    bool operator>(Fixed other) const { return raw > other.raw; }
+    bool operator<=(Fixed other) const { return raw <= other.raw; }
+    bool operator>=(Fixed other) const { return raw >= other.raw; }
+
+private:
+    constexpr Fixed(int64_t value, bool) : raw(value) {}
+
+    int64_t raw;
+};
+
+inline Fixed Fixed::add(Fixed a, Fixed b) {
+    int64_t r;
+    if (__builtin_add_overflow(a.raw, b.raw, &r)) {
+        r = (b.raw > 0) ? RAW_MAX : RAW_MIN;
+    }
+    return Fixed(r, true);
+}
+
+inline Fixed Fixed::sub(Fixed a, Fixed b) {
+    int64_t r;
+    if (__builtin_sub_overflow(a.raw, b.raw, &r)) {
+        r = (b.raw < 0) ? RAW_MAX : RAW_MIN;
+    }
+    return Fixed(r, true);
+}
+
+#endif // __cplusplus
+
+#endif // __FIXED_POINT_H
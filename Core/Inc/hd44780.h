@@ -0,0 +1,162 @@
+/**
+  ******************************************************************************
+  * @file           : hd44780.h
+  * @brief          : HD44780 character LCD driver (4-bit GPIO or PCF8574 I2C)
+  * @author         : STM32 Calculator Project
+  * @date           : 2024
+  ******************************************************************************
+  */
+
+#ifndef __HD44780_H
+#define __HD44780_H
+
+#ifdef __cplusplus
+
+#include <cstdint>
+#include "stm32f1xx_hal.h"
+
+// Datasheet timings (fosc = 270 kHz) in microseconds
+#define HD44780_POWER_ON_MS         40      // Vcc rise to first instruction
+#define HD44780_INIT_WAIT1_US       4100    // After the first function set
+#define HD44780_INIT_WAIT2_US       100     // After the second function set
+#define HD44780_EXEC_US             37      // Most instructions
+#define HD44780_WRITE_US            41      // Data write (37 + tADD 4)
+#define HD44780_CLEAR_US            1520    // Clear display / return home
+
+// Give up on the busy flag after this long and fall back to timed waits
+#ifndef HD44780_BUSY_TIMEOUT_US
+#define HD44780_BUSY_TIMEOUT_US     5000
+#endif
+
+// PCF8574 backpack wiring (the common "LCM1602" board)
+#define HD44780_I2C_ADDRESS         0x27
+#define HD44780_I2C_RS              0x01
+#define HD44780_I2C_RW              0x02
+#define HD44780_I2C_E               0x04
+#define HD44780_I2C_BACKLIGHT       0x08
+
+/**
+  * Physical interface: latches one nibble per E pulse and, where the R/W
+  * line is wired, reads the busy flag back.
+  */
+class Hd44780Bus {
+public:
+    virtual bool init() = 0;
+    // Sends bits 0-3 of nibble on D4-D7 with one E pulse
+    virtual bool write_nibble(uint8_t nibble, bool rs) = 0;
+    // Reads busy flag + address counter (two E pulses); false if R/W is not wired
+    virtual bool read_status(uint8_t& status) = 0;
+    virtual bool can_read() const = 0;
+
+protected:
+    // Never deleted through the base: trivial, so bus globals need no
+    // registered destructor
+    constexpr Hd44780Bus() {}
+    ~Hd44780Bus() = default;
+};
+
+// Pins of a directly wired module (all on one port); rw = 0 when R/W is tied low
+struct Hd44780GpioPins {
+    GPIO_TypeDef* port;
+    uint16_t rs;
+    uint16_t rw;
+    uint16_t e;
+    uint16_t data[4];       // D4..D7
+};
+
+class Hd44780GpioBus : public Hd44780Bus {
+public:
+    // Constructor
+    constexpr Hd44780GpioBus(const Hd44780GpioPins& pins) : pins(pins) {}
+
+    bool init();
+    bool write_nibble(uint8_t nibble, bool rs);
+    bool read_status(uint8_t& status);
+    bool can_read() const { return pins.rw != 0; }
+
+private:
+    Hd44780GpioPins pins;
+
+    // Private helper methods
+    void set_data_direction(bool output);
+    void pulse_enable();
+};
+
+/**
+  * PCF8574 backpack. Each expander write is one I2C frame (~90 us at
+  * 100 kHz), longer than most instruction times, so the busy flag is only
+  * polled when asked for; timed waits cover clear and home.
+  */
+class Hd44780I2cBus : public Hd44780Bus {
+public:
+    // Constructor
+    constexpr Hd44780I2cBus(I2C_HandleTypeDef* hi2c, uint8_t address = HD44780_I2C_ADDRESS,
+                            bool poll_busy = false)
+        : i2c_handle(hi2c)
+        , device_address((uint16_t)(address << 1))
+        , backlight(HD44780_I2C_BACKLIGHT)
+        , poll_busy(poll_busy) {
+    }
+
+    bool init();
+    bool write_nibble(uint8_t nibble, bool rs);
+    bool read_status(uint8_t& status);
+    bool can_read() const { return poll_busy; }
+
+    void set_backlight(bool on);
+
+private:
+    I2C_HandleTypeDef* i2c_handle;
+    uint16_t device_address;
+    uint8_t backlight;
+    bool poll_busy;
+
+    // Private helper methods
+    bool write_expander(uint8_t value);
+};
+
+class Hd44780 {
+public:
+    // Constructor
+    constexpr Hd44780(Hd44780Bus& bus)
+        : bus(bus)
+        , ready(false)
+        , busy_flag(false)
+        , ready_cycle(0)
+        , init_time_us(0) {
+    }
+
+    // Runs the 4-bit initialisation; false when no controller answers
+    bool init();
+    bool is_ready() const { return ready; }
+
+    // Instructions
+    void command(uint8_t command);
+    void write_data(uint8_t data);
+    void clear();
+    void set_address(uint8_t address);
+
+    // Time from the power-on wait ending to the controller being ready
+    uint32_t get_init_time_us() const { return init_time_us; }
+    bool uses_busy_flag() const { return busy_flag; }
+
+private:
+    Hd44780Bus& bus;
+    bool ready;
+    bool busy_flag;             // Poll BF; otherwise wait out execution times
+    uint32_t ready_cycle;       // DWT cycle count when the controller is free
+    uint32_t init_time_us;
+
+    // Private helper methods
+    void write_byte(uint8_t value, bool rs, uint32_t exec_us);
+    void wait_ready();
+    bool wait_busy_flag();
+    void set_deadline(uint32_t us);
+};
+
+// Microsecond busy-wait on the DWT cycle counter
+void hd44780_delay_us(uint32_t us);
+
+#endif // __cplusplus
+
+#endif // __HD44780_H
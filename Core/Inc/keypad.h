@@ -12,11 +12,17 @@
 
 #ifdef __cplusplus
 
+#include <atomic>
 #include <cstdint>
-#include <functional>
+#include <type_traits>
 #include "stm32f1xx_hal.h"
+#include "ring_buffer.h"
 
-// Key definitions
+// Key codes: characters keep their ASCII value, function keys that have no
+// single character start at KEY_FUNCTION_BASE
+typedef uint16_t KeyCode;
+
+#define KEY_NONE        0x0000
 #define KEY_0           '0'
 #define KEY_1           '1'
 #define KEY_2           '2'
@@ -31,77 +37,322 @@
 #define KEY_MINUS       '-'
 #define KEY_MULTIPLY    '*'
 #define KEY_DIVIDE      '/'
+#define KEY_POWER       '^'
+#define KEY_OPEN_PAREN  '('
+#define KEY_CLOSE_PAREN ')'
 #define KEY_EQUALS      '='
 #define KEY_CLEAR       'C'
 #define KEY_DECIMAL     '.'
 #define KEY_MEMORY      'M'
-#define KEY_MEMORY_ADD  'M+'
-#define KEY_MEMORY_SUB  'M-'
-#define KEY_MEMORY_RECALL 'MR'
-#define KEY_MEMORY_CLEAR 'MC'
+#define KEY_FUNCTION_BASE 0x0100
+#define KEY_MEMORY_ADD  0x0101
+#define KEY_MEMORY_SUB  0x0102
+#define KEY_MEMORY_RECALL 0x0103
+#define KEY_MEMORY_CLEAR 0x0104
+#define KEY_SQUARE_ROOT 0x0105
+#define KEY_FUNCTION_LAST KEY_SQUARE_ROOT
+
+// Largest matrix side: one byte of column bits, 64 keys in a KeyMask
+#define KEYPAD_MAX_LINES 8
+
+// Scanning modes
+enum KeypadMode {
+    KEYPAD_MODE_POLLING = 0,    // handle_key_event() scans and debounces each call
+    KEYPAD_MODE_INTERRUPT,      // A column EXTI edge triggers the scan
+    KEYPAD_MODE_TIMER           // A timer scans periodically, events are queued
+};
+
+// How a scan touches the GPIO ports
+enum KeypadScanMethod {
+    KEYPAD_SCAN_PINS = 0,       // HAL_GPIO_WritePin / HAL_GPIO_ReadPin per pin
+    KEYPAD_SCAN_PORT            // One BSRR write and one IDR read per row
+};
+
+// Debounce window: interrupt mode ignores presses this soon after a release,
+// timer and polling modes need a key stable this long before reporting it
+#ifndef KEYPAD_DEBOUNCE_MS
+#define KEYPAD_DEBOUNCE_MS 50
+#endif
+
+// Timer mode defaults (see KeypadTiming)
+#ifndef KEYPAD_SCAN_PERIOD_MS
+#define KEYPAD_SCAN_PERIOD_MS 5
+#endif
+
+#ifndef KEYPAD_REPEAT_DELAY_MS
+#define KEYPAD_REPEAT_DELAY_MS 500
+#endif
+
+#ifndef KEYPAD_REPEAT_INTERVAL_MS
+#define KEYPAD_REPEAT_INTERVAL_MS 100
+#endif
+
+// Events buffered between the timer interrupt and the main loop (power of two)
+#ifndef KEYPAD_EVENT_QUEUE_SIZE
+#define KEYPAD_EVENT_QUEUE_SIZE 16
+#endif
+
+// Timer clock after the prescaler set up by MX_TIM2_Init (72 MHz / 7200)
+#ifndef KEYPAD_TIMER_CLOCK_HZ
+#define KEYPAD_TIMER_CLOCK_HZ 10000
+#endif
+
+enum KeyEventType {
+    KEY_EVENT_PRESS = 0,
+    KEY_EVENT_RELEASE,
+    KEY_EVENT_REPEAT
+};
+
+struct KeyEvent {
+    KeyCode key;
+    uint8_t type;               // KeyEventType
+    uint32_t time;              // HAL_GetTick() when detected
+};
+
+// Receives keys from handle_key_event(); context is the pointer given to
+// set_key_callback()
+typedef void (*KeypadCallback)(KeyCode key, void* context);
+
+// Timer and polling mode timing; repeat_delay_ms = 0 disables auto-repeat
+struct KeypadTiming {
+    uint16_t scan_period_ms;
+    uint16_t debounce_ms;
+    uint16_t repeat_delay_ms;
+    uint16_t repeat_interval_ms;
+};
+
+// Smallest unsigned type with one bit per key
+template <unsigned Keys>
+struct KeypadMaskType {
+    typedef typename std::conditional<(Keys <= 16), uint16_t,
+            typename std::conditional<(Keys <= 32), uint32_t, uint64_t>::type>::type type;
+};
+
+// Default keymaps by matrix size; other sizes pass the address of their own
+template <uint8_t Rows, uint8_t Cols>
+struct KeypadLayout;
+
+template <>
+struct KeypadLayout<4, 4> {
+    static constexpr KeyCode keymap[4][4] = {
+        {'1', '2', '3', '+'},
+        {'4', '5', '6', '-'},
+        {'7', '8', '9', '*'},
+        {'C', '0', '=', '/'}
+    };
+};
+
+// Production panel: memory and function keys above the 4x4 block
+template <>
+struct KeypadLayout<5, 6> {
+    static constexpr KeyCode keymap[5][6] = {
+        {KEY_MEMORY_CLEAR, KEY_MEMORY_RECALL, KEY_MEMORY_SUB, KEY_MEMORY_ADD, KEY_SQUARE_ROOT, 'C'},
+        {'7', '8', '9', '/', '(', ')'},
+        {'4', '5', '6', '*', '^', KEY_NONE},
+        {'1', '2', '3', '-', KEY_NONE, KEY_NONE},
+        {'0', '.', '=', '+', KEY_NONE, KEY_NONE}
+    };
+};
+
+// Bench matrix: every key code once, row-major, the rest unpopulated
+template <>
+struct KeypadLayout<8, 8> {
+    static constexpr KeyCode keymap[8][8] = {
+        {'0', '1', '2', '3', '4', '5', '6', '7'},
+        {'8', '9', '+', '-', '*', '/', '=', 'C'},
+        {'.', '(', ')', '^', 'M', KEY_MEMORY_ADD, KEY_MEMORY_SUB, KEY_MEMORY_RECALL},
+        {KEY_MEMORY_CLEAR, KEY_SQUARE_ROOT, KEY_NONE, KEY_NONE, KEY_NONE, KEY_NONE, KEY_NONE, KEY_NONE},
+        {KEY_NONE, KEY_NONE, KEY_NONE, KEY_NONE, KEY_NONE, KEY_NONE, KEY_NONE, KEY_NONE},
+        {KEY_NONE, KEY_NONE, KEY_NONE, KEY_NONE, KEY_NONE, KEY_NONE, KEY_NONE, KEY_NONE},
+        {KEY_NONE, KEY_NONE, KEY_NONE, KEY_NONE, KEY_NONE, KEY_NONE, KEY_NONE, KEY_NONE},
+        {KEY_NONE, KEY_NONE, KEY_NONE, KEY_NONE, KEY_NONE, KEY_NONE, KEY_NONE, KEY_NONE}
+    };
+};
 
-class Keypad {
+/**
+  * Rows x Cols key matrix, rows driven and columns read with pull-ups. The
+  * sizes are template parameters so every scan loop has a constant trip
+  * count the compiler can unroll, and scan time grows linearly with
+  * Rows * Cols. The keymap lives in flash and is only indexed.
+  *
+  * Key bits are laid out row * Cols + col in a KeyMask. The firmware uses
+  * the 4x4 Keypad typedef below.
+  */
+template <uint8_t Rows, uint8_t Cols>
+class BasicKeypad {
 public:
-    // Constructor
-    Keypad();
+    static_assert(Rows >= 1 && Rows <= KEYPAD_MAX_LINES && Cols >= 1 && Cols <= KEYPAD_MAX_LINES,
+                  "Keypad matrix sides must be 1..KEYPAD_MAX_LINES");
     
-    // Destructor
-    ~Keypad();
+    static const uint8_t ROWS = Rows;
+    static const uint8_t COLS = Cols;
+    static const uint8_t KEY_COUNT = Rows * Cols;
+    typedef typename KeypadMaskType<Rows * Cols>::type KeyMask;
+    typedef KeyCode Keymap[Rows][Cols];
+    
+    // Constructor: pins not set before init() get the default wiring there.
+    // The keymap is read in place, so it needs static storage (a constexpr
+    // table at namespace or static scope keeps it in flash)
+    constexpr BasicKeypad(const Keymap* keymap = &KeypadLayout<Rows, Cols>::keymap)
+        : row_port(nullptr)
+        , col_port(nullptr)
+        , row_pins()
+        , col_pins()
+        , keymap(keymap)
+        , initialized(false)
+        , last_key_time(0)
+        , last_key(KEY_NONE)
+        , key_callback(nullptr)
+        , callback_context(nullptr)
+        , mode(KEYPAD_MODE_POLLING)
+        , col_mask(0)
+        , pending_key(KEY_NONE)
+        , key_down(false)
+        , release_time(0u - KEYPAD_DEBOUNCE_MS)
+        , scan_count(0)
+        , timer_handle(nullptr)
+        , timing{KEYPAD_SCAN_PERIOD_MS, KEYPAD_DEBOUNCE_MS,
+                 KEYPAD_REPEAT_DELAY_MS, KEYPAD_REPEAT_INTERVAL_MS}
+        , integrator()
+        , debounce_ticks(1)
+        , stable_keys(0)
+        , repeat_index(-1)
+        , repeat_ticks(0)
+        , events()
+        , dropped_events(0)
+        , scan_method(KEYPAD_SCAN_PORT)
+        , row_mask(0)
+        , row_select()
+        , col_shift(0)
+        , col_lut_valid(false)
+        , col_lut()
+        , last_scan_cycles(0) {
+    }
     
     // Keypad initialization
-    void init();
+    void init(KeypadMode mode = KEYPAD_MODE_POLLING);
     void init_gpio();
     void init_timer();
     
     // Key scanning
-    char scan_key();
+    KeyCode scan_key();
+    // Raw state of every key, bit row * Cols + col (n-key rollover)
+    KeyMask scan_keys();
+    void set_scan_method(KeypadScanMethod method);
     bool is_key_pressed();
-    char get_pressed_key();
+    KeyCode get_pressed_key();
     
-    // Debouncing
+    // Debouncing: debounce_delay() blocks for KEYPAD_DEBOUNCE_MS and is kept
+    // for callers of get_pressed_key(); handle_key_event() never waits
     void debounce_delay();
-    bool is_valid_key(char key);
+    bool is_valid_key(KeyCode key);
+    KeyCode key_at(uint8_t row, uint8_t col) const;
     
-    // Event handling
-    void set_key_callback(std::function<void(char)> callback);
+    // Event handling; in polling mode call handle_key_event() every
+    // scan_period_ms, each call is one debounce step
+    void set_key_callback(KeypadCallback callback, void* context = nullptr);
     void handle_key_event();
     
+    // Interrupt mode: call from HAL_GPIO_EXTI_Callback
+    void on_column_interrupt(uint16_t pin);
+    
+    // Timer mode: set before init(); timer_callback() runs from
+    // HAL_TIM_PeriodElapsedCallback. The main loop is the only consumer:
+    // either handle_key_event() or get_event() drains the queue
+    void set_timer(TIM_HandleTypeDef* htim);
+    void set_timing(const KeypadTiming& timing);
+    KeypadTiming get_timing() const { return timing; }
+    void timer_callback();
+    bool get_event(KeyEvent& event);
+    uint32_t get_dropped_events() const { return dropped_events; }
+    bool has_events() const { return !events.empty(); }
+    
     // Status checking
     bool is_initialized() const;
     uint32_t get_last_key_time() const;
+    KeypadMode get_mode() const { return mode; }
+    uint32_t get_scan_count() const { return scan_count; }
+    uint32_t get_last_scan_cycles() const { return last_scan_cycles; }
+    // Debounced state of every key in timer mode, same layout as scan_keys()
+    KeyMask get_key_state() const { return stable_keys; }
     
-    // GPIO control
-    void set_row_pins(GPIO_TypeDef* port, uint16_t* pins);
-    void set_col_pins(GPIO_TypeDef* port, uint16_t* pins);
+    // GPIO control: Rows / Cols pins, all on one port each; set before init().
+    // Defaults are PA0.. for the rows and the next pins for the columns
+    void set_row_pins(GPIO_TypeDef* port, const uint16_t* pins);
+    void set_col_pins(GPIO_TypeDef* port, const uint16_t* pins);
     
 private:
     // Private member variables
     GPIO_TypeDef* row_port;
     GPIO_TypeDef* col_port;
-    uint16_t row_pins[4];
-    uint16_t col_pins[4];
+    uint16_t row_pins[Rows];
+    uint16_t col_pins[Cols];
+    const Keymap* keymap;
     
     bool initialized;
     uint32_t last_key_time;
-    char last_key;
-    std::function<void(char)> key_callback;
+    KeyCode last_key;
+    KeypadCallback key_callback;
+    void* callback_context;
+    
+    // Interrupt mode state, written by the EXTI handler
+    KeypadMode mode;
+    uint16_t col_mask;
+    std::atomic<KeyCode> pending_key;
+    volatile bool key_down;
+    volatile uint32_t release_time;
+    volatile uint32_t scan_count;
+    
+    // Debounce state, written by the timer interrupt (by handle_key_event()
+    // when polling)
+    TIM_HandleTypeDef* timer_handle;
+    KeypadTiming timing;
+    uint8_t integrator[Rows * Cols]; // Per key: 0 = released .. debounce_ticks = pressed
+    uint8_t debounce_ticks;
+    KeyMask stable_keys;        // Debounced state, bit row * Cols + col
+    int8_t repeat_index;        // Key that auto-repeats, -1 for none
+    uint16_t repeat_ticks;
+    RingBuffer<KeyEvent, KEYPAD_EVENT_QUEUE_SIZE> events;
+    volatile uint32_t dropped_events;
+    
+    // Port scanning tables, rebuilt when the pins change
+    KeypadScanMethod scan_method;
+    uint16_t row_mask;
+    uint32_t row_select[Rows];  // BSRR value selecting each row
+    uint8_t col_shift;          // Lowest column pin number
+    bool col_lut_valid;
+    uint8_t col_lut[1u << Cols]; // IDR bits >> col_shift -> column bits
+    volatile uint32_t last_scan_cycles;
     
     // Private helper methods
-    void scan_matrix();
-    char decode_key(uint8_t row, uint8_t col);
+    KeyMask scan_matrix();
+    KeyMask scan_pins();
+    KeyMask scan_port();
+    KeyCode decode_key(uint8_t index) const;
     bool read_row(uint8_t row);
     bool read_column(uint8_t col);
     void set_row_high(uint8_t row);
     void set_row_low(uint8_t row);
     void set_col_high(uint8_t col);
     void set_col_low(uint8_t col);
+    void set_all_rows(GPIO_PinState state);
+    void update_scan_tables();
     
     // Timer handling
     void start_timer();
     void stop_timer();
-    void timer_callback();
+    void debounce_scan();
+    void push_event(KeyCode key, KeyEventType type);
+    static uint16_t ms_to_ticks(uint16_t ms, uint16_t period_ms);
 };
 
+// Instantiated in keypad.cpp for the supported panels
+extern template class BasicKeypad<4, 4>;
+extern template class BasicKeypad<5, 6>;
+extern template class BasicKeypad<8, 8>;
+
+typedef BasicKeypad<4, 4> Keypad;
+
 #endif // __cplusplus
 
 #endif // __KEYPAD_H
@@ -31,7 +31,6 @@ extern "C" {
 
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
-#include <string>
 #include <cstdint>
 /* USER CODE END Includes */
 
@@ -62,7 +61,32 @@ void Error_Handler(void);
 #define LED_GPIO_PORT GPIOC
 #define LED_GPIO_CLK_ENABLE() __HAL_RCC_GPIOC_CLK_ENABLE()
 
+/* HD44780 LCD: 4-bit bus on GPIOB, or a PCF8574 backpack on I2C1 (PB6/PB7)
+   when LCD_USE_I2C is defined */
+#define LCD_GPIO_PORT GPIOB
+#define LCD_RS_PIN GPIO_PIN_12
+#define LCD_RW_PIN GPIO_PIN_13
+#define LCD_E_PIN GPIO_PIN_14
+#define LCD_D4_PIN GPIO_PIN_8
+#define LCD_D5_PIN GPIO_PIN_9
+#define LCD_D6_PIN GPIO_PIN_10
+#define LCD_D7_PIN GPIO_PIN_11
+
 /* USER CODE BEGIN Private defines */
+/* Scheduler: LED heartbeat period, shortest idle worth entering STOP for,
+   keypad wake-up source (KEYPAD_MODE_INTERRUPT is needed for STOP) */
+#define APP_HEARTBEAT_MS 1000
+#define APP_STOP_MIN_MS 50
+#ifndef APP_KEYPAD_MODE
+#define APP_KEYPAD_MODE KEYPAD_MODE_TIMER
+#endif
+/* TX queue room needed before the next received line is evaluated: its
+   reply must fit */
+#define APP_RX_REPLY_MAX 48
+/* Alone on a line received on USART1: dumps the profiler zones (PROFILE=1) */
+#define APP_PROFILE_DUMP_KEY '?'
+/* Alone on a line: dumps the event trace for Tools/trace_decode (TRACE=1) */
+#define APP_TRACE_DUMP_KEY '!'
 
 /* USER CODE END Private defines */
 
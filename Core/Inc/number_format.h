@@ -0,0 +1,52 @@
+/**
+  ******************************************************************************
+  * @file           : number_format.h
+  * @brief          : Heap-free number to text conversion (Grisu2)
+  * @author         : STM32 Calculator Project
+  * @date           : 2024
+  ******************************************************************************
+  */
+
+#ifndef __NUMBER_FORMAT_H
+#define __NUMBER_FORMAT_H
+
+#ifdef __cplusplus
+
+#include <cstddef>
+#include <cstdint>
+
+// Buffer size that holds any result ("-0.00000123456789012345678901" at most)
+#define NUMBER_FORMAT_MAX       32
+
+// Columns of the 2x16 character LCD
+#define NUMBER_FORMAT_LCD_WIDTH 16
+
+/**
+  * Round-trip text written to buffer with a terminating NUL. Grisu2 always
+  * reads back to the same value and is the shortest such text for all but
+  * ~0.1% of doubles. Plain notation is used while the decimal point stays
+  * within 21 digits, scientific ("1.5e-7") beyond that; -0 prints as "0",
+  * non-finite values as "nan", "inf" and "-inf". Returns the length, or 0
+  * (and an empty string when possible) if capacity is too small.
+  */
+size_t number_format_shortest(double value, char* buffer, size_t capacity);
+size_t number_format_shortest(float value, char* buffer, size_t capacity);
+size_t number_format_shortest(long double value, char* buffer, size_t capacity);
+
+/**
+  * Like number_format_shortest but never wider than width columns (buffer
+  * needs width + 1 bytes): extra digits are rounded away, switching to
+  * scientific notation when the integer part or leading zeros do not fit.
+  * width must be at least 8 to hold any double ("-1.8e308").
+  */
+size_t number_format_fit(double value, char* buffer, size_t width);
+size_t number_format_fit(float value, char* buffer, size_t width);
+size_t number_format_fit(long double value, char* buffer, size_t width);
+
+// Decimal digits of value, for status lines in builds without printf;
+// returns the length, or 0 (and an empty string) if capacity is too small
+size_t number_format_uint(uint64_t value, char* buffer, size_t capacity);
+
+#endif // __cplusplus
+
+#endif // __NUMBER_FORMAT_H
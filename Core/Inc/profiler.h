@@ -0,0 +1,87 @@
+/**
+  ******************************************************************************
+  * @file           : profiler.h
+  * @brief          : Scoped cycle-count profiling zones (DWT CYCCNT)
+  * @author         : STM32 Calculator Project
+  * @date           : 2024
+  ******************************************************************************
+  */
+
+#ifndef __PROFILER_H
+#define __PROFILER_H
+
+#ifdef __cplusplus
+
+#include <cstddef>
+#include <cstdint>
+#include "stm32f1xx_hal.h"
+
+// Free-running counter and its rate. The DWT cycle counter on the target;
+// the mock HAL defines a host time base (rdtsc or steady_clock) instead
+#ifndef PROFILE_COUNTER
+#define PROFILE_COUNTER()       ((uint32_t)DWT->CYCCNT)
+#define PROFILE_COUNTER_HZ()    (SystemCoreClock)
+#endif
+
+// Instrumented code paths; add a zone here and its name in profiler.cpp
+enum ProfileZone : uint8_t {
+    PROFILE_CALCULATE_RESULT = 0,
+    PROFILE_PRINT_NUMBER,
+    PROFILE_LCD_REFRESH,
+    PROFILE_SCAN_KEY,
+    PROFILE_ZONE_COUNT
+};
+
+// Counter ticks (CPU cycles on the target) per zone
+struct ProfileStats {
+    uint32_t count;
+    uint32_t min_cycles;
+    uint32_t max_cycles;
+    uint64_t total_cycles;
+};
+
+// Starts the cycle counter; zones recorded before read as 0 cycles
+void profiler_init();
+void profiler_reset();
+
+// A zone is updated by one context at a time: scan_key may run in the
+// EXTI handler, the other zones belong to the main loop
+void profiler_record(ProfileZone zone, uint32_t cycles);
+ProfileStats profiler_get(ProfileZone zone);
+const char* profiler_zone_name(ProfileZone zone);
+
+// One line per zone that ran ("scan_key n=12 cyc min/avg/max=..."),
+// passed to write without the line ending; integer formatting only
+typedef void (*ProfileWriter)(const char* line, void* context);
+void profiler_dump(ProfileWriter write, void* context);
+
+/**
+  * Times its own lifetime into a zone: one counter read at construction
+  * and one at destruction. Use PROFILE_SCOPE, which compiles to nothing
+  * unless CALC_PROFILE is defined.
+  */
+class ProfileScope {
+public:
+    explicit ProfileScope(ProfileZone zone) : zone(zone), start(PROFILE_COUNTER()) {}
+    ~ProfileScope() { profiler_record(zone, PROFILE_COUNTER() - start); }
+
+private:
+    ProfileZone zone;
+    uint32_t start;
+
+    ProfileScope(const ProfileScope&);
+    ProfileScope& operator=(const ProfileScope&);
+};
+
+#define PROFILE_CONCAT_INNER(a, b)  a##b
+#define PROFILE_CONCAT(a, b)        PROFILE_CONCAT_INNER(a, b)
+
+#ifdef CALC_PROFILE
+#define PROFILE_SCOPE(zone)     ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)(zone)
+#else
+#define PROFILE_SCOPE(zone)     do { } while (0)
+#endif
+
+#endif // __cplusplus
+
+#endif // __PROFILER_H
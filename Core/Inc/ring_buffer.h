@@ -0,0 +1,108 @@
+/**
+  ******************************************************************************
+  * @file           : ring_buffer.h
+  * @brief          : Lock-free single-producer / single-consumer ring buffer
+  * @author         : STM32 Calculator Project
+  * @date           : 2024
+  ******************************************************************************
+  */
+
+#ifndef __RING_BUFFER_H
+#define __RING_BUFFER_H
+
+#ifdef __cplusplus
+
+#include <atomic>
+#include <cstddef>
+
+/**
+  * Fixed-capacity FIFO shared by exactly one producer and one consumer, e.g.
+  * main loop and an interrupt handler. No locks and no interrupt masking:
+  * each index is written by one side only, and the release store that
+  * publishes it orders the element accesses before it. Capacity must be a
+  * power of two; indices run freely and are masked on access, so all
+  * Capacity slots are usable.
+  */
+template<typename T, size_t Capacity>
+class RingBuffer {
+public:
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                  "RingBuffer capacity must be a power of two");
+
+    // Constructor
+    constexpr RingBuffer() : slots{}, head(0), tail(0) {}
+
+    // Producer side
+    bool push(const T& item) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) == Capacity) {
+            return false;
+        }
+        slots[h & MASK] = item;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Copies as many items as fit; returns the number written
+    size_t write(const T* items, size_t count) {
+        size_t h = head.load(std::memory_order_relaxed);
+        size_t space = Capacity - (h - tail.load(std::memory_order_acquire));
+        if (count > space) {
+            count = space;
+        }
+        for (size_t i = 0; i < count; i++) {
+            slots[(h + i) & MASK] = items[i];
+        }
+        head.store(h + count, std::memory_order_release);
+        return count;
+    }
+
+    size_t free_space() const {
+        return Capacity - (head.load(std::memory_order_relaxed) -
+                           tail.load(std::memory_order_acquire));
+    }
+
+    // Consumer side
+    bool pop(T& item) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = slots[t & MASK];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Longest run of queued items that is contiguous in memory (for DMA);
+    // stays valid until consume() releases it
+    size_t peek_contiguous(const T*& data) const {
+        size_t t = tail.load(std::memory_order_relaxed);
+        size_t available = head.load(std::memory_order_acquire) - t;
+        size_t offset = t & MASK;
+        data = &slots[offset];
+        return (available < Capacity - offset) ? available : Capacity - offset;
+    }
+
+    void consume(size_t count) {
+        tail.store(tail.load(std::memory_order_relaxed) + count, std::memory_order_release);
+    }
+
+    // Either side (approximate while the other side is running)
+    size_t size() const {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+    bool empty() const { return size() == 0; }
+    bool full() const { return size() == Capacity; }
+    static size_t capacity() { return Capacity; }
+
+private:
+    static const size_t MASK = Capacity - 1;
+
+    T slots[Capacity];
+    std::atomic<size_t> head;   // Next slot to write, owned by the producer
+    std::atomic<size_t> tail;   // Next slot to read, owned by the consumer
+};
+
+#endif // __cplusplus
+
+#endif // __RING_BUFFER_H
@@ -0,0 +1,125 @@
+/**
+  ******************************************************************************
+  * @file           : scheduler.h
+  * @brief          : Event-driven cooperative scheduler with tickless idle
+  * @author         : STM32 Calculator Project
+  * @date           : 2024
+  ******************************************************************************
+  */
+
+#ifndef __SCHEDULER_H
+#define __SCHEDULER_H
+
+#ifdef __cplusplus
+
+#include <atomic>
+#include <cstdint>
+#include "stm32f1xx_hal.h"
+
+// Task table size (one event bit per task)
+#ifndef SCHEDULER_MAX_TASKS
+#define SCHEDULER_MAX_TASKS 8
+#endif
+
+// No timer armed for a task / nothing due
+#define SCHEDULER_NO_DEADLINE 0xFFFFFFFFu
+
+typedef void (*SchedulerTaskFn)(void* context);
+
+// Called with interrupts masked when no task is ready; sleep_ms is the time
+// to the next deadline (SCHEDULER_NO_DEADLINE: wait for an interrupt only).
+// Must return after an interrupt is pending: WFI wakes even while masked
+typedef void (*SchedulerIdleHook)(uint32_t sleep_ms);
+
+// Times in microseconds from the DWT cycle counter; latency is from the
+// notify() or the timer deadline to the start of the run
+struct SchedulerTaskStats {
+    uint32_t runs;
+    uint32_t event_wakeups;
+    uint32_t timer_wakeups;
+    uint32_t run_us_total;
+    uint32_t run_us_max;
+    uint32_t latency_us_total;
+    uint32_t latency_us_max;
+};
+
+struct SchedulerStats {
+    uint32_t idle_entries;
+    uint32_t idle_ms;               // HAL_GetTick() time spent in the idle hook
+};
+
+/**
+  * Runs tasks to completion, each when its event bit is set by notify()
+  * (typically from an interrupt handler) or its timer falls due; lower task
+  * ids run first. With nothing ready the core goes to the idle hook until
+  * the next deadline, so no time is spent polling.
+  *
+  * notify() is the only call that may come from an interrupt; everything
+  * else belongs to the main loop.
+  */
+class Scheduler {
+public:
+    // Constructor
+    constexpr Scheduler()
+        : tasks{}
+        , task_count(0)
+        , pending(0)
+        , notify_cycle()
+        , idle_hook(default_idle)
+        , stats() {
+    }
+
+    // Returns the task id, or -1 when the table is full. period_ms = 0 runs
+    // the task on events only
+    int8_t add_task(const char* name, SchedulerTaskFn function, void* context,
+                    uint32_t period_ms = 0);
+
+    // Wake-ups
+    void notify(uint8_t task);                      // Interrupt safe
+    void wake_after(uint8_t task, uint32_t delay_ms);   // One-shot timer
+    void set_period(uint8_t task, uint32_t period_ms);
+
+    // Runs every ready task once; idles when none was ready
+    void run_once();
+    void run();
+
+    void set_idle_hook(SchedulerIdleHook hook) { idle_hook = hook; }
+    uint32_t time_to_next_deadline() const;
+
+    // Statistics
+    uint8_t get_task_count() const { return task_count; }
+    const char* get_task_name(uint8_t task) const;
+    SchedulerTaskStats get_task_stats(uint8_t task) const;
+    SchedulerStats get_stats() const { return stats; }
+    void reset_stats();
+
+private:
+    struct Task {
+        const char* name;
+        SchedulerTaskFn function;
+        void* context;
+        uint32_t period_ms;
+        uint32_t deadline;          // HAL_GetTick() value, or SCHEDULER_NO_DEADLINE
+        uint32_t timer_latency_us;  // How late the last deadline was collected
+        SchedulerTaskStats stats;
+    };
+
+    // Private member variables
+    Task tasks[SCHEDULER_MAX_TASKS];
+    uint8_t task_count;
+    std::atomic<uint32_t> pending;  // Event bits, set by notify()
+    volatile uint32_t notify_cycle[SCHEDULER_MAX_TASKS];
+    SchedulerIdleHook idle_hook;
+    SchedulerStats stats;
+
+    // Private helper methods
+    uint32_t collect_ready(uint32_t now);
+    void run_task(uint8_t task, uint32_t latency_us);
+    void idle();
+    static void default_idle(uint32_t sleep_ms);
+    static uint32_t cycles_to_us(uint32_t cycles);
+};
+
+#endif // __cplusplus
+
+#endif // __SCHEDULER_H
@@ -0,0 +1,151 @@
+/**
+  ******************************************************************************
+  * @file           : session_table.h
+  * @brief          : Compact keypad state of many calculator sessions
+  * @author         : STM32 Calculator Project
+  * @date           : 2024
+  ******************************************************************************
+  */
+
+#ifndef __SESSION_TABLE_H
+#define __SESSION_TABLE_H
+
+#ifdef __cplusplus
+
+#include <cstddef>
+#include <cstdint>
+#include "calc_state.h"
+
+#define SESSION_NONE                0xFFFFFFFFu
+
+// Sessions ahead whose records process_input() prefetches
+#ifndef SESSION_PREFETCH_DISTANCE
+#define SESSION_PREFETCH_DISTANCE   8
+#endif
+
+/**
+  * The state BasicCalcState keeps for keypad input, for many sessions at
+  * once. Keys arrive for scattered sessions, so the fields one key needs
+  * are kept together: a fixed-size record per session (values, entry and
+  * the one-byte error and status codes) in one array, memory registers in
+  * a second one. The operand and operator stacks take most of a
+  * Calculator's size but are only live mid-expression: they come from a
+  * pool of stack blocks, held by a session from its first pending
+  * operator until '=', 'C' or an error. When the pool is empty the key
+  * fails as a too-deep expression would.
+  *
+  * Digit and point keys are applied to the record directly; every other
+  * key is run by BasicCalcState::process_input() on the session's state,
+  * so a session behaves exactly like a Calculator fed the same keys. The
+  * table allocates nothing: init() lays the arrays out in caller storage
+  * (a static array on the device, any buffer on a host). Not for
+  * BigDecimal, whose values live on the heap.
+  */
+template <typename T>
+class BasicSessionTable {
+public:
+    // Constructor
+    constexpr BasicSessionTable()
+        : session_count(0)
+        , block_count(0)
+        , free_count(0)
+        , states(nullptr)
+        , memory_value(nullptr)
+        , blocks(nullptr)
+        , free_blocks(nullptr)
+        , scratch() {
+    }
+
+    // Storage init() needs for sessions and blocks, alignment slack included
+    static size_t storage_size(uint32_t sessions, uint32_t blocks);
+
+    // Lays the table out in storage and resets every session; false (and
+    // an empty table) when bytes is short of storage_size()
+    bool init(void* storage, size_t bytes, uint32_t sessions, uint32_t blocks);
+
+    // Keys as for BasicCalculator::process_input(), keys[i] to sessions[i]
+    // in order. Session ids past capacity() are ignored here and below
+    void process_input(const uint32_t* sessions, const char* keys, size_t n);
+    void process_input(uint32_t session, char key);
+
+    // As a new Calculator, memory and status flags included
+    void reset(uint32_t session);
+
+    // Memory functions
+    void memory_store(uint32_t session, T value);
+    T memory_recall(uint32_t session) const;
+    void memory_clear(uint32_t session);
+    void memory_add(uint32_t session, T value);
+    void memory_subtract(uint32_t session, T value);
+
+    // Per-session state, as the Calculator getters
+    T get_current_value(uint32_t session) const;
+    T get_last_result(uint32_t session) const;
+    bool is_error(uint32_t session) const;
+    CalcError get_error_code(uint32_t session) const;
+    uint8_t get_status_flags(uint32_t session) const;
+    void clear_status_flags(uint32_t session);
+
+    uint32_t capacity() const { return session_count; }
+    uint32_t blocks_in_use() const { return block_count - free_count; }
+
+private:
+    typedef BasicCalcState<T> Calc;
+    typedef NumTraits<T> Num;
+
+    // entry_flags: the entry state in the low bits, then the decimal point
+    static const uint8_t ENTRY_STATE_MASK = 0x03;
+    static const uint8_t ENTRY_POINT = 0x04;
+
+    // Everything a key reads or writes bar the stacks; 32 bytes for double
+    struct SessionState {
+        T current_value;
+        T last_result;
+        int64_t entry_mantissa;
+        uint32_t stack_block;       // SESSION_NONE while both stacks are empty
+        uint8_t entry_decimals;
+        uint8_t entry_flags;
+        CalcError error_code;
+        uint8_t status_flags;
+    };
+
+    struct StackBlock {
+        T operands[CALC_STACK_DEPTH];
+        char operators[CALC_STACK_DEPTH];
+        uint8_t operand_count;
+        uint8_t operator_count;
+    };
+
+    // Private member variables
+    uint32_t session_count;
+    uint32_t block_count;
+    uint32_t free_count;
+    SessionState* states;
+    T* memory_value;
+    StackBlock* blocks;
+    uint32_t* free_blocks;
+
+    // Runs the keys that touch the stacks
+    Calc scratch;
+
+    // Private helper methods
+    uintptr_t place(uintptr_t base, uint32_t sessions, uint32_t block_total);
+    void append_digit(SessionState& state, uint8_t digit);
+    void load(const SessionState& state);
+    void store(SessionState& state);
+    void release_block(SessionState& state);
+};
+
+// Instantiated in session_table.cpp for the fixed-size backends
+extern template class BasicSessionTable<float>;
+extern template class BasicSessionTable<double>;
+extern template class BasicSessionTable<long double>;
+extern template class BasicSessionTable<Fixed>;
+
+#ifndef CALC_NUMERIC_BIGNUM
+typedef BasicSessionTable<calc_value_t> SessionTable;
+#endif
+
+#endif // __cplusplus
+
+#endif // __SESSION_TABLE_H
@@ -28,10 +28,38 @@ typedef struct {
     uint32_t Speed;
 } GPIO_InitTypeDef;
 
+#ifdef __cplusplus
+// Port registers the simulation has to see: reads of IDR/ODR return live
+// pin levels, writes to ODR/BSRR/BRR drive the pins like HAL_GPIO_WritePin
+struct MockGpioInput {
+    operator uint32_t() const;
+};
+
+struct MockGpioOutput {
+    operator uint32_t() const;
+    MockGpioOutput& operator=(uint32_t value);
+};
+
+struct MockGpioSetReset {
+    MockGpioSetReset& operator=(uint32_t value);
+};
+
+struct MockGpioReset {
+    MockGpioReset& operator=(uint32_t value);
+};
+
 typedef struct {
-    uint32_t Instance;
-    uint32_t Init;
+    volatile uint32_t CRL;
+    volatile uint32_t CRH;
+    MockGpioInput IDR;
+    MockGpioOutput ODR;
+    MockGpioSetReset BSRR;
+    MockGpioReset BRR;
+    volatile uint32_t LCKR;
 } GPIO_TypeDef;
+#else
+typedef struct GPIO_TypeDef GPIO_TypeDef;
+#endif
 
 // Mock UART types
 typedef struct {
@@ -39,6 +67,27 @@ typedef struct {
     uint32_t Init;
 } UART_HandleTypeDef;
 
+// Mock interrupt numbers (STM32F103 vector positions)
+typedef enum {
+    EXTI0_IRQn          = 6,
+    EXTI1_IRQn          = 7,
+    EXTI2_IRQn          = 8,
+    EXTI3_IRQn          = 9,
+    EXTI4_IRQn          = 10,
+    DMA1_Channel4_IRQn  = 14,
+    DMA1_Channel5_IRQn  = 15,
+    EXTI9_5_IRQn        = 23,
+    TIM2_IRQn           = 28,
+    USART1_IRQn         = 37,
+    EXTI15_10_IRQn      = 40
+} IRQn_Type;
+
+// Mock I2C types
+typedef struct {
+    uint32_t Instance;
+    uint32_t Init;
+} I2C_HandleTypeDef;
+
 // Mock Timer types
 typedef struct {
     uint32_t Instance;
@@ -96,6 +145,9 @@ typedef struct {
 #define GPIO_MODE_OUTPUT_OD        ((uint32_t)0x00000011)
 #define GPIO_MODE_AF_PP            ((uint32_t)0x00000002)
 #define GPIO_MODE_AF_OD            ((uint32_t)0x00000012)
+#define GPIO_MODE_IT_RISING        ((uint32_t)0x10110000)
+#define GPIO_MODE_IT_FALLING       ((uint32_t)0x10210000)
+#define GPIO_MODE_IT_RISING_FALLING ((uint32_t)0x10310000)
 
 #define GPIO_NOPULL                ((uint32_t)0x00000000)
 #define GPIO_PULLUP                ((uint32_t)0x00000001)
@@ -120,6 +172,34 @@ extern GPIO_TypeDef* GPIOB;
 extern GPIO_TypeDef* GPIOC;
 extern GPIO_TypeDef* GPIOD;
 
+// Core clock and DWT cycle counter (CMSIS); CYCCNT follows the mock clock
+// (host or virtual time) scaled to SystemCoreClock
+extern uint32_t SystemCoreClock;
+
+#ifdef __cplusplus
+struct MockCycleCounter {
+    operator uint32_t() const;
+    MockCycleCounter& operator=(uint32_t value);
+};
+
+typedef struct {
+    volatile uint32_t CTRL;
+    MockCycleCounter CYCCNT;
+} DWT_Type;
+
+typedef struct {
+    volatile uint32_t DEMCR;
+} CoreDebug_Type;
+
+extern DWT_Type mock_dwt;
+extern CoreDebug_Type mock_core_debug;
+
+#define DWT                        (&mock_dwt)
+#define CoreDebug                  (&mock_core_debug)
+#define DWT_CTRL_CYCCNTENA_Msk     (1UL << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk (1UL << 24)
+#endif
+
 // UART constants
 #define UART_MODE_TX               ((uint32_t)0x00000001)
 #define UART_MODE_RX               ((uint32_t)0x00000002)
@@ -241,9 +321,18 @@ typedef enum {
 #define __HAL_RCC_GPIOC_CLK_ENABLE()   do { } while(0)
 #define __HAL_RCC_GPIOD_CLK_ENABLE()   do { } while(0)
 
-// HAL macros
-#define HAL_Delay(ms)              do { } while(0)
-#define HAL_GetTick()              ((uint32_t)0)
+// Interrupt masking is a no-op on the host; WFI lets virtual time run to
+// the next simulated interrupt
+#define __disable_irq()            do { } while(0)
+#define __enable_irq()             do { } while(0)
+#define __WFI()                    mock_wfi()
+
+// Timer registers
+#define __HAL_TIM_SET_AUTORELOAD(htim, value)  mock_tim_set_autoreload(htim, value)
+
+// EXTI pending flags
+#define __HAL_GPIO_EXTI_CLEAR_IT(pin)  mock_exti_clear(pin)
+#define __HAL_GPIO_EXTI_GET_IT(pin)    mock_exti_pending(pin)
 
 /* Exported functions prototypes ---------------------------------------------*/
 
@@ -253,14 +342,63 @@ GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin);
 void HAL_GPIO_WritePin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState);
 void HAL_GPIO_TogglePin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin);
 
+// EXTI functions
+void HAL_GPIO_EXTI_IRQHandler(uint16_t GPIO_Pin);
+void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin);
+void mock_exti_clear(uint16_t GPIO_Pin);
+uint16_t mock_exti_pending(uint16_t GPIO_Pin);
+
+// NVIC functions
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority);
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn);
+void HAL_NVIC_DisableIRQ(IRQn_Type IRQn);
+
 // UART functions
 HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef* huart);
 HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef* huart, uint8_t* pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef* huart, uint8_t* pData, uint16_t Size);
+HAL_StatusTypeDef HAL_UART_Transmit_IT(UART_HandleTypeDef* huart, uint8_t* pData, uint16_t Size);
+HAL_StatusTypeDef HAL_UART_AbortTransmit(UART_HandleTypeDef* huart);
+
+// Reception into a buffer the DMA fills circularly (the mock always wraps);
+// HAL_UARTEx_RxEventCallback reports the write position at half transfer,
+// transfer complete and idle line
+#define HAL_UART_RXEVENT_TC        0x00000000U
+#define HAL_UART_RXEVENT_HT        0x00000001U
+#define HAL_UART_RXEVENT_IDLE      0x00000002U
+HAL_StatusTypeDef HAL_UARTEx_ReceiveToIdle_DMA(UART_HandleTypeDef* huart, uint8_t* pData, uint16_t Size);
+uint32_t HAL_UARTEx_GetRxEventType(UART_HandleTypeDef* huart);
+HAL_StatusTypeDef HAL_UART_AbortReceive(UART_HandleTypeDef* huart);
+
+// gState | RxState: BUSY_TX while a transfer runs, BUSY_RX while receiving
+#define HAL_UART_STATE_READY       0x20U
+#define HAL_UART_STATE_BUSY_TX     0x21U
+#define HAL_UART_STATE_BUSY_RX     0x22U
+uint32_t HAL_UART_GetState(UART_HandleTypeDef* huart);
+
+// UART callbacks (weak in the mock, overridden by the application)
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef* huart);
+void HAL_UART_ErrorCallback(UART_HandleTypeDef* huart);
+void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef* huart, uint16_t Size);
+
+// Tick in milliseconds of the mock clock; HAL_Delay only advances virtual
+// time and returns at once on host time
+uint32_t HAL_GetTick(void);
+void HAL_Delay(uint32_t Delay);
+
+// I2C functions
+HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef* hi2c);
+HAL_StatusTypeDef HAL_I2C_Master_Transmit(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint8_t* pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_I2C_Master_Receive(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint8_t* pData, uint16_t Size, uint32_t Timeout);
 
 // Timer functions
 HAL_StatusTypeDef HAL_TIM_Base_Init(TIM_HandleTypeDef* htim);
 HAL_StatusTypeDef HAL_TIM_Base_Start(TIM_HandleTypeDef* htim);
 HAL_StatusTypeDef HAL_TIM_Base_Stop(TIM_HandleTypeDef* htim);
+HAL_StatusTypeDef HAL_TIM_Base_Start_IT(TIM_HandleTypeDef* htim);
+HAL_StatusTypeDef HAL_TIM_Base_Stop_IT(TIM_HandleTypeDef* htim);
+void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef* htim);
+void mock_tim_set_autoreload(TIM_HandleTypeDef* htim, uint32_t value);
 
 // RCC functions
 HAL_StatusTypeDef HAL_RCC_OscConfig(RCC_OscInitTypeDef* RCC_OscInitStruct);
@@ -269,6 +407,112 @@ HAL_StatusTypeDef HAL_RCC_ClockConfig(RCC_ClkInitTypeDef* RCC_ClkInitStruct, uin
 // PWR functions
 HAL_StatusTypeDef HAL_PWREx_ConfigVoltageScaling(uint32_t VoltageScaling);
 
+/* Mock control (host only) -------------------------------------------------*/
+
+// How background UART transfers finish: IMMEDIATE completes inside the
+// Transmit_DMA/_IT call, MANUAL waits for mock_uart_complete_tx(), TIMED
+// completes after the time the bytes take on the wire (10 bits each at
+// the mock baud rate; virtual clock only, immediate on the host clock)
+typedef enum {
+    MOCK_UART_TX_IMMEDIATE = 0,
+    MOCK_UART_TX_MANUAL,
+    MOCK_UART_TX_TIMED
+} MockUartTxMode;
+
+void mock_uart_set_tx_mode(MockUartTxMode mode);
+// Line rate of MOCK_UART_TX_TIMED and of received bytes (115200 by default)
+void mock_uart_set_baud(uint32_t baud);
+// Bytes sent to the MCU: on the virtual clock they arrive back to back at
+// the baud rate, after any still on the wire, and the line goes idle one
+// character time after the last; on the host clock they arrive at once.
+// Bytes arriving with no reception running are lost
+void mock_uart_receive(UART_HandleTypeDef* huart, const uint8_t* data, size_t length);
+// Bytes still on the wire
+size_t mock_uart_rx_pending(UART_HandleTypeDef* huart);
+// Receive error (noise, framing): reception is aborted, HAL_UART_ErrorCallback runs
+void mock_uart_rx_error(UART_HandleTypeDef* huart);
+// Bytes passed to HAL_UART_Transmit or finished in the background, echoed or not
+uint32_t mock_uart_tx_bytes(void);
+// Receives every transmitted byte as it leaves the UART (a background
+// transfer when it finishes), like the far end of the line; nullptr stops
+typedef void (*MockUartTxSink)(UART_HandleTypeDef* huart, const uint8_t* data, size_t length, void* context);
+void mock_uart_set_tx_sink(MockUartTxSink sink, void* context);
+bool mock_uart_tx_pending(UART_HandleTypeDef* huart);
+// Finishes the pending transfer and runs HAL_UART_TxCpltCallback
+void mock_uart_complete_tx(UART_HandleTypeDef* huart);
+// Aborts the pending transfer and runs HAL_UART_ErrorCallback
+void mock_uart_fail_tx(UART_HandleTypeDef* huart);
+
+// Simulated HD44780 controller on GPIO pins or behind a PCF8574 I2C
+// expander (P0 RS, P1 RW, P2 E, P3 backlight, P4-P7 D4-D7). It decodes the
+// 4-bit protocol, keeps DDRAM, answers busy-flag reads and counts writes
+// that break the datasheet timing (power-on wait, instruction while busy).
+// The controller is powered with the MCU (HAL_GetTick() == 0); attaching
+// resets it.
+void mock_lcd_attach_gpio(GPIO_TypeDef* port, uint16_t rs, uint16_t rw, uint16_t e, const uint16_t* data);
+void mock_lcd_attach_i2c(uint16_t address);
+// Copies length characters of a row from DDRAM
+void mock_lcd_get_row(uint8_t row, char* buffer, uint8_t length);
+uint32_t mock_lcd_instructions(void);
+uint32_t mock_lcd_violations(void);
+const char* mock_lcd_last_violation(void);
+
+// Runs HAL_TIM_PeriodElapsedCallback once per period if the timer was
+// started with HAL_TIM_Base_Start_IT
+void mock_tim_elapse(TIM_HandleTypeDef* htim, uint32_t periods);
+uint32_t mock_tim_get_autoreload(TIM_HandleTypeDef* htim);
+
+// Simulated key matrix (up to 8x8): rows are outputs, columns inputs with
+// pull-ups. A pressed key pulls its column low while its row is driven
+// low; column edges raise EXTI on pins configured for it.
+void mock_keypad_attach(GPIO_TypeDef* row_port, const uint16_t* row_pins, uint8_t rows,
+                        GPIO_TypeDef* col_port, const uint16_t* col_pins, uint8_t cols);
+void mock_keypad_press(uint8_t row, uint8_t col);
+void mock_keypad_release(uint8_t row, uint8_t col);
+// Presses or releases a key when the virtual clock reaches at_us; returns
+// the number of actions not yet applied
+void mock_keypad_schedule(uint64_t at_us, uint8_t row, uint8_t col, bool pressed);
+size_t mock_keypad_scheduled(void);
+
+// Mock clock. HOST follows the wall clock. VIRTUAL starts from the current
+// time and only moves when the program waits: HAL_Delay, __WFI (to the next
+// interrupt or SysTick) or mock_clock_advance_us. Each HAL_GetTick / CYCCNT
+// read costs MOCK_CLOCK_READ_NS so busy-waits end. Running timers then
+// fire on their own every (ARR + 1) counts of MOCK_TIM_COUNTER_HZ, and
+// scripted key actions are applied as their time passes.
+typedef enum {
+    MOCK_CLOCK_HOST = 0,
+    MOCK_CLOCK_VIRTUAL
+} MockClockMode;
+
+#ifndef MOCK_CLOCK_READ_NS
+#define MOCK_CLOCK_READ_NS         100
+#endif
+
+// TIM2 of the firmware: 72 MHz / (Prescaler 7199 + 1)
+#ifndef MOCK_TIM_COUNTER_HZ
+#define MOCK_TIM_COUNTER_HZ        10000
+#endif
+
+void mock_clock_set_mode(MockClockMode mode);
+uint64_t mock_clock_now_us(void);
+void mock_clock_advance_us(uint64_t us);
+void mock_wfi(void);
+// WFI with SysTick held off for up to max_ms, like the firmware's tickless
+// idle; 0xFFFFFFFF waits for the next interrupt only
+void mock_wfi_tickless(uint32_t max_ms);
+
+// Echo of GPIO writes and UART transmits on stdout (on by default)
+void mock_set_console_echo(bool enabled);
+
+// Time base of profiler.h on the host: the TSC on x86, else steady_clock
+// nanoseconds. Independent of the mock clock, so virtual time does not
+// skew profiles
+uint32_t mock_profile_counter(void);
+uint32_t mock_profile_counter_hz(void);
+#define PROFILE_COUNTER()          mock_profile_counter()
+#define PROFILE_COUNTER_HZ()       mock_profile_counter_hz()
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,82 @@
+/**
+  ******************************************************************************
+  * @file           : trace.h
+  * @brief          : Binary event trace ring for key-to-display latency
+  * @author         : STM32 Calculator Project
+  * @date           : 2024
+  ******************************************************************************
+  */
+
+#ifndef __TRACE_H
+#define __TRACE_H
+
+#ifdef __cplusplus
+
+#include <cstddef>
+#include <cstdint>
+#include "stm32f1xx_hal.h"
+
+// Records kept (power of two); the oldest are overwritten. 8 bytes each
+#ifndef TRACE_BUFFER_SIZE
+#define TRACE_BUFFER_SIZE 256
+#endif
+
+// Points along the path of a key stroke, in the order they happen
+enum TraceEvent : uint8_t {
+    TRACE_NONE = 0,
+    TRACE_KEY_DETECT,           // Key first seen by a scan (arg: key code)
+    TRACE_KEY_DEBOUNCED,        // Press accepted by the timer debounce (arg: key code)
+    TRACE_KEY_DISPATCH,         // Key callback entered (arg: key code)
+    TRACE_CALC_INPUT,           // process_input entered (arg: input)
+    TRACE_CALC_DONE,            // process_input returned (arg: input)
+    TRACE_UART_SEND,            // Display text queued (arg: bytes)
+    TRACE_UART_TX_START,        // Transfer started (arg: bytes)
+    TRACE_UART_TX_DONE,         // Transfer finished (arg: bytes still queued)
+    TRACE_LCD_REFRESH,          // Changed cells written to the LCD (arg: cells)
+    TRACE_EVENT_COUNT
+};
+
+// DWT cycle count at the event (wraps after 2^32 cycles, ~60 s at 72 MHz)
+struct TraceRecord {
+    uint32_t timestamp;
+    uint16_t arg;
+    uint8_t event;              // TraceEvent
+    uint8_t reserved;
+};
+
+// Starts the cycle counter and empties the ring; recording starts enabled
+void trace_init();
+void trace_reset();
+void trace_enable(bool enabled);
+
+// Any context, interrupts included: a slot is claimed with one atomic add
+void trace_record(TraceEvent event, uint16_t arg);
+
+// Records held (at most TRACE_BUFFER_SIZE) and records overwritten
+size_t trace_count();
+uint32_t trace_lost();
+
+// Copies the held records oldest first; returns the number copied
+size_t trace_snapshot(TraceRecord* records, size_t max_records);
+const char* trace_event_name(TraceEvent event);
+
+/**
+  * Text dump for a serial console, read back by Tools/trace_decode:
+  *   TRACE v1 hz=<counter Hz> records=<n> lost=<n>
+  *   <16 hex digits per record, the little-endian bytes, 4 per line>
+  *   TRACE END
+  * Lines go to write without the line ending. Recording pauses meanwhile,
+  * so the dump's own UART traffic is not traced.
+  */
+typedef void (*TraceWriter)(const char* line, void* context);
+void trace_dump(TraceWriter write, void* context);
+
+#ifdef CALC_TRACE
+#define TRACE_EVENT(event, arg)     trace_record((event), (uint16_t)(arg))
+#else
+#define TRACE_EVENT(event, arg)     do { } while (0)
+#endif
+
+#endif // __cplusplus
+
+#endif // __TRACE_H
@@ -0,0 +1,163 @@
+/**
+  ******************************************************************************
+  * @file           : uart_rx_channel.h
+  * @brief          : Line-framed UART receive channel on a circular DMA buffer
+  * @author         : STM32 Calculator Project
+  * @date           : 2024
+  ******************************************************************************
+  */
+
+#ifndef __UART_RX_CHANNEL_H
+#define __UART_RX_CHANNEL_H
+
+#ifdef __cplusplus
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include "stm32f1xx_hal.h"
+#include "ring_buffer.h"
+
+// Circular DMA buffer in bytes. Unread bytes are safe up to half of it
+// (see read_line()): 256 bytes give the main loop 11 ms at 115200 baud
+#ifndef UART_RX_DMA_SIZE
+#define UART_RX_DMA_SIZE        256
+#endif
+
+// Longest line kept, terminator excluded; longer lines are skipped whole
+#ifndef UART_RX_LINE_MAX
+#define UART_RX_LINE_MAX        64
+#endif
+
+// Idle line after a burst ends the line even without CR or LF, for hosts
+// that send one expression per burst; 0 for terminals typing by hand
+#ifndef UART_RX_IDLE_ENDS_LINE
+#define UART_RX_IDLE_ENDS_LINE  1
+#endif
+
+// Number of UARTs the receive callbacks can dispatch to
+#ifndef UART_RX_MAX_CHANNELS
+#define UART_RX_MAX_CHANNELS    2
+#endif
+
+// Each field has a single writer: errors the interrupt side, the rest the
+// main loop
+struct UartRxStats {
+    uint32_t bytes_received;    // Read out of the DMA buffer
+    uint32_t lines;
+    uint32_t overruns;          // Times the DMA caught up with unread bytes
+    uint32_t bytes_lost;        // Overwritten, or pending at a receive error
+    uint32_t lines_too_long;
+    uint32_t errors;            // Receive errors; reception was restarted
+};
+
+// Called from the receive interrupt when bytes have arrived
+typedef void (*UartRxNotify)(void* context);
+
+/**
+  * HAL_UARTEx_ReceiveToIdle_DMA keeps a circular buffer filling on its own;
+  * the half transfer, transfer complete and idle line interrupts only
+  * publish how far it got. The main loop cuts lines out of the buffer
+  * with read_line() at its own pace, so the next line is received while
+  * the current one is evaluated and its reply sent. A line ends at CR or
+  * LF and, with UART_RX_IDLE_ENDS_LINE, where the line went idle. Binary
+  * frames (calc_protocol.h) in between are taken with read().
+  *
+  * read_line(), peek() and read() belong to the main loop; on_rx_event()
+  * and on_rx_error() to the interrupt side. Channels are never destroyed
+  * on the device; stop() detaches one that goes out of scope.
+  */
+class UartRxChannel {
+public:
+    // Constructor
+    constexpr UartRxChannel(UART_HandleTypeDef* huart)
+        : uart_handle(huart)
+        , dma_buffer{}
+        , dma_position(0)
+        , received(0)
+        , restarts(0)
+        , restart_count(0)
+        , idle_marks()
+        , consumed(0)
+        , restarts_seen(0)
+        , next_mark(0)
+        , has_next_mark(false)
+        , line{}
+        , line_length(0)
+        , discarding(false)
+        , notify(nullptr)
+        , notify_context(nullptr)
+        , stats() {
+    }
+
+    // Starts reception; false if the HAL refused it
+    bool start();
+
+    // Aborts reception and detaches the channel from the interrupt
+    // callbacks; needed before a channel on the stack goes out of scope
+    void stop();
+    void set_notify(UartRxNotify callback, void* context);
+
+    // Copies the next complete line, NUL-terminated and without its line
+    // ending, into buffer (truncated to size - 1); false when none is ready.
+    // Empty lines are skipped. A byte with the top bit set at the start of a
+    // line is not text (a binary frame): it is left for read()
+    bool read_line(char* buffer, size_t size);
+
+    // Raw access for binary frames: the next byte without taking it, and
+    // up to size bytes taken; false / 0 when none has arrived
+    bool peek(uint8_t& byte);
+    size_t read(uint8_t* buffer, size_t size);
+
+    // Received bytes not read yet (approximate while receiving)
+    bool has_data() const;
+    UartRxStats get_stats() const { return stats; }
+
+    // Called from HAL_UARTEx_RxEventCallback / HAL_UART_ErrorCallback
+    void on_rx_event(uint16_t position, bool idle);
+    void on_rx_error();
+
+    UART_HandleTypeDef* handle() const { return uart_handle; }
+
+private:
+    // Private member variables
+    UART_HandleTypeDef* uart_handle;
+    uint8_t dma_buffer[UART_RX_DMA_SIZE];
+
+    // Interrupt side
+    uint16_t dma_position;              // Write position last reported by the HAL
+    std::atomic<uint32_t> received;     // Bytes the DMA has written, ever
+    std::atomic<uint32_t> restarts;     // Receive errors; bumped after restart_count
+    volatile uint32_t restart_count;    // received when the DMA restarted at 0
+    RingBuffer<uint32_t, 8> idle_marks; // received at each idle line
+
+    // Main loop side
+    uint32_t consumed;                  // Bytes read out of the buffer, ever
+    uint32_t restarts_seen;
+    uint32_t next_mark;                 // Popped idle mark not reached yet
+    bool has_next_mark;
+    char line[UART_RX_LINE_MAX];
+    uint16_t line_length;
+    bool discarding;                    // Rest of a broken or too long line
+
+    UartRxNotify notify;
+    void* notify_context;
+    UartRxStats stats;
+
+    // Private helper methods
+    bool next_byte(uint8_t& byte);
+    bool register_channel();
+    bool idle_mark_reached();
+    void drop_line();
+
+    UartRxChannel(const UartRxChannel&);
+    UartRxChannel& operator=(const UartRxChannel&);
+};
+
+// Restarts the reception of a channel after a receive error; called from
+// HAL_UART_ErrorCallback in uart_tx_queue.cpp
+void uart_rx_on_error(UART_HandleTypeDef* huart);
+
+#endif // __cplusplus
+
+#endif // __UART_RX_CHANNEL_H
@@ -0,0 +1,116 @@
+/**
+  ******************************************************************************
+  * @file           : uart_tx_queue.h
+  * @brief          : Non-blocking UART transmit queue drained by DMA
+  * @author         : STM32 Calculator Project
+  * @date           : 2024
+  ******************************************************************************
+  */
+
+#ifndef __UART_TX_QUEUE_H
+#define __UART_TX_QUEUE_H
+
+#ifdef __cplusplus
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include "stm32f1xx_hal.h"
+#include "ring_buffer.h"
+
+// Queue size in bytes (power of two); one LCD-less result line is ~40 bytes
+#ifndef UART_TX_BUFFER_SIZE
+#define UART_TX_BUFFER_SIZE     256
+#endif
+
+// Queued bytes that start a transfer right away instead of waiting for poll()
+#ifndef UART_TX_COALESCE_BYTES
+#define UART_TX_COALESCE_BYTES  32
+#endif
+
+// Number of UARTs the completion callback can dispatch to
+#ifndef UART_TX_MAX_QUEUES
+#define UART_TX_MAX_QUEUES      2
+#endif
+
+// Each field has a single writer: bytes_* the main loop, the rest whichever
+// side holds the transfer
+struct UartTxStats {
+    uint32_t bytes_queued;
+    uint32_t bytes_dropped;     // Rejected by write() or timed out in write_wait()
+    uint32_t transfers;         // DMA (or interrupt) transfers started
+    uint32_t errors;            // Transfers aborted by the HAL, data lost
+};
+
+/**
+  * Bytes are copied into a ring and sent by HAL_UART_Transmit_DMA (or
+  * HAL_UART_Transmit_IT with UART_TX_USE_IT) in the background. Writes
+  * smaller than UART_TX_COALESCE_BYTES are held until poll() or flush(),
+  * so the pieces of one display update leave in a single transfer; data
+  * written while a transfer is in flight goes out with the next one.
+  *
+  * write*() and poll() belong to the main loop (single producer); the
+  * completion callback is the only consumer. The queue registers with the
+  * callbacks when it starts its first transfer, not when constructed, and
+  * is never destroyed on the device; stop() detaches one that goes out of
+  * scope.
+  */
+class UartTxQueue {
+public:
+    // Constructor
+    constexpr UartTxQueue(UART_HandleTypeDef* huart)
+        : uart_handle(huart)
+        , ring()
+        , busy(false)
+        , in_flight(0)
+        , stats() {
+    }
+
+    // Non-blocking: returns the bytes accepted, the rest is counted as dropped
+    size_t write(const uint8_t* data, size_t length);
+
+    // Backpressure: waits up to timeout_ms for space; returns the bytes accepted
+    size_t write_wait(const uint8_t* data, size_t length, uint32_t timeout_ms);
+
+    // Starts a transfer for held bytes; call once per main loop iteration
+    void poll();
+
+    // Waits until everything queued has left the UART; false on timeout
+    bool flush(uint32_t timeout_ms);
+
+    // Aborts the transfer in flight and detaches the queue from the
+    // completion callbacks; bytes still held go out with the next write
+    void stop();
+
+    // Status
+    size_t free_space() const { return ring.free_space(); }
+    size_t pending() const { return ring.size(); }
+    bool is_busy() const { return busy.load(std::memory_order_acquire); }
+    UartTxStats get_stats() const { return stats; }
+
+    // Called from HAL_UART_TxCpltCallback / HAL_UART_ErrorCallback
+    void on_tx_complete();
+    void on_tx_error();
+
+    UART_HandleTypeDef* handle() const { return uart_handle; }
+
+private:
+    // Private member variables
+    UART_HandleTypeDef* uart_handle;
+    RingBuffer<uint8_t, UART_TX_BUFFER_SIZE> ring;
+    std::atomic<bool> busy;         // A transfer owns the front of the ring
+    volatile size_t in_flight;      // Length of that transfer
+    UartTxStats stats;
+
+    // Private helper methods
+    void start_transfer();
+    bool try_start();
+    bool register_queue();
+
+    UartTxQueue(const UartTxQueue&);
+    UartTxQueue& operator=(const UartTxQueue&);
+};
+
+#endif // __cplusplus
+
+#endif // __UART_TX_QUEUE_H
@@ -0,0 +1,888 @@
+/**
+  ******************************************************************************
+  * @file           : bignum.cpp
+  * @brief          : Arbitrary-precision integer and decimal implementation
+  * @author         : STM32 Calculator Project
+  * @date           : 2024
+  ******************************************************************************
+  */
+
+#include "bignum.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+typedef BigInt::Limb Limb;
+typedef std::vector<Limb> Mag;
+
+static const uint64_t LIMB_BASE = (uint64_t)1 << 32;
+static const Limb DECIMAL_CHUNK = 1000000000u;     // 10^9, largest power of ten in a limb
+static const int DECIMAL_CHUNK_DIGITS = 9;
+
+static size_t karatsuba_threshold = BIGNUM_KARATSUBA_THRESHOLD;
+static size_t toom3_threshold = BIGNUM_TOOM3_THRESHOLD;
+
+// Magnitude helpers (little-endian limbs, no leading zeros)
+static void mag_trim(Mag& m) {
+    while (!m.empty() && m.back() == 0) {
+        m.pop_back();
+    }
+}
+
+static int mag_compare(const Mag& a, const Mag& b) {
+    if (a.size() != b.size()) {
+        return a.size() < b.size() ? -1 : 1;
+    }
+    for (size_t i = a.size(); i-- > 0;) {
+        if (a[i] != b[i]) {
+            return a[i] < b[i] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+static Mag mag_add(const Mag& a, const Mag& b) {
+    const Mag& longer = a.size() >= b.size() ? a : b;
+    const Mag& shorter = a.size() >= b.size() ? b : a;
+    Mag r(longer.size() + 1);
+    uint64_t carry = 0;
+    for (size_t i = 0; i < longer.size(); i++) {
+        uint64_t t = (uint64_t)longer[i] + (i < shorter.size() ? shorter[i] : 0) + carry;
+        r[i] = (Limb)t;
+        carry = t >> 32;
+    }
+    r[longer.size()] = (Limb)carry;
+    mag_trim(r);
+    return r;
+}
+
+// a - b, requires a >= b
+static Mag mag_sub(const Mag& a, const Mag& b) {
+    Mag r(a.size());
+    int64_t borrow = 0;
+    for (size_t i = 0; i < a.size(); i++) {
+        int64_t t = (int64_t)a[i] - (i < b.size() ? b[i] : 0) - borrow;
+        borrow = t < 0;
+        r[i] = (Limb)t;
+    }
+    mag_trim(r);
+    return r;
+}
+
+// r += a * B^shift, growing r as needed
+static void mag_add_shifted(Mag& r, const Mag& a, size_t shift) {
+    if (a.empty()) {
+        return;
+    }
+    if (r.size() < a.size() + shift + 1) {
+        r.resize(a.size() + shift + 1, 0);
+    }
+    uint64_t carry = 0;
+    size_t i = 0;
+    for (; i < a.size(); i++) {
+        uint64_t t = (uint64_t)r[i + shift] + a[i] + carry;
+        r[i + shift] = (Limb)t;
+        carry = t >> 32;
+    }
+    for (i += shift; carry != 0; i++) {
+        if (i == r.size()) {
+            r.push_back(0);
+        }
+        uint64_t t = (uint64_t)r[i] + carry;
+        r[i] = (Limb)t;
+        carry = t >> 32;
+    }
+}
+
+static Mag mag_slice(const Mag& m, size_t from, size_t count) {
+    if (from >= m.size()) {
+        return Mag();
+    }
+    size_t end = std::min(m.size(), from + count);
+    Mag r(m.begin() + from, m.begin() + end);
+    mag_trim(r);
+    return r;
+}
+
+// In place m = m * factor + addend
+static void mag_mul_small(Mag& m, Limb factor, Limb addend) {
+    uint64_t carry = addend;
+    for (size_t i = 0; i < m.size(); i++) {
+        uint64_t t = (uint64_t)m[i] * factor + carry;
+        m[i] = (Limb)t;
+        carry = t >> 32;
+    }
+    if (carry != 0) {
+        m.push_back((Limb)carry);
+    }
+    mag_trim(m);
+}
+
+// In place m /= divisor, returns the remainder
+static Limb mag_divmod_small(Mag& m, Limb divisor) {
+    uint64_t rem = 0;
+    for (size_t i = m.size(); i-- > 0;) {
+        uint64_t cur = (rem << 32) | m[i];
+        m[i] = (Limb)(cur / divisor);
+        rem = cur % divisor;
+    }
+    mag_trim(m);
+    return (Limb)rem;
+}
+
+static Mag mag_mul(const Mag& a, const Mag& b);
+
+static Mag mag_mul_school(const Mag& a, const Mag& b) {
+    Mag r(a.size() + b.size(), 0);
+    for (size_t i = 0; i < a.size(); i++) {
+        uint64_t carry = 0;
+        uint64_t ai = a[i];
+        if (ai == 0) {
+            continue;
+        }
+        for (size_t j = 0; j < b.size(); j++) {
+            uint64_t t = ai * b[j] + r[i + j] + carry;
+            r[i + j] = (Limb)t;
+            carry = t >> 32;
+        }
+        r[i + b.size()] = (Limb)carry;
+    }
+    mag_trim(r);
+    return r;
+}
+
+// a = a1*B^k + a0: a*b = z2*B^2k + ((a0+a1)(b0+b1) - z0 - z2)*B^k + z0
+static Mag mag_mul_karatsuba(const Mag& a, const Mag& b) {
+    size_t k = (std::max(a.size(), b.size()) + 1) / 2;
+    Mag a0 = mag_slice(a, 0, k), a1 = mag_slice(a, k, k);
+    Mag b0 = mag_slice(b, 0, k), b1 = mag_slice(b, k, k);
+
+    Mag z0 = mag_mul(a0, b0);
+    Mag z2 = mag_mul(a1, b1);
+    Mag z1 = mag_mul(mag_add(a0, a1), mag_add(b0, b1));
+    z1 = mag_sub(mag_sub(z1, z0), z2);
+
+    Mag r;
+    r.reserve(a.size() + b.size() + 1);
+    r = z0;
+    mag_add_shifted(r, z1, k);
+    mag_add_shifted(r, z2, 2 * k);
+    mag_trim(r);
+    return r;
+}
+
+// Signed magnitude for the Toom-3 evaluation/interpolation points
+struct SignedMag {
+    Mag mag;
+    bool negative;
+};
+
+static SignedMag signed_make(const Mag& m, bool negative) {
+    SignedMag r;
+    r.mag = m;
+    r.negative = negative && !m.empty();
+    return r;
+}
+
+static SignedMag signed_add(const SignedMag& a, const SignedMag& b) {
+    if (a.negative == b.negative) {
+        return signed_make(mag_add(a.mag, b.mag), a.negative);
+    }
+    if (mag_compare(a.mag, b.mag) >= 0) {
+        return signed_make(mag_sub(a.mag, b.mag), a.negative);
+    }
+    return signed_make(mag_sub(b.mag, a.mag), b.negative);
+}
+
+static SignedMag signed_sub(const SignedMag& a, const SignedMag& b) {
+    return signed_add(a, signed_make(b.mag, !b.negative));
+}
+
+static SignedMag signed_mul(const SignedMag& a, const SignedMag& b) {
+    return signed_make(mag_mul(a.mag, b.mag), a.negative != b.negative);
+}
+
+// Exact division by a small constant (the interpolation divisors 2 and 3)
+static SignedMag signed_div_exact(SignedMag a, Limb divisor) {
+    mag_divmod_small(a.mag, divisor);
+    return signed_make(a.mag, a.negative);
+}
+
+// Toom-Cook 3-way with points 0, 1, -1, -2, inf (Bodrato's sequence)
+static Mag mag_mul_toom3(const Mag& a, const Mag& b) {
+    size_t k = (std::max(a.size(), b.size()) + 2) / 3;
+    SignedMag a0 = signed_make(mag_slice(a, 0, k), false);
+    SignedMag a1 = signed_make(mag_slice(a, k, k), false);
+    SignedMag a2 = signed_make(mag_slice(a, 2 * k, k), false);
+    SignedMag b0 = signed_make(mag_slice(b, 0, k), false);
+    SignedMag b1 = signed_make(mag_slice(b, k, k), false);
+    SignedMag b2 = signed_make(mag_slice(b, 2 * k, k), false);
+
+    // Evaluation
+    SignedMag pa = signed_add(a0, a2);
+    SignedMag pa_1 = signed_add(pa, a1);
+    SignedMag pa_m1 = signed_sub(pa, a1);
+    SignedMag pa_m2 = signed_add(pa_m1, a2);
+    pa_m2 = signed_sub(signed_add(pa_m2, pa_m2), a0);
+
+    SignedMag pb = signed_add(b0, b2);
+    SignedMag pb_1 = signed_add(pb, b1);
+    SignedMag pb_m1 = signed_sub(pb, b1);
+    SignedMag pb_m2 = signed_add(pb_m1, b2);
+    pb_m2 = signed_sub(signed_add(pb_m2, pb_m2), b0);
+
+    // Pointwise products
+    SignedMag r0 = signed_mul(a0, b0);
+    SignedMag r1 = signed_mul(pa_1, pb_1);
+    SignedMag rm1 = signed_mul(pa_m1, pb_m1);
+    SignedMag rm2 = signed_mul(pa_m2, pb_m2);
+    SignedMag rinf = signed_mul(a2, b2);
+
+    // Interpolation
+    SignedMag t3 = signed_div_exact(signed_sub(rm2, r1), 3);
+    SignedMag t1 = signed_div_exact(signed_sub(r1, rm1), 2);
+    SignedMag t2 = signed_sub(rm1, r0);
+    t3 = signed_add(signed_div_exact(signed_sub(t2, t3), 2), signed_add(rinf, rinf));
+    t2 = signed_sub(signed_add(t2, t1), rinf);
+    t1 = signed_sub(t1, t3);
+
+    // All coefficients of a product of non-negative polynomials are >= 0
+    Mag r;
+    r.reserve(a.size() + b.size() + 1);
+    r = r0.mag;
+    mag_add_shifted(r, t1.mag, k);
+    mag_add_shifted(r, t2.mag, 2 * k);
+    mag_add_shifted(r, t3.mag, 3 * k);
+    mag_add_shifted(r, rinf.mag, 4 * k);
+    mag_trim(r);
+    return r;
+}
+
+static Mag mag_mul(const Mag& a, const Mag& b) {
+    if (a.empty() || b.empty()) {
+        return Mag();
+    }
+    const Mag& longer = a.size() >= b.size() ? a : b;
+    const Mag& shorter = a.size() >= b.size() ? b : a;
+
+    if (shorter.size() < karatsuba_threshold) {
+        return mag_mul_school(longer, shorter);
+    }
+
+    // Unbalanced operands: multiply shorter-sized chunks of the longer one
+    if (longer.size() >= 2 * shorter.size()) {
+        Mag r;
+        r.reserve(longer.size() + shorter.size() + 1);
+        for (size_t from = 0; from < longer.size(); from += shorter.size()) {
+            mag_add_shifted(r, mag_mul(mag_slice(longer, from, shorter.size()), shorter), from);
+        }
+        mag_trim(r);
+        return r;
+    }
+
+    if (shorter.size() >= toom3_threshold) {
+        return mag_mul_toom3(longer, shorter);
+    }
+    return mag_mul_karatsuba(longer, shorter);
+}
+
+// Knuth, TAOCP vol. 2, 4.3.1 algorithm D (truncating); v must be non-zero
+static void mag_divmod(const Mag& u, const Mag& v, Mag& q, Mag& r) {
+    if (mag_compare(u, v) < 0) {
+        q.clear();
+        r = u;
+        return;
+    }
+    if (v.size() == 1) {
+        q = u;
+        Limb rem = mag_divmod_small(q, v[0]);
+        r.clear();
+        if (rem != 0) {
+            r.push_back(rem);
+        }
+        return;
+    }
+
+    size_t n = v.size();
+    size_t m = u.size() - n;
+    int s = __builtin_clz(v[n - 1]);
+
+    // D1: normalise so the divisor's top bit is set
+    Mag vn(n);
+    for (size_t i = n - 1; i > 0; i--) {
+        vn[i] = (v[i] << s) | (s ? (Limb)((uint64_t)v[i - 1] >> (32 - s)) : 0);
+    }
+    vn[0] = v[0] << s;
+
+    Mag un(u.size() + 1);
+    un[u.size()] = s ? (Limb)((uint64_t)u[u.size() - 1] >> (32 - s)) : 0;
+    for (size_t i = u.size() - 1; i > 0; i--) {
+        un[i] = (u[i] << s) | (s ? (Limb)((uint64_t)u[i - 1] >> (32 - s)) : 0);
+    }
+    un[0] = u[0] << s;
+
+    q.assign(m + 1, 0);
+    for (size_t j = m + 1; j-- > 0;) {
+        // D3: estimate qhat from the top two limbs, correct it at most twice
+        uint64_t num = ((uint64_t)un[j + n] << 32) | un[j + n - 1];
+        uint64_t qhat = num / vn[n - 1];
+        uint64_t rhat = num % vn[n - 1];
+        while (qhat >= LIMB_BASE || qhat * vn[n - 2] > ((rhat << 32) | un[j + n - 2])) {
+            qhat--;
+            rhat += vn[n - 1];
+            if (rhat >= LIMB_BASE) {
+                break;
+            }
+        }
+
+        // D4: multiply and subtract
+        int64_t borrow = 0;
+        int64_t t;
+        for (size_t i = 0; i < n; i++) {
+            uint64_t p = qhat * vn[i];
+            t = (int64_t)un[i + j] - borrow - (int64_t)(p & 0xFFFFFFFFu);
+            un[i + j] = (Limb)t;
+            borrow = (int64_t)(p >> 32) - (t >> 32);
+        }
+        t = (int64_t)un[j + n] - borrow;
+        un[j + n] = (Limb)t;
+
+        // D5/D6: qhat was one too large, add the divisor back
+        q[j] = (Limb)qhat;
+        if (t < 0) {
+            q[j]--;
+            uint64_t carry = 0;
+            for (size_t i = 0; i < n; i++) {
+                uint64_t sum = (uint64_t)un[i + j] + vn[i] + carry;
+                un[i + j] = (Limb)sum;
+                carry = sum >> 32;
+            }
+            un[j + n] = (Limb)(un[j + n] + carry);
+        }
+    }
+    mag_trim(q);
+
+    // D8: unnormalise the remainder
+    r.assign(n, 0);
+    for (size_t i = 0; i < n; i++) {
+        r[i] = (un[i] >> s) | (s ? (Limb)((uint64_t)un[i + 1] << (32 - s)) : 0);
+    }
+    mag_trim(r);
+}
+
+// Constructors
+BigInt::BigInt()
+    : negative(false) {
+}
+
+BigInt::BigInt(int64_t value)
+    : negative(value < 0) {
+    uint64_t mag = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+    while (mag != 0) {
+        limbs.push_back((Limb)mag);
+        mag >>= 32;
+    }
+}
+
+bool BigInt::parse(const char* text, size_t length, BigInt& out) {
+    size_t i = 0;
+    bool neg = false;
+    if (i < length && (text[i] == '+' || text[i] == '-')) {
+        neg = (text[i] == '-');
+        i++;
+    }
+    if (i == length) {
+        return false;
+    }
+
+    BigInt result;
+    // Leading partial chunk so the rest are exactly 9 digits
+    size_t first = (length - i) % DECIMAL_CHUNK_DIGITS;
+    if (first == 0) {
+        first = DECIMAL_CHUNK_DIGITS;
+    }
+    while (i < length) {
+        Limb chunk = 0;
+        Limb scale = 1;
+        for (size_t end = i + first; i < end; i++) {
+            if (text[i] < '0' || text[i] > '9') {
+                return false;
+            }
+            chunk = chunk * 10 + (Limb)(text[i] - '0');
+            scale *= 10;
+        }
+        mag_mul_small(result.limbs, scale, chunk);
+        first = DECIMAL_CHUNK_DIGITS;
+    }
+    result.negative = neg && !result.limbs.empty();
+    out = result;
+    return true;
+}
+
+// Conversion
+std::string BigInt::to_string() const {
+    if (limbs.empty()) {
+        return "0";
+    }
+
+    // Peel off 9 digits per division, least significant first
+    std::vector<Limb> chunks;
+    Mag m = limbs;
+    while (!m.empty()) {
+        chunks.push_back(mag_divmod_small(m, DECIMAL_CHUNK));
+    }
+
+    std::string s;
+    s.reserve(chunks.size() * DECIMAL_CHUNK_DIGITS + 1);
+    if (negative) {
+        s += '-';
+    }
+    char buffer[16];
+    for (size_t i = chunks.size(); i-- > 0;) {
+        Limb c = chunks[i];
+        int len = 0;
+        do {
+            buffer[len++] = (char)('0' + c % 10);
+            c /= 10;
+        } while (c != 0);
+        if (i != chunks.size() - 1) {
+            while (len < DECIMAL_CHUNK_DIGITS) {
+                buffer[len++] = '0';
+            }
+        }
+        while (len > 0) {
+            s += buffer[--len];
+        }
+    }
+    return s;
+}
+
+double BigInt::to_double() const {
+    return strtod(to_string().c_str(), nullptr);
+}
+
+size_t BigInt::bit_length() const {
+    if (limbs.empty()) {
+        return 0;
+    }
+    return limbs.size() * 32 - (size_t)__builtin_clz(limbs.back());
+}
+
+// Arithmetic
+BigInt BigInt::add(const BigInt& a, const BigInt& b) {
+    SignedMag r = signed_add(signed_make(a.limbs, a.negative), signed_make(b.limbs, b.negative));
+    BigInt out;
+    out.limbs.swap(r.mag);
+    out.negative = r.negative;
+    return out;
+}
+
+BigInt BigInt::sub(const BigInt& a, const BigInt& b) {
+    return add(a, -b);
+}
+
+BigInt BigInt::mul(const BigInt& a, const BigInt& b) {
+    BigInt out;
+    out.limbs = mag_mul(a.limbs, b.limbs);
+    out.negative = (a.negative != b.negative) && !out.limbs.empty();
+    return out;
+}
+
+bool BigInt::divmod(const BigInt& a, const BigInt& b, BigInt& quotient, BigInt& remainder) {
+    if (b.limbs.empty()) {
+        return false;
+    }
+    BigInt q, r;
+    mag_divmod(a.limbs, b.limbs, q.limbs, r.limbs);
+    q.negative = (a.negative != b.negative) && !q.limbs.empty();
+    r.negative = a.negative && !r.limbs.empty();
+    quotient = q;
+    remainder = r;
+    return true;
+}
+
+BigInt BigInt::pow(const BigInt& base, uint32_t exponent) {
+    BigInt result(1);
+    BigInt square = base;
+    while (exponent != 0) {
+        if (exponent & 1) {
+            result = mul(result, square);
+        }
+        exponent >>= 1;
+        if (exponent != 0) {
+            square = mul(square, square);
+        }
+    }
+    return result;
+}
+
+BigInt BigInt::pow10(uint32_t exponent) {
+    static const Limb small_pow10[] = {
+        1u, 10u, 100u, 1000u, 10000u, 100000u, 1000000u, 10000000u, 100000000u, 1000000000u
+    };
+    if (exponent <= 9) {
+        return BigInt((int64_t)small_pow10[exponent]);
+    }
+    return pow(BigInt(10), exponent);
+}
+
+BigInt BigInt::isqrt(const BigInt& value) {
+    if (value.limbs.empty() || value.negative) {
+        return BigInt();
+    }
+
+    // Newton from a power of two above the root; decreases monotonically
+    BigInt x(1);
+    x.shift_left((value.bit_length() + 1) / 2);
+    for (;;) {
+        BigInt q, r;
+        divmod(value, x, q, r);
+        BigInt y = add(x, q);
+        y.divmod_small(2);
+        if (compare(y, x) >= 0) {
+            return x;
+        }
+        x = y;
+    }
+}
+
+int BigInt::compare(const BigInt& a, const BigInt& b) {
+    if (a.negative != b.negative) {
+        return a.negative ? -1 : 1;
+    }
+    int c = mag_compare(a.limbs, b.limbs);
+    return a.negative ? -c : c;
+}
+
+// In-place helpers
+BigInt& BigInt::mul_small(Limb factor) {
+    mag_mul_small(limbs, factor, 0);
+    if (limbs.empty()) {
+        negative = false;
+    }
+    return *this;
+}
+
+BigInt::Limb BigInt::divmod_small(Limb divisor) {
+    Limb rem = mag_divmod_small(limbs, divisor);
+    if (limbs.empty()) {
+        negative = false;
+    }
+    return rem;
+}
+
+BigInt& BigInt::shift_left(size_t bits) {
+    if (limbs.empty()) {
+        return *this;
+    }
+    size_t whole = bits / 32;
+    int part = (int)(bits % 32);
+    if (part != 0) {
+        Limb carry = 0;
+        for (size_t i = 0; i < limbs.size(); i++) {
+            Limb next = limbs[i] >> (32 - part);
+            limbs[i] = (limbs[i] << part) | carry;
+            carry = next;
+        }
+        if (carry != 0) {
+            limbs.push_back(carry);
+        }
+    }
+    limbs.insert(limbs.begin(), whole, 0);
+    return *this;
+}
+
+BigInt BigInt::operator-() const {
+    BigInt r = *this;
+    r.negative = !negative && !limbs.empty();
+    return r;
+}
+
+void BigInt::set_multiply_thresholds(size_t karatsuba, size_t toom3) {
+    // Each split needs a few limbs per piece to make progress
+    karatsuba_threshold = karatsuba ? std::max(karatsuba, (size_t)4) : BIGNUM_KARATSUBA_THRESHOLD;
+    toom3_threshold = toom3 ? std::max(toom3, (size_t)9) : BIGNUM_TOOM3_THRESHOLD;
+}
+
+// BigDecimal constructors
+BigDecimal::BigDecimal()
+    : scale(0) {
+}
+
+BigDecimal::BigDecimal(int64_t value)
+    : unscaled(value)
+    , scale(0) {
+}
+
+BigDecimal::BigDecimal(const BigInt& unscaled, uint32_t scale)
+    : unscaled(unscaled)
+    , scale(scale) {
+}
+
+BigDecimal BigDecimal::from_scientific(uint64_t mantissa, int32_t exponent) {
+    BigInt m((int64_t)(mantissa >> 32));
+    m.shift_left(32);
+    m = BigInt::add(m, BigInt((int64_t)(mantissa & 0xFFFFFFFFu)));
+
+    if (exponent >= 0) {
+        return BigDecimal(BigInt::mul(m, BigInt::pow10((uint32_t)exponent)), 0);
+    }
+    BigDecimal r(m, (uint32_t)-exponent);
+    r.normalize();
+    return r;
+}
+
+BigDecimal BigDecimal::from_double(double value) {
+    if (std::isnan(value) || std::isinf(value) || value == 0.0) {
+        return BigDecimal();
+    }
+
+    // value = m * 2^e exactly, with m a 53-bit integer
+    int e = 0;
+    double frac = frexp(value, &e);
+    int64_t m = (int64_t)ldexp(frac, 53);
+    e -= 53;
+
+    BigInt mant(m);
+    if (e >= 0) {
+        mant.shift_left((size_t)e);
+        return BigDecimal(mant, 0);
+    }
+    // m / 2^k == m * 5^k / 10^k
+    BigDecimal r(BigInt::mul(mant, BigInt::pow(BigInt(5), (uint32_t)-e)), (uint32_t)-e);
+    r.normalize();
+    return r;
+}
+
+bool BigDecimal::parse(const char* text, size_t length, BigDecimal& out) {
+    std::string digits;
+    digits.reserve(length);
+    size_t i = 0;
+    if (i < length && (text[i] == '+' || text[i] == '-')) {
+        if (text[i] == '-') {
+            digits += '-';
+        }
+        i++;
+    }
+
+    int64_t frac_digits = 0;
+    bool seen_point = false;
+    bool any_digit = false;
+    for (; i < length; i++) {
+        char c = text[i];
+        if (c >= '0' && c <= '9') {
+            digits += c;
+            any_digit = true;
+            frac_digits += seen_point;
+        } else if (c == '.' && !seen_point) {
+            seen_point = true;
+        } else {
+            break;
+        }
+    }
+    if (!any_digit) {
+        return false;
+    }
+
+    int64_t exponent = 0;
+    if (i < length && (text[i] == 'e' || text[i] == 'E')) {
+        i++;
+        bool neg = false;
+        if (i < length && (text[i] == '+' || text[i] == '-')) {
+            neg = (text[i] == '-');
+            i++;
+        }
+        if (i == length) {
+            return false;
+        }
+        for (; i < length && text[i] >= '0' && text[i] <= '9'; i++) {
+            if (exponent > BIGNUM_MAX_DIGITS) {
+                return false;
+            }
+            exponent = exponent * 10 + (text[i] - '0');
+        }
+        exponent = neg ? -exponent : exponent;
+    }
+    if (i != length) {
+        return false;
+    }
+
+    BigInt value;
+    if (!BigInt::parse(digits.data(), digits.size(), value)) {
+        return false;
+    }
+    int64_t scale = frac_digits - exponent;
+    if (scale < -(int64_t)BIGNUM_MAX_DIGITS || scale > (int64_t)BIGNUM_MAX_DIGITS) {
+        return false;
+    }
+    if (scale < 0) {
+        out = BigDecimal(BigInt::mul(value, BigInt::pow10((uint32_t)-scale)), 0);
+    } else {
+        out = BigDecimal(value, (uint32_t)scale);
+    }
+    return true;
+}
+
+// BigDecimal conversion
+std::string BigDecimal::to_string() const {
+    std::string digits = unscaled.to_string();
+    if (scale == 0) {
+        return digits;
+    }
+
+    bool neg = unscaled.is_negative();
+    if (neg) {
+        digits.erase(0, 1);
+    }
+    if (digits.size() <= scale) {
+        digits.insert(0, scale - digits.size() + 1, '0');
+    }
+    digits.insert(digits.size() - scale, 1, '.');
+    if (neg) {
+        digits.insert(0, 1, '-');
+    }
+    return digits;
+}
+
+double BigDecimal::to_double() const {
+    return strtod(to_string().c_str(), nullptr);
+}
+
+// BigDecimal arithmetic
+BigDecimal BigDecimal::add(const BigDecimal& a, const BigDecimal& b) {
+    uint32_t s = std::max(a.scale, b.scale);
+    return BigDecimal(BigInt::add(a.rescaled(s), b.rescaled(s)), s);
+}
+
+BigDecimal BigDecimal::sub(const BigDecimal& a, const BigDecimal& b) {
+    uint32_t s = std::max(a.scale, b.scale);
+    return BigDecimal(BigInt::sub(a.rescaled(s), b.rescaled(s)), s);
+}
+
+BigDecimal BigDecimal::mul(const BigDecimal& a, const BigDecimal& b) {
+    return BigDecimal(BigInt::mul(a.unscaled, b.unscaled), a.scale + b.scale);
+}
+
+bool BigDecimal::div(const BigDecimal& a, const BigDecimal& b, BigDecimal& out) {
+    if (b.is_zero()) {
+        return false;
+    }
+    uint32_t s = std::max((uint32_t)BIGNUM_DIV_DIGITS, std::max(a.scale, b.scale));
+    if (a.digit_estimate() + s + b.scale > BIGNUM_MAX_DIGITS) {
+        return false;
+    }
+
+    // a/b = ua*10^(s + sb - sa) / ub * 10^-s, rounded half away from zero
+    BigInt numerator = BigInt::mul(a.unscaled, BigInt::pow10(s + b.scale - a.scale));
+    BigInt q, r;
+    BigInt::divmod(numerator, b.unscaled, q, r);
+    BigInt twice_r = BigInt::add(r, r);
+    if (twice_r.is_negative()) {
+        twice_r = -twice_r;
+    }
+    BigInt divisor = b.unscaled.is_negative() ? -b.unscaled : b.unscaled;
+    if (BigInt::compare(twice_r, divisor) >= 0) {
+        q = BigInt::add(q, BigInt(numerator.is_negative() != b.is_negative() ? -1 : 1));
+    }
+
+    out = BigDecimal(q, s);
+    out.normalize();
+    return true;
+}
+
+bool BigDecimal::sqrt(const BigDecimal& value, BigDecimal& out) {
+    if (value.is_negative()) {
+        return false;
+    }
+    uint32_t s = std::max((uint32_t)BIGNUM_DIV_DIGITS, (value.scale + 1) / 2);
+
+    // sqrt(u * 10^-sc) = sqrt(u * 10^(2s - sc)) * 10^-s
+    BigInt n = BigInt::mul(value.unscaled, BigInt::pow10(2 * s - value.scale));
+    BigInt root = BigInt::isqrt(n);
+
+    // Round to nearest: root + 1/2 <= sqrt(n)  <=>  4n >= (2 root + 1)^2
+    BigInt odd = BigInt::add(BigInt::add(root, root), BigInt(1));
+    BigInt four_n = n;
+    four_n.mul_small(4);
+    if (BigInt::compare(four_n, BigInt::mul(odd, odd)) >= 0) {
+        root = BigInt::add(root, BigInt(1));
+    }
+
+    out = BigDecimal(root, s);
+    out.normalize();
+    return true;
+}
+
+bool BigDecimal::pow(const BigDecimal& base, const BigDecimal& exponent, BigDecimal& out) {
+    // Only integer exponents are exact; fractional ones are a domain error
+    BigDecimal e = exponent;
+    e.normalize();
+    if (e.scale != 0) {
+        return false;
+    }
+    if (e.unscaled.limb_count() > 1) {
+        return false;
+    }
+
+    BigInt magnitude = e.unscaled.is_negative() ? -e.unscaled : e.unscaled;
+    uint32_t n = magnitude.is_zero() ? 0 : (uint32_t)magnitude.to_double();
+    if (base.is_zero()) {
+        if (e.is_negative()) {
+            return false;
+        }
+        out = BigDecimal(n == 0 ? 1 : 0);
+        return true;
+    }
+    if ((uint64_t)base.digit_estimate() * n > BIGNUM_MAX_DIGITS ||
+        (uint64_t)base.scale * n > BIGNUM_MAX_DIGITS) {
+        return false;
+    }
+
+    BigDecimal result(BigInt::pow(base.unscaled, n), base.scale * n);
+    if (e.is_negative()) {
+        return div(BigDecimal(1), result, out);
+    }
+    out = result;
+    return true;
+}
+
+int BigDecimal::compare(const BigDecimal& a, const BigDecimal& b) {
+    uint32_t s = std::max(a.scale, b.scale);
+    return BigInt::compare(a.rescaled(s), b.rescaled(s));
+}
+
+void BigDecimal::normalize() {
+    // Strip whole 10^9 chunks first, then single digits
+    while (scale >= (uint32_t)DECIMAL_CHUNK_DIGITS && !unscaled.is_zero()) {
+        BigInt t = unscaled;
+        if (t.divmod_small(DECIMAL_CHUNK) != 0) {
+            break;
+        }
+        unscaled = t;
+        scale -= DECIMAL_CHUNK_DIGITS;
+    }
+    while (scale > 0 && !unscaled.is_zero()) {
+        BigInt t = unscaled;
+        if (t.divmod_small(10) != 0) {
+            break;
+        }
+        unscaled = t;
+        scale--;
+    }
+    if (unscaled.is_zero()) {
+        scale = 0;
+    }
+}
+
+// BigDecimal private helpers
+BigInt BigDecimal::rescaled(uint32_t new_scale) const {
+    if (new_scale == scale) {
+        return unscaled;
+    }
+    return BigInt::mul(unscaled, BigInt::pow10(new_scale - scale));
+}
+
+size_t BigDecimal::digit_estimate() const {
+    // log10(2) ~= 0.30103
+    return unscaled.bit_length() * 30103 / 100000 + 1;
+}
@@ -0,0 +1,230 @@
+/**
+  ******************************************************************************
+  * @file           : calc_batch.cpp
+  * @brief          : Batch arithmetic kernels implementation
+  * @author         : STM32 Calculator Project
+  * @date           : 2024
+  ******************************************************************************
+  */
+
+#include "calc_batch.h"
+#include <cmath>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define CALC_BATCH_X86 1
+#include <immintrin.h>
+#endif
+
+enum BatchOp {
+    BATCH_ADD = 0,
+    BATCH_SUB,
+    BATCH_MUL,
+    BATCH_DIV
+};
+
+typedef size_t (*BatchKernel)(BatchOp op, const double* a, const double* b,
+                              double* out, size_t n, uint8_t* lane_status);
+
+// Scalar kernel: mirrors Calculator::add/subtract/multiply/divide per lane
+static size_t batch_scalar(BatchOp op, const double* a, const double* b,
+                           double* out, size_t n, uint8_t* lane_status) {
+    size_t failed = 0;
+    for (size_t i = 0; i < n; i++) {
+        double x = a[i];
+        double y = b[i];
+        uint8_t status = CALC_LANE_OK;
+        double r = 0.0;
+
+        if (op == BATCH_DIV && y == 0.0) {
+            status = CALC_LANE_DIVISION_BY_ZERO;
+        } else if (std::isnan(x) || std::isnan(y) || std::isinf(x) || std::isinf(y)) {
+            status = CALC_LANE_INVALID_NUMBER;
+        } else {
+            switch (op) {
+                case BATCH_ADD: r = x + y; break;
+                case BATCH_SUB: r = x - y; break;
+                case BATCH_MUL: r = x * y; break;
+                case BATCH_DIV: r = x / y; break;
+            }
+        }
+
+        out[i] = r;
+        if (lane_status != nullptr) {
+            lane_status[i] = status;
+        }
+        failed += (status != CALC_LANE_OK);
+    }
+    return failed;
+}
+
+#ifdef CALC_BATCH_X86
+
+// Writes lane statuses for one vector from the finite/zero bit masks
+static inline size_t batch_store_status(uint8_t* lane_status, int finite_bits,
+                                        int zero_bits, int lanes, int all_bits) {
+    int ok_bits = finite_bits & ~zero_bits & all_bits;
+    if (lane_status != nullptr) {
+        for (int l = 0; l < lanes; l++) {
+            uint8_t status = CALC_LANE_OK;
+            if (zero_bits & (1 << l)) {
+                status = CALC_LANE_DIVISION_BY_ZERO;
+            } else if (!(finite_bits & (1 << l))) {
+                status = CALC_LANE_INVALID_NUMBER;
+            }
+            lane_status[l] = status;
+        }
+    }
+    return (size_t)__builtin_popcount(all_bits & ~ok_bits);
+}
+
+__attribute__((target("sse2")))
+static size_t batch_sse2(BatchOp op, const double* a, const double* b,
+                         double* out, size_t n, uint8_t* lane_status) {
+    const __m128d zero = _mm_setzero_pd();
+    size_t failed = 0;
+    size_t i = 0;
+
+    for (; i + 2 <= n; i += 2) {
+        __m128d va = _mm_loadu_pd(a + i);
+        __m128d vb = _mm_loadu_pd(b + i);
+
+        // x - x == 0 exactly when x is finite
+        __m128d finite = _mm_and_pd(_mm_cmpeq_pd(_mm_sub_pd(va, va), zero),
+                                    _mm_cmpeq_pd(_mm_sub_pd(vb, vb), zero));
+        __m128d r;
+        __m128d bad_divisor = zero;
+        switch (op) {
+            case BATCH_ADD: r = _mm_add_pd(va, vb); break;
+            case BATCH_SUB: r = _mm_sub_pd(va, vb); break;
+            case BATCH_MUL: r = _mm_mul_pd(va, vb); break;
+            default:
+                bad_divisor = _mm_cmpeq_pd(vb, zero);
+                r = _mm_div_pd(va, vb);
+                break;
+        }
+
+        __m128d ok = _mm_andnot_pd(bad_divisor, finite);
+        _mm_storeu_pd(out + i, _mm_and_pd(r, ok));
+
+        int finite_bits = _mm_movemask_pd(finite);
+        int zero_bits = _mm_movemask_pd(bad_divisor);
+        if ((finite_bits & ~zero_bits) != 0x3 || lane_status != nullptr) {
+            failed += batch_store_status(lane_status ? lane_status + i : nullptr,
+                                         finite_bits, zero_bits, 2, 0x3);
+        }
+    }
+
+    return failed + batch_scalar(op, a + i, b + i, out + i, n - i,
+                                 lane_status ? lane_status + i : nullptr);
+}
+
+__attribute__((target("avx2")))
+static size_t batch_avx2(BatchOp op, const double* a, const double* b,
+                         double* out, size_t n, uint8_t* lane_status) {
+    const __m256d zero = _mm256_setzero_pd();
+    size_t failed = 0;
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        __m256d va = _mm256_loadu_pd(a + i);
+        __m256d vb = _mm256_loadu_pd(b + i);
+
+        __m256d finite = _mm256_and_pd(
+            _mm256_cmp_pd(_mm256_sub_pd(va, va), zero, _CMP_EQ_OQ),
+            _mm256_cmp_pd(_mm256_sub_pd(vb, vb), zero, _CMP_EQ_OQ));
+        __m256d r;
+        __m256d bad_divisor = zero;
+        switch (op) {
+            case BATCH_ADD: r = _mm256_add_pd(va, vb); break;
+            case BATCH_SUB: r = _mm256_sub_pd(va, vb); break;
+            case BATCH_MUL: r = _mm256_mul_pd(va, vb); break;
+            default:
+                bad_divisor = _mm256_cmp_pd(vb, zero, _CMP_EQ_OQ);
+                r = _mm256_div_pd(va, vb);
+                break;
+        }
+
+        __m256d ok = _mm256_andnot_pd(bad_divisor, finite);
+        _mm256_storeu_pd(out + i, _mm256_and_pd(r, ok));
+
+        int finite_bits = _mm256_movemask_pd(finite);
+        int zero_bits = _mm256_movemask_pd(bad_divisor);
+        if ((finite_bits & ~zero_bits) != 0xF || lane_status != nullptr) {
+            failed += batch_store_status(lane_status ? lane_status + i : nullptr,
+                                         finite_bits, zero_bits, 4, 0xF);
+        }
+    }
+
+    return failed + batch_scalar(op, a + i, b + i, out + i, n - i,
+                                 lane_status ? lane_status + i : nullptr);
+}
+
+#endif // CALC_BATCH_X86
+
+static CalcBatchIsa active_isa = CALC_BATCH_SCALAR;
+static BatchKernel active_kernel = nullptr;
+
+static CalcBatchIsa batch_best_isa() {
+#ifdef CALC_BATCH_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return CALC_BATCH_AVX2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return CALC_BATCH_SSE2;
+    }
+#endif
+    return CALC_BATCH_SCALAR;
+}
+
+static void batch_select(CalcBatchIsa isa) {
+    active_isa = CALC_BATCH_SCALAR;
+    active_kernel = batch_scalar;
+#ifdef CALC_BATCH_X86
+    if (isa == CALC_BATCH_AVX2) {
+        active_isa = CALC_BATCH_AVX2;
+        active_kernel = batch_avx2;
+    } else if (isa == CALC_BATCH_SSE2) {
+        active_isa = CALC_BATCH_SSE2;
+        active_kernel = batch_sse2;
+    }
+#else
+    (void)isa;
+#endif
+}
+
+static inline size_t batch_run(BatchOp op, const double* a, const double* b,
+                               double* out, size_t n, uint8_t* lane_status) {
+    if (active_kernel == nullptr) {
+        batch_select(batch_best_isa());
+    }
+    return active_kernel(op, a, b, out, n, lane_status);
+}
+
+size_t calc_batch_add(const double* a, const double* b, double* out, size_t n, uint8_t* lane_status) {
+    return batch_run(BATCH_ADD, a, b, out, n, lane_status);
+}
+
+size_t calc_batch_subtract(const double* a, const double* b, double* out, size_t n, uint8_t* lane_status) {
+    return batch_run(BATCH_SUB, a, b, out, n, lane_status);
+}
+
+size_t calc_batch_multiply(const double* a, const double* b, double* out, size_t n, uint8_t* lane_status) {
+    return batch_run(BATCH_MUL, a, b, out, n, lane_status);
+}
+
+size_t calc_batch_divide(const double* a, const double* b, double* out, size_t n, uint8_t* lane_status) {
+    return batch_run(BATCH_DIV, a, b, out, n, lane_status);
+}
+
+CalcBatchIsa calc_batch_active_isa() {
+    if (active_kernel == nullptr) {
+        batch_select(batch_best_isa());
+    }
+    return active_isa;
+}
+
+void calc_batch_force_isa(CalcBatchIsa isa) {
+    CalcBatchIsa best = batch_best_isa();
+    batch_select(isa > best ? best : isa);
+}
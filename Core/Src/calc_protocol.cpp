@@ -0,0 +1,335 @@
+/**
+  ******************************************************************************
+  * @file           : calc_protocol.cpp
+  * @brief          : Binary framed calculation protocol (frames, CRC16, server)
+  * @author         : STM32 Calculator Project
+  * @date           : 2024
+  ******************************************************************************
+  */
+
+#include "calc_protocol.h"
+#include <cmath>
+#include <cstring>
+
+static_assert(CALC_FRAME_PAYLOAD_MAX >= 16 && CALC_FRAME_PAYLOAD_MAX <= 255,
+              "CALC_FRAME_PAYLOAD_MAX must fit the length byte");
+
+// Operand pairs of the narrowest format in the largest request
+static const size_t BATCH_LANES_MAX = (CALC_FRAME_PAYLOAD_MAX - CALC_REQUEST_HEADER) / 8;
+
+// CRC16/CCITT-FALSE, one table step per byte
+static const uint16_t crc16_table[256] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+    0x1231, 0x0210, 0x3273, 0x2252, 0x52B5, 0x4294, 0x72F7, 0x62D6,
+    0x9339, 0x8318, 0xB37B, 0xA35A, 0xD3BD, 0xC39C, 0xF3FF, 0xE3DE,
+    0x2462, 0x3443, 0x0420, 0x1401, 0x64E6, 0x74C7, 0x44A4, 0x5485,
+    0xA56A, 0xB54B, 0x8528, 0x9509, 0xE5EE, 0xF5CF, 0xC5AC, 0xD58D,
+    0x3653, 0x2672, 0x1611, 0x0630, 0x76D7, 0x66F6, 0x5695, 0x46B4,
+    0xB75B, 0xA77A, 0x9719, 0x8738, 0xF7DF, 0xE7FE, 0xD79D, 0xC7BC,
+    0x48C4, 0x58E5, 0x6886, 0x78A7, 0x0840, 0x1861, 0x2802, 0x3823,
+    0xC9CC, 0xD9ED, 0xE98E, 0xF9AF, 0x8948, 0x9969, 0xA90A, 0xB92B,
+    0x5AF5, 0x4AD4, 0x7AB7, 0x6A96, 0x1A71, 0x0A50, 0x3A33, 0x2A12,
+    0xDBFD, 0xCBDC, 0xFBBF, 0xEB9E, 0x9B79, 0x8B58, 0xBB3B, 0xAB1A,
+    0x6CA6, 0x7C87, 0x4CE4, 0x5CC5, 0x2C22, 0x3C03, 0x0C60, 0x1C41,
+    0xEDAE, 0xFD8F, 0xCDEC, 0xDDCD, 0xAD2A, 0xBD0B, 0x8D68, 0x9D49,
+    0x7E97, 0x6EB6, 0x5ED5, 0x4EF4, 0x3E13, 0x2E32, 0x1E51, 0x0E70,
+    0xFF9F, 0xEFBE, 0xDFDD, 0xCFFC, 0xBF1B, 0xAF3A, 0x9F59, 0x8F78,
+    0x9188, 0x81A9, 0xB1CA, 0xA1EB, 0xD10C, 0xC12D, 0xF14E, 0xE16F,
+    0x1080, 0x00A1, 0x30C2, 0x20E3, 0x5004, 0x4025, 0x7046, 0x6067,
+    0x83B9, 0x9398, 0xA3FB, 0xB3DA, 0xC33D, 0xD31C, 0xE37F, 0xF35E,
+    0x02B1, 0x1290, 0x22F3, 0x32D2, 0x4235, 0x5214, 0x6277, 0x7256,
+    0xB5EA, 0xA5CB, 0x95A8, 0x8589, 0xF56E, 0xE54F, 0xD52C, 0xC50D,
+    0x34E2, 0x24C3, 0x14A0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+    0xA7DB, 0xB7FA, 0x8799, 0x97B8, 0xE75F, 0xF77E, 0xC71D, 0xD73C,
+    0x26D3, 0x36F2, 0x0691, 0x16B0, 0x6657, 0x7676, 0x4615, 0x5634,
+    0xD94C, 0xC96D, 0xF90E, 0xE92F, 0x99C8, 0x89E9, 0xB98A, 0xA9AB,
+    0x5844, 0x4865, 0x7806, 0x6827, 0x18C0, 0x08E1, 0x3882, 0x28A3,
+    0xCB7D, 0xDB5C, 0xEB3F, 0xFB1E, 0x8BF9, 0x9BD8, 0xABBB, 0xBB9A,
+    0x4A75, 0x5A54, 0x6A37, 0x7A16, 0x0AF1, 0x1AD0, 0x2AB3, 0x3A92,
+    0xFD2E, 0xED0F, 0xDD6C, 0xCD4D, 0xBDAA, 0xAD8B, 0x9DE8, 0x8DC9,
+    0x7C26, 0x6C07, 0x5C64, 0x4C45, 0x3CA2, 0x2C83, 0x1CE0, 0x0CC1,
+    0xEF1F, 0xFF3E, 0xCF5D, 0xDF7C, 0xAF9B, 0xBFBA, 0x8FD9, 0x9FF8,
+    0x6E17, 0x7E36, 0x4E55, 0x5E74, 0x2E93, 0x3EB2, 0x0ED1, 0x1EF0
+};
+
+uint16_t calc_crc16(const uint8_t* data, size_t length, uint16_t crc) {
+    for (size_t i = 0; i < length; i++) {
+        crc = (uint16_t)((crc << 8) ^ crc16_table[((crc >> 8) ^ data[i]) & 0xFF]);
+    }
+    return crc;
+}
+
+size_t calc_frame_encode(const uint8_t* payload, size_t length, uint8_t* frame, size_t size) {
+    if (length > CALC_FRAME_PAYLOAD_MAX || size < length + CALC_FRAME_OVERHEAD) {
+        return 0;
+    }
+    frame[0] = CALC_FRAME_SYNC;
+    frame[1] = (uint8_t)length;
+    memmove(frame + 2, payload, length);
+    uint16_t crc = calc_crc16(frame + 1, length + 1);
+    frame[length + 2] = (uint8_t)crc;
+    frame[length + 3] = (uint8_t)(crc >> 8);
+    return length + CALC_FRAME_OVERHEAD;
+}
+
+size_t calc_operand_size(CalcOperandFormat format) {
+    switch (format) {
+        case CALC_FORMAT_F64: return 8;
+        case CALC_FORMAT_F32: return 4;
+        case CALC_FORMAT_Q16_16: return 4;
+        default: return 0;
+    }
+}
+
+static void put_le(uint64_t bits, size_t bytes, uint8_t* out) {
+    for (size_t i = 0; i < bytes; i++) {
+        out[i] = (uint8_t)(bits >> (8 * i));
+    }
+}
+
+static uint64_t get_le(const uint8_t* in, size_t bytes) {
+    uint64_t bits = 0;
+    for (size_t i = 0; i < bytes; i++) {
+        bits |= (uint64_t)in[i] << (8 * i);
+    }
+    return bits;
+}
+
+void calc_operand_put(CalcOperandFormat format, double value, uint8_t* out) {
+    if (format == CALC_FORMAT_F64) {
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        put_le(bits, 8, out);
+    } else if (format == CALC_FORMAT_F32) {
+        float narrow = (float)value;
+        uint32_t bits;
+        memcpy(&bits, &narrow, sizeof(bits));
+        put_le(bits, 4, out);
+    } else if (format == CALC_FORMAT_Q16_16) {
+        // Saturated like Fixed; NaN has no encoding and reads 0
+        double scaled = value * 65536.0;
+        int32_t raw;
+        if (scaled != scaled) {
+            raw = 0;
+        } else if (scaled >= 2147483647.0) {
+            raw = INT32_MAX;
+        } else if (scaled <= -2147483648.0) {
+            raw = INT32_MIN;
+        } else {
+            raw = (int32_t)std::floor(scaled + 0.5);
+        }
+        put_le((uint32_t)raw, 4, out);
+    }
+}
+
+double calc_operand_get(CalcOperandFormat format, const uint8_t* in) {
+    if (format == CALC_FORMAT_F64) {
+        uint64_t bits = get_le(in, 8);
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+    if (format == CALC_FORMAT_F32) {
+        uint32_t bits = (uint32_t)get_le(in, 4);
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+    if (format == CALC_FORMAT_Q16_16) {
+        return (int32_t)(uint32_t)get_le(in, 4) / 65536.0;
+    }
+    return 0.0;
+}
+
+size_t calc_batch_lanes_max(CalcOperandFormat format) {
+    size_t size = calc_operand_size(format);
+    return size != 0 ? (CALC_FRAME_PAYLOAD_MAX - CALC_REQUEST_HEADER) / (2 * size) : 0;
+}
+
+CalcFrameResult CalcFrameDecoder::push(uint8_t byte) {
+    switch (state) {
+        case STATE_SYNC:
+            if (byte != CALC_FRAME_SYNC) {
+                stats.bytes_skipped++;
+                return CALC_FRAME_SKIPPED;
+            }
+            state = STATE_LENGTH;
+            return CALC_FRAME_NEED_MORE;
+        case STATE_LENGTH:
+            if (byte > CALC_FRAME_PAYLOAD_MAX) {
+                // Not a frame of ours: the sync byte was noise
+                stats.bytes_skipped += 2;
+                state = STATE_SYNC;
+                return CALC_FRAME_SKIPPED;
+            }
+            length = byte;
+            buffer[0] = byte;
+            received = 1;
+            state = STATE_BODY;
+            return CALC_FRAME_NEED_MORE;
+        case STATE_BODY:
+            buffer[received++] = byte;
+            if (received < length + 3) {
+                return CALC_FRAME_NEED_MORE;
+            }
+            if (calc_crc16(buffer, length + 1) !=
+                (uint16_t)(buffer[length + 1] | (buffer[length + 2] << 8))) {
+                stats.crc_errors++;
+                state = STATE_SYNC;
+                return CALC_FRAME_BAD_CRC;
+            }
+            stats.frames++;
+            state = STATE_READY;
+            return CALC_FRAME_READY;
+        default:
+            return CALC_FRAME_NEED_MORE;    // Ready: release() first
+    }
+}
+
+size_t CalcFrameDecoder::wanted() const {
+    switch (state) {
+        case STATE_SYNC:
+        case STATE_LENGTH:
+            return 1;
+        case STATE_BODY:
+            return (size_t)length + 3 - received;
+        default:
+            return 0;
+    }
+}
+
+void CalcFrameDecoder::release() {
+    state = STATE_SYNC;
+}
+
+// Scratch kept off the stack, for one caller at a time; hosts serving from
+// several threads build with -DCALC_PROTOCOL_THREAD_LOCAL=thread_local
+#ifndef CALC_PROTOCOL_THREAD_LOCAL
+#define CALC_PROTOCOL_THREAD_LOCAL
+#endif
+static CALC_PROTOCOL_THREAD_LOCAL double batch_a[BATCH_LANES_MAX];
+static CALC_PROTOCOL_THREAD_LOCAL double batch_b[BATCH_LANES_MAX];
+static CALC_PROTOCOL_THREAD_LOCAL double batch_out[BATCH_LANES_MAX];
+static CALC_PROTOCOL_THREAD_LOCAL uint8_t batch_status[BATCH_LANES_MAX];
+static CALC_PROTOCOL_THREAD_LOCAL uint8_t reply[CALC_FRAME_PAYLOAD_MAX];
+static CALC_PROTOCOL_THREAD_LOCAL char expression_text[CALC_FRAME_PAYLOAD_MAX + 1];
+
+template <typename T>
+static size_t serve_batch(CalcOpcode opcode, CalcOperandFormat format, const uint8_t* operands,
+                          size_t length, uint8_t* out, CalcFrameStatus& status) {
+    size_t size = calc_operand_size(format);
+    if (size == 0) {
+        status = CALC_STATUS_BAD_FORMAT;
+        return 0;
+    }
+    if (length % (2 * size) != 0) {
+        status = CALC_STATUS_BAD_LENGTH;
+        return 0;
+    }
+    size_t lanes = length / (2 * size);
+    for (size_t i = 0; i < lanes; i++) {
+        batch_a[i] = calc_operand_get(format, operands + 2 * i * size);
+        batch_b[i] = calc_operand_get(format, operands + (2 * i + 1) * size);
+    }
+
+    size_t failed;
+    if (opcode == CALC_OP_ADD) {
+        failed = BasicCalculator<T>::add(batch_a, batch_b, batch_out, lanes, batch_status);
+    } else if (opcode == CALC_OP_SUBTRACT) {
+        failed = BasicCalculator<T>::subtract(batch_a, batch_b, batch_out, lanes, batch_status);
+    } else if (opcode == CALC_OP_MULTIPLY) {
+        failed = BasicCalculator<T>::multiply(batch_a, batch_b, batch_out, lanes, batch_status);
+    } else {
+        failed = BasicCalculator<T>::divide(batch_a, batch_b, batch_out, lanes, batch_status);
+    }
+
+    for (size_t i = 0; i < lanes; i++) {
+        calc_operand_put(format, batch_out[i], out + i * size);
+    }
+    size_t used = lanes * size;
+    if (failed != 0) {
+        status = CALC_STATUS_LANE_ERRORS;
+        memcpy(out + used, batch_status, lanes);
+        used += lanes;
+    }
+    return used;
+}
+
+template <typename T>
+static size_t serve_eval(BasicCalculator<T>& calculator, CalcOperandFormat format,
+                         const uint8_t* text, size_t length, uint8_t* out, CalcFrameStatus& status) {
+    if (calc_operand_size(format) == 0) {
+        status = CALC_STATUS_BAD_FORMAT;
+        return 0;
+    }
+    memcpy(expression_text, text, length);
+    expression_text[length] = '\0';
+    T value = calculator.evaluate(expression_text);
+    if (calculator.is_error()) {
+        status = CALC_STATUS_CALC_ERROR;
+        out[0] = calculator.get_error_code();
+        return 1;
+    }
+    calc_operand_put(format, NumTraits<T>::to_double(value), out);
+    return calc_operand_size(format);
+}
+
+template <typename T>
+size_t calc_protocol_serve(BasicCalculator<T>& calculator, const uint8_t* request, size_t length,
+                           uint8_t* frame, size_t size) {
+    if (length < CALC_REQUEST_HEADER) {
+        return 0;
+    }
+    CalcOpcode opcode = (CalcOpcode)request[0];
+    CalcOperandFormat format = (CalcOperandFormat)request[1];
+    const uint8_t* operands = request + CALC_REQUEST_HEADER;
+    size_t operand_bytes = length - CALC_REQUEST_HEADER;
+
+    CalcFrameStatus status = CALC_STATUS_OK;
+    size_t used = CALC_RESPONSE_HEADER;
+    switch (opcode) {
+        case CALC_OP_PING:
+            break;
+        case CALC_OP_ADD:
+        case CALC_OP_SUBTRACT:
+        case CALC_OP_MULTIPLY:
+        case CALC_OP_DIVIDE:
+            used += serve_batch<T>(opcode, format, operands, operand_bytes, reply + used, status);
+            break;
+        case CALC_OP_EVAL:
+            used += serve_eval(calculator, format, operands, operand_bytes, reply + used, status);
+            break;
+        default:
+            status = CALC_STATUS_BAD_OPCODE;
+            break;
+    }
+    reply[0] = (uint8_t)(opcode | CALC_RESPONSE_FLAG);
+    reply[1] = format;
+    reply[2] = request[2];
+    reply[3] = request[3];
+    reply[4] = status;
+    return calc_frame_encode(reply, used, frame, size);
+}
+
+size_t calc_protocol_reply_max(const uint8_t* request, size_t length) {
+    if (length < CALC_REQUEST_HEADER) {
+        return 0;
+    }
+    size_t size = calc_operand_size((CalcOperandFormat)request[1]);
+    size_t results = 8;     // One result or error code (EVAL), or nothing
+    if (request[0] >= CALC_OP_ADD && request[0] <= CALC_OP_DIVIDE && size != 0) {
+        // Results and lane status bytes
+        results = (length - CALC_REQUEST_HEADER) / (2 * size) * (size + 1);
+    }
+    return CALC_FRAME_OVERHEAD + CALC_RESPONSE_HEADER + results;
+}
+
+// Explicit instantiations for every supported backend
+template size_t calc_protocol_serve<float>(BasicCalculator<float>&, const uint8_t*, size_t, uint8_t*, size_t);
+template size_t calc_protocol_serve<double>(BasicCalculator<double>&, const uint8_t*, size_t, uint8_t*, size_t);
+template size_t calc_protocol_serve<long double>(BasicCalculator<long double>&, const uint8_t*, size_t, uint8_t*, size_t);
+template size_t calc_protocol_serve<Fixed>(BasicCalculator<Fixed>&, const uint8_t*, size_t, uint8_t*, size_t);
+#ifdef CALC_ENABLE_BIGNUM
+template size_t calc_protocol_serve<BigDecimal>(BasicCalculator<BigDecimal>&, const uint8_t*, size_t, uint8_t*, size_t);
+#endif
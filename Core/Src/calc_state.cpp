@@ -0,0 +1,542 @@
+/**
+  ******************************************************************************
+  * @file           : calc_state.cpp
+  * @brief          : Calculator state transitions
+  * @author         : STM32 Calculator Project
+  * @date           : 2024
+  ******************************************************************************
+  */
+
+#include "calc_state.h"
+
+// Error descriptions, indexed by CalcError
+static const char* const error_strings[CALC_ERROR_COUNT] = {
+    "",
+    "Invalid number",
+    "Division by zero",
+    "Invalid input for square root",
+    "Invalid percentage calculation",
+    "Syntax error",
+    "Expression too long"
+};
+
+const char* calc_error_string(CalcError error) {
+    return (error < CALC_ERROR_COUNT) ? error_strings[error] : "Unknown error";
+}
+
+// Basic arithmetic operations
+template <typename T>
+T BasicCalcState<T>::add(T a, T b) {
+    if (validate_operation(a, b, '+')) {
+        return record_result(Num::add(a, b));
+    }
+    return Num::zero();
+}
+
+template <typename T>
+T BasicCalcState<T>::subtract(T a, T b) {
+    if (validate_operation(a, b, '-')) {
+        return record_result(Num::sub(a, b));
+    }
+    return Num::zero();
+}
+
+template <typename T>
+T BasicCalcState<T>::multiply(T a, T b) {
+    if (validate_operation(a, b, '*')) {
+        return record_result(Num::mul(a, b));
+    }
+    return Num::zero();
+}
+
+template <typename T>
+T BasicCalcState<T>::divide(T a, T b) {
+    if (Num::is_zero(b)) {
+        set_error(CALC_ERROR_DIVISION_BY_ZERO);
+        return Num::zero();
+    }
+    
+    if (validate_operation(a, b, '/')) {
+        return record_result(Num::div(a, b));
+    }
+    return Num::zero();
+}
+
+template <typename T>
+T BasicCalcState<T>::apply(char op, T a, T b) {
+    switch (op) {
+        case '+': return add(a, b);
+        case '-': return subtract(a, b);
+        case '*': return multiply(a, b);
+        case '/': return divide(a, b);
+        case '^': return power(a, b);
+        case '%': return percentage(a, b);
+        default:
+            set_error(CALC_ERROR_SYNTAX);
+            return Num::zero();
+    }
+}
+
+// Advanced operations
+template <typename T>
+T BasicCalcState<T>::power(T base, T exponent) {
+    if (validate_operation(base, exponent, '^')) {
+        T result;
+        if (!Num::pow(base, exponent, result)) {
+            set_error(CALC_ERROR_INVALID_NUMBER);
+            return Num::zero();
+        }
+        return record_result(result);
+    }
+    return Num::zero();
+}
+
+template <typename T>
+T BasicCalcState<T>::square_root(T value) {
+    T result;
+    if (!Num::sqrt(value, result)) {
+        set_error(CALC_ERROR_INVALID_SQRT);
+        return Num::zero();
+    }
+    
+    last_result = result;
+    return last_result;
+}
+
+template <typename T>
+T BasicCalcState<T>::percentage(T value, T total) {
+    if (Num::is_zero(total)) {
+        set_error(CALC_ERROR_INVALID_PERCENTAGE);
+        return Num::zero();
+    }
+    
+    last_result = Num::mul(Num::div(value, total), Num::from_int(100));
+    return last_result;
+}
+
+// Memory functions
+template <typename T>
+void BasicCalcState<T>::memory_store(T value) {
+    memory_value = value;
+    clear_error();
+}
+
+template <typename T>
+T BasicCalcState<T>::memory_recall() const {
+    return memory_value;
+}
+
+template <typename T>
+void BasicCalcState<T>::memory_clear() {
+    memory_value = Num::zero();
+}
+
+template <typename T>
+void BasicCalcState<T>::memory_add(T value) {
+    memory_value = Num::add(memory_value, value);
+}
+
+template <typename T>
+void BasicCalcState<T>::memory_subtract(T value) {
+    memory_value = Num::sub(memory_value, value);
+}
+
+// Utility functions
+template <typename T>
+void BasicCalcState<T>::clear() {
+    reset_input();
+    clear_error();
+}
+
+template <typename T>
+bool BasicCalcState<T>::is_error() const {
+    return error_code != CALC_ERROR_NONE;
+}
+
+template <typename T>
+const char* BasicCalcState<T>::get_last_error() const {
+    return calc_error_string(error_code);
+}
+
+template <typename T>
+CalcError BasicCalcState<T>::get_error_code() const {
+    return error_code;
+}
+
+template <typename T>
+uint8_t BasicCalcState<T>::get_status_flags() const {
+    return status_flags;
+}
+
+template <typename T>
+void BasicCalcState<T>::clear_status_flags() {
+    status_flags = 0;
+}
+
+template <typename T>
+T BasicCalcState<T>::get_last_result() const {
+    return last_result;
+}
+
+template <typename T>
+T BasicCalcState<T>::get_current_value() const {
+    return current_value;
+}
+
+// Expression evaluation
+template <typename T>
+T BasicCalcState<T>::evaluate(const char* expression) {
+    BasicExpression<T> compiled;
+    ExpressionBase::Status status = compiled.compile(expression);
+    if (status != ExpressionBase::EXPR_OK) {
+        set_expression_error(status);
+        return Num::zero();
+    }
+    return evaluate(compiled);
+}
+
+template <typename T>
+T BasicCalcState<T>::evaluate(const BasicExpression<T>& expression, const T* variables) {
+    T result = Num::zero();
+    ExpressionBase::Status status = expression.evaluate(variables, result);
+    if (status != ExpressionBase::EXPR_OK) {
+        set_expression_error(status);
+        return Num::zero();
+    }
+    
+    clear_error();
+    return record_result(result);
+}
+
+// Input processing
+// Keys are fed through an incremental shunting-yard: operators only reduce
+// pending operators of higher (or equal, left-associative) precedence, so
+// 2+3*4= gives 14 and parentheses nest up to CALC_STACK_DEPTH levels.
+template <typename T>
+void BasicCalcState<T>::process_input(char input) {
+    if (is_error()) {
+        clear_error();
+    }
+    
+    switch (input) {
+        case '0': case '1': case '2': case '3': case '4':
+        case '5': case '6': case '7': case '8': case '9':
+            append_digit((uint8_t)(input - '0'));
+            break;
+            
+        case '.':
+            if (entry_state != ENTRY_TYPING) {
+                append_digit(0);
+            }
+            entry_point = true;
+            break;
+            
+        case '+': case '-': case '*': case '/': case '^':
+            set_operation(input);
+            break;
+            
+        case '(':
+            if (entry_state != ENTRY_NONE) {
+                set_operation('*');  // Implicit multiplication: 2(3+4)
+            }
+            if (operator_count >= CALC_STACK_DEPTH) {
+                set_error(CALC_ERROR_TOO_LONG);
+                reset_input();
+                break;
+            }
+            operator_stack[operator_count++] = '(';
+            break;
+            
+        case ')': {
+            bool open_group = false;
+            for (uint8_t i = 0; i < operator_count; i++) {
+                if (operator_stack[i] == '(') {
+                    open_group = true;
+                }
+            }
+            if (!open_group) {
+                break;
+            }
+            if (entry_state == ENTRY_NONE) {
+                set_error(CALC_ERROR_SYNTAX);
+                reset_input();
+                break;
+            }
+            push_entry();
+            reduce_while(0, false);
+            if (is_error()) {
+                break;
+            }
+            operator_count--;  // Discard '('
+            current_value = operand_stack[--operand_count];
+            entry_state = ENTRY_VALUE;
+            break;
+        }
+            
+        case '=':
+            calculate_result();
+            break;
+            
+        case 'C':
+            clear();
+            break;
+            
+        case 'M':
+            // Memory operations
+            break;
+            
+        default:
+            break;
+    }
+}
+
+template <typename T>
+void BasicCalcState<T>::set_operation(char op) {
+    if (!ExpressionBase::is_binary_operator(op)) {
+        return;
+    }
+    
+    if (entry_state == ENTRY_NONE) {
+        if (operator_count > 0 && operator_stack[operator_count - 1] != '(') {
+            // Operator typed twice: the new one replaces the old one
+            operator_count--;
+            current_value = operand_stack[--operand_count];
+            entry_state = ENTRY_VALUE;
+        } else if (operator_count == 0 && operand_count == 0) {
+            // Chain from the previous result: "= * 2 ="
+            current_value = last_result;
+            entry_state = ENTRY_VALUE;
+        } else {
+            // Leading sign inside a group: "(-5)" is read as "(0-5)"
+            current_value = Num::zero();
+            entry_state = ENTRY_VALUE;
+        }
+    }
+    
+    push_entry();
+    reduce_while(ExpressionBase::precedence(op), ExpressionBase::is_right_associative(op));
+    if (is_error()) {
+        return;
+    }
+    
+    if (operator_count >= CALC_STACK_DEPTH) {
+        set_error(CALC_ERROR_TOO_LONG);
+        reset_input();
+        return;
+    }
+    operator_stack[operator_count++] = op;
+    entry_state = ENTRY_NONE;
+}
+
+template <typename T>
+void BasicCalcState<T>::calculate_result() {
+    if (operator_count == 0 && operand_count == 0) {
+        if (entry_state != ENTRY_NONE) {
+            last_result = current_value;
+            entry_state = ENTRY_VALUE;
+        }
+        return;
+    }
+    
+    if (entry_state == ENTRY_NONE) {
+        // Dangling '(' at the end are dropped with the operator in front of
+        // them (explicit or the implicit '*'), which has no right operand
+        while (operator_count > 0 && operator_stack[operator_count - 1] == '(') {
+            operator_count--;
+        }
+        if (operator_count > 0) {
+            operator_count--;
+        }
+        if (operand_count == 0) {
+            reset_input();
+            return;
+        }
+        current_value = operand_stack[--operand_count];
+        entry_state = ENTRY_VALUE;
+    }
+    
+    push_entry();
+    while (operator_count > 0 && !is_error()) {
+        if (operator_stack[operator_count - 1] == '(') {
+            operator_count--;  // Unclosed groups close implicitly
+        } else {
+            reduce_top();
+        }
+    }
+    if (is_error()) {
+        return;
+    }
+    
+    last_result = operand_stack[0];
+    operand_count = 0;
+    current_value = last_result;
+    entry_state = ENTRY_VALUE;
+}
+
+template <typename T>
+void BasicCalcState<T>::enter_value(T value) {
+    // A key like any other: it clears the error shown
+    if (is_error()) {
+        clear_error();
+    }
+    current_value = value;
+    entry_state = ENTRY_VALUE;
+}
+
+// Private helper methods
+template <typename T>
+void BasicCalcState<T>::set_error(CalcError error) {
+    error_code = error;
+    switch (error) {
+        case CALC_ERROR_DIVISION_BY_ZERO:
+            status_flags |= CALC_FLAG_DIVIDE_BY_ZERO;
+            break;
+        case CALC_ERROR_SYNTAX:
+        case CALC_ERROR_TOO_LONG:
+            status_flags |= CALC_FLAG_SYNTAX;
+            break;
+        default:
+            status_flags |= CALC_FLAG_INVALID;
+            break;
+    }
+}
+
+template <typename T>
+void BasicCalcState<T>::clear_error() {
+    error_code = CALC_ERROR_NONE;
+}
+
+template <typename T>
+bool BasicCalcState<T>::validate_operation(T a, T b, char op) {
+    // Basic validation - can be extended
+    if (!Num::is_valid(a) || !Num::is_valid(b)) {
+        set_error(CALC_ERROR_INVALID_NUMBER);
+        return false;
+    }
+    
+    clear_error();
+    return true;
+}
+
+template <typename T>
+T BasicCalcState<T>::record_result(T result) {
+    if (Num::is_overflow(result)) {
+        status_flags |= CALC_FLAG_OVERFLOW;
+    }
+    last_result = result;
+    return last_result;
+}
+
+template <typename T>
+void BasicCalcState<T>::append_digit(uint8_t digit) {
+    if (entry_state != ENTRY_TYPING) {
+        entry_mantissa = 0;
+        entry_decimals = 0;
+        entry_point = false;
+        entry_state = ENTRY_TYPING;
+    }
+    
+    // Digits beyond 15 significant ones are ignored
+    if (entry_mantissa >= ENTRY_MANTISSA_LIMIT) {
+        return;
+    }
+    
+    entry_mantissa = entry_mantissa * 10 + digit;
+    if (entry_point) {
+        entry_decimals++;
+    }
+    current_value = Num::from_decimal(entry_mantissa, entry_decimals);
+}
+
+template <typename T>
+void BasicCalcState<T>::push_entry() {
+    if (operand_count >= CALC_STACK_DEPTH) {
+        set_error(CALC_ERROR_TOO_LONG);
+        reset_input();
+        return;
+    }
+    operand_stack[operand_count++] = (entry_state == ENTRY_NONE) ? Num::zero() : current_value;
+}
+
+template <typename T>
+bool BasicCalcState<T>::reduce_top() {
+    if (operand_count < 2) {
+        set_error(CALC_ERROR_SYNTAX);
+        reset_input();
+        return false;
+    }
+    
+    char op = operator_stack[--operator_count];
+    T b = operand_stack[--operand_count];
+    T a = operand_stack[operand_count - 1];
+    T result = Num::zero();
+    
+    switch (op) {
+        case '+': result = add(a, b); break;
+        case '-': result = subtract(a, b); break;
+        case '*': result = multiply(a, b); break;
+        case '/': result = divide(a, b); break;
+        case '^': result = power(a, b); break;
+        default: break;
+    }
+    
+    if (is_error()) {
+        reset_input();
+        return false;
+    }
+    operand_stack[operand_count - 1] = result;
+    return true;
+}
+
+template <typename T>
+void BasicCalcState<T>::reduce_while(uint8_t precedence, bool right_associative) {
+    while (operator_count > 0 && operator_stack[operator_count - 1] != '(') {
+        uint8_t top = ExpressionBase::precedence(operator_stack[operator_count - 1]);
+        if (top > precedence || (top == precedence && !right_associative)) {
+            if (!reduce_top()) {
+                return;
+            }
+        } else {
+            break;
+        }
+    }
+}
+
+template <typename T>
+void BasicCalcState<T>::reset_input() {
+    current_value = Num::zero();
+    entry_mantissa = 0;
+    entry_decimals = 0;
+    entry_point = false;
+    entry_state = ENTRY_NONE;
+    operand_count = 0;
+    operator_count = 0;
+}
+
+template <typename T>
+void BasicCalcState<T>::set_expression_error(ExpressionBase::Status status) {
+    switch (status) {
+        case ExpressionBase::EXPR_DIVISION_BY_ZERO:
+            set_error(CALC_ERROR_DIVISION_BY_ZERO);
+            break;
+        case ExpressionBase::EXPR_INVALID_NUMBER:
+            set_error(CALC_ERROR_INVALID_NUMBER);
+            break;
+        case ExpressionBase::EXPR_TOO_LONG:
+        case ExpressionBase::EXPR_TOO_DEEP:
+            set_error(CALC_ERROR_TOO_LONG);
+            break;
+        default:
+            set_error(CALC_ERROR_SYNTAX);
+            break;
+    }
+}
+
+// Explicit instantiations
+template class BasicCalcState<float>;
+template class BasicCalcState<double>;
+template class BasicCalcState<long double>;
+template class BasicCalcState<Fixed>;
+#ifdef CALC_ENABLE_BIGNUM
+template class BasicCalcState<BigDecimal>;
+#endif
@@ -8,224 +8,180 @@
   */
 
 #include "calculator.h"
-#include <cmath>
-#include <cstring>
+#include "profiler.h"
+#include "trace.h"
 
-// Constructor
-Calculator::Calculator() 
-    : current_value(0.0)
-    , stored_value(0.0)
-    , memory_value(0.0)
-    , current_operation('\0')
-    , has_error(false)
-    , error_message("")
-    , last_result(0.0) {
+// Basic arithmetic operations
+template <typename T>
+T BasicCalculator<T>::add(T a, T b) {
+    return state.add(a, b);
 }
 
-// Destructor
-Calculator::~Calculator() {
+template <typename T>
+T BasicCalculator<T>::subtract(T a, T b) {
+    return state.subtract(a, b);
 }
 
-// Basic arithmetic operations
-double Calculator::add(double a, double b) {
-    if (validate_operation(a, b, '+')) {
-        last_result = a + b;
-        return last_result;
-    }
-    return 0.0;
+template <typename T>
+T BasicCalculator<T>::multiply(T a, T b) {
+    return state.multiply(a, b);
 }
 
-double Calculator::subtract(double a, double b) {
-    if (validate_operation(a, b, '-')) {
-        last_result = a - b;
-        return last_result;
-    }
-    return 0.0;
+template <typename T>
+T BasicCalculator<T>::divide(T a, T b) {
+    return state.divide(a, b);
 }
 
-double Calculator::multiply(double a, double b) {
-    if (validate_operation(a, b, '*')) {
-        last_result = a * b;
-        return last_result;
-    }
-    return 0.0;
+// Batch arithmetic
+template <typename T>
+size_t BasicCalculator<T>::add(const double* a, const double* b, double* out, size_t n, uint8_t* lane_status) {
+    return calc_batch_add(a, b, out, n, lane_status);
 }
 
-double Calculator::divide(double a, double b) {
-    if (b == 0.0) {
-        set_error("Division by zero");
-        return 0.0;
-    }
-    
-    if (validate_operation(a, b, '/')) {
-        last_result = a / b;
-        return last_result;
-    }
-    return 0.0;
+template <typename T>
+size_t BasicCalculator<T>::subtract(const double* a, const double* b, double* out, size_t n, uint8_t* lane_status) {
+    return calc_batch_subtract(a, b, out, n, lane_status);
+}
+
+template <typename T>
+size_t BasicCalculator<T>::multiply(const double* a, const double* b, double* out, size_t n, uint8_t* lane_status) {
+    return calc_batch_multiply(a, b, out, n, lane_status);
+}
+
+template <typename T>
+size_t BasicCalculator<T>::divide(const double* a, const double* b, double* out, size_t n, uint8_t* lane_status) {
+    return calc_batch_divide(a, b, out, n, lane_status);
 }
 
 // Advanced operations
-double Calculator::power(double base, double exponent) {
-    if (validate_operation(base, exponent, '^')) {
-        last_result = pow(base, exponent);
-        return last_result;
-    }
-    return 0.0;
+template <typename T>
+T BasicCalculator<T>::power(T base, T exponent) {
+    return state.power(base, exponent);
 }
 
-double Calculator::square_root(double value) {
-    if (value < 0.0) {
-        set_error("Invalid input for square root");
-        return 0.0;
-    }
-    
-    last_result = sqrt(value);
-    return last_result;
+template <typename T>
+T BasicCalculator<T>::square_root(T value) {
+    return state.square_root(value);
 }
 
-double Calculator::percentage(double value, double total) {
-    if (total == 0.0) {
-        set_error("Invalid percentage calculation");
-        return 0.0;
-    }
-    
-    last_result = (value / total) * 100.0;
-    return last_result;
+template <typename T>
+T BasicCalculator<T>::percentage(T value, T total) {
+    return state.percentage(value, total);
 }
 
 // Memory functions
-void Calculator::memory_store(double value) {
-    memory_value = value;
-    clear_error();
+template <typename T>
+void BasicCalculator<T>::memory_store(T value) {
+    state.memory_store(value);
 }
 
-double Calculator::memory_recall() {
-    return memory_value;
+template <typename T>
+T BasicCalculator<T>::memory_recall() {
+    return state.memory_recall();
 }
 
-void Calculator::memory_clear() {
-    memory_value = 0.0;
+template <typename T>
+void BasicCalculator<T>::memory_clear() {
+    state.memory_clear();
 }
 
-void Calculator::memory_add(double value) {
-    memory_value += value;
+template <typename T>
+void BasicCalculator<T>::memory_add(T value) {
+    state.memory_add(value);
 }
 
-void Calculator::memory_subtract(double value) {
-    memory_value -= value;
+template <typename T>
+void BasicCalculator<T>::memory_subtract(T value) {
+    state.memory_subtract(value);
 }
 
 // Utility functions
-void Calculator::clear() {
-    current_value = 0.0;
-    stored_value = 0.0;
-    current_operation = '\0';
-    clear_error();
+template <typename T>
+void BasicCalculator<T>::clear() {
+    state.clear();
 }
 
-bool Calculator::is_error() const {
-    return has_error;
+template <typename T>
+bool BasicCalculator<T>::is_error() const {
+    return state.is_error();
 }
 
-std::string Calculator::get_last_error() const {
-    return error_message;
+template <typename T>
+const char* BasicCalculator<T>::get_last_error() const {
+    return state.get_last_error();
 }
 
-double Calculator::get_last_result() const {
-    return last_result;
+template <typename T>
+CalcError BasicCalculator<T>::get_error_code() const {
+    return state.get_error_code();
 }
 
-// Input processing
-void Calculator::process_input(char input) {
-    if (has_error) {
-        clear_error();
-    }
-    
-    switch (input) {
-        case '0': case '1': case '2': case '3': case '4':
-        case '5': case '6': case '7': case '8': case '9':
-            current_value = current_value * 10.0 + (input - '0');
-            break;
-            
-        case '.':
-            // Handle decimal point
-            break;
-            
-        case '+': case '-': case '*': case '/':
-            set_operation(input);
-            break;
-            
-        case '=':
-            calculate_result();
-            break;
-            
-        case 'C':
-            clear();
-            break;
-            
-        case 'M':
-            // Memory operations
-            break;
-            
-        default:
-            break;
-    }
+template <typename T>
+uint8_t BasicCalculator<T>::get_status_flags() const {
+    return state.get_status_flags();
 }
 
-void Calculator::set_operation(char op) {
-    if (current_operation != '\0') {
-        calculate_result();
-    }
-    
-    stored_value = current_value;
-    current_operation = op;
-    current_value = 0.0;
+template <typename T>
+void BasicCalculator<T>::clear_status_flags() {
+    state.clear_status_flags();
 }
 
-void Calculator::calculate_result() {
-    if (current_operation == '\0') {
-        return;
-    }
-    
-    switch (current_operation) {
-        case '+':
-            current_value = add(stored_value, current_value);
-            break;
-        case '-':
-            current_value = subtract(stored_value, current_value);
-            break;
-        case '*':
-            current_value = multiply(stored_value, current_value);
-            break;
-        case '/':
-            current_value = divide(stored_value, current_value);
-            break;
-        default:
-            break;
-    }
-    
-    current_operation = '\0';
-    stored_value = 0.0;
+template <typename T>
+T BasicCalculator<T>::get_last_result() const {
+    return state.get_last_result();
+}
+
+template <typename T>
+T BasicCalculator<T>::get_current_value() const {
+    return state.get_current_value();
 }
 
-// Private helper methods
-void Calculator::set_error(const std::string& error) {
-    has_error = true;
-    error_message = error;
+// Expression evaluation
+template <typename T>
+T BasicCalculator<T>::evaluate(const char* expression) {
+    return state.evaluate(expression);
 }
 
-void Calculator::clear_error() {
-    has_error = false;
-    error_message = "";
+template <typename T>
+T BasicCalculator<T>::evaluate(const BasicExpression<T>& expression, const T* variables) {
+    return state.evaluate(expression, variables);
 }
 
-bool Calculator::validate_operation(double a, double b, char op) {
-    // Basic validation - can be extended
-    if (std::isnan(a) || std::isnan(b) || std::isinf(a) || std::isinf(b)) {
-        set_error("Invalid number");
-        return false;
+// Input processing
+template <typename T>
+void BasicCalculator<T>::process_input(char input) {
+    TRACE_EVENT(TRACE_CALC_INPUT, (uint8_t)input);
+    if (input == '=') {
+        // Timed as the calculate_result() it runs
+        PROFILE_SCOPE(PROFILE_CALCULATE_RESULT);
+        state.process_input(input);
+    } else {
+        state.process_input(input);
     }
-    
-    clear_error();
-    return true;
+    TRACE_EVENT(TRACE_CALC_DONE, (uint8_t)input);
 }
+
+template <typename T>
+void BasicCalculator<T>::set_operation(char op) {
+    state.set_operation(op);
+}
+
+template <typename T>
+void BasicCalculator<T>::calculate_result() {
+    PROFILE_SCOPE(PROFILE_CALCULATE_RESULT);
+    state.calculate_result();
+}
+
+template <typename T>
+void BasicCalculator<T>::enter_value(T value) {
+    state.enter_value(value);
+}
+
+// Explicit instantiations
+template class BasicCalculator<float>;
+template class BasicCalculator<double>;
+template class BasicCalculator<long double>;
+template class BasicCalculator<Fixed>;
+#ifdef CALC_ENABLE_BIGNUM
+template class BasicCalculator<BigDecimal>;
+#endif
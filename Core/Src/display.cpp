@@ -9,67 +9,123 @@
 
 #include "display.h"
 #include <cstring>
-#include <sstream>
-#include <iomanip>
-
-// Constructor
-Display::Display(UART_HandleTypeDef* huart) 
-    : uart_handle(huart)
-    , lcd_available(false) {
-    
-    if (uart_handle != nullptr) {
-        // UART is available
-    }
-}
-
-// Destructor
-Display::~Display() {
-}
+#include "number_format.h"
+#include "profiler.h"
+#include "trace.h"
 
 // Display functions
 void Display::clear() {
     if (lcd_available) {
-        lcd_send_command(0x01);  // Clear display
-        lcd_send_command(0x02);  // Return home
+        // Blank the shadow; refresh() rewrites only cells that had text
+        for (uint8_t row = 0; row < DISPLAY_LCD_ROWS; row++) {
+            lcd_clear_row(row);
+        }
+        set_cursor(0, 0);
     } else {
         send_uart_data("\033[2J\033[H");  // Clear screen and home cursor
     }
 }
 
-void Display::print(const std::string& text) {
-    if (lcd_available) {
-        lcd_write_string(text);
-    } else {
-        send_uart_data(text);
-    }
+void Display::print(const char* text) {
+    write_text(text, active_sink());
 }
 
-void Display::print_line(const std::string& text) {
+void Display::print_line(const char* text) {
     print(text);
     if (lcd_available) {
-        lcd_send_command(0xC0);  // Move to second line
+        set_cursor(1, 0);  // Move to second line
     } else {
         send_uart_data("\r\n");
     }
 }
 
+void Display::print_uart(const char* text) {
+    send_uart_data(text);
+}
+
+void Display::write_uart(const uint8_t* data, size_t length) {
+    send_uart_data(data, length);
+}
+
+template <typename T>
+void Display::print_uart_result(const T& result) {
+    print_result_to(result, SINK_UART);
+}
+
+void Display::print_uart_error(const char* error) {
+    print_error_to(error, SINK_UART);
+}
+
+void Display::print_number(float number) {
+    print_number_to(number, active_sink());
+}
+
 void Display::print_number(double number) {
-    std::ostringstream oss;
-    oss << std::fixed << std::setprecision(6) << number;
-    
-    // Remove trailing zeros
-    std::string str = oss.str();
-    str.erase(str.find_last_not_of('0') + 1, std::string::npos);
-    if (str.back() == '.') str.pop_back();
-    
-    print(str);
+    print_number_to(number, active_sink());
 }
 
-void Display::print_error(const std::string& error) {
-    if (lcd_available) {
+void Display::print_number(long double number) {
+    print_number_to(number, active_sink());
+}
+
+void Display::print_number(Fixed number) {
+    print_number_to(number, active_sink());
+}
+
+#ifdef CALC_ENABLE_BIGNUM
+void Display::print_number(const BigDecimal& number) {
+    print_number_to(number, active_sink());
+}
+#endif
+
+// Shortest round-trip digits; on the LCD rounded to fit one row
+template <typename T>
+void Display::print_number_to(T number, Sink sink) {
+    PROFILE_SCOPE(PROFILE_PRINT_NUMBER);
+    char buffer[NUMBER_FORMAT_MAX];
+    if (sink == SINK_LCD) {
+        number_format_fit(number, buffer, NUMBER_FORMAT_LCD_WIDTH);
+    } else {
+        number_format_shortest(number, buffer, sizeof(buffer));
+    }
+    write_text(buffer, sink);
+}
+
+void Display::print_number_to(Fixed number, Sink sink) {
+    PROFILE_SCOPE(PROFILE_PRINT_NUMBER);
+    // Integer-only formatting, no soft-float on FPU-less targets; Q31.32
+    // resolves about 9 decimals, fewer are shown when the LCD row is full
+    char buffer[NUMBER_FORMAT_MAX];
+    size_t length = number.format(buffer, sizeof(buffer), 9);
+    if (sink == SINK_LCD && length > NUMBER_FORMAT_LCD_WIDTH) {
+        const char* point = strchr(buffer, '.');
+        size_t integer_length = point ? (size_t)(point - buffer) : length;
+        uint8_t decimals = 0;
+        if (integer_length + 1 < NUMBER_FORMAT_LCD_WIDTH) {
+            decimals = (uint8_t)(NUMBER_FORMAT_LCD_WIDTH - integer_length - 1);
+        }
+        number.format(buffer, sizeof(buffer), decimals);
+    }
+    write_text(buffer, sink);
+}
+
+#ifdef CALC_ENABLE_BIGNUM
+void Display::print_number_to(const BigDecimal& number, Sink sink) {
+    PROFILE_SCOPE(PROFILE_PRINT_NUMBER);
+    // Exact digits; division results are already rounded to BIGNUM_DIV_DIGITS
+    write_text(number.to_string().c_str(), sink);
+}
+#endif
+
+void Display::print_error(const char* error) {
+    print_error_to(error, active_sink());
+}
+
+void Display::print_error_to(const char* error, Sink sink) {
+    if (sink == SINK_LCD) {
         clear();
         lcd_write_string("ERROR:");
-        lcd_send_command(0xC0);
+        set_cursor(1, 0);
         lcd_write_string(error);
     } else {
         send_uart_data("ERROR: ");
@@ -78,20 +134,45 @@ void Display::print_error(const std::string& error) {
     }
 }
 
-void Display::print_result(double result) {
-    if (lcd_available) {
-        lcd_send_command(0xC0);  // Move to second line
+// "= " and the number on the LCD's second row, " = number" on the UART
+template <typename T>
+void Display::print_result_to(const T& result, Sink sink) {
+    if (sink == SINK_LCD) {
+        lcd_clear_row(1);
+        set_cursor(1, 0);  // Move to second line
         lcd_write_string("= ");
-        print_number(result);
+        print_number_to(result, sink);
     } else {
         send_uart_data(" = ");
-        print_number(result);
+        print_number_to(result, sink);
         send_uart_data("\r\n");
     }
 }
 
+void Display::print_result(float result) {
+    print_result_to(result, active_sink());
+}
+
+void Display::print_result(double result) {
+    print_result_to(result, active_sink());
+}
+
+void Display::print_result(long double result) {
+    print_result_to(result, active_sink());
+}
+
+void Display::print_result(Fixed result) {
+    print_result_to(result, active_sink());
+}
+
+#ifdef CALC_ENABLE_BIGNUM
+void Display::print_result(const BigDecimal& result) {
+    print_result_to(result, active_sink());
+}
+#endif
+
 void Display::print_operation(char operation) {
-    std::string op_str;
+    const char* op_str;
     switch (operation) {
         case '+': op_str = " + "; break;
         case '-': op_str = " - "; break;
@@ -106,9 +187,9 @@ void Display::print_operation(char operation) {
 // Cursor control
 void Display::set_cursor(uint8_t row, uint8_t col) {
     if (lcd_available) {
-        uint8_t address = (row == 0) ? 0x80 : 0xC0;
-        address += col;
-        lcd_send_command(address);
+        // Only moves the shadow cursor; refresh() addresses the controller
+        cursor_row = (row < DISPLAY_LCD_ROWS) ? row : DISPLAY_LCD_ROWS - 1;
+        cursor_col = (col < DISPLAY_LCD_COLS) ? col : DISPLAY_LCD_COLS;
     } else {
         // For UART, we can't control cursor position easily
         // Just print newlines to simulate
@@ -120,7 +201,7 @@ void Display::set_cursor(uint8_t row, uint8_t col) {
 
 void Display::home() {
     if (lcd_available) {
-        lcd_send_command(0x02);
+        set_cursor(0, 0);
     } else {
         send_uart_data("\033[H");
     }
@@ -154,7 +235,7 @@ void Display::print_clear() {
 // Status display
 void Display::show_calculator_mode() {
     if (lcd_available) {
-        lcd_send_command(0x80);
+        set_cursor(0, 0);
         lcd_write_string("CALCULATOR");
     } else {
         send_uart_data("=== STM32 CALCULATOR ===\r\n");
@@ -163,7 +244,7 @@ void Display::show_calculator_mode() {
 
 void Display::show_memory_status(bool has_memory) {
     if (lcd_available) {
-        lcd_send_command(0x8F);  // Top right corner
+        set_cursor(0, 15);  // Top right corner
         lcd_write_string(has_memory ? "M" : " ");
     } else {
         send_uart_data(has_memory ? "[M] " : "    ");
@@ -172,69 +253,172 @@ void Display::show_memory_status(bool has_memory) {
 
 void Display::show_error_status(bool has_error) {
     if (lcd_available) {
-        lcd_send_command(0x8E);  // Top right corner - 1
+        set_cursor(0, 14);  // Top right corner - 1
         lcd_write_string(has_error ? "E" : " ");
     } else {
         send_uart_data(has_error ? "[E] " : "    ");
     }
 }
 
+// LCD shadow framebuffer
+void Display::refresh() {
+    PROFILE_SCOPE(PROFILE_LCD_REFRESH);
+    if (!lcd_available) {
+        return;
+    }
+    
+    uint32_t commands = 0;
+    uint32_t data_bytes = 0;
+    for (uint8_t row = 0; row < DISPLAY_LCD_ROWS; row++) {
+        for (uint8_t col = 0; col < DISPLAY_LCD_COLS; col++) {
+            char cell = lcd_frame[row][col];
+            if (cell == lcd_shown[row][col]) {
+                continue;
+            }
+            // The address counter follows each write, so a run of changed
+            // cells needs one set-address command
+            uint8_t address = lcd_row_address(row) + col;
+            if (address != lcd_address) {
+                lcd_send_command(0x80 | address);
+                commands++;
+            }
+            lcd_send_data((uint8_t)cell);
+            data_bytes++;
+            lcd_shown[row][col] = cell;
+            lcd_address = address + 1;
+        }
+    }
+    
+    if (data_bytes != 0) {
+        TRACE_EVENT(TRACE_LCD_REFRESH, data_bytes);
+    }
+    lcd_stats.refreshes++;
+    lcd_stats.last_commands = commands;
+    lcd_stats.last_data_bytes = data_bytes;
+    lcd_stats.commands += commands;
+    lcd_stats.data_bytes += data_bytes;
+}
+
+const char* Display::get_lcd_row(uint8_t row) const {
+    return lcd_frame[row < DISPLAY_LCD_ROWS ? row : DISPLAY_LCD_ROWS - 1];
+}
+
+LcdRefreshStats Display::get_lcd_stats() const {
+    return lcd_stats;
+}
+
+bool Display::init_lcd() {
+    lcd_init();
+    return lcd_available;
+}
+
+// UART queue
+void Display::poll() {
+    refresh();
+    tx_queue.poll();
+}
+
+bool Display::flush(uint32_t timeout_ms) {
+    return tx_queue.flush(timeout_ms);
+}
+
+void Display::stop() {
+    tx_queue.stop();
+}
+
+size_t Display::tx_free_space() const {
+    return tx_queue.free_space();
+}
+
+bool Display::is_tx_idle() const {
+    return tx_queue.pending() == 0 && !tx_queue.is_busy();
+}
+
+UartTxStats Display::get_tx_stats() const {
+    return tx_queue.get_stats();
+}
+
 // Private helper methods
-void Display::send_uart_data(const std::string& data) {
-    if (uart_handle != nullptr) {
-        HAL_UART_Transmit(uart_handle, (uint8_t*)data.c_str(), data.length(), 1000);
+Display::Sink Display::active_sink() const {
+    return lcd_available ? SINK_LCD : SINK_UART;
+}
+
+void Display::write_text(const char* text, Sink sink) {
+    if (sink == SINK_LCD) {
+        lcd_write_string(text);
+    } else {
+        send_uart_data(text);
     }
 }
 
 void Display::send_uart_data(const char* data) {
-    if (uart_handle != nullptr) {
-        HAL_UART_Transmit(uart_handle, (uint8_t*)data, strlen(data), 1000);
-    }
+    send_uart_data((const uint8_t*)data, strlen(data));
 }
 
-void Display::send_uart_byte(uint8_t byte) {
+void Display::send_uart_data(const uint8_t* data, size_t length) {
+    // Returns once queued; only blocks while the queue is full
+    TRACE_EVENT(TRACE_UART_SEND, length);
     if (uart_handle != nullptr) {
-        HAL_UART_Transmit(uart_handle, &byte, 1, 1000);
+        tx_queue.write_wait(data, length, DISPLAY_TX_TIMEOUT_MS);
     }
 }
 
-void Display::delay_ms(uint32_t ms) {
-    HAL_Delay(ms);
+void Display::send_uart_byte(uint8_t byte) {
+    send_uart_data(&byte, 1);
 }
 
 // LCD specific methods (if available)
 void Display::lcd_init() {
-    // Initialize LCD in 4-bit mode
-    delay_ms(50);
-    
-    lcd_send_command(0x33);
-    delay_ms(5);
-    lcd_send_command(0x32);
-    delay_ms(5);
-    lcd_send_command(0x28);  // 4-bit mode, 2 lines, 5x8 font
-    delay_ms(5);
-    lcd_send_command(0x0C);  // Display on, cursor off, blink off
-    delay_ms(5);
-    lcd_send_command(0x06);  // Increment cursor, no display shift
-    delay_ms(5);
-    lcd_send_command(0x01);  // Clear display
-    delay_ms(5);
+    // Without a responding controller output stays on UART
+    lcd_available = false;
+    if (lcd == nullptr || !lcd->init()) {
+        return;
+    }
     
+    // The controller is blank now; the shadow keeps whatever was drawn.
+    // Cells never drawn are still NUL from construction
+    memset(lcd_shown, ' ', sizeof(lcd_shown));
+    for (uint8_t row = 0; row < DISPLAY_LCD_ROWS; row++) {
+        for (uint8_t col = 0; col < DISPLAY_LCD_COLS; col++) {
+            if (lcd_frame[row][col] == '\0') {
+                lcd_frame[row][col] = ' ';
+            }
+        }
+        lcd_frame[row][DISPLAY_LCD_COLS] = '\0';
+    }
+    lcd_address = 0;
     lcd_available = true;
 }
 
 void Display::lcd_send_command(uint8_t command) {
-    // This would need to be implemented based on your LCD hardware
-    // For now, just a placeholder
+    lcd->command(command);
 }
 
 void Display::lcd_send_data(uint8_t data) {
-    // This would need to be implemented based on your LCD hardware
-    // For now, just a placeholder
+    lcd->write_data(data);
 }
 
-void Display::lcd_write_string(const std::string& text) {
-    for (char c : text) {
-        lcd_send_data(c);
+void Display::lcd_write_string(const char* text) {
+    // Into the shadow at the cursor; text past the row end is cut off
+    for (; *text != '\0' && cursor_col < DISPLAY_LCD_COLS; text++) {
+        lcd_frame[cursor_row][cursor_col++] = *text;
     }
 }
+
+void Display::lcd_clear_row(uint8_t row) {
+    memset(lcd_frame[row], ' ', DISPLAY_LCD_COLS);
+}
+
+uint8_t Display::lcd_row_address(uint8_t row) {
+    // DDRAM address of column 0: rows 0/1 start at 0x00/0x40
+    return (row == 0) ? 0x00 : 0x40;
+}
+
+// Explicit instantiations for the calculator number types
+template void Display::print_uart_result<float>(const float&);
+template void Display::print_uart_result<double>(const double&);
+template void Display::print_uart_result<long double>(const long double&);
+template void Display::print_uart_result<Fixed>(const Fixed&);
+#ifdef CALC_ENABLE_BIGNUM
+template void Display::print_uart_result<BigDecimal>(const BigDecimal&);
+#endif
@@ -0,0 +1,393 @@
+/**
+  ******************************************************************************
+  * @file           : expression.cpp
+  * @brief          : Expression compiler implementation
+  * @author         : STM32 Calculator Project
+  * @date           : 2024
+  ******************************************************************************
+  */
+
+#include "expression.h"
+#include <cstring>
+
+// Internal marker for unary minus on the operator stack
+static const char OP_UNARY_MINUS = '~';
+
+// Constructor
+template <typename T>
+BasicExpression<T>::BasicExpression()
+    : code_length(0)
+    , constant_count(0)
+    , stack_depth(0)
+    , compiled(false) {
+}
+
+// Compilation
+template <typename T>
+ExpressionBase::Status BasicExpression<T>::compile(const char* text) {
+    if (text == nullptr) {
+        reset();
+        return EXPR_EMPTY;
+    }
+    return compile(text, strlen(text));
+}
+
+template <typename T>
+ExpressionBase::Status BasicExpression<T>::compile(const char* text, size_t length) {
+    reset();
+
+    char op_stack[EXPR_MAX_DEPTH];
+    uint8_t op_count = 0;
+    uint8_t depth = 0;
+    bool expect_operand = true;
+    bool any_token = false;
+
+    size_t i = 0;
+    while (i < length) {
+        char c = text[i];
+
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+            i++;
+            continue;
+        }
+        any_token = true;
+
+        if ((c >= '0' && c <= '9') || c == '.') {
+            if (!expect_operand) {
+                return EXPR_SYNTAX_ERROR;
+            }
+            uint64_t mantissa = 0;
+            int32_t exponent = 0;
+            size_t consumed = parse_number(text + i, length - i, mantissa, exponent);
+            if (consumed == 0) {
+                return EXPR_SYNTAX_ERROR;
+            }
+            if (constant_count >= EXPR_MAX_CONSTANTS) {
+                return EXPR_TOO_LONG;
+            }
+            constants[constant_count] = Num::from_scientific(mantissa, exponent);
+            if (!emit(OP_CONST, constant_count, 1, depth)) {
+                return code_length >= EXPR_MAX_INSTRUCTIONS ? EXPR_TOO_LONG : EXPR_TOO_DEEP;
+            }
+            constant_count++;
+            expect_operand = false;
+            i += consumed;
+            continue;
+        }
+
+        if (c >= 'a' && c <= 'z') {
+            if (!expect_operand) {
+                return EXPR_SYNTAX_ERROR;
+            }
+            if (!emit(OP_VAR, (uint8_t)(c - 'a'), 1, depth)) {
+                return code_length >= EXPR_MAX_INSTRUCTIONS ? EXPR_TOO_LONG : EXPR_TOO_DEEP;
+            }
+            expect_operand = false;
+            i++;
+            continue;
+        }
+
+        if (c == '(') {
+            if (!expect_operand) {
+                return EXPR_SYNTAX_ERROR;
+            }
+            if (op_count >= EXPR_MAX_DEPTH) {
+                return EXPR_TOO_DEEP;
+            }
+            op_stack[op_count++] = c;
+            i++;
+            continue;
+        }
+
+        if (c == ')') {
+            if (expect_operand) {
+                return EXPR_SYNTAX_ERROR;
+            }
+            while (op_count > 0 && op_stack[op_count - 1] != '(') {
+                if (!emit_operator(op_stack[--op_count], depth)) {
+                    return EXPR_TOO_LONG;
+                }
+            }
+            if (op_count == 0) {
+                return EXPR_SYNTAX_ERROR;
+            }
+            op_count--;  // Discard '('
+            i++;
+            continue;
+        }
+
+        if (is_binary_operator(c)) {
+            if (expect_operand) {
+                // Prefix sign: '-' negates, '+' is a no-op
+                if (c == '-') {
+                    if (op_count >= EXPR_MAX_DEPTH) {
+                        return EXPR_TOO_DEEP;
+                    }
+                    op_stack[op_count++] = OP_UNARY_MINUS;
+                } else if (c != '+') {
+                    return EXPR_SYNTAX_ERROR;
+                }
+                i++;
+                continue;
+            }
+
+            uint8_t prec = precedence(c);
+            while (op_count > 0 && op_stack[op_count - 1] != '(') {
+                uint8_t top = precedence(op_stack[op_count - 1]);
+                if (top > prec || (top == prec && !is_right_associative(c))) {
+                    if (!emit_operator(op_stack[--op_count], depth)) {
+                        return EXPR_TOO_LONG;
+                    }
+                } else {
+                    break;
+                }
+            }
+            if (op_count >= EXPR_MAX_DEPTH) {
+                return EXPR_TOO_DEEP;
+            }
+            op_stack[op_count++] = c;
+            expect_operand = true;
+            i++;
+            continue;
+        }
+
+        return EXPR_SYNTAX_ERROR;
+    }
+
+    if (!any_token) {
+        return EXPR_EMPTY;
+    }
+    if (expect_operand) {
+        return EXPR_SYNTAX_ERROR;
+    }
+
+    while (op_count > 0) {
+        char op = op_stack[--op_count];
+        if (op == '(') {
+            return EXPR_SYNTAX_ERROR;
+        }
+        if (!emit_operator(op, depth)) {
+            return EXPR_TOO_LONG;
+        }
+    }
+
+    compiled = true;
+    return EXPR_OK;
+}
+
+template <typename T>
+void BasicExpression<T>::reset() {
+    code_length = 0;
+    constant_count = 0;
+    stack_depth = 0;
+    compiled = false;
+}
+
+// Evaluation
+template <typename T>
+ExpressionBase::Status BasicExpression<T>::evaluate(T& result) const {
+    return evaluate(nullptr, result);
+}
+
+template <typename T>
+ExpressionBase::Status BasicExpression<T>::evaluate(const T* variables, T& result) const {
+    if (!compiled) {
+        return EXPR_EMPTY;
+    }
+
+    // Depth was bounded at compile time, so no per-instruction checks here
+    T stack[EXPR_MAX_DEPTH];
+    uint8_t sp = 0;
+
+    for (uint16_t pc = 0; pc < code_length; pc++) {
+        const Instruction& ins = code[pc];
+        switch (ins.opcode) {
+            case OP_CONST:
+                stack[sp++] = constants[ins.operand];
+                break;
+            case OP_VAR:
+                stack[sp++] = (variables != nullptr) ? variables[ins.operand] : Num::zero();
+                break;
+            case OP_ADD:
+                sp--;
+                stack[sp - 1] = Num::add(stack[sp - 1], stack[sp]);
+                break;
+            case OP_SUB:
+                sp--;
+                stack[sp - 1] = Num::sub(stack[sp - 1], stack[sp]);
+                break;
+            case OP_MUL:
+                sp--;
+                stack[sp - 1] = Num::mul(stack[sp - 1], stack[sp]);
+                break;
+            case OP_DIV:
+                sp--;
+                if (Num::is_zero(stack[sp])) {
+                    return EXPR_DIVISION_BY_ZERO;
+                }
+                stack[sp - 1] = Num::div(stack[sp - 1], stack[sp]);
+                break;
+            case OP_POW:
+                sp--;
+                if (!Num::pow(stack[sp - 1], stack[sp], stack[sp - 1])) {
+                    return EXPR_INVALID_NUMBER;
+                }
+                break;
+            case OP_NEG:
+                stack[sp - 1] = Num::sub(Num::zero(), stack[sp - 1]);
+                break;
+            default:
+                return EXPR_SYNTAX_ERROR;
+        }
+    }
+
+    // NaN/Inf anywhere in the chain propagates to the result; Fixed
+    // saturates instead and is left to the caller's overflow flag
+    if (!Num::is_valid(stack[0])) {
+        return EXPR_INVALID_NUMBER;
+    }
+
+    result = stack[0];
+    return EXPR_OK;
+}
+
+// Program inspection
+template <typename T>
+bool BasicExpression<T>::is_compiled() const {
+    return compiled;
+}
+
+template <typename T>
+uint16_t BasicExpression<T>::size() const {
+    return code_length;
+}
+
+template <typename T>
+uint8_t BasicExpression<T>::max_depth() const {
+    return stack_depth;
+}
+
+// Operator helpers
+uint8_t ExpressionBase::precedence(char op) {
+    switch (op) {
+        case '+': case '-':
+            return 1;
+        case '*': case '/':
+            return 2;
+        case OP_UNARY_MINUS:
+            return 3;
+        case '^':
+            return 4;
+        default:
+            return 0;
+    }
+}
+
+bool ExpressionBase::is_right_associative(char op) {
+    return op == '^' || op == OP_UNARY_MINUS;
+}
+
+bool ExpressionBase::is_binary_operator(char op) {
+    return op == '+' || op == '-' || op == '*' || op == '/' || op == '^';
+}
+
+// Private helper methods
+template <typename T>
+bool BasicExpression<T>::emit(uint8_t opcode, uint8_t operand, int8_t depth_change, uint8_t& depth) {
+    if (code_length >= EXPR_MAX_INSTRUCTIONS) {
+        return false;
+    }
+    if (depth_change > 0 && depth >= EXPR_MAX_DEPTH) {
+        return false;
+    }
+
+    code[code_length].opcode = opcode;
+    code[code_length].operand = operand;
+    code_length++;
+
+    depth = (uint8_t)(depth + depth_change);
+    if (depth > stack_depth) {
+        stack_depth = depth;
+    }
+    return true;
+}
+
+template <typename T>
+bool BasicExpression<T>::emit_operator(char op, uint8_t& depth) {
+    switch (op) {
+        case '+': return emit(OP_ADD, 0, -1, depth);
+        case '-': return emit(OP_SUB, 0, -1, depth);
+        case '*': return emit(OP_MUL, 0, -1, depth);
+        case '/': return emit(OP_DIV, 0, -1, depth);
+        case '^': return emit(OP_POW, 0, -1, depth);
+        case OP_UNARY_MINUS: return emit(OP_NEG, 0, 0, depth);
+        default: return false;
+    }
+}
+
+size_t ExpressionBase::parse_number(const char* text, size_t length, uint64_t& mantissa, int32_t& exponent) {
+    // Hand-rolled instead of strtod, which allocates on newlib
+    mantissa = 0;
+    exponent = 0;
+    uint8_t significant = 0;
+    bool any_digit = false;
+    bool seen_point = false;
+    size_t i = 0;
+
+    for (; i < length; i++) {
+        char c = text[i];
+        if (c >= '0' && c <= '9') {
+            any_digit = true;
+            if (significant < 19) {
+                mantissa = mantissa * 10 + (uint64_t)(c - '0');
+                if (mantissa != 0) {
+                    significant++;
+                }
+                if (seen_point) {
+                    exponent--;
+                }
+            } else if (!seen_point) {
+                exponent++;  // Digits beyond uint64 precision only scale
+            }
+        } else if (c == '.' && !seen_point) {
+            seen_point = true;
+        } else {
+            break;
+        }
+    }
+
+    if (!any_digit) {
+        return 0;
+    }
+
+    // Optional exponent, only if a digit actually follows
+    if (i < length && (text[i] == 'e' || text[i] == 'E')) {
+        size_t j = i + 1;
+        bool negative = false;
+        if (j < length && (text[j] == '+' || text[j] == '-')) {
+            negative = (text[j] == '-');
+            j++;
+        }
+        if (j < length && text[j] >= '0' && text[j] <= '9') {
+            int32_t e = 0;
+            for (; j < length && text[j] >= '0' && text[j] <= '9'; j++) {
+                if (e < 10000) {
+                    e = e * 10 + (text[j] - '0');
+                }
+            }
+            exponent += negative ? -e : e;
+            i = j;
+        }
+    }
+
+    return i;
+}
+
+// Explicit instantiations
+template class BasicExpression<float>;
+template class BasicExpression<double>;
+template class BasicExpression<long double>;
+template class BasicExpression<Fixed>;
+#ifdef CALC_ENABLE_BIGNUM
+template class BasicExpression<BigDecimal>;
+#endif
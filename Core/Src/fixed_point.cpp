@@ -0,0 +1,474 @@
+/**
+  ******************************************************************************
+  * @file           : fixed_point.cpp
+  * @brief          : Saturating Q-format fixed-point implementation
+  * @author         : STM32 Calculator Project
+  * @date           : 2024
+  ******************************************************************************
+  */
+
+#include "fixed_point.h"
+#include <cmath>
+
+static const int F = Fixed::FRAC_BITS;
+
+// 2^(2^-i) for i = 1..62 in Q2.62, used by exp2 bit decomposition
+static const uint64_t exp2_table[62] = {
+    0x5A827999FCEF3242ULL, 0x4C1BF828C6DC54B8ULL, 0x45CAE0F1F545EB73ULL,
+    0x42D561B3E6243D8AULL, 0x4166C34C5615D0ECULL, 0x40B268F9DE0183BAULL,
+    0x4058F6A7ECCCD5B6ULL, 0x402C6BE96AF2FB58ULL, 0x4016321B687027A8ULL,
+    0x400B18178BA33B14ULL, 0x40058BCE410147E8ULL, 0x4002C5D7BFF71DAFULL,
+    0x400162E807EE7E5BULL, 0x4000B1730DF6A524ULL, 0x400058B9497B8152ULL,
+    0x40002C5C955DD701ULL, 0x4000162E46D6F26CULL, 0x40000B1722757B1BULL,
+    0x4000058B90FD3E0CULL, 0x400002C5C86F3F26ULL, 0x40000162E433C79BULL,
+    0x400000B17218EDD0ULL, 0x40000058B90C3968ULL, 0x4000002C5C860D54ULL,
+    0x400000162E4302D2ULL, 0x4000000B17218073ULL, 0x400000058B90BFFCULL,
+    0x40000002C5C85FEFULL, 0x4000000162E42FF3ULL, 0x40000000B17217F9ULL,
+    0x4000000058B90BFCULL, 0x400000002C5C85FEULL, 0x40000000162E42FFULL,
+    0x400000000B17217FULL, 0x40000000058B90C0ULL, 0x4000000002C5C860ULL,
+    0x400000000162E430ULL, 0x4000000000B17218ULL, 0x400000000058B90CULL,
+    0x40000000002C5C86ULL, 0x4000000000162E43ULL, 0x40000000000B1721ULL,
+    0x4000000000058B91ULL, 0x400000000002C5C8ULL, 0x40000000000162E4ULL,
+    0x400000000000B172ULL, 0x40000000000058B9ULL, 0x4000000000002C5DULL,
+    0x400000000000162EULL, 0x4000000000000B17ULL, 0x400000000000058CULL,
+    0x40000000000002C6ULL, 0x4000000000000163ULL, 0x40000000000000B1ULL,
+    0x4000000000000059ULL, 0x400000000000002CULL, 0x4000000000000016ULL,
+    0x400000000000000BULL, 0x4000000000000006ULL, 0x4000000000000003ULL,
+    0x4000000000000001ULL, 0x4000000000000001ULL
+};
+
+static const uint64_t pow10_u64[20] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+    10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+    100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+    100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+    100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL
+};
+
+// 128-bit unsigned helpers built from 32-bit halves (no __int128 on ARM)
+struct U128 {
+    uint64_t hi;
+    uint64_t lo;
+};
+
+static inline U128 mul_u64(uint64_t a, uint64_t b) {
+    uint64_t a_lo = (uint32_t)a, a_hi = a >> 32;
+    uint64_t b_lo = (uint32_t)b, b_hi = b >> 32;
+
+    uint64_t p0 = a_lo * b_lo;
+    uint64_t p1 = a_lo * b_hi;
+    uint64_t p2 = a_hi * b_lo;
+    uint64_t p3 = a_hi * b_hi;
+
+    uint64_t mid = (p0 >> 32) + (uint32_t)p1 + (uint32_t)p2;
+    U128 r;
+    r.lo = (mid << 32) | (uint32_t)p0;
+    r.hi = p3 + (p1 >> 32) + (p2 >> 32) + (mid >> 32);
+    return r;
+}
+
+static inline U128 add_u128(U128 a, uint64_t b) {
+    U128 r;
+    r.lo = a.lo + b;
+    r.hi = a.hi + (r.lo < a.lo ? 1 : 0);
+    return r;
+}
+
+static inline U128 add_u128(U128 a, U128 b) {
+    U128 r;
+    r.lo = a.lo + b.lo;
+    r.hi = a.hi + b.hi + (r.lo < a.lo ? 1 : 0);
+    return r;
+}
+
+static inline U128 sub_u128(U128 a, U128 b) {
+    U128 r;
+    r.lo = a.lo - b.lo;
+    r.hi = a.hi - b.hi - (a.lo < b.lo ? 1 : 0);
+    return r;
+}
+
+static inline bool less_u128(U128 a, U128 b) {
+    return a.hi < b.hi || (a.hi == b.hi && a.lo < b.lo);
+}
+
+// Full 128-bit right shift for 0 < shift < 64
+static inline U128 shr2_u128(U128 a, int shift) {
+    U128 r;
+    r.lo = (a.lo >> shift) | (a.hi << (64 - shift));
+    r.hi = a.hi >> shift;
+    return r;
+}
+
+// Shifts right by 0 < shift < 64, returning the low 64 bits and whether
+// any bits above them remain
+static inline uint64_t shr_u128(U128 a, int shift, bool& overflow) {
+    overflow = (a.hi >> shift) != 0;
+    return (a.lo >> shift) | (a.hi << (64 - shift));
+}
+
+// 128 / 64 -> 64 division; fails if the quotient needs > 64 bits
+static bool div_u128(U128 n, uint64_t d, uint64_t& quotient) {
+    if (d == 0 || n.hi >= d) {
+        return false;
+    }
+    if (n.hi == 0) {
+        quotient = n.lo / d;
+        return true;
+    }
+#if defined(__SIZEOF_INT128__)
+    quotient = (uint64_t)((((unsigned __int128)n.hi << 64) | n.lo) / d);
+    return true;
+#else
+    if (d <= 0xFFFFFFFFULL) {
+        // Schoolbook division by 32-bit limbs (hardware UDIV-sized steps)
+        uint64_t rem = n.hi % d;
+        uint64_t cur = (rem << 32) | (n.lo >> 32);
+        uint64_t q_hi = cur / d;
+        rem = cur % d;
+        cur = (rem << 32) | (uint32_t)n.lo;
+        quotient = (q_hi << 32) | (cur / d);
+        return true;
+    }
+
+    // Restoring shift-subtract for wide divisors
+    uint64_t rem = n.hi;
+    uint64_t lo = n.lo;
+    for (int i = 0; i < 64; i++) {
+        uint64_t carry = rem >> 63;
+        rem = (rem << 1) | (lo >> 63);
+        lo <<= 1;
+        if (carry || rem >= d) {
+            rem -= d;
+            lo |= 1;
+        }
+    }
+    quotient = lo;
+    return true;
+#endif
+}
+
+static inline uint64_t magnitude(int64_t v) {
+    return v < 0 ? (uint64_t)0 - (uint64_t)v : (uint64_t)v;
+}
+
+// Applies the sign to a magnitude, saturating outside int64 range
+static inline int64_t signed_saturate(uint64_t mag, bool negative, bool overflow) {
+    if (negative) {
+        if (overflow || mag > (uint64_t)INT64_MAX + 1) {
+            return INT64_MIN;
+        }
+        return (int64_t)((uint64_t)0 - mag);
+    }
+    if (overflow || mag > (uint64_t)INT64_MAX) {
+        return INT64_MAX;
+    }
+    return (int64_t)mag;
+}
+
+// Construction
+Fixed Fixed::from_decimal(int64_t mantissa, uint8_t decimals) {
+    bool negative = mantissa < 0;
+    uint64_t mag = magnitude(mantissa);
+    if (decimals > 19) {
+        decimals = 19;
+    }
+
+    // (mantissa << F) / 10^decimals, rounded to nearest
+    U128 n;
+    n.hi = mag >> (64 - F);
+    n.lo = mag << F;
+    uint64_t divisor = pow10_u64[decimals];
+    n = add_u128(n, divisor / 2);
+
+    uint64_t q = 0;
+    bool overflow = !div_u128(n, divisor, q);
+    return from_raw(signed_saturate(q, negative, overflow));
+}
+
+Fixed Fixed::from_scientific(uint64_t mantissa, int32_t exponent) {
+    if (mantissa == 0) {
+        return Fixed();
+    }
+
+    // Fold a positive exponent into the mantissa while it stays exact
+    while (exponent > 0 && mantissa <= UINT64_MAX / 10) {
+        mantissa *= 10;
+        exponent--;
+    }
+    if (exponent > 0) {
+        return from_raw(RAW_MAX);
+    }
+
+    // Drop digits below the last fraction bit so from_decimal() can take it
+    while ((exponent < 0 && mantissa > (uint64_t)INT64_MAX) || exponent < -19) {
+        mantissa /= 10;
+        exponent++;
+    }
+    if (mantissa > (uint64_t)INT64_MAX) {
+        return from_raw(RAW_MAX);
+    }
+    return from_decimal((int64_t)mantissa, (uint8_t)-exponent);
+}
+
+Fixed Fixed::from_double(double value) {
+    if (std::isnan(value)) {
+        return Fixed();
+    }
+    double scaled = ldexp(value, F);
+    if (scaled >= 9.2233720368547758e18) {
+        return from_raw(RAW_MAX);
+    }
+    if (scaled <= -9.2233720368547758e18) {
+        return from_raw(RAW_MIN);
+    }
+    return from_raw(llround(scaled));
+}
+
+// Conversion
+double Fixed::to_double() const {
+    return ldexp((double)raw, -F);
+}
+
+// Saturating arithmetic
+Fixed Fixed::mul(Fixed a, Fixed b) {
+    bool negative = (a.raw < 0) != (b.raw < 0);
+    U128 p = mul_u64(magnitude(a.raw), magnitude(b.raw));
+    p = add_u128(p, (uint64_t)1 << (F - 1));
+
+    bool overflow = false;
+    uint64_t mag = shr_u128(p, F, overflow);
+    return from_raw(signed_saturate(mag, negative, overflow));
+}
+
+bool Fixed::div(Fixed a, Fixed b, Fixed& out) {
+    if (b.raw == 0) {
+        return false;
+    }
+    bool negative = (a.raw < 0) != (b.raw < 0);
+    uint64_t num = magnitude(a.raw);
+    uint64_t den = magnitude(b.raw);
+
+    // (|a| << F) / |b|, rounded to nearest
+    U128 n;
+    n.hi = num >> (64 - F);
+    n.lo = num << F;
+    n = add_u128(n, den / 2);
+
+    uint64_t q = 0;
+    bool overflow = !div_u128(n, den, q);
+    out = from_raw(signed_saturate(q, negative, overflow));
+    return true;
+}
+
+bool Fixed::sqrt(Fixed value, Fixed& out) {
+    if (value.raw < 0) {
+        return false;
+    }
+
+    // sqrt(raw * 2^F) is the raw result; classic digit-by-digit over 128 bits
+    uint64_t v = (uint64_t)value.raw;
+    U128 op;
+    op.hi = v >> (64 - F);
+    op.lo = v << F;
+    U128 res = {0, 0};
+    if ((op.hi | op.lo) == 0) {
+        out = Fixed();
+        return true;
+    }
+
+    // Start from the highest power of four not above the operand
+    int msb = op.hi ? 127 - __builtin_clzll(op.hi) : 63 - __builtin_clzll(op.lo);
+    int start = msb & ~1;
+    U128 one;
+    one.hi = (start >= 64) ? (uint64_t)1 << (start - 64) : 0;
+    one.lo = (start >= 64) ? 0 : (uint64_t)1 << start;
+
+    while ((one.hi | one.lo) != 0) {
+        U128 trial = add_u128(res, one);
+        if (!less_u128(op, trial)) {
+            op = sub_u128(op, trial);
+            res = add_u128(shr2_u128(res, 1), one);
+        } else {
+            res = shr2_u128(res, 1);
+        }
+        one = shr2_u128(one, 2);
+    }
+
+    out = from_raw(signed_saturate(res.lo, false, res.hi != 0));
+    return true;
+}
+
+bool Fixed::log2(Fixed value, Fixed& out) {
+    if (value.raw <= 0) {
+        return false;
+    }
+
+    uint64_t v = (uint64_t)value.raw;
+    int msb = 63 - __builtin_clzll(v);
+    int64_t integer = msb - F;
+
+    // Normalise to y in [1, 2) as Q.F, then square repeatedly for fraction bits
+    uint64_t y = (msb >= F) ? (v >> (msb - F)) : (v << (F - msb));
+    uint64_t fraction = 0;
+    for (int i = F - 1; i >= 0; i--) {
+        bool unused = false;
+        y = shr_u128(mul_u64(y, y), F, unused);
+        if (y >= ((uint64_t)2 << F)) {
+            y >>= 1;
+            fraction |= (uint64_t)1 << i;
+        }
+    }
+
+    out = from_raw(integer * RAW_ONE + (int64_t)fraction);
+    return true;
+}
+
+Fixed Fixed::exp2(Fixed value) {
+    int64_t n = value.raw >> F;  // floor
+    uint64_t f = (uint64_t)value.raw & (uint64_t)(RAW_ONE - 1);
+
+    if (n >= 63 - F) {
+        return from_raw(RAW_MAX);
+    }
+    if (n < -F - 1) {
+        return Fixed();
+    }
+
+    // 2^f = product of 2^(2^-i) over the set fraction bits, in Q2.62
+    uint64_t acc = (uint64_t)1 << 62;
+    for (int i = 1; i <= F; i++) {
+        if (f & ((uint64_t)1 << (F - i))) {
+            bool unused = false;
+            acc = shr_u128(mul_u64(acc, exp2_table[i - 1]), 62, unused);
+        }
+    }
+
+    // Rescale Q2.62 -> Q.F and apply 2^n
+    int shift = (int)n - (62 - F);
+    if (shift >= 0) {
+        if (acc > ((uint64_t)INT64_MAX >> shift)) {
+            return from_raw(RAW_MAX);
+        }
+        return from_raw((int64_t)(acc << shift));
+    }
+    shift = -shift;
+    if (shift >= 64) {
+        return Fixed();
+    }
+    uint64_t rounded = (acc >> shift) + ((acc >> (shift - 1)) & 1);
+    return from_raw((int64_t)rounded);
+}
+
+bool Fixed::pow(Fixed base, Fixed exponent, Fixed& out) {
+    if (exponent.is_integer()) {
+        // Exponentiation by squaring with saturating multiplies
+        int64_t e = exponent.integer_part();
+        uint64_t n = magnitude(e);
+        Fixed result = from_int(1);
+        Fixed b = base;
+        while (n != 0) {
+            if (n & 1) {
+                result = mul(result, b);
+            }
+            n >>= 1;
+            if (n != 0) {
+                b = mul(b, b);
+            }
+            if (result.is_saturated() || result.is_zero()) {
+                break;
+            }
+        }
+        if (e < 0) {
+            return div(from_int(1), result, out);
+        }
+        out = result;
+        return true;
+    }
+
+    // Fractional exponent: b^e = 2^(e * log2 b), defined for b > 0 only
+    if (base.raw < 0) {
+        return false;
+    }
+    if (base.raw == 0) {
+        if (exponent.raw <= 0) {
+            return false;
+        }
+        out = Fixed();
+        return true;
+    }
+
+    Fixed lg;
+    log2(base, lg);
+    out = exp2(mul(exponent, lg));
+    return true;
+}
+
+// Text conversion
+size_t Fixed::format(char* buffer, size_t capacity, uint8_t decimals) const {
+    if (buffer == nullptr || capacity == 0) {
+        return 0;
+    }
+    if (decimals > 18) {
+        decimals = 18;
+    }
+
+    uint64_t mag = magnitude(raw);
+    uint64_t integer = mag >> F;
+    uint64_t fraction = mag & (uint64_t)(RAW_ONE - 1);
+
+    // Round the fraction to the requested decimals, carrying into the integer
+    bool unused = false;
+    U128 scaled = mul_u64(fraction, pow10_u64[decimals]);
+    scaled = add_u128(scaled, (uint64_t)1 << (F - 1));
+    uint64_t frac_digits = shr_u128(scaled, F, unused);
+    if (frac_digits >= pow10_u64[decimals]) {
+        frac_digits -= pow10_u64[decimals];
+        integer++;
+    }
+
+    char tmp[48];
+    size_t len = 0;
+
+    // Fraction digits, least significant first, skipping trailing zeros
+    bool significant = false;
+    for (uint8_t i = 0; i < decimals; i++) {
+        uint8_t digit = (uint8_t)(frac_digits % 10);
+        frac_digits /= 10;
+        if (digit != 0) {
+            significant = true;
+        }
+        if (significant) {
+            tmp[len++] = (char)('0' + digit);
+        }
+    }
+    if (significant) {
+        tmp[len++] = '.';
+    }
+
+    do {
+        tmp[len++] = (char)('0' + integer % 10);
+        integer /= 10;
+    } while (integer != 0);
+
+    if (raw < 0 && (significant || len > 1 || tmp[len - 1] != '0')) {
+        tmp[len++] = '-';
+    }
+
+    // Reverse into the caller's buffer, truncating if needed
+    size_t out = 0;
+    while (len > 0 && out + 1 < capacity) {
+        buffer[out++] = tmp[--len];
+    }
+    buffer[out] = '\0';
+    return out;
+}
+
+// Operators
+Fixed Fixed::operator/(Fixed other) const {
+    Fixed result;
+    if (!div(*this, other, result)) {
+        return from_raw(raw < 0 ? RAW_MIN : RAW_MAX);
+    }
+    return result;
+}
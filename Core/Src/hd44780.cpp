@@ -0,0 +1,254 @@
+/**
+  ******************************************************************************
+  * @file           : hd44780.cpp
+  * @brief          : HD44780 character LCD driver (4-bit GPIO or PCF8574 I2C)
+  * @author         : STM32 Calculator Project
+  * @date           : 2024
+  ******************************************************************************
+  */
+
+#include "hd44780.h"
+
+// Cycle counter helpers
+static void cycle_counter_enable() {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+static uint32_t cycles_per_us() {
+    return SystemCoreClock / 1000000;
+}
+
+static bool cycle_reached(uint32_t target) {
+    return (int32_t)((uint32_t)DWT->CYCCNT - target) >= 0;
+}
+
+void hd44780_delay_us(uint32_t us) {
+    uint32_t target = (uint32_t)DWT->CYCCNT + us * cycles_per_us();
+    while (!cycle_reached(target)) {
+    }
+}
+
+// E high and low phases must each last 450 ns (PWEH / tcycE); 1 us covers both
+static void enable_pulse_delay() {
+    hd44780_delay_us(1);
+}
+
+// GPIO bus
+bool Hd44780GpioBus::init() {
+    GPIO_InitTypeDef gpio_init = {};
+    gpio_init.Pin = pins.rs | pins.rw | pins.e;
+    gpio_init.Mode = GPIO_MODE_OUTPUT_PP;
+    gpio_init.Pull = GPIO_NOPULL;
+    gpio_init.Speed = GPIO_SPEED_FREQ_HIGH;
+    HAL_GPIO_Init(pins.port, &gpio_init);
+    HAL_GPIO_WritePin(pins.port, pins.rs | pins.e, GPIO_PIN_RESET);
+    if (pins.rw != 0) {
+        HAL_GPIO_WritePin(pins.port, pins.rw, GPIO_PIN_RESET);
+    }
+    set_data_direction(true);
+    return true;
+}
+
+bool Hd44780GpioBus::write_nibble(uint8_t nibble, bool rs) {
+    HAL_GPIO_WritePin(pins.port, pins.rs, rs ? GPIO_PIN_SET : GPIO_PIN_RESET);
+    for (int i = 0; i < 4; i++) {
+        HAL_GPIO_WritePin(pins.port, pins.data[i], ((nibble >> i) & 1) ? GPIO_PIN_SET : GPIO_PIN_RESET);
+    }
+    pulse_enable();
+    return true;
+}
+
+bool Hd44780GpioBus::read_status(uint8_t& status) {
+    if (pins.rw == 0) {
+        return false;
+    }
+    set_data_direction(false);
+    HAL_GPIO_WritePin(pins.port, pins.rs, GPIO_PIN_RESET);
+    HAL_GPIO_WritePin(pins.port, pins.rw, GPIO_PIN_SET);
+
+    // High nibble (BF, AC6-4) then low nibble (AC3-0), read while E is high
+    status = 0;
+    for (int half = 1; half >= 0; half--) {
+        HAL_GPIO_WritePin(pins.port, pins.e, GPIO_PIN_SET);
+        enable_pulse_delay();
+        for (int i = 0; i < 4; i++) {
+            if (HAL_GPIO_ReadPin(pins.port, pins.data[i]) == GPIO_PIN_SET) {
+                status |= (uint8_t)(1 << (i + 4 * half));
+            }
+        }
+        HAL_GPIO_WritePin(pins.port, pins.e, GPIO_PIN_RESET);
+        enable_pulse_delay();
+    }
+
+    HAL_GPIO_WritePin(pins.port, pins.rw, GPIO_PIN_RESET);
+    set_data_direction(true);
+    return true;
+}
+
+void Hd44780GpioBus::set_data_direction(bool output) {
+    // Pulled up as inputs so a missing module reads as permanently busy
+    GPIO_InitTypeDef gpio_init = {};
+    gpio_init.Pin = pins.data[0] | pins.data[1] | pins.data[2] | pins.data[3];
+    gpio_init.Mode = output ? GPIO_MODE_OUTPUT_PP : GPIO_MODE_INPUT;
+    gpio_init.Pull = output ? GPIO_NOPULL : GPIO_PULLUP;
+    gpio_init.Speed = GPIO_SPEED_FREQ_HIGH;
+    HAL_GPIO_Init(pins.port, &gpio_init);
+}
+
+void Hd44780GpioBus::pulse_enable() {
+    HAL_GPIO_WritePin(pins.port, pins.e, GPIO_PIN_SET);
+    enable_pulse_delay();
+    HAL_GPIO_WritePin(pins.port, pins.e, GPIO_PIN_RESET);
+    enable_pulse_delay();
+}
+
+// I2C bus
+bool Hd44780I2cBus::init() {
+    // Also probes the expander: a missing backpack NACKs
+    return write_expander(0);
+}
+
+bool Hd44780I2cBus::write_nibble(uint8_t nibble, bool rs) {
+    uint8_t pins = (uint8_t)((nibble << 4) | (rs ? HD44780_I2C_RS : 0));
+    // E high and low in one frame; each byte already takes ~90 us on the bus
+    uint8_t frame[2] = {(uint8_t)(pins | HD44780_I2C_E | backlight), (uint8_t)(pins | backlight)};
+    return HAL_I2C_Master_Transmit(i2c_handle, device_address, frame, 2, 10) == HAL_OK;
+}
+
+bool Hd44780I2cBus::read_status(uint8_t& status) {
+    if (!poll_busy) {
+        return false;
+    }
+    // Data pins written high so the quasi-bidirectional outputs can be read
+    uint8_t idle = (uint8_t)(0xF0 | HD44780_I2C_RW | backlight);
+    status = 0;
+    for (int half = 1; half >= 0; half--) {
+        uint8_t pins = 0;
+        if (!write_expander((uint8_t)(idle | HD44780_I2C_E)) ||
+            HAL_I2C_Master_Receive(i2c_handle, device_address, &pins, 1, 10) != HAL_OK ||
+            !write_expander(idle)) {
+            return false;
+        }
+        status |= (uint8_t)((pins >> 4) << (4 * half));
+    }
+    return write_expander(backlight);
+}
+
+void Hd44780I2cBus::set_backlight(bool on) {
+    backlight = on ? HD44780_I2C_BACKLIGHT : 0;
+    write_expander(backlight);
+}
+
+bool Hd44780I2cBus::write_expander(uint8_t value) {
+    return HAL_I2C_Master_Transmit(i2c_handle, device_address, &value, 1, 10) == HAL_OK;
+}
+
+bool Hd44780::init() {
+    ready = false;
+    busy_flag = false;
+    cycle_counter_enable();
+    if (!bus.init()) {
+        return false;
+    }
+
+    // Only the remainder of the power-on time, not a fixed sleep
+    while (HAL_GetTick() < HD44780_POWER_ON_MS) {
+    }
+    uint32_t start = (uint32_t)DWT->CYCCNT;
+
+    // 8-bit function set three times, then switch to 4-bit; the busy flag
+    // cannot be read yet, so these follow the datasheet waits exactly
+    ready_cycle = start;
+    bus.write_nibble(0x3, false);
+    set_deadline(HD44780_INIT_WAIT1_US);
+    wait_ready();
+    bus.write_nibble(0x3, false);
+    set_deadline(HD44780_INIT_WAIT2_US);
+    wait_ready();
+    bus.write_nibble(0x3, false);
+    set_deadline(HD44780_EXEC_US);
+    wait_ready();
+    if (!bus.write_nibble(0x2, false)) {
+        return false;
+    }
+    set_deadline(HD44780_EXEC_US);
+
+    // From here on the busy flag works when R/W is wired
+    if (bus.can_read()) {
+        busy_flag = true;
+        if (!wait_busy_flag()) {
+            return false;   // Data lines stuck busy: no module fitted
+        }
+    }
+
+    write_byte(0x28, false, HD44780_EXEC_US);   // 4-bit, 2 lines, 5x8 font
+    write_byte(0x08, false, HD44780_EXEC_US);   // Display off
+    write_byte(0x01, false, HD44780_CLEAR_US);  // Clear display
+    write_byte(0x06, false, HD44780_EXEC_US);   // Increment cursor, no shift
+    write_byte(0x0C, false, HD44780_EXEC_US);   // Display on, cursor off
+    wait_ready();
+
+    init_time_us = ((uint32_t)DWT->CYCCNT - start) / cycles_per_us();
+    ready = true;
+    return true;
+}
+
+// Instructions
+void Hd44780::command(uint8_t command) {
+    // Clear (0x01) and return home (0x02/0x03) are the slow ones
+    uint32_t exec_us = (command < 0x04) ? HD44780_CLEAR_US : HD44780_EXEC_US;
+    write_byte(command, false, exec_us);
+}
+
+void Hd44780::write_data(uint8_t data) {
+    write_byte(data, true, HD44780_WRITE_US);
+}
+
+void Hd44780::clear() {
+    command(0x01);
+}
+
+void Hd44780::set_address(uint8_t address) {
+    command((uint8_t)(0x80 | (address & 0x7F)));
+}
+
+// Private helper methods
+void Hd44780::write_byte(uint8_t value, bool rs, uint32_t exec_us) {
+    // Waits only if the previous instruction is still executing, so the CPU
+    // is not held for the execution time of the last write
+    wait_ready();
+    bus.write_nibble(value >> 4, rs);
+    bus.write_nibble(value & 0x0F, rs);
+    set_deadline(exec_us);
+}
+
+void Hd44780::wait_ready() {
+    if (busy_flag) {
+        if (!wait_busy_flag()) {
+            // Flag never cleared: R/W miswired, keep going on timed waits
+            busy_flag = false;
+        }
+        return;
+    }
+    while (!cycle_reached(ready_cycle)) {
+    }
+}
+
+bool Hd44780::wait_busy_flag() {
+    uint32_t limit = (uint32_t)DWT->CYCCNT + HD44780_BUSY_TIMEOUT_US * cycles_per_us();
+    uint8_t status;
+    while (bus.read_status(status)) {
+        if ((status & 0x80) == 0) {
+            return true;
+        }
+        if (cycle_reached(limit)) {
+            return false;
+        }
+    }
+    return false;
+}
+
+void Hd44780::set_deadline(uint32_t us) {
+    ready_cycle = (uint32_t)DWT->CYCCNT + us * cycles_per_us();
+}
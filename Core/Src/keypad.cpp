@@ -9,106 +9,154 @@
 
 #include "keypad.h"
 #include <cstring>
+#include "profiler.h"
+#include "trace.h"
 
-// Constructor
-Keypad::Keypad() 
-    : row_port(nullptr)
-    , col_port(nullptr)
-    , initialized(false)
-    , last_key_time(0)
-    , last_key('\0')
-    , key_callback(nullptr) {
-    
-    // Initialize pin arrays
-    memset(row_pins, 0, sizeof(row_pins));
-    memset(col_pins, 0, sizeof(col_pins));
-}
+// Out-of-line definitions of the default keymaps (odr-used by address)
+constexpr KeyCode KeypadLayout<4, 4>::keymap[4][4];
+constexpr KeyCode KeypadLayout<5, 6>::keymap[5][6];
+constexpr KeyCode KeypadLayout<8, 8>::keymap[8][8];
 
-// Destructor
-Keypad::~Keypad() {
+// EXTI vector serving a pin: lines 0-4 have their own, 5-9 and 10-15 share
+static IRQn_Type exti_irq(uint16_t pin) {
+    uint8_t line = 0;
+    while (line < 15 && !(pin & (1u << line))) {
+        line++;
+    }
+    if (line <= 4) {
+        return (IRQn_Type)(EXTI0_IRQn + line);
+    }
+    return (line <= 9) ? EXTI9_5_IRQn : EXTI15_10_IRQn;
 }
 
 // Keypad initialization
-void Keypad::init() {
+template <uint8_t Rows, uint8_t Cols>
+void BasicKeypad<Rows, Cols>::init(KeypadMode mode) {
+    this->mode = mode;
+    
+    // Cycle counter for get_last_scan_cycles()
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    
     init_gpio();
     init_timer();
     initialized = true;
+    // Re-initialising into another mode must not leave the scans running
+    if (mode == KEYPAD_MODE_TIMER) {
+        start_timer();
+    } else {
+        stop_timer();
+    }
 }
 
-void Keypad::init_gpio() {
-    // This would need to be implemented based on your specific GPIO configuration
-    // For now, just a placeholder
-    
-    // Example for STM32F103C8T6:
-    // Row pins: PA0, PA1, PA2, PA3
-    // Col pins: PA4, PA5, PA6, PA7
+template <uint8_t Rows, uint8_t Cols>
+void BasicKeypad<Rows, Cols>::init_gpio() {
+    // Default wiring: rows on PA0.., columns on the pins after them
+    if (row_port == nullptr) {
+        uint16_t pins[Rows];
+        for (uint8_t row = 0; row < Rows; row++) {
+            pins[row] = (uint16_t)(1u << row);
+        }
+        set_row_pins(GPIOA, pins);
+    }
+    if (col_port == nullptr) {
+        uint16_t pins[Cols];
+        for (uint8_t col = 0; col < Cols; col++) {
+            pins[col] = (uint16_t)(1u << (Rows + col));
+        }
+        set_col_pins(GPIOA, pins);
+    }
     
-    // Enable GPIO clocks
+    // Clocks of ports other than GPIOA are enabled by MX_GPIO_Init
     __HAL_RCC_GPIOA_CLK_ENABLE();
     
     // Configure row pins as output
-    GPIO_InitTypeDef gpio_init = {0};
-    gpio_init.Pin = GPIO_PIN_0 | GPIO_PIN_1 | GPIO_PIN_2 | GPIO_PIN_3;
+    GPIO_InitTypeDef gpio_init = {};
+    gpio_init.Pin = row_mask;
     gpio_init.Mode = GPIO_MODE_OUTPUT_PP;
     gpio_init.Pull = GPIO_NOPULL;
     gpio_init.Speed = GPIO_SPEED_FREQ_LOW;
-    HAL_GPIO_Init(GPIOA, &gpio_init);
+    HAL_GPIO_Init(row_port, &gpio_init);
     
-    // Configure col pins as input with pull-up
-    gpio_init.Pin = GPIO_PIN_4 | GPIO_PIN_5 | GPIO_PIN_6 | GPIO_PIN_7;
-    gpio_init.Mode = GPIO_MODE_INPUT;
+    // Configure col pins as input with pull-up; in interrupt mode both
+    // edges raise EXTI (press wakes the scanner, release ends debounce)
+    gpio_init.Pin = col_mask;
+    gpio_init.Mode = (mode == KEYPAD_MODE_INTERRUPT) ? GPIO_MODE_IT_RISING_FALLING : GPIO_MODE_INPUT;
     gpio_init.Pull = GPIO_PULLUP;
     gpio_init.Speed = GPIO_SPEED_FREQ_LOW;
-    HAL_GPIO_Init(GPIOA, &gpio_init);
+    HAL_GPIO_Init(col_port, &gpio_init);
+    
+    // Rows are active low. Polling idles them high and pulls one low at a
+    // time; interrupt mode idles them all low so any key pulls a column low
+    set_all_rows(mode == KEYPAD_MODE_INTERRUPT ? GPIO_PIN_RESET : GPIO_PIN_SET);
     
-    // Set default pin configuration
-    row_port = GPIOA;
-    col_port = GPIOA;
-    row_pins[0] = GPIO_PIN_0;
-    row_pins[1] = GPIO_PIN_1;
-    row_pins[2] = GPIO_PIN_2;
-    row_pins[3] = GPIO_PIN_3;
-    col_pins[0] = GPIO_PIN_4;
-    col_pins[1] = GPIO_PIN_5;
-    col_pins[2] = GPIO_PIN_6;
-    col_pins[3] = GPIO_PIN_7;
+    if (mode == KEYPAD_MODE_INTERRUPT) {
+        for (uint8_t col = 0; col < Cols; col++) {
+            HAL_NVIC_SetPriority(exti_irq(col_pins[col]), 6, 0);
+            HAL_NVIC_EnableIRQ(exti_irq(col_pins[col]));
+        }
+    }
 }
 
-void Keypad::init_timer() {
-    // This would need to be implemented based on your timer configuration
-    // For now, just a placeholder
+template <uint8_t Rows, uint8_t Cols>
+void BasicKeypad<Rows, Cols>::init_timer() {
+    if (timing.scan_period_ms == 0) {
+        timing.scan_period_ms = 1;
+    }
+    // Integrator depth: consecutive agreeing scans needed to change state
+    uint16_t ticks = ms_to_ticks(timing.debounce_ms, timing.scan_period_ms);
+    debounce_ticks = (uint8_t)(ticks > 255 ? 255 : ticks);
+    memset(integrator, 0, sizeof(integrator));
+    stable_keys = 0;
+    repeat_index = -1;
+    
+    if (mode == KEYPAD_MODE_TIMER && timer_handle != nullptr) {
+        __HAL_TIM_SET_AUTORELOAD(timer_handle,
+                                 (uint32_t)timing.scan_period_ms * (KEYPAD_TIMER_CLOCK_HZ / 1000) - 1);
+    }
 }
 
 // Key scanning
-char Keypad::scan_key() {
+template <uint8_t Rows, uint8_t Cols>
+KeyCode BasicKeypad<Rows, Cols>::scan_key() {
+    PROFILE_SCOPE(PROFILE_SCAN_KEY);
     if (!initialized) {
-        return '\0';
+        return KEY_NONE;
     }
     
-    for (uint8_t row = 0; row < 4; row++) {
-        set_row_high(row);
-        
-        for (uint8_t col = 0; col < 4; col++) {
-            if (read_column(col)) {
-                char key = decode_key(row, col);
-                set_row_low(row);
-                return key;
-            }
+    // First pressed key in row-major order
+    KeyMask keys = scan_matrix();
+    for (uint8_t index = 0; index < KEY_COUNT; index++) {
+        if (keys & ((KeyMask)1 << index)) {
+            return decode_key(index);
         }
-        
-        set_row_low(row);
     }
-    
-    return '\0';
+    return KEY_NONE;
+}
+
+template <uint8_t Rows, uint8_t Cols>
+typename BasicKeypad<Rows, Cols>::KeyMask BasicKeypad<Rows, Cols>::scan_keys() {
+    if (!initialized) {
+        return 0;
+    }
+    return scan_matrix();
+}
+
+template <uint8_t Rows, uint8_t Cols>
+void BasicKeypad<Rows, Cols>::set_scan_method(KeypadScanMethod method) {
+    scan_method = method;
 }
 
-bool Keypad::is_key_pressed() {
-    return scan_key() != '\0';
+template <uint8_t Rows, uint8_t Cols>
+bool BasicKeypad<Rows, Cols>::is_key_pressed() {
+    return scan_key() != KEY_NONE;
 }
 
-char Keypad::get_pressed_key() {
-    char key = scan_key();
-    if (key != '\0') {
+template <uint8_t Rows, uint8_t Cols>
+KeyCode BasicKeypad<Rows, Cols>::get_pressed_key() {
+    KeyCode key = scan_key();
+    if (key != KEY_NONE) {
+        TRACE_EVENT(TRACE_KEY_DETECT, key);
         last_key = key;
         last_key_time = HAL_GetTick();
     }
@@ -116,126 +164,379 @@ char Keypad::get_pressed_key() {
 }
 
 // Debouncing
-void Keypad::debounce_delay() {
-    HAL_Delay(50);  // 50ms debounce delay
+template <uint8_t Rows, uint8_t Cols>
+void BasicKeypad<Rows, Cols>::debounce_delay() {
+    HAL_Delay(KEYPAD_DEBOUNCE_MS);
 }
 
-bool Keypad::is_valid_key(char key) {
+template <uint8_t Rows, uint8_t Cols>
+bool BasicKeypad<Rows, Cols>::is_valid_key(KeyCode key) {
     return (key >= '0' && key <= '9') || 
            key == '+' || key == '-' || key == '*' || key == '/' ||
-           key == '=' || key == 'C' || key == '.' || key == 'M';
+           key == '^' || key == '(' || key == ')' ||
+           key == '=' || key == 'C' || key == '.' || key == 'M' ||
+           (key > KEY_FUNCTION_BASE && key <= KEY_FUNCTION_LAST);
+}
+
+template <uint8_t Rows, uint8_t Cols>
+KeyCode BasicKeypad<Rows, Cols>::key_at(uint8_t row, uint8_t col) const {
+    return (row < Rows && col < Cols) ? (*keymap)[row][col] : KEY_NONE;
 }
 
 // Event handling
-void Keypad::set_key_callback(std::function<void(char)> callback) {
+template <uint8_t Rows, uint8_t Cols>
+void BasicKeypad<Rows, Cols>::set_key_callback(KeypadCallback callback, void* context) {
     key_callback = callback;
+    callback_context = context;
+}
+
+template <uint8_t Rows, uint8_t Cols>
+void BasicKeypad<Rows, Cols>::handle_key_event() {
+    if (mode == KEYPAD_MODE_INTERRUPT) {
+        // The EXTI handler already scanned and debounced; just deliver
+        KeyCode key = pending_key.exchange(KEY_NONE);
+        if (key != KEY_NONE && is_valid_key(key) && key_callback) {
+            key_callback(key, callback_context);
+        }
+        return;
+    }
+    
+    if (mode == KEYPAD_MODE_POLLING) {
+        // One integrator step per call, as the timer would take it; the
+        // caller's period stands in for the scan period
+        debounce_scan();
+    }
+    
+    // Drain the queue; presses and repeats go to the key callback
+    KeyEvent event;
+    while (events.pop(event)) {
+        if (event.type == KEY_EVENT_RELEASE) {
+            continue;
+        }
+        last_key = event.key;
+        last_key_time = event.time;
+        if (is_valid_key(event.key) && key_callback) {
+            key_callback(event.key, callback_context);
+        }
+    }
 }
 
-void Keypad::handle_key_event() {
-    char key = get_pressed_key();
-    if (key != '\0' && is_valid_key(key)) {
-        if (key_callback) {
-            key_callback(key);
+template <uint8_t Rows, uint8_t Cols>
+void BasicKeypad<Rows, Cols>::on_column_interrupt(uint16_t pin) {
+    if (mode != KEYPAD_MODE_INTERRUPT || !initialized || (pin & col_mask) == 0) {
+        return;
+    }
+    
+    KeyCode key = scan_key();
+    // Row switching during the scan retriggers the column lines
+    __HAL_GPIO_EXTI_CLEAR_IT(col_mask);
+    
+    uint32_t now = HAL_GetTick();
+    if (key != KEY_NONE) {
+        if (!key_down) {
+            key_down = true;
+            // A press right after a release is contact bounce
+            if (now - release_time >= KEYPAD_DEBOUNCE_MS) {
+                TRACE_EVENT(TRACE_KEY_DETECT, key);
+                last_key = key;
+                last_key_time = now;
+                pending_key.store(key);
+            }
         }
-        debounce_delay();
+    } else if (key_down) {
+        key_down = false;
+        release_time = now;
     }
 }
 
 // Status checking
-bool Keypad::is_initialized() const {
+template <uint8_t Rows, uint8_t Cols>
+bool BasicKeypad<Rows, Cols>::is_initialized() const {
     return initialized;
 }
 
-uint32_t Keypad::get_last_key_time() const {
+template <uint8_t Rows, uint8_t Cols>
+uint32_t BasicKeypad<Rows, Cols>::get_last_key_time() const {
     return last_key_time;
 }
 
 // GPIO control
-void Keypad::set_row_pins(GPIO_TypeDef* port, uint16_t* pins) {
+template <uint8_t Rows, uint8_t Cols>
+void BasicKeypad<Rows, Cols>::set_row_pins(GPIO_TypeDef* port, const uint16_t* pins) {
     row_port = port;
     memcpy(row_pins, pins, sizeof(row_pins));
+    update_scan_tables();
 }
 
-void Keypad::set_col_pins(GPIO_TypeDef* port, uint16_t* pins) {
+template <uint8_t Rows, uint8_t Cols>
+void BasicKeypad<Rows, Cols>::set_col_pins(GPIO_TypeDef* port, const uint16_t* pins) {
     col_port = port;
     memcpy(col_pins, pins, sizeof(col_pins));
+    update_scan_tables();
 }
 
 // Private helper methods
-void Keypad::scan_matrix() {
-    // This method is called internally by scan_key()
+template <uint8_t Rows, uint8_t Cols>
+typename BasicKeypad<Rows, Cols>::KeyMask BasicKeypad<Rows, Cols>::scan_matrix() {
+    // Every key's state, bit row * Cols + col, so any number of simultaneous
+    // keys is reported (without diodes three keys on a rectangle ghost a fourth)
+    uint32_t start = DWT->CYCCNT;
+    scan_count++;
+    KeyMask keys = (scan_method == KEYPAD_SCAN_PORT) ? scan_port() : scan_pins();
+    
+    // Back to idle: rows high for polling, all low to arm the column EXTI
+    set_all_rows(mode == KEYPAD_MODE_INTERRUPT ? GPIO_PIN_RESET : GPIO_PIN_SET);
+    last_scan_cycles = DWT->CYCCNT - start;
+    return keys;
 }
 
-char Keypad::decode_key(uint8_t row, uint8_t col) {
-    // Keypad layout:
-    // Row 0: 1, 2, 3, A
-    // Row 1: 4, 5, 6, B
-    // Row 2: 7, 8, 9, C
-    // Row 3: *, 0, #, D
-    
-    static const char keymap[4][4] = {
-        {'1', '2', '3', '+'},
-        {'4', '5', '6', '-'},
-        {'7', '8', '9', '*'},
-        {'C', '0', '=', '/'}
-    };
-    
-    if (row < 4 && col < 4) {
-        return keymap[row][col];
+template <uint8_t Rows, uint8_t Cols>
+typename BasicKeypad<Rows, Cols>::KeyMask BasicKeypad<Rows, Cols>::scan_pins() {
+    // One HAL call per row edge and per column read
+    if (mode == KEYPAD_MODE_INTERRUPT) {
+        set_all_rows(GPIO_PIN_SET);
     }
-    
-    return '\0';
+    KeyMask keys = 0;
+    for (uint8_t row = 0; row < Rows; row++) {
+        // Select one row at a time by pulling it low; a pressed key then
+        // pulls its column low against the pull-up
+        set_row_low(row);
+        for (uint8_t col = 0; col < Cols; col++) {
+            if (read_column(col)) {
+                keys |= (KeyMask)1 << (row * Cols + col);
+            }
+        }
+        set_row_high(row);
+    }
+    return keys;
 }
 
-bool Keypad::read_row(uint8_t row) {
-    if (row_port == nullptr || row >= 4) {
+template <uint8_t Rows, uint8_t Cols>
+typename BasicKeypad<Rows, Cols>::KeyMask BasicKeypad<Rows, Cols>::scan_port() {
+    // One BSRR write selects a row (it low, the others high), one IDR read
+    // returns every column
+    KeyMask keys = 0;
+    for (uint8_t row = 0; row < Rows; row++) {
+        row_port->BSRR = row_select[row];
+        // Discarded read: the input synchronisers lag the output by 2 cycles
+        (void)(uint32_t)col_port->IDR;
+        uint32_t pressed = ~(uint32_t)col_port->IDR & col_mask;
+        uint8_t cols;
+        if (col_lut_valid) {
+            cols = col_lut[(pressed >> col_shift) & ((1u << Cols) - 1)];
+        } else {
+            cols = 0;
+            for (uint8_t col = 0; col < Cols; col++) {
+                if (pressed & col_pins[col]) {
+                    cols |= (uint8_t)(1u << col);
+                }
+            }
+        }
+        keys |= (KeyMask)cols << (row * Cols);
+    }
+    return keys;
+}
+
+template <uint8_t Rows, uint8_t Cols>
+KeyCode BasicKeypad<Rows, Cols>::decode_key(uint8_t index) const {
+    // Bit index row * Cols + col is also the row-major keymap index
+    return (*keymap)[index / Cols][index % Cols];
+}
+
+template <uint8_t Rows, uint8_t Cols>
+bool BasicKeypad<Rows, Cols>::read_row(uint8_t row) {
+    if (row_port == nullptr || row >= Rows) {
         return false;
     }
     
     return HAL_GPIO_ReadPin(row_port, row_pins[row]) == GPIO_PIN_SET;
 }
 
-bool Keypad::read_column(uint8_t col) {
-    if (col_port == nullptr || col >= 4) {
+template <uint8_t Rows, uint8_t Cols>
+bool BasicKeypad<Rows, Cols>::read_column(uint8_t col) {
+    if (col_port == nullptr || col >= Cols) {
         return false;
     }
     
     return HAL_GPIO_ReadPin(col_port, col_pins[col]) == GPIO_PIN_RESET;
 }
 
-void Keypad::set_row_high(uint8_t row) {
-    if (row_port != nullptr && row < 4) {
+template <uint8_t Rows, uint8_t Cols>
+void BasicKeypad<Rows, Cols>::set_row_high(uint8_t row) {
+    if (row_port != nullptr && row < Rows) {
         HAL_GPIO_WritePin(row_port, row_pins[row], GPIO_PIN_SET);
     }
 }
 
-void Keypad::set_row_low(uint8_t row) {
-    if (row_port != nullptr && row < 4) {
+template <uint8_t Rows, uint8_t Cols>
+void BasicKeypad<Rows, Cols>::set_row_low(uint8_t row) {
+    if (row_port != nullptr && row < Rows) {
         HAL_GPIO_WritePin(row_port, row_pins[row], GPIO_PIN_RESET);
     }
 }
 
-void Keypad::set_col_high(uint8_t col) {
-    if (col_port != nullptr && col < 4) {
+template <uint8_t Rows, uint8_t Cols>
+void BasicKeypad<Rows, Cols>::set_col_high(uint8_t col) {
+    if (col_port != nullptr && col < Cols) {
         HAL_GPIO_WritePin(col_port, col_pins[col], GPIO_PIN_SET);
     }
 }
 
-void Keypad::set_col_low(uint8_t col) {
-    if (col_port != nullptr && col < 4) {
+template <uint8_t Rows, uint8_t Cols>
+void BasicKeypad<Rows, Cols>::set_col_low(uint8_t col) {
+    if (col_port != nullptr && col < Cols) {
         HAL_GPIO_WritePin(col_port, col_pins[col], GPIO_PIN_RESET);
     }
 }
 
+template <uint8_t Rows, uint8_t Cols>
+void BasicKeypad<Rows, Cols>::set_all_rows(GPIO_PinState state) {
+    if (row_port == nullptr) {
+        return;
+    }
+    if (scan_method == KEYPAD_SCAN_PORT) {
+        row_port->BSRR = (state == GPIO_PIN_SET) ? row_mask : ((uint32_t)row_mask << 16);
+    } else {
+        HAL_GPIO_WritePin(row_port, row_mask, state);
+    }
+}
+
+template <uint8_t Rows, uint8_t Cols>
+void BasicKeypad<Rows, Cols>::update_scan_tables() {
+    row_mask = 0;
+    for (uint8_t row = 0; row < Rows; row++) {
+        row_mask |= row_pins[row];
+    }
+    col_mask = 0;
+    for (uint8_t col = 0; col < Cols; col++) {
+        col_mask |= col_pins[col];
+    }
+    
+    // BSRR word per row: reset its pin (upper half), set the other rows
+    for (uint8_t row = 0; row < Rows; row++) {
+        row_select[row] = ((uint32_t)row_pins[row] << 16) | (uint16_t)(row_mask & ~row_pins[row]);
+    }
+    
+    // Columns inside one Cols-bit window of the port decode through a lookup
+    // table from IDR bits to column bits (any pin order); otherwise bit tests
+    col_shift = 0;
+    while (col_shift < 16 && col_mask != 0 && !(col_mask & (1u << col_shift))) {
+        col_shift++;
+    }
+    col_lut_valid = col_mask != 0 && ((uint32_t)col_mask >> col_shift) < (1u << Cols);
+    for (uint16_t bits = 0; bits < (1u << Cols); bits++) {
+        uint8_t cols = 0;
+        for (uint8_t col = 0; col < Cols && col_lut_valid; col++) {
+            if (((uint32_t)bits << col_shift) & col_pins[col]) {
+                cols |= (uint8_t)(1u << col);
+            }
+        }
+        col_lut[bits] = cols;
+    }
+}
+
 // Timer handling
-void Keypad::start_timer() {
-    // This would need to be implemented based on your timer configuration
+template <uint8_t Rows, uint8_t Cols>
+void BasicKeypad<Rows, Cols>::start_timer() {
+    if (timer_handle != nullptr) {
+        HAL_TIM_Base_Start_IT(timer_handle);
+    }
 }
 
-void Keypad::stop_timer() {
-    // This would need to be implemented based on your timer configuration
+template <uint8_t Rows, uint8_t Cols>
+void BasicKeypad<Rows, Cols>::stop_timer() {
+    if (timer_handle != nullptr) {
+        HAL_TIM_Base_Stop_IT(timer_handle);
+    }
+}
+
+template <uint8_t Rows, uint8_t Cols>
+void BasicKeypad<Rows, Cols>::timer_callback() {
+    if (mode != KEYPAD_MODE_TIMER || !initialized) {
+        return;
+    }
+    debounce_scan();
+}
+
+template <uint8_t Rows, uint8_t Cols>
+void BasicKeypad<Rows, Cols>::debounce_scan() {
+    // Integrator debounce: each key counts towards pressed or released and
+    // only flips state at either end, so bounce shorter than the window
+    // never produces an event and nothing in the ISR waits
+    KeyMask raw = scan_matrix();
+    for (uint8_t index = 0; index < KEY_COUNT; index++) {
+        KeyMask bit = (KeyMask)1 << index;
+        if (raw & bit) {
+            if (integrator[index] == 0 && !(stable_keys & bit)) {
+                TRACE_EVENT(TRACE_KEY_DETECT, decode_key(index));
+            }
+            if (integrator[index] < debounce_ticks && ++integrator[index] == debounce_ticks &&
+                !(stable_keys & bit)) {
+                stable_keys |= bit;
+                repeat_index = (int8_t)index;
+                repeat_ticks = 0;
+                push_event(decode_key(index), KEY_EVENT_PRESS);
+                TRACE_EVENT(TRACE_KEY_DEBOUNCED, decode_key(index));
+            }
+        } else if (integrator[index] > 0 && --integrator[index] == 0 && (stable_keys & bit)) {
+            stable_keys &= (KeyMask)~bit;
+            if (repeat_index == (int8_t)index) {
+                repeat_index = -1;
+            }
+            push_event(decode_key(index), KEY_EVENT_RELEASE);
+        }
+    }
+    
+    // Auto-repeat for the most recently pressed key while it is held
+    if (repeat_index >= 0 && timing.repeat_delay_ms != 0) {
+        uint16_t delay = ms_to_ticks(timing.repeat_delay_ms, timing.scan_period_ms);
+        uint16_t interval = ms_to_ticks(timing.repeat_interval_ms, timing.scan_period_ms);
+        repeat_ticks++;
+        if (repeat_ticks >= delay && (repeat_ticks - delay) % interval == 0) {
+            push_event(decode_key((uint8_t)repeat_index), KEY_EVENT_REPEAT);
+        }
+        if (repeat_ticks >= delay + interval) {
+            repeat_ticks = delay;
+        }
+    }
+}
+
+template <uint8_t Rows, uint8_t Cols>
+void BasicKeypad<Rows, Cols>::set_timer(TIM_HandleTypeDef* htim) {
+    timer_handle = htim;
+}
+
+template <uint8_t Rows, uint8_t Cols>
+void BasicKeypad<Rows, Cols>::set_timing(const KeypadTiming& timing) {
+    this->timing = timing;
+    if (initialized) {
+        init_timer();
+    }
 }
 
-void Keypad::timer_callback() {
-    // This would need to be implemented based on your timer configuration
+template <uint8_t Rows, uint8_t Cols>
+bool BasicKeypad<Rows, Cols>::get_event(KeyEvent& event) {
+    return events.pop(event);
 }
+
+template <uint8_t Rows, uint8_t Cols>
+void BasicKeypad<Rows, Cols>::push_event(KeyCode key, KeyEventType type) {
+    KeyEvent event;
+    event.key = key;
+    event.type = (uint8_t)type;
+    event.time = HAL_GetTick();
+    if (!events.push(event)) {
+        dropped_events++;
+    }
+}
+
+template <uint8_t Rows, uint8_t Cols>
+uint16_t BasicKeypad<Rows, Cols>::ms_to_ticks(uint16_t ms, uint16_t period_ms) {
+    uint16_t ticks = (uint16_t)((ms + period_ms - 1) / period_ms);
+    return ticks == 0 ? 1 : ticks;
+}
+
+// Explicit instantiations for the supported panels
+template class BasicKeypad<4, 4>;
+template class BasicKeypad<5, 6>;
+template class BasicKeypad<8, 8>;
@@ -13,9 +13,16 @@
 #include "calculator.h"
 #include "display.h"
 #include "keypad.h"
+#include "hd44780.h"
+#include "scheduler.h"
+#include "uart_rx_channel.h"
+#include "calc_protocol.h"
+#include "profiler.h"
+#include "trace.h"
 #include "stm32f1xx_hal.h"
 
 /* Private includes ----------------------------------------------------------*/
+#include <type_traits>
 
 /* Private typedef -----------------------------------------------------------*/
 
@@ -25,20 +32,78 @@
 
 /* Private variables ---------------------------------------------------------*/
 UART_HandleTypeDef huart1;
+DMA_HandleTypeDef hdma_usart1_tx;
+DMA_HandleTypeDef hdma_usart1_rx;
 TIM_HandleTypeDef htim2;
 
+#ifdef LCD_USE_I2C
+I2C_HandleTypeDef hi2c1;
+Hd44780I2cBus lcd_bus(&hi2c1);
+#else
+Hd44780GpioBus lcd_bus({LCD_GPIO_PORT, LCD_RS_PIN, LCD_RW_PIN, LCD_E_PIN,
+                        {LCD_D4_PIN, LCD_D5_PIN, LCD_D6_PIN, LCD_D7_PIN}});
+#endif
+Hd44780 lcd(lcd_bus);
+
 Calculator calculator;
-Display display(&huart1);
+Display display(&huart1, &lcd);
+UartRxChannel uart_rx(&huart1);
 Keypad keypad;
+Scheduler scheduler;
+
+/* Scheduler tasks, in priority order */
+static int8_t task_keypad;
+static int8_t task_uart_rx;
+static int8_t task_display;
+static int8_t task_led;
+
+/* Binary protocol frames received between command lines, and the reply */
+static CalcFrameDecoder frame_decoder;
+static uint8_t frame_reply[CALC_FRAME_MAX];
 
 /* Private function prototypes -----------------------------------------------*/
 void SystemClock_Config(void);
 static void MX_GPIO_Init(void);
+static void MX_DMA_Init(void);
 static void MX_USART1_UART_Init(void);
+#ifdef LCD_USE_I2C
+static void MX_I2C1_Init(void);
+#endif
 static void MX_TIM2_Init(void);
+static void handle_key(KeyCode key, void* context);
+static void keypad_task(void* context);
+static void uart_rx_task(void* context);
+static void notify_uart_rx(void* context);
+static void handle_line(const char* line);
+static bool read_frame_bytes(void);
+static void handle_frame(void);
+static void display_task(void* context);
+static void write_diagnostic_line(const char* line, void* context);
+static void led_task(void* context);
+static void enter_idle(uint32_t sleep_ms);
+static void sleep_tickless(uint32_t sleep_ms);
 
 /* Private user code ---------------------------------------------------------*/
 
+#ifdef HEAP_FREE
+/* Globals live until reset and have no destructors to register; the newlib
+   atexit table would otherwise be allocated with malloc */
+static_assert(std::is_trivially_destructible<Display>::value &&
+              std::is_trivially_destructible<UartRxChannel>::value &&
+              std::is_trivially_destructible<Calculator>::value &&
+              std::is_trivially_destructible<Keypad>::value &&
+              std::is_trivially_destructible<Scheduler>::value &&
+              std::is_trivially_destructible<Hd44780>::value,
+              "globals must not need atexit registration");
+extern "C" int __aeabi_atexit(void* object, void (*destructor)(void*), void* dso_handle)
+{
+    (void)object;
+    (void)destructor;
+    (void)dso_handle;
+    return 0;
+}
+#endif
+
 /**
   * @brief  The application entry point.
   * @retval int
@@ -55,58 +120,308 @@ int main(void)
 
     /* Initialize all configured peripherals */
     MX_GPIO_Init();
+    MX_DMA_Init();
     MX_USART1_UART_Init();
+#ifdef LCD_USE_I2C
+    MX_I2C1_Init();
+#endif
     MX_TIM2_Init();
 
+    /* Cycle counter for the PROFILE_SCOPE zones and the event trace */
+    profiler_init();
+    trace_init();
+
     /* Initialize calculator components */
     calculator.clear();
-    keypad.init();
+    /* TIM2 scans the keypad every KEYPAD_SCAN_PERIOD_MS and queues debounced
+       key events; APP_KEYPAD_MODE KEYPAD_MODE_INTERRUPT wakes on column EXTI
+       instead, which also allows STOP mode */
+    keypad.set_timer(&htim2);
+    keypad.init(APP_KEYPAD_MODE);
+    keypad.set_key_callback(handle_key);
     
-    // Set up keypad callback
-    keypad.set_key_callback([](char key) {
-        calculator.process_input(key);
-        
-        // Update display based on input
-        if (key >= '0' && key <= '9') {
-            display.print_number(calculator.get_last_result());
-        } else if (key == '+' || key == '-' || key == '*' || key == '/') {
-            display.print_operation(key);
-        } else if (key == '=') {
-            display.print_result(calculator.get_last_result());
-        } else if (key == 'C') {
-            display.clear();
-            display.show_calculator_mode();
-        }
-        
-        // Show error if any
-        if (calculator.is_error()) {
-            display.print_error(calculator.get_last_error());
-        }
-    });
+    /* Output moves to the LCD if one answers, otherwise stays on UART */
+    display.init_lcd();
+
+    /* Interrupts and timers wake the tasks; nothing runs in between */
+    /* Polling mode has no interrupt to wake the keypad task: scan on a timer */
+    task_keypad = scheduler.add_task("keypad", keypad_task, nullptr,
+                                     keypad.get_mode() == KEYPAD_MODE_POLLING ? KEYPAD_SCAN_PERIOD_MS : 0);
+    task_uart_rx = scheduler.add_task("uart_rx", uart_rx_task, nullptr);
+    task_display = scheduler.add_task("display", display_task, nullptr);
+    task_led = scheduler.add_task("led", led_task, nullptr, APP_HEARTBEAT_MS);
+    scheduler.set_idle_hook(enter_idle);
+
+    /* USART1 receives into a circular DMA buffer; each line is an expression */
+    uart_rx.set_notify(notify_uart_rx, nullptr);
+    uart_rx.start();
 
     /* Show welcome message */
     display.show_calculator_mode();
     display.print_line("Git Demo - Calculator Ready!");
     display.print_line("Version 2.0 - Updated for Git demo");
+    scheduler.notify(task_display);
     
     /* Infinite loop */
-    while (1)
-    {
-        /* Handle keypad events */
-        keypad.handle_key_event();
-        
-        /* Small delay to prevent busy waiting */
-        HAL_Delay(10);
-        
-        /* Toggle LED to show system is running */
-        static uint32_t led_timer = 0;
-        if (HAL_GetTick() - led_timer > 1000) {
-            HAL_GPIO_TogglePin(LED_GPIO_PORT, LED_PIN);
-            led_timer = HAL_GetTick();
+    scheduler.run();
+}
+
+/**
+  * @brief Applies one key from the keypad or the UART to the calculator.
+  */
+static void handle_key(KeyCode key, void* context)
+{
+    (void)context;
+    TRACE_EVENT(TRACE_KEY_DISPATCH, key);
+    // Function keys act on the calculator directly; the rest are input
+    // characters
+    if (key == KEY_MEMORY_ADD) {
+        calculator.memory_add(calculator.get_current_value());
+    } else if (key == KEY_MEMORY_SUB) {
+        calculator.memory_subtract(calculator.get_current_value());
+    } else if (key == KEY_MEMORY_CLEAR) {
+        calculator.memory_clear();
+    } else if (key == KEY_MEMORY_RECALL) {
+        // The recalled value becomes the entry, as if typed
+        calculator.enter_value(calculator.memory_recall());
+        display.print_number(calculator.get_current_value());
+    } else if (key == KEY_SQUARE_ROOT) {
+        calc_value_t root = calculator.square_root(calculator.get_current_value());
+        if (!calculator.is_error()) {
+            calculator.enter_value(root);
+            display.print_result(root);
         }
+    } else if (key < KEY_FUNCTION_BASE) {
+        calculator.process_input((char)key);
+    }
+    
+    // Update display based on input
+    if (key >= '0' && key <= '9') {
+        display.print_number(calculator.get_current_value());
+    } else if (key == '+' || key == '-' || key == '*' || key == '/') {
+        display.print_operation((char)key);
+    } else if (key == '=') {
+        display.print_result(calculator.get_last_result());
+    } else if (key == 'C') {
+        display.clear();
+        display.show_calculator_mode();
+    }
+    
+    // Show error if any
+    if (calculator.is_error()) {
+        display.print_error(calculator.get_last_error());
+    }
+    scheduler.notify(task_display);
+}
+
+/**
+  * @brief Keypad task: delivers the events queued by the scan interrupt.
+  */
+static void keypad_task(void* context)
+{
+    (void)context;
+    keypad.handle_key_event();
+}
+
+/**
+  * @brief UART RX task: answers the command lines and protocol frames
+  *        received so far, one reply each. The DMA keeps receiving the next
+  *        ones meanwhile.
+  */
+static void uart_rx_task(void* context)
+{
+    (void)context;
+    char line[UART_RX_LINE_MAX + 1];
+    uint8_t byte;
+    // A reply waits for room in the TX queue rather than being cut short;
+    // its request stays in the DMA buffer until then
+    for (;;) {
+        if (frame_decoder.is_ready()) {
+            if (display.tx_free_space() <
+                calc_protocol_reply_max(frame_decoder.payload(), frame_decoder.payload_length())) {
+                break;
+            }
+            handle_frame();
+        } else if (frame_decoder.in_frame() || (uart_rx.peek(byte) && byte == CALC_FRAME_SYNC)) {
+            if (!read_frame_bytes()) {
+                return;     // The rest of the frame has not arrived
+            }
+            continue;
+        } else if (!uart_rx.has_data()) {
+            return;
+        } else if (display.tx_free_space() < APP_RX_REPLY_MAX) {
+            break;
+        } else if (uart_rx.read_line(line, sizeof(line))) {
+            handle_line(line);
+        } else if (uart_rx.peek(byte) && (byte & 0x80) != 0) {
+            uart_rx.read(&byte, 1);     // Not text, not a frame: noise
+            continue;
+        } else {
+            return;
+        }
+        scheduler.notify(task_display);
+    }
+    scheduler.wake_after(task_uart_rx, 1);
+}
+
+/**
+  * @brief Receive interrupt: bytes arrived in the DMA buffer.
+  */
+static void notify_uart_rx(void* context)
+{
+    (void)context;
+    scheduler.notify(task_uart_rx);
+}
+
+/**
+  * @brief Evaluates one received line as a whole expression and replies on
+  *        the UART; APP_PROFILE_DUMP_KEY and APP_TRACE_DUMP_KEY alone on a
+  *        line dump the diagnostics instead.
+  */
+static void handle_line(const char* line)
+{
+    if (line[0] == APP_PROFILE_DUMP_KEY && line[1] == '\0') {
+        profiler_dump(write_diagnostic_line, nullptr);
+        return;
+    }
+    if (line[0] == APP_TRACE_DUMP_KEY && line[1] == '\0') {
+        trace_dump(write_diagnostic_line, nullptr);
+        return;
+    }
+    calc_value_t result = calculator.evaluate(line);
+    if (calculator.is_error()) {
+        display.print_uart_error(calculator.get_last_error());
+    } else {
+        display.print_uart_result(result);
     }
 }
 
+/**
+  * @brief Passes received bytes to the frame decoder, never past the end of
+  *        the current frame; false when none had arrived.
+  */
+static bool read_frame_bytes(void)
+{
+    uint8_t bytes[32];
+    size_t wanted = frame_decoder.wanted();
+    size_t count = uart_rx.read(bytes, wanted < sizeof(bytes) ? wanted : sizeof(bytes));
+    for (size_t i = 0; i < count; i++) {
+        frame_decoder.push(bytes[i]);
+    }
+    return count > 0;
+}
+
+/**
+  * @brief Runs one protocol request on the calculator and queues the
+  *        response frame.
+  */
+static void handle_frame(void)
+{
+    size_t length = calc_protocol_serve(calculator, frame_decoder.payload(), frame_decoder.payload_length(),
+                                        frame_reply, sizeof(frame_reply));
+    frame_decoder.release();
+    if (length != 0) {
+        display.write_uart(frame_reply, length);
+    }
+}
+
+/**
+  * @brief Sends one profiler or trace line on the UART, even while output is
+  *        on the LCD.
+  */
+static void write_diagnostic_line(const char* line, void* context)
+{
+    (void)context;
+    display.print_uart(line);
+    display.print_uart("\r\n");
+}
+
+/**
+  * @brief Display task: refreshes the LCD and sends queued UART text.
+  */
+static void display_task(void* context)
+{
+    (void)context;
+    display.poll();
+}
+
+/**
+  * @brief LED heartbeat task, every APP_HEARTBEAT_MS.
+  */
+static void led_task(void* context)
+{
+    (void)context;
+    HAL_GPIO_TogglePin(LED_GPIO_PORT, LED_PIN);
+}
+
+/**
+  * @brief Idle hook, entered with interrupts masked. Long waits with the
+  *        timers free go to STOP, others sleep without SysTick interrupts.
+  */
+static void enter_idle(uint32_t sleep_ms)
+{
+    if (sleep_ms == 0) {
+        return;
+    }
+    // STOP halts every clock but EXTI: only safe when the keypad wakes on
+    // column edges and no UART transfer is running. UART input arriving
+    // during STOP is lost. SysTick stops too, so timers resume late by the
+    // time spent in STOP
+    if (sleep_ms >= APP_STOP_MIN_MS && keypad.get_mode() == KEYPAD_MODE_INTERRUPT &&
+        display.is_tx_idle()) {
+        HAL_SuspendTick();
+        HAL_PWR_EnterSTOPMode(PWR_LOWPOWERREGULATOR_ON, PWR_STOPENTRY_WFI);
+        SystemClock_Config();   // STOP wakes on HSI
+        HAL_ResumeTick();
+        return;
+    }
+    sleep_tickless(sleep_ms);
+}
+
+/**
+  * @brief Sleeps up to sleep_ms with SysTick reprogrammed to fire once at
+  *        the end, then credits the skipped ticks to the HAL tick counter.
+  */
+static void sleep_tickless(uint32_t sleep_ms)
+{
+    uint32_t cycles_per_tick = SystemCoreClock / 1000;
+    uint32_t max_ticks = SysTick_LOAD_RELOAD_Msk / cycles_per_tick;
+    if (sleep_ms > max_ticks) {
+        sleep_ms = max_ticks;   // 233 ms at 72 MHz; idle again afterwards
+    }
+    if (sleep_ms < 2) {
+        __WFI();
+        return;
+    }
+
+    // Stretch the current tick to cover the whole sleep
+    SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+    uint32_t reload = SysTick->VAL + (sleep_ms - 1) * cycles_per_tick;
+    SysTick->LOAD = reload;
+    SysTick->VAL = 0;
+    SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+
+    __WFI();
+
+    // Stopped by a plain write: reading CTRL would clear COUNTFLAG
+    SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_TICKINT_Msk;
+    if (SysTick->CTRL & SysTick_CTRL_COUNTFLAG_Msk) {
+        // Slept the whole time; the pending SysTick interrupt adds the last tick
+        uwTick += sleep_ms - 1;
+        SysTick->LOAD = cycles_per_tick - 1;
+    } else {
+        // Another interrupt woke the core: credit whole ticks and time the
+        // next interrupt to the original tick boundary
+        uint32_t elapsed = reload - SysTick->VAL;
+        uint32_t ticks = elapsed / cycles_per_tick;
+        uwTick += ticks;
+        SysTick->LOAD = (ticks + 1) * cycles_per_tick - elapsed;
+    }
+    SysTick->VAL = 0;
+    SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+    SysTick->LOAD = cycles_per_tick - 1;    // Used from the next reload on
+}
+
 /**
   * @brief System Clock Configuration
   * @retval None
@@ -165,8 +480,81 @@ static void MX_USART1_UART_Init(void)
     {
         Error_Handler();
     }
+
+    /* USART1_TX is DMA1 channel 4; the display queue streams through it */
+    hdma_usart1_tx.Instance = DMA1_Channel4;
+    hdma_usart1_tx.Init.Direction = DMA_MEMORY_TO_PERIPH;
+    hdma_usart1_tx.Init.PeriphInc = DMA_PINC_DISABLE;
+    hdma_usart1_tx.Init.MemInc = DMA_MINC_ENABLE;
+    hdma_usart1_tx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    hdma_usart1_tx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+    hdma_usart1_tx.Init.Mode = DMA_NORMAL;
+    hdma_usart1_tx.Init.Priority = DMA_PRIORITY_LOW;
+    if (HAL_DMA_Init(&hdma_usart1_tx) != HAL_OK)
+    {
+        Error_Handler();
+    }
+    __HAL_LINKDMA(&huart1, hdmatx, hdma_usart1_tx);
+
+    /* USART1_RX is DMA1 channel 5, circular: uart_rx cuts lines out of it */
+    hdma_usart1_rx.Instance = DMA1_Channel5;
+    hdma_usart1_rx.Init.Direction = DMA_PERIPH_TO_MEMORY;
+    hdma_usart1_rx.Init.PeriphInc = DMA_PINC_DISABLE;
+    hdma_usart1_rx.Init.MemInc = DMA_MINC_ENABLE;
+    hdma_usart1_rx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    hdma_usart1_rx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+    hdma_usart1_rx.Init.Mode = DMA_CIRCULAR;
+    hdma_usart1_rx.Init.Priority = DMA_PRIORITY_HIGH;
+    if (HAL_DMA_Init(&hdma_usart1_rx) != HAL_OK)
+    {
+        Error_Handler();
+    }
+    __HAL_LINKDMA(&huart1, hdmarx, hdma_usart1_rx);
+
+    /* The HAL raises the transfer complete callback from the USART IRQ */
+    HAL_NVIC_SetPriority(USART1_IRQn, 5, 0);
+    HAL_NVIC_EnableIRQ(USART1_IRQn);
 }
 
+/**
+  * @brief DMA controller clock and interrupt enable
+  * @param None
+  * @retval None
+  */
+static void MX_DMA_Init(void)
+{
+    __HAL_RCC_DMA1_CLK_ENABLE();
+
+    HAL_NVIC_SetPriority(DMA1_Channel4_IRQn, 5, 0);
+    HAL_NVIC_EnableIRQ(DMA1_Channel4_IRQn);
+    HAL_NVIC_SetPriority(DMA1_Channel5_IRQn, 5, 0);
+    HAL_NVIC_EnableIRQ(DMA1_Channel5_IRQn);
+}
+
+#ifdef LCD_USE_I2C
+/**
+  * @brief I2C1 Initialization Function (LCD backpack)
+  * @param None
+  * @retval None
+  */
+static void MX_I2C1_Init(void)
+{
+    hi2c1.Instance = I2C1;
+    hi2c1.Init.ClockSpeed = 100000;
+    hi2c1.Init.DutyCycle = I2C_DUTYCYCLE_2;
+    hi2c1.Init.OwnAddress1 = 0;
+    hi2c1.Init.AddressingMode = I2C_ADDRESSINGMODE_7BIT;
+    hi2c1.Init.DualAddressMode = I2C_DUALADDRESS_DISABLE;
+    hi2c1.Init.OwnAddress2 = 0;
+    hi2c1.Init.GeneralCallMode = I2C_GENERALCALL_DISABLE;
+    hi2c1.Init.NoStretchMode = I2C_NOSTRETCH_DISABLE;
+    if (HAL_I2C_Init(&hi2c1) != HAL_OK)
+    {
+        Error_Handler();
+    }
+}
+#endif
+
 /**
   * @brief TIM2 Initialization Function
   * @param None
@@ -198,6 +586,10 @@ static void MX_TIM2_Init(void)
     {
         Error_Handler();
     }
+
+    /* Update interrupt drives the keypad scan (period set by Keypad) */
+    HAL_NVIC_SetPriority(TIM2_IRQn, 6, 0);
+    HAL_NVIC_EnableIRQ(TIM2_IRQn);
 }
 
 /**
@@ -214,6 +606,7 @@ static void MX_GPIO_Init(void)
     __HAL_RCC_GPIOD_CLK_ENABLE();
     __HAL_RCC_GPIOA_CLK_ENABLE();
     __HAL_RCC_GPIOB_CLK_ENABLE();
+    /* LCD pins are configured by the HD44780 bus driver */
 
     /* Configure GPIO pin Output Level */
     HAL_GPIO_WritePin(LED_GPIO_PORT, LED_PIN, GPIO_PIN_RESET);
@@ -226,6 +619,79 @@ static void MX_GPIO_Init(void)
     HAL_GPIO_Init(LED_GPIO_PORT, &GPIO_InitStruct);
 }
 
+/**
+  * @brief This function handles DMA1 channel4 (USART1_TX) global interrupt.
+  */
+extern "C" void DMA1_Channel4_IRQHandler(void)
+{
+    HAL_DMA_IRQHandler(&hdma_usart1_tx);
+}
+
+/**
+  * @brief This function handles DMA1 channel5 (USART1_RX) global interrupt.
+  */
+extern "C" void DMA1_Channel5_IRQHandler(void)
+{
+    HAL_DMA_IRQHandler(&hdma_usart1_rx);
+}
+
+/**
+  * @brief This function handles USART1 global interrupt.
+  */
+extern "C" void USART1_IRQHandler(void)
+{
+    HAL_UART_IRQHandler(&huart1);
+}
+
+/**
+  * @brief This function handles EXTI line4 interrupt (keypad column 0).
+  */
+extern "C" void EXTI4_IRQHandler(void)
+{
+    HAL_GPIO_EXTI_IRQHandler(GPIO_PIN_4);
+}
+
+/**
+  * @brief This function handles EXTI lines 9:5 interrupt (keypad columns 1-3).
+  */
+extern "C" void EXTI9_5_IRQHandler(void)
+{
+    HAL_GPIO_EXTI_IRQHandler(GPIO_PIN_5);
+    HAL_GPIO_EXTI_IRQHandler(GPIO_PIN_6);
+    HAL_GPIO_EXTI_IRQHandler(GPIO_PIN_7);
+}
+
+/**
+  * @brief This function handles TIM2 global interrupt.
+  */
+extern "C" void TIM2_IRQHandler(void)
+{
+    HAL_TIM_IRQHandler(&htim2);
+}
+
+/**
+  * @brief Period elapsed callback: one keypad scan per TIM2 update.
+  */
+extern "C" void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef* htim)
+{
+    if (htim->Instance == TIM2)
+    {
+        keypad.timer_callback();
+        if (keypad.has_events()) {
+            scheduler.notify(task_keypad);
+        }
+    }
+}
+
+/**
+  * @brief EXTI line detection callback: a keypad column changed level.
+  */
+extern "C" void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
+{
+    keypad.on_column_interrupt(GPIO_Pin);
+    scheduler.notify(task_keypad);
+}
+
 /**
   * @brief  This function is executed in case of error occurrence.
   * @retval None
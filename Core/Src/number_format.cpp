@@ -0,0 +1,527 @@
+/**
+  ******************************************************************************
+  * @file           : number_format.cpp
+  * @brief          : Heap-free number to text conversion implementation
+  * @author         : STM32 Calculator Project
+  * @date           : 2024
+  ******************************************************************************
+  *
+  * Shortest round-trip digits come from Grisu2 (Loitsch, "Printing
+  * Floating-Point Numbers Quickly and Accurately with Integers", PLDI 2010):
+  * 64-bit integer arithmetic only, no allocation and no locale.
+  */
+
+#include "number_format.h"
+#include <cfloat>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Decimal digits of a finite value: digits * 10^exponent
+struct DecimalDigits {
+    char digits[24];
+    int count;
+    int exponent;
+    bool negative;
+};
+
+enum ValueKind {
+    VALUE_FINITE = 0,
+    VALUE_ZERO,
+    VALUE_NAN,
+    VALUE_INF
+};
+
+// 64-bit significand and binary exponent ("do-it-yourself floating point")
+struct DiyFp {
+    uint64_t f;
+    int e;
+};
+
+// Normalised 10^k for k = -348, -340, ..., 340
+static const uint64_t cached_pow10_f[] = {
+    0xFA8FD5A0081C0288ull, 0xBAAEE17FA23EBF76ull, 0x8B16FB203055AC76ull, 0xCF42894A5DCE35EAull,
+    0x9A6BB0AA55653B2Dull, 0xE61ACF033D1A45DFull, 0xAB70FE17C79AC6CAull, 0xFF77B1FCBEBCDC4Full,
+    0xBE5691EF416BD60Cull, 0x8DD01FAD907FFC3Cull, 0xD3515C2831559A83ull, 0x9D71AC8FADA6C9B5ull,
+    0xEA9C227723EE8BCBull, 0xAECC49914078536Dull, 0x823C12795DB6CE57ull, 0xC21094364DFB5637ull,
+    0x9096EA6F3848984Full, 0xD77485CB25823AC7ull, 0xA086CFCD97BF97F4ull, 0xEF340A98172AACE5ull,
+    0xB23867FB2A35B28Eull, 0x84C8D4DFD2C63F3Bull, 0xC5DD44271AD3CDBAull, 0x936B9FCEBB25C996ull,
+    0xDBAC6C247D62A584ull, 0xA3AB66580D5FDAF6ull, 0xF3E2F893DEC3F126ull, 0xB5B5ADA8AAFF80B8ull,
+    0x87625F056C7C4A8Bull, 0xC9BCFF6034C13053ull, 0x964E858C91BA2655ull, 0xDFF9772470297EBDull,
+    0xA6DFBD9FB8E5B88Full, 0xF8A95FCF88747D94ull, 0xB94470938FA89BCFull, 0x8A08F0F8BF0F156Bull,
+    0xCDB02555653131B6ull, 0x993FE2C6D07B7FACull, 0xE45C10C42A2B3B06ull, 0xAA242499697392D3ull,
+    0xFD87B5F28300CA0Eull, 0xBCE5086492111AEBull, 0x8CBCCC096F5088CCull, 0xD1B71758E219652Cull,
+    0x9C40000000000000ull, 0xE8D4A51000000000ull, 0xAD78EBC5AC620000ull, 0x813F3978F8940984ull,
+    0xC097CE7BC90715B3ull, 0x8F7E32CE7BEA5C70ull, 0xD5D238A4ABE98068ull, 0x9F4F2726179A2245ull,
+    0xED63A231D4C4FB27ull, 0xB0DE65388CC8ADA8ull, 0x83C7088E1AAB65DBull, 0xC45D1DF942711D9Aull,
+    0x924D692CA61BE758ull, 0xDA01EE641A708DEAull, 0xA26DA3999AEF774Aull, 0xF209787BB47D6B85ull,
+    0xB454E4A179DD1877ull, 0x865B86925B9BC5C2ull, 0xC83553C5C8965D3Dull, 0x952AB45CFA97A0B3ull,
+    0xDE469FBD99A05FE3ull, 0xA59BC234DB398C25ull, 0xF6C69A72A3989F5Cull, 0xB7DCBF5354E9BECEull,
+    0x88FCF317F22241E2ull, 0xCC20CE9BD35C78A5ull, 0x98165AF37B2153DFull, 0xE2A0B5DC971F303Aull,
+    0xA8D9D1535CE3B396ull, 0xFB9B7CD9A4A7443Cull, 0xBB764C4CA7A44410ull, 0x8BAB8EEFB6409C1Aull,
+    0xD01FEF10A657842Cull, 0x9B10A4E5E9913129ull, 0xE7109BFBA19C0C9Dull, 0xAC2820D9623BF429ull,
+    0x80444B5E7AA7CF85ull, 0xBF21E44003ACDD2Dull, 0x8E679C2F5E44FF8Full, 0xD433179D9C8CB841ull,
+    0x9E19DB92B4E31BA9ull, 0xEB96BF6EBADF77D9ull, 0xAF87023B9BF0EE6Bull,
+};
+
+static const int16_t cached_pow10_e[] = {
+    -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980, -954, -927,
+    -901, -874, -847, -821, -794, -768, -741, -715, -688, -661, -635, -608,
+    -582, -555, -529, -502, -475, -449, -422, -396, -369, -343, -316, -289,
+    -263, -236, -210, -183, -157, -130, -103, -77, -50, -24, 3, 30,
+    56, 83, 109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+    375, 402, 428, 455, 481, 508, 534, 561, 588, 614, 641, 667,
+    694, 720, 747, 774, 800, 827, 853, 880, 907, 933, 960, 986,
+    1013, 1039, 1066,
+};
+
+static const uint64_t pow10_u64[] = {
+    1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull,
+    100000000ull, 1000000000ull, 10000000000ull, 100000000000ull, 1000000000000ull,
+    10000000000000ull, 100000000000000ull, 1000000000000000ull, 10000000000000000ull,
+    100000000000000000ull, 1000000000000000000ull, 10000000000000000000ull
+};
+
+static DiyFp diy_make(uint64_t f, int e) {
+    DiyFp r;
+    r.f = f;
+    r.e = e;
+    return r;
+}
+
+// Upper 64 bits of the 128-bit product, rounded
+static DiyFp diy_mul(DiyFp x, DiyFp y) {
+    const uint64_t mask = 0xFFFFFFFFu;
+    uint64_t a = x.f >> 32, b = x.f & mask;
+    uint64_t c = y.f >> 32, d = y.f & mask;
+    uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+    uint64_t mid = (bd >> 32) + (ad & mask) + (bc & mask) + (1u << 31);
+    return diy_make(ac + (ad >> 32) + (bc >> 32) + (mid >> 32), x.e + y.e + 64);
+}
+
+static DiyFp diy_normalize(DiyFp x) {
+    int shift = __builtin_clzll(x.f);
+    return diy_make(x.f << shift, x.e - shift);
+}
+
+// Digit generation for the scaled value w inside (w_plus - delta, w_plus)
+static void grisu_round(char* buffer, int length, uint64_t delta, uint64_t rest,
+                        uint64_t ten_kappa, uint64_t wp_w) {
+    while (rest < wp_w && delta - rest >= ten_kappa &&
+           (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w)) {
+        buffer[length - 1]--;
+        rest += ten_kappa;
+    }
+}
+
+static void grisu_digits(DiyFp w, DiyFp w_plus, uint64_t delta, DecimalDigits& out) {
+    const DiyFp one = diy_make((uint64_t)1 << -w_plus.e, w_plus.e);
+    const uint64_t wp_w = w_plus.f - w.f;
+    uint32_t p1 = (uint32_t)(w_plus.f >> -one.e);
+    uint64_t p2 = w_plus.f & (one.f - 1);
+
+    int kappa = 1;
+    while (kappa < 10 && p1 >= pow10_u64[kappa]) {
+        kappa++;
+    }
+
+    out.count = 0;
+    while (kappa > 0) {
+        uint32_t digit = (uint32_t)(p1 / pow10_u64[kappa - 1]);
+        p1 = (uint32_t)(p1 % pow10_u64[kappa - 1]);
+        if (digit != 0 || out.count != 0) {
+            out.digits[out.count++] = (char)('0' + digit);
+        }
+        kappa--;
+        uint64_t rest = ((uint64_t)p1 << -one.e) + p2;
+        if (rest <= delta) {
+            out.exponent += kappa;
+            grisu_round(out.digits, out.count, delta, rest, pow10_u64[kappa] << -one.e, wp_w);
+            return;
+        }
+    }
+
+    for (;;) {
+        p2 *= 10;
+        delta *= 10;
+        char digit = (char)(p2 >> -one.e);
+        if (digit != 0 || out.count != 0) {
+            out.digits[out.count++] = (char)('0' + digit);
+        }
+        p2 &= one.f - 1;
+        kappa--;
+        if (p2 < delta) {
+            out.exponent += kappa;
+            grisu_round(out.digits, out.count, delta, p2, one.f, wp_w * pow10_u64[-kappa]);
+            return;
+        }
+    }
+}
+
+// f * 2^e with the given hidden bit (IEEE significand, not yet normalised)
+static void grisu2(uint64_t f, int e, uint64_t hidden_bit, DecimalDigits& out) {
+    DiyFp v = diy_make(f, e);
+
+    // Boundaries m-/m+ halfway to the neighbouring values, sharing m+'s exponent
+    DiyFp plus = diy_normalize(diy_make((v.f << 1) + 1, v.e - 1));
+    DiyFp minus = (v.f == hidden_bit) ? diy_make((v.f << 2) - 1, v.e - 2)
+                                      : diy_make((v.f << 1) - 1, v.e - 1);
+    minus.f <<= minus.e - plus.e;
+    minus.e = plus.e;
+
+    // Cached 10^-k that brings m+ into [2^-60, 2^-32) after multiplication
+    double dk = (-61 - plus.e) * 0.30102999566398114 + 347;
+    int k = (int)dk;
+    if (dk - k > 0.0) {
+        k++;
+    }
+    unsigned index = (unsigned)((k >> 3) + 1);
+    DiyFp c_mk = diy_make(cached_pow10_f[index], cached_pow10_e[index]);
+    out.exponent = -(-348 + (int)index * 8);
+
+    DiyFp w = diy_mul(diy_normalize(v), c_mk);
+    DiyFp w_plus = diy_mul(plus, c_mk);
+    DiyFp w_minus = diy_mul(minus, c_mk);
+    w_minus.f++;
+    w_plus.f--;
+    grisu_digits(w, w_plus, w_plus.f - w_minus.f, out);
+}
+
+static ValueKind decompose(double value, DecimalDigits& out) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    out.negative = (bits >> 63) != 0;
+    int biased = (int)((bits >> 52) & 0x7FF);
+    uint64_t significand = bits & (((uint64_t)1 << 52) - 1);
+
+    if (biased == 0x7FF) {
+        return significand != 0 ? VALUE_NAN : VALUE_INF;
+    }
+    if (biased == 0 && significand == 0) {
+        return VALUE_ZERO;
+    }
+    const uint64_t hidden = (uint64_t)1 << 52;
+    if (biased != 0) {
+        grisu2(significand | hidden, biased - 1075, hidden, out);
+    } else {
+        grisu2(significand, -1074, hidden, out);
+    }
+    return VALUE_FINITE;
+}
+
+static ValueKind decompose(float value, DecimalDigits& out) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    out.negative = (bits >> 31) != 0;
+    int biased = (int)((bits >> 23) & 0xFF);
+    uint32_t significand = bits & ((1u << 23) - 1);
+
+    if (biased == 0xFF) {
+        return significand != 0 ? VALUE_NAN : VALUE_INF;
+    }
+    if (biased == 0 && significand == 0) {
+        return VALUE_ZERO;
+    }
+    const uint64_t hidden = (uint64_t)1 << 23;
+    if (biased != 0) {
+        grisu2(significand | hidden, biased - 150, hidden, out);
+    } else {
+        grisu2(significand, -149, hidden, out);
+    }
+    return VALUE_FINITE;
+}
+
+static ValueKind decompose(long double value, DecimalDigits& out) {
+#if LDBL_MANT_DIG == DBL_MANT_DIG
+    return decompose((double)value, out);
+#else
+    // No Grisu tables for the x87 format: find the shortest %Le precision
+    // that reads back exactly (monotonic, so binary search), host only
+    out.negative = value < 0.0L || (value == 0.0L && 1.0L / value < 0.0L);
+    if (value != value) {
+        return VALUE_NAN;
+    }
+    if (value == 0.0L) {
+        return VALUE_ZERO;
+    }
+    if (value - value != 0.0L) {
+        return VALUE_INF;
+    }
+
+    char text[48];
+    int lo = 1, hi = 21;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        snprintf(text, sizeof(text), "%.*Le", mid - 1, value);
+        if (strtold(text, nullptr) == value) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    snprintf(text, sizeof(text), "%.*Le", lo - 1, value);
+
+    // "-d.ddde+XX" -> digits and exponent
+    const char* p = text + (text[0] == '-');
+    out.count = 0;
+    for (; *p != 'e'; p++) {
+        if (*p != '.') {
+            out.digits[out.count++] = *p;
+        }
+    }
+    out.exponent = atoi(p + 1) - (out.count - 1);
+    while (out.count > 1 && out.digits[out.count - 1] == '0') {
+        out.count--;
+        out.exponent++;
+    }
+    return VALUE_FINITE;
+#endif
+}
+
+// Bounded output buffer; overflow is sticky and reported by finish()
+struct TextWriter {
+    char* buffer;
+    size_t capacity;
+    size_t length;
+    bool overflow;
+
+    void put(char c) {
+        if (length + 1 < capacity) {
+            buffer[length++] = c;
+        } else {
+            overflow = true;
+        }
+    }
+
+    void repeat(char c, int count) {
+        for (int i = 0; i < count; i++) {
+            put(c);
+        }
+    }
+
+    void put_int(int value) {
+        unsigned mag = value < 0 ? 0u - (unsigned)value : (unsigned)value;
+        if (value < 0) {
+            put('-');
+        }
+        put_uint(mag);
+    }
+
+    void put_uint(uint64_t value) {
+        char tmp[20];
+        int n = 0;
+        do {
+            tmp[n++] = (char)('0' + value % 10);
+            value /= 10;
+        } while (value != 0);
+        while (n > 0) {
+            put(tmp[--n]);
+        }
+    }
+
+    size_t finish() {
+        if (capacity == 0) {
+            return 0;
+        }
+        if (overflow) {
+            buffer[0] = '\0';
+            return 0;
+        }
+        buffer[length] = '\0';
+        return length;
+    }
+};
+
+static TextWriter writer_make(char* buffer, size_t capacity) {
+    TextWriter w;
+    w.buffer = buffer;
+    w.capacity = capacity;
+    w.length = 0;
+    w.overflow = false;
+    return w;
+}
+
+static size_t write_special(ValueKind kind, bool negative, TextWriter& w) {
+    const char* text = (kind == VALUE_NAN) ? "nan" : (kind == VALUE_INF ? (negative ? "-inf" : "inf") : "0");
+    for (; *text != '\0'; text++) {
+        w.put(*text);
+    }
+    return w.finish();
+}
+
+// d.ddd then 'e' and the decimal exponent, no '+' (narrow displays)
+static void write_scientific(const DecimalDigits& d, TextWriter& w) {
+    if (d.negative) {
+        w.put('-');
+    }
+    w.put(d.digits[0]);
+    if (d.count > 1) {
+        w.put('.');
+        for (int i = 1; i < d.count; i++) {
+            w.put(d.digits[i]);
+        }
+    }
+    w.put('e');
+    w.put_int(d.exponent + d.count - 1);
+}
+
+static void write_plain(const DecimalDigits& d, TextWriter& w) {
+    int point = d.count + d.exponent;    // Digits before the decimal point
+    if (d.negative) {
+        w.put('-');
+    }
+    if (point <= 0) {
+        w.put('0');
+        w.put('.');
+        w.repeat('0', -point);
+        for (int i = 0; i < d.count; i++) {
+            w.put(d.digits[i]);
+        }
+    } else if (point >= d.count) {
+        for (int i = 0; i < d.count; i++) {
+            w.put(d.digits[i]);
+        }
+        w.repeat('0', point - d.count);
+    } else {
+        for (int i = 0; i < d.count; i++) {
+            if (i == point) {
+                w.put('.');
+            }
+            w.put(d.digits[i]);
+        }
+    }
+}
+
+static int decimal_width(int value) {
+    int width = (value < 0) ? 2 : 1;
+    for (unsigned mag = value < 0 ? 0u - (unsigned)value : (unsigned)value; mag >= 10; mag /= 10) {
+        width++;
+    }
+    return width;
+}
+
+// Rounds half up to at most keep significant digits, dropping trailing zeros
+static void round_digits(DecimalDigits& d, int keep) {
+    if (keep < 1) {
+        keep = 1;
+    }
+    if (keep < d.count) {
+        bool up = d.digits[keep] >= '5';
+        d.exponent += d.count - keep;
+        d.count = keep;
+        if (up) {
+            int i = keep - 1;
+            while (i >= 0 && d.digits[i] == '9') {
+                d.digits[i--] = '0';
+            }
+            if (i < 0) {
+                // 999 -> 1000
+                d.digits[0] = '1';
+                d.exponent += d.count;
+                d.count = 1;
+            } else {
+                d.digits[i]++;
+            }
+        }
+    }
+    while (d.count > 1 && d.digits[d.count - 1] == '0') {
+        d.count--;
+        d.exponent++;
+    }
+}
+
+static size_t format_shortest(ValueKind kind, DecimalDigits& d, char* buffer, size_t capacity) {
+    TextWriter w = writer_make(buffer, capacity);
+    if (kind != VALUE_FINITE) {
+        return write_special(kind, d.negative, w);
+    }
+
+    // Same switch-over points as ECMAScript Number.prototype.toString
+    int point = d.count + d.exponent;
+    if (point > -6 && point <= 21) {
+        write_plain(d, w);
+    } else {
+        write_scientific(d, w);
+    }
+    return w.finish();
+}
+
+static size_t format_fit(ValueKind kind, DecimalDigits& d, char* buffer, size_t width) {
+    size_t length = format_shortest(kind, d, buffer, width + 1);
+    if (length != 0 || kind != VALUE_FINITE) {
+        return length;
+    }
+
+    int room = (int)width - (d.negative ? 1 : 0);
+    int point = d.count + d.exponent;
+    TextWriter w = writer_make(buffer, width + 1);
+
+    if (point >= 1 && point <= room) {
+        // Integer part fits: spend the rest on fraction digits
+        round_digits(d, room - 1 >= point ? room - 1 : point);
+        if (d.count + d.exponent <= room) {
+            write_plain(d, w);
+            return w.finish();
+        }
+    } else if (point <= 0 && point > -5 && room - 2 + point >= 1) {
+        // A few leading zeros: 0.000123456789
+        round_digits(d, room - 2 + point);
+        write_plain(d, w);
+        return w.finish();
+    }
+
+    // Scientific: mantissa gets whatever the exponent leaves over
+    for (;;) {
+        int exponent10 = d.count + d.exponent - 1;
+        int mantissa_room = room - 1 - decimal_width(exponent10);
+        round_digits(d, mantissa_room >= 3 ? mantissa_room - 1 : 1);
+        if (d.count + d.exponent - 1 == exponent10) {
+            break;
+        }
+        // Rounding carried into a new exponent (9.99e9 -> 1e10), redo
+    }
+    write_scientific(d, w);
+    return w.finish();
+}
+
+size_t number_format_shortest(double value, char* buffer, size_t capacity) {
+    DecimalDigits d;
+    ValueKind kind = decompose(value, d);
+    return format_shortest(kind, d, buffer, capacity);
+}
+
+size_t number_format_shortest(float value, char* buffer, size_t capacity) {
+    DecimalDigits d;
+    ValueKind kind = decompose(value, d);
+    return format_shortest(kind, d, buffer, capacity);
+}
+
+size_t number_format_shortest(long double value, char* buffer, size_t capacity) {
+    DecimalDigits d;
+    ValueKind kind = decompose(value, d);
+    return format_shortest(kind, d, buffer, capacity);
+}
+
+size_t number_format_fit(double value, char* buffer, size_t width) {
+    DecimalDigits d;
+    ValueKind kind = decompose(value, d);
+    return format_fit(kind, d, buffer, width);
+}
+
+size_t number_format_fit(float value, char* buffer, size_t width) {
+    DecimalDigits d;
+    ValueKind kind = decompose(value, d);
+    return format_fit(kind, d, buffer, width);
+}
+
+size_t number_format_fit(long double value, char* buffer, size_t width) {
+    DecimalDigits d;
+    ValueKind kind = decompose(value, d);
+    return format_fit(kind, d, buffer, width);
+}
+
+size_t number_format_uint(uint64_t value, char* buffer, size_t capacity) {
+    TextWriter w = writer_make(buffer, capacity);
+    w.put_uint(value);
+    return w.finish();
+}
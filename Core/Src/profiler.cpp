@@ -0,0 +1,118 @@
+/**
+  ******************************************************************************
+  * @file           : profiler.cpp
+  * @brief          : Scoped cycle-count profiling zones (DWT CYCCNT)
+  * @author         : STM32 Calculator Project
+  * @date           : 2024
+  ******************************************************************************
+  */
+
+#include "profiler.h"
+#include "number_format.h"
+
+static const char* const zone_names[PROFILE_ZONE_COUNT] = {
+    "calculate_result",
+    "print_number",
+    "lcd_refresh",
+    "scan_key"
+};
+
+static ProfileStats zones[PROFILE_ZONE_COUNT];
+
+void profiler_init() {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    profiler_reset();
+}
+
+void profiler_reset() {
+    for (uint8_t zone = 0; zone < PROFILE_ZONE_COUNT; zone++) {
+        zones[zone].count = 0;
+        zones[zone].min_cycles = UINT32_MAX;
+        zones[zone].max_cycles = 0;
+        zones[zone].total_cycles = 0;
+    }
+}
+
+void profiler_record(ProfileZone zone, uint32_t cycles) {
+    if (zone >= PROFILE_ZONE_COUNT) {
+        return;
+    }
+    ProfileStats& stats = zones[zone];
+    stats.count++;
+    stats.total_cycles += cycles;
+    if (cycles < stats.min_cycles) {
+        stats.min_cycles = cycles;
+    }
+    if (cycles > stats.max_cycles) {
+        stats.max_cycles = cycles;
+    }
+}
+
+ProfileStats profiler_get(ProfileZone zone) {
+    ProfileStats empty = {0, 0, 0, 0};
+    if (zone >= PROFILE_ZONE_COUNT || zones[zone].count == 0) {
+        return empty;
+    }
+    return zones[zone];
+}
+
+const char* profiler_zone_name(ProfileZone zone) {
+    return zone < PROFILE_ZONE_COUNT ? zone_names[zone] : "";
+}
+
+// Text appended to line, NUL-terminated and cut at size; no printf, whose
+// newlib-nano version allocates and fails the heap-free link
+static size_t append(char* line, size_t used, size_t size, const char* text) {
+    while (*text != '\0' && used + 1 < size) {
+        line[used++] = *text++;
+    }
+    line[used] = '\0';
+    return used;
+}
+
+static size_t append_uint(char* line, size_t used, size_t size, uint64_t value) {
+    char digits[24];
+    number_format_uint(value, digits, sizeof(digits));
+    return append(line, used, size, digits);
+}
+
+// Nanoseconds as "us.fff" without floating point
+static size_t append_us(char* line, size_t used, size_t size, uint64_t cycles, uint32_t hz) {
+    uint64_t ns = hz != 0 ? cycles * 1000000000ull / hz : 0;
+    char fraction[5] = {'.', (char)('0' + ns % 1000 / 100), (char)('0' + ns % 100 / 10), (char)('0' + ns % 10), '\0'};
+    used = append_uint(line, used, size, ns / 1000);
+    return append(line, used, size, fraction);
+}
+
+void profiler_dump(ProfileWriter write, void* context) {
+    uint32_t hz = PROFILE_COUNTER_HZ();
+    char line[128];
+    const size_t size = sizeof(line);
+    for (uint8_t zone = 0; zone < PROFILE_ZONE_COUNT; zone++) {
+        const ProfileStats& stats = zones[zone];
+        if (stats.count == 0) {
+            continue;
+        }
+        uint64_t average = stats.total_cycles / stats.count;
+        size_t used = append(line, 0, size, zone_names[zone]);
+        while (used < 16) {
+            used = append(line, used, size, " ");   // Name column
+        }
+        used = append(line, used, size, " n=");
+        used = append_uint(line, used, size, stats.count);
+        used = append(line, used, size, " cyc min/avg/max=");
+        used = append_uint(line, used, size, stats.min_cycles);
+        used = append(line, used, size, "/");
+        used = append_uint(line, used, size, average);
+        used = append(line, used, size, "/");
+        used = append_uint(line, used, size, stats.max_cycles);
+        used = append(line, used, size, " us=");
+        used = append_us(line, used, size, stats.min_cycles, hz);
+        used = append(line, used, size, "/");
+        used = append_us(line, used, size, average, hz);
+        used = append(line, used, size, "/");
+        append_us(line, used, size, stats.max_cycles, hz);
+        write(line, context);
+    }
+}
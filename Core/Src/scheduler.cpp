@@ -0,0 +1,185 @@
+/**
+  ******************************************************************************
+  * @file           : scheduler.cpp
+  * @brief          : Event-driven cooperative scheduler with tickless idle
+  * @author         : STM32 Calculator Project
+  * @date           : 2024
+  ******************************************************************************
+  */
+
+#include "scheduler.h"
+#include <cstring>
+
+int8_t Scheduler::add_task(const char* name, SchedulerTaskFn function, void* context,
+                           uint32_t period_ms) {
+    if (task_count >= SCHEDULER_MAX_TASKS || function == nullptr) {
+        return -1;
+    }
+
+    // Latency statistics need the cycle counter
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    Task& task = tasks[task_count];
+    task.name = name;
+    task.function = function;
+    task.context = context;
+    task.period_ms = period_ms;
+    task.deadline = (period_ms != 0) ? HAL_GetTick() + period_ms : SCHEDULER_NO_DEADLINE;
+    return (int8_t)task_count++;
+}
+
+// Wake-ups
+void Scheduler::notify(uint8_t task) {
+    if (task >= task_count) {
+        return;
+    }
+    uint32_t bit = 1u << task;
+    // Timestamp only the first notify of a burst; approximate if two
+    // interrupts race on the same task
+    if (!(pending.load(std::memory_order_relaxed) & bit)) {
+        notify_cycle[task] = DWT->CYCCNT;
+    }
+    pending.fetch_or(bit, std::memory_order_release);
+}
+
+void Scheduler::wake_after(uint8_t task, uint32_t delay_ms) {
+    if (task < task_count) {
+        tasks[task].deadline = HAL_GetTick() + delay_ms;
+    }
+}
+
+void Scheduler::set_period(uint8_t task, uint32_t period_ms) {
+    if (task < task_count) {
+        tasks[task].period_ms = period_ms;
+        tasks[task].deadline = (period_ms != 0) ? HAL_GetTick() + period_ms : SCHEDULER_NO_DEADLINE;
+    }
+}
+
+void Scheduler::run_once() {
+    uint32_t now = HAL_GetTick();
+    uint32_t timer_ready = collect_ready(now);
+    uint32_t event_ready = pending.exchange(0, std::memory_order_acquire);
+
+    if ((timer_ready | event_ready) == 0) {
+        idle();
+        return;
+    }
+
+    uint32_t cycle = DWT->CYCCNT;
+    for (uint8_t task = 0; task < task_count; task++) {
+        uint32_t bit = 1u << task;
+        if (event_ready & bit) {
+            tasks[task].stats.event_wakeups++;
+            run_task(task, cycles_to_us(cycle - notify_cycle[task]));
+        } else if (timer_ready & bit) {
+            tasks[task].stats.timer_wakeups++;
+            run_task(task, tasks[task].timer_latency_us);
+        }
+    }
+}
+
+void Scheduler::run() {
+    while (1) {
+        run_once();
+    }
+}
+
+uint32_t Scheduler::time_to_next_deadline() const {
+    uint32_t now = HAL_GetTick();
+    uint32_t soonest = SCHEDULER_NO_DEADLINE;
+    for (uint8_t task = 0; task < task_count; task++) {
+        if (tasks[task].deadline == SCHEDULER_NO_DEADLINE) {
+            continue;
+        }
+        int32_t remaining = (int32_t)(tasks[task].deadline - now);
+        uint32_t wait = (remaining > 0) ? (uint32_t)remaining : 0;
+        if (wait < soonest) {
+            soonest = wait;
+        }
+    }
+    return soonest;
+}
+
+// Statistics
+const char* Scheduler::get_task_name(uint8_t task) const {
+    return (task < task_count) ? tasks[task].name : nullptr;
+}
+
+SchedulerTaskStats Scheduler::get_task_stats(uint8_t task) const {
+    SchedulerTaskStats empty = {0, 0, 0, 0, 0, 0, 0};
+    return (task < task_count) ? tasks[task].stats : empty;
+}
+
+void Scheduler::reset_stats() {
+    for (uint8_t task = 0; task < task_count; task++) {
+        memset(&tasks[task].stats, 0, sizeof(tasks[task].stats));
+    }
+    stats.idle_entries = 0;
+    stats.idle_ms = 0;
+}
+
+// Private helper methods
+uint32_t Scheduler::collect_ready(uint32_t now) {
+    uint32_t ready = 0;
+    for (uint8_t task = 0; task < task_count; task++) {
+        Task& entry = tasks[task];
+        if (entry.deadline == SCHEDULER_NO_DEADLINE || (int32_t)(now - entry.deadline) < 0) {
+            continue;
+        }
+        ready |= 1u << task;
+        entry.timer_latency_us = (now - entry.deadline) * 1000;
+
+        // Periodic tasks keep their phase; after an overrun the missed
+        // periods are skipped instead of run back to back
+        if (entry.period_ms == 0) {
+            entry.deadline = SCHEDULER_NO_DEADLINE;
+        } else {
+            entry.deadline += entry.period_ms;
+            if ((int32_t)(now - entry.deadline) >= 0) {
+                entry.deadline = now + entry.period_ms;
+            }
+        }
+    }
+    return ready;
+}
+
+void Scheduler::run_task(uint8_t task, uint32_t latency_us) {
+    Task& entry = tasks[task];
+    entry.stats.latency_us_total += latency_us;
+    if (latency_us > entry.stats.latency_us_max) {
+        entry.stats.latency_us_max = latency_us;
+    }
+
+    uint32_t start = DWT->CYCCNT;
+    entry.function(entry.context);
+    uint32_t run_us = cycles_to_us(DWT->CYCCNT - start);
+
+    entry.stats.runs++;
+    entry.stats.run_us_total += run_us;
+    if (run_us > entry.stats.run_us_max) {
+        entry.stats.run_us_max = run_us;
+    }
+}
+
+void Scheduler::idle() {
+    // Masked so a notify() between the check and the sleep still wakes it
+    __disable_irq();
+    if (pending.load(std::memory_order_acquire) == 0) {
+        uint32_t start = HAL_GetTick();
+        idle_hook(time_to_next_deadline());
+        stats.idle_entries++;
+        stats.idle_ms += HAL_GetTick() - start;
+    }
+    __enable_irq();
+}
+
+// Sleeps until the next interrupt; SysTick keeps ticking
+void Scheduler::default_idle(uint32_t sleep_ms) {
+    (void)sleep_ms;
+    __WFI();
+}
+
+uint32_t Scheduler::cycles_to_us(uint32_t cycles) {
+    return cycles / (SystemCoreClock / 1000000);
+}
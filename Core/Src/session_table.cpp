@@ -0,0 +1,284 @@
+/**
+  ******************************************************************************
+  * @file           : session_table.cpp
+  * @brief          : Compact keypad state of many calculator sessions
+  * @author         : STM32 Calculator Project
+  * @date           : 2024
+  ******************************************************************************
+  */
+
+#include "session_table.h"
+#include <cstring>
+
+// Session records start on a line, so a 32-byte one never straddles two
+static const size_t CACHE_LINE = 64;
+
+// Next array of count Us at cursor, aligned to align (a power of two)
+template <typename U>
+static U* carve(uintptr_t& cursor, size_t count, size_t align = alignof(U)) {
+    cursor = (cursor + align - 1) & ~(uintptr_t)(align - 1);
+    U* array = reinterpret_cast<U*>(cursor);
+    cursor += count * sizeof(U);
+    return array;
+}
+
+template <typename T>
+size_t BasicSessionTable<T>::storage_size(uint32_t sessions, uint32_t blocks) {
+    BasicSessionTable<T> measure;
+    // Measured from a line-aligned base; any other base pads by less
+    return measure.place(0, sessions, blocks) + CACHE_LINE;
+}
+
+template <typename T>
+bool BasicSessionTable<T>::init(void* storage, size_t bytes, uint32_t sessions, uint32_t block_total) {
+    *this = BasicSessionTable<T>();
+    if (storage == nullptr || sessions == SESSION_NONE || bytes < storage_size(sessions, block_total)) {
+        return false;
+    }
+    place((uintptr_t)storage, sessions, block_total);
+    session_count = sessions;
+    block_count = block_total;
+    free_count = block_total;
+    for (uint32_t i = 0; i < block_total; i++) {
+        free_blocks[i] = block_total - 1 - i;   // Block 0 is handed out first
+    }
+    for (uint32_t session = 0; session < sessions; session++) {
+        states[session].stack_block = SESSION_NONE;
+        reset(session);
+    }
+    return true;
+}
+
+template <typename T>
+void BasicSessionTable<T>::process_input(const uint32_t* sessions, const char* keys, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        // Session ids are usually scattered: fetch the records ahead of use
+#if defined(__GNUC__)
+        if (i + SESSION_PREFETCH_DISTANCE < n && sessions[i + SESSION_PREFETCH_DISTANCE] < session_count) {
+            __builtin_prefetch(states + sessions[i + SESSION_PREFETCH_DISTANCE], 1);
+        }
+#endif
+        process_input(sessions[i], keys[i]);
+    }
+}
+
+template <typename T>
+void BasicSessionTable<T>::process_input(uint32_t session, char key) {
+    if (session >= session_count) {
+        return;
+    }
+    SessionState& state = states[session];
+    switch (key) {
+        // Entry keys only touch the record
+        case '0': case '1': case '2': case '3': case '4':
+        case '5': case '6': case '7': case '8': case '9':
+            state.error_code = CALC_ERROR_NONE;
+            append_digit(state, (uint8_t)(key - '0'));
+            break;
+
+        case '.':
+            state.error_code = CALC_ERROR_NONE;
+            if ((state.entry_flags & ENTRY_STATE_MASK) != Calc::ENTRY_TYPING) {
+                append_digit(state, 0);
+            }
+            state.entry_flags |= ENTRY_POINT;
+            break;
+
+        default:
+            load(state);
+            scratch.process_input(key);
+            store(state);
+            break;
+    }
+}
+
+template <typename T>
+void BasicSessionTable<T>::reset(uint32_t session) {
+    if (session >= session_count) {
+        return;
+    }
+    SessionState& state = states[session];
+    release_block(state);
+    state.current_value = Num::zero();
+    state.last_result = Num::zero();
+    state.entry_mantissa = 0;
+    state.entry_decimals = 0;
+    state.entry_flags = Calc::ENTRY_NONE;
+    state.error_code = CALC_ERROR_NONE;
+    state.status_flags = 0;
+    memory_value[session] = Num::zero();
+}
+
+// Memory functions
+template <typename T>
+void BasicSessionTable<T>::memory_store(uint32_t session, T value) {
+    if (session < session_count) {
+        memory_value[session] = value;
+        states[session].error_code = CALC_ERROR_NONE;
+    }
+}
+
+template <typename T>
+T BasicSessionTable<T>::memory_recall(uint32_t session) const {
+    return session < session_count ? memory_value[session] : Num::zero();
+}
+
+template <typename T>
+void BasicSessionTable<T>::memory_clear(uint32_t session) {
+    if (session < session_count) {
+        memory_value[session] = Num::zero();
+    }
+}
+
+template <typename T>
+void BasicSessionTable<T>::memory_add(uint32_t session, T value) {
+    if (session < session_count) {
+        memory_value[session] = Num::add(memory_value[session], value);
+    }
+}
+
+template <typename T>
+void BasicSessionTable<T>::memory_subtract(uint32_t session, T value) {
+    if (session < session_count) {
+        memory_value[session] = Num::sub(memory_value[session], value);
+    }
+}
+
+// Per-session state
+template <typename T>
+T BasicSessionTable<T>::get_current_value(uint32_t session) const {
+    return session < session_count ? states[session].current_value : Num::zero();
+}
+
+template <typename T>
+T BasicSessionTable<T>::get_last_result(uint32_t session) const {
+    return session < session_count ? states[session].last_result : Num::zero();
+}
+
+template <typename T>
+bool BasicSessionTable<T>::is_error(uint32_t session) const {
+    return get_error_code(session) != CALC_ERROR_NONE;
+}
+
+template <typename T>
+CalcError BasicSessionTable<T>::get_error_code(uint32_t session) const {
+    return session < session_count ? states[session].error_code : CALC_ERROR_NONE;
+}
+
+template <typename T>
+uint8_t BasicSessionTable<T>::get_status_flags(uint32_t session) const {
+    return session < session_count ? states[session].status_flags : 0;
+}
+
+template <typename T>
+void BasicSessionTable<T>::clear_status_flags(uint32_t session) {
+    if (session < session_count) {
+        states[session].status_flags = 0;
+    }
+}
+
+// Private helper methods
+template <typename T>
+uintptr_t BasicSessionTable<T>::place(uintptr_t base, uint32_t sessions, uint32_t block_total) {
+    uintptr_t cursor = base;
+    states = carve<SessionState>(cursor, sessions, CACHE_LINE);
+    blocks = carve<StackBlock>(cursor, block_total, CACHE_LINE);
+    memory_value = carve<T>(cursor, sessions);
+    free_blocks = carve<uint32_t>(cursor, block_total);
+    return cursor;
+}
+
+// As BasicCalcState::append_digit(), on the record
+template <typename T>
+void BasicSessionTable<T>::append_digit(SessionState& state, uint8_t digit) {
+    if ((state.entry_flags & ENTRY_STATE_MASK) != Calc::ENTRY_TYPING) {
+        state.entry_mantissa = 0;
+        state.entry_decimals = 0;
+        state.entry_flags = Calc::ENTRY_TYPING;
+    }
+
+    if (state.entry_mantissa >= Calc::ENTRY_MANTISSA_LIMIT) {
+        return;
+    }
+
+    state.entry_mantissa = state.entry_mantissa * 10 + digit;
+    if (state.entry_flags & ENTRY_POINT) {
+        state.entry_decimals++;
+    }
+    state.current_value = Num::from_decimal(state.entry_mantissa, state.entry_decimals);
+}
+
+// Session state into the scratch state; memory is not needed there
+template <typename T>
+void BasicSessionTable<T>::load(const SessionState& state) {
+    scratch.current_value = state.current_value;
+    scratch.last_result = state.last_result;
+    scratch.entry_mantissa = state.entry_mantissa;
+    scratch.entry_decimals = state.entry_decimals;
+    scratch.entry_point = (state.entry_flags & ENTRY_POINT) != 0;
+    scratch.entry_state = (typename Calc::EntryState)(state.entry_flags & ENTRY_STATE_MASK);
+    scratch.error_code = state.error_code;
+    scratch.status_flags = state.status_flags;
+
+    if (state.stack_block == SESSION_NONE) {
+        scratch.operand_count = 0;
+        scratch.operator_count = 0;
+        return;
+    }
+    const StackBlock& block = blocks[state.stack_block];
+    scratch.operand_count = block.operand_count;
+    scratch.operator_count = block.operator_count;
+    for (uint8_t i = 0; i < block.operand_count; i++) {
+        scratch.operand_stack[i] = block.operands[i];
+    }
+    memcpy(scratch.operator_stack, block.operators, block.operator_count);
+}
+
+// Back from the scratch state, taking or returning a stack block
+template <typename T>
+void BasicSessionTable<T>::store(SessionState& state) {
+    if (scratch.operand_count == 0 && scratch.operator_count == 0) {
+        release_block(state);
+    } else {
+        if (state.stack_block == SESSION_NONE) {
+            if (free_count == 0) {
+                // No stack to keep the pending operation in
+                scratch.set_error(CALC_ERROR_TOO_LONG);
+                scratch.reset_input();
+            } else {
+                state.stack_block = free_blocks[--free_count];
+            }
+        }
+        if (state.stack_block != SESSION_NONE) {
+            StackBlock& block = blocks[state.stack_block];
+            block.operand_count = scratch.operand_count;
+            block.operator_count = scratch.operator_count;
+            for (uint8_t i = 0; i < scratch.operand_count; i++) {
+                block.operands[i] = scratch.operand_stack[i];
+            }
+            memcpy(block.operators, scratch.operator_stack, scratch.operator_count);
+        }
+    }
+
+    state.current_value = scratch.current_value;
+    state.last_result = scratch.last_result;
+    state.entry_mantissa = scratch.entry_mantissa;
+    state.entry_decimals = scratch.entry_decimals;
+    state.entry_flags = (uint8_t)(scratch.entry_state | (scratch.entry_point ? ENTRY_POINT : 0));
+    state.error_code = scratch.error_code;
+    state.status_flags = scratch.status_flags;
+}
+
+template <typename T>
+void BasicSessionTable<T>::release_block(SessionState& state) {
+    if (state.stack_block != SESSION_NONE) {
+        free_blocks[free_count++] = state.stack_block;
+        state.stack_block = SESSION_NONE;
+    }
+}
+
+// Explicit instantiations
+template class BasicSessionTable<float>;
+template class BasicSessionTable<double>;
+template class BasicSessionTable<long double>;
+template class BasicSessionTable<Fixed>;
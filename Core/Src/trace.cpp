@@ -0,0 +1,132 @@
+/**
+  ******************************************************************************
+  * @file           : trace.cpp
+  * @brief          : Binary event trace ring for key-to-display latency
+  * @author         : STM32 Calculator Project
+  * @date           : 2024
+  ******************************************************************************
+  */
+
+#include "trace.h"
+#include <atomic>
+#include "number_format.h"
+
+static_assert(TRACE_BUFFER_SIZE >= 2 && (TRACE_BUFFER_SIZE & (TRACE_BUFFER_SIZE - 1)) == 0,
+              "TRACE_BUFFER_SIZE must be a power of two");
+static_assert(sizeof(TraceRecord) == 8, "TraceRecord must stay 8 bytes");
+
+static const char* const event_names[TRACE_EVENT_COUNT] = {
+    "none",
+    "key_detect",
+    "key_debounced",
+    "key_dispatch",
+    "calc_input",
+    "calc_done",
+    "uart_send",
+    "uart_tx_start",
+    "uart_tx_done",
+    "lcd_refresh"
+};
+
+static TraceRecord records[TRACE_BUFFER_SIZE];
+static std::atomic<uint32_t> head(0);      // Records ever claimed; slot = head % size
+static volatile bool enabled = true;
+
+void trace_init() {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    trace_reset();
+    enabled = true;
+}
+
+void trace_reset() {
+    head.store(0);
+}
+
+void trace_enable(bool on) {
+    enabled = on;
+}
+
+void trace_record(TraceEvent event, uint16_t arg) {
+    if (!enabled) {
+        return;
+    }
+    // The slot is ours once claimed; a context preempting the write below
+    // claims the next one
+    uint32_t slot = head.fetch_add(1, std::memory_order_relaxed) & (TRACE_BUFFER_SIZE - 1);
+    TraceRecord& record = records[slot];
+    record.timestamp = (uint32_t)DWT->CYCCNT;
+    record.arg = arg;
+    record.event = (uint8_t)event;
+    record.reserved = 0;
+}
+
+size_t trace_count() {
+    uint32_t count = head.load();
+    return count < TRACE_BUFFER_SIZE ? count : TRACE_BUFFER_SIZE;
+}
+
+uint32_t trace_lost() {
+    uint32_t count = head.load();
+    return count > TRACE_BUFFER_SIZE ? count - TRACE_BUFFER_SIZE : 0;
+}
+
+size_t trace_snapshot(TraceRecord* out, size_t max_records) {
+    uint32_t end = head.load();
+    size_t count = trace_count();
+    if (count > max_records) {
+        count = max_records;
+    }
+    uint32_t first = end - (uint32_t)count;
+    for (size_t i = 0; i < count; i++) {
+        out[i] = records[(first + i) & (TRACE_BUFFER_SIZE - 1)];
+    }
+    return count;
+}
+
+const char* trace_event_name(TraceEvent event) {
+    return event < TRACE_EVENT_COUNT ? event_names[event] : "unknown";
+}
+
+void trace_dump(TraceWriter write, void* context) {
+    bool was_enabled = enabled;
+    enabled = false;
+
+    uint32_t end = head.load();
+    size_t count = trace_count();
+    uint32_t first = end - (uint32_t)count;
+    // Header without printf, whose newlib-nano version fails the heap-free link
+    char line[80];
+    const char* const fields[] = {"TRACE v1 hz=", " records=", " lost="};
+    const uint32_t values[] = {SystemCoreClock, (uint32_t)count, trace_lost()};
+    size_t used = 0;
+    for (size_t f = 0; f < 3; f++) {
+        for (const char* c = fields[f]; *c != '\0'; c++) {
+            line[used++] = *c;
+        }
+        used += number_format_uint(values[f], line + used, sizeof(line) - used);
+    }
+    write(line, context);
+
+    // Raw record bytes, so the decoder and the ring share one layout
+    static const char hex[] = "0123456789abcdef";
+    used = 0;
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t* bytes = (const uint8_t*)&records[(first + i) & (TRACE_BUFFER_SIZE - 1)];
+        if (used != 0) {
+            line[used++] = ' ';
+        }
+        for (size_t b = 0; b < sizeof(TraceRecord); b++) {
+            line[used++] = hex[bytes[b] >> 4];
+            line[used++] = hex[bytes[b] & 0x0F];
+        }
+        if ((i + 1) % 4 == 0 || i + 1 == count) {
+            line[used] = '\0';
+            write(line, context);
+            used = 0;
+        }
+    }
+    write("TRACE END", context);
+
+    enabled = was_enabled;
+}
@@ -0,0 +1,250 @@
+/**
+  ******************************************************************************
+  * @file           : uart_rx_channel.cpp
+  * @brief          : Line-framed UART receive channel on a circular DMA buffer
+  * @author         : STM32 Calculator Project
+  * @date           : 2024
+  ******************************************************************************
+  */
+
+#include "uart_rx_channel.h"
+#include <cstring>
+
+// Channels the receive callbacks dispatch to, looked up by handle
+static UartRxChannel* registered_channels[UART_RX_MAX_CHANNELS];
+
+static UartRxChannel* find_channel(UART_HandleTypeDef* huart) {
+    for (size_t i = 0; i < UART_RX_MAX_CHANNELS; i++) {
+        if (registered_channels[i] != nullptr && registered_channels[i]->handle() == huart) {
+            return registered_channels[i];
+        }
+    }
+    return nullptr;
+}
+
+bool UartRxChannel::start() {
+    if (uart_handle == nullptr || !register_channel()) {
+        return false;
+    }
+    dma_position = 0;
+    restart_count = received.load(std::memory_order_relaxed);
+    return HAL_UARTEx_ReceiveToIdle_DMA(uart_handle, dma_buffer, UART_RX_DMA_SIZE) == HAL_OK;
+}
+
+void UartRxChannel::stop() {
+    if (uart_handle != nullptr) {
+        HAL_UART_AbortReceive(uart_handle);
+    }
+    for (size_t i = 0; i < UART_RX_MAX_CHANNELS; i++) {
+        if (registered_channels[i] == this) {
+            registered_channels[i] = nullptr;
+        }
+    }
+}
+
+void UartRxChannel::set_notify(UartRxNotify callback, void* context) {
+    notify = callback;
+    notify_context = context;
+}
+
+bool UartRxChannel::read_line(char* buffer, size_t size) {
+    uint8_t byte;
+    while (next_byte(byte)) {
+        if ((byte & 0x80) != 0 && line_length == 0 && !discarding) {
+            return false;   // Not text: left for read()
+        }
+        consumed++;
+        stats.bytes_received++;
+
+        bool end_of_line = byte == '\r' || byte == '\n';
+        if (!end_of_line && !discarding) {
+            if (line_length == UART_RX_LINE_MAX) {
+                stats.lines_too_long++;
+                discarding = true;
+            } else {
+                line[line_length++] = (char)byte;
+            }
+        }
+#if UART_RX_IDLE_ENDS_LINE
+        if (idle_mark_reached()) {
+            end_of_line = true;
+        }
+#endif
+        if (!end_of_line) {
+            continue;
+        }
+
+        // CR LF and idle after a terminated line leave empty lines behind
+        bool complete = !discarding && line_length > 0 && size > 0;
+        if (complete) {
+            size_t length = line_length < size - 1 ? line_length : size - 1;
+            memcpy(buffer, line, length);
+            buffer[length] = '\0';
+            stats.lines++;
+        }
+        drop_line();
+        if (complete) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool UartRxChannel::peek(uint8_t& byte) {
+    return next_byte(byte);
+}
+
+size_t UartRxChannel::read(uint8_t* buffer, size_t size) {
+    size_t count = 0;
+    uint8_t byte;
+    while (count < size && next_byte(byte)) {
+        consumed++;
+        stats.bytes_received++;
+        buffer[count++] = byte;
+    }
+    return count;
+}
+
+bool UartRxChannel::has_data() const {
+    return received.load(std::memory_order_acquire) != consumed;
+}
+
+void UartRxChannel::on_rx_event(uint16_t position, bool idle) {
+    // Transfer complete reports the full size: the DMA is back at 0. Half
+    // transfer and transfer complete come every half buffer, so the
+    // distance from the previous position is never ambiguous
+    uint16_t wrapped = position % UART_RX_DMA_SIZE;
+    uint32_t delta = (wrapped + UART_RX_DMA_SIZE - dma_position) % UART_RX_DMA_SIZE;
+    dma_position = wrapped;
+    uint32_t total = received.load(std::memory_order_relaxed) + delta;
+    received.store(total, std::memory_order_release);
+#if UART_RX_IDLE_ENDS_LINE
+    if (idle) {
+        idle_marks.push(total);     // Full: the line waits for CR or LF
+    }
+#else
+    (void)idle;
+#endif
+    if (notify != nullptr) {
+        notify(notify_context);
+    }
+}
+
+void UartRxChannel::on_rx_error() {
+    // The HAL aborted the reception; bytes after the last event are lost
+    stats.errors++;
+    HAL_UART_AbortReceive(uart_handle);
+    restart_count = received.load(std::memory_order_relaxed);
+    dma_position = 0;
+    restarts.store(restarts.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    HAL_UARTEx_ReceiveToIdle_DMA(uart_handle, dma_buffer, UART_RX_DMA_SIZE);
+    if (notify != nullptr) {
+        notify(notify_context);
+    }
+}
+
+// Private helper methods
+bool UartRxChannel::next_byte(uint8_t& byte) {
+    for (;;) {
+        uint32_t seen = restarts.load(std::memory_order_acquire);
+        if (seen != restarts_seen) {
+            // Reception restarted at the buffer start: what was unread is stale
+            restarts_seen = seen;
+            uint32_t restart_at = restart_count;
+            if ((int32_t)(restart_at - consumed) > 0) {
+                stats.bytes_lost += restart_at - consumed;
+                consumed = restart_at;
+            }
+            // The line the error hit is skipped
+            drop_line();
+            discarding = true;
+        }
+
+        // The DMA runs ahead of the last reported position by up to half the
+        // buffer (the next half transfer or transfer complete interrupt), so
+        // only the newest half of the buffer is known to be intact
+        uint32_t end = received.load(std::memory_order_acquire);
+        if (consumed == end) {
+            return false;
+        }
+        if (end - consumed > UART_RX_DMA_SIZE / 2) {
+            // Skip to the newest byte; unless it ended a line, the next line
+            // arrives without its start
+            stats.overruns++;
+            stats.bytes_lost += end - consumed;
+            consumed = end;
+            drop_line();
+            uint8_t last = dma_buffer[(end - 1 - restart_count) % UART_RX_DMA_SIZE];
+            discarding = last != '\r' && last != '\n';
+#if UART_RX_IDLE_ENDS_LINE
+            if (idle_mark_reached()) {
+                discarding = false;
+            }
+#endif
+            continue;
+        }
+        byte = dma_buffer[(consumed - restart_count) % UART_RX_DMA_SIZE];
+        if (restarts.load(std::memory_order_acquire) != restarts_seen ||
+            received.load(std::memory_order_acquire) - consumed > UART_RX_DMA_SIZE / 2) {
+            continue;   // Overwritten while reading; handled above
+        }
+        return true;
+    }
+}
+
+bool UartRxChannel::register_channel() {
+    size_t free_slot = UART_RX_MAX_CHANNELS;
+    for (size_t i = 0; i < UART_RX_MAX_CHANNELS; i++) {
+        if (registered_channels[i] == this) {
+            return true;
+        }
+        if (registered_channels[i] == nullptr && free_slot == UART_RX_MAX_CHANNELS) {
+            free_slot = i;
+        }
+    }
+    if (free_slot == UART_RX_MAX_CHANNELS) {
+        return false;
+    }
+    registered_channels[free_slot] = this;
+    return true;
+}
+
+bool UartRxChannel::idle_mark_reached() {
+    for (;;) {
+        if (!has_next_mark) {
+            if (!idle_marks.pop(next_mark)) {
+                return false;
+            }
+            has_next_mark = true;
+        }
+        int32_t ahead = (int32_t)(next_mark - consumed);
+        if (ahead > 0) {
+            return false;
+        }
+        has_next_mark = false;
+        if (ahead == 0) {
+            return true;
+        }
+        // Behind the reader: its bytes were dropped
+    }
+}
+
+void UartRxChannel::drop_line() {
+    line_length = 0;
+    discarding = false;
+}
+
+// HAL callbacks (override the weak HAL definitions)
+extern "C" void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef* huart, uint16_t Size) {
+    UartRxChannel* channel = find_channel(huart);
+    if (channel != nullptr) {
+        channel->on_rx_event(Size, HAL_UARTEx_GetRxEventType(huart) == HAL_UART_RXEVENT_IDLE);
+    }
+}
+
+void uart_rx_on_error(UART_HandleTypeDef* huart) {
+    UartRxChannel* channel = find_channel(huart);
+    if (channel != nullptr) {
+        channel->on_rx_error();
+    }
+}
@@ -0,0 +1,193 @@
+/**
+  ******************************************************************************
+  * @file           : uart_tx_queue.cpp
+  * @brief          : Non-blocking UART transmit queue drained by DMA
+  * @author         : STM32 Calculator Project
+  * @date           : 2024
+  ******************************************************************************
+  */
+
+#include "uart_tx_queue.h"
+#include "trace.h"
+#include "uart_rx_channel.h"
+
+// Largest length HAL_UART_Transmit_DMA accepts
+static const size_t MAX_TRANSFER = 0xFFFF;
+
+// Queues the completion callbacks dispatch to, looked up by handle
+static UartTxQueue* registered_queues[UART_TX_MAX_QUEUES];
+
+static UartTxQueue* find_queue(UART_HandleTypeDef* huart) {
+    for (size_t i = 0; i < UART_TX_MAX_QUEUES; i++) {
+        if (registered_queues[i] != nullptr && registered_queues[i]->handle() == huart) {
+            return registered_queues[i];
+        }
+    }
+    return nullptr;
+}
+
+size_t UartTxQueue::write(const uint8_t* data, size_t length) {
+    size_t accepted = ring.write(data, length);
+    stats.bytes_queued += accepted;
+    stats.bytes_dropped += length - accepted;
+
+    if (ring.size() >= UART_TX_COALESCE_BYTES) {
+        try_start();
+    }
+    return accepted;
+}
+
+size_t UartTxQueue::write_wait(const uint8_t* data, size_t length, uint32_t timeout_ms) {
+    uint32_t start = HAL_GetTick();
+    size_t accepted = ring.write(data, length);
+
+    while (accepted < length) {
+        // Full: make sure the queue is draining, then wait for room
+        try_start();
+        if (HAL_GetTick() - start >= timeout_ms) {
+            break;
+        }
+        accepted += ring.write(data + accepted, length - accepted);
+    }
+
+    stats.bytes_queued += accepted;
+    stats.bytes_dropped += length - accepted;
+    if (ring.size() >= UART_TX_COALESCE_BYTES) {
+        try_start();
+    }
+    return accepted;
+}
+
+void UartTxQueue::poll() {
+    if (!ring.empty()) {
+        try_start();
+    }
+}
+
+bool UartTxQueue::flush(uint32_t timeout_ms) {
+    uint32_t start = HAL_GetTick();
+    while (!ring.empty() || busy.load(std::memory_order_acquire)) {
+        try_start();
+        if (HAL_GetTick() - start >= timeout_ms) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void UartTxQueue::stop() {
+    // Detached first, so a completion racing the abort chains nothing
+    for (size_t i = 0; i < UART_TX_MAX_QUEUES; i++) {
+        if (registered_queues[i] == this) {
+            registered_queues[i] = nullptr;
+        }
+    }
+    if (busy.load(std::memory_order_acquire)) {
+        HAL_UART_AbortTransmit(uart_handle);
+        ring.consume(in_flight);
+        in_flight = 0;
+        busy.store(false);
+    }
+}
+
+void UartTxQueue::on_tx_complete() {
+    // Still owns busy: release the sent bytes and chain the next run
+    ring.consume(in_flight);
+    in_flight = 0;
+    TRACE_EVENT(TRACE_UART_TX_DONE, ring.size());
+    start_transfer();
+}
+
+void UartTxQueue::on_tx_error() {
+    // The HAL aborted the transfer; its bytes are lost, keep the rest going
+    stats.errors++;
+    ring.consume(in_flight);
+    in_flight = 0;
+    start_transfer();
+}
+
+// Private helper methods
+bool UartTxQueue::try_start() {
+    bool expected = false;
+    if (uart_handle == nullptr || !register_queue() ||
+        !busy.compare_exchange_strong(expected, true)) {
+        return false;
+    }
+    start_transfer();
+    return true;
+}
+
+bool UartTxQueue::register_queue() {
+    // Before the first transfer, so its completion finds the queue
+    size_t free_slot = UART_TX_MAX_QUEUES;
+    for (size_t i = 0; i < UART_TX_MAX_QUEUES; i++) {
+        if (registered_queues[i] == this) {
+            return true;
+        }
+        if (registered_queues[i] == nullptr && free_slot == UART_TX_MAX_QUEUES) {
+            free_slot = i;
+        }
+    }
+    if (free_slot == UART_TX_MAX_QUEUES) {
+        return false;   // More queues than UART_TX_MAX_QUEUES: nothing is sent
+    }
+    registered_queues[free_slot] = this;
+    return true;
+}
+
+void UartTxQueue::start_transfer() {
+    // Caller holds busy
+    const uint8_t* data;
+    size_t length = ring.peek_contiguous(data);
+    if (length == 0) {
+        busy.store(false);
+        // The producer may have queued bytes after the peek but before the
+        // store; its own try_start() saw busy set and gave up, so retry here
+        if (!ring.empty()) {
+            try_start();
+        }
+        return;
+    }
+    if (length > MAX_TRANSFER) {
+        length = MAX_TRANSFER;
+    }
+
+    // Set before starting: the completion interrupt may fire before return
+    in_flight = length;
+    stats.transfers++;
+    TRACE_EVENT(TRACE_UART_TX_START, length);
+#ifdef UART_TX_USE_IT
+    HAL_StatusTypeDef status = HAL_UART_Transmit_IT(uart_handle, (uint8_t*)data, (uint16_t)length);
+#else
+    HAL_StatusTypeDef status = HAL_UART_Transmit_DMA(uart_handle, (uint8_t*)data, (uint16_t)length);
+#endif
+    if (status != HAL_OK) {
+        // Nothing was started; the next write, poll() or flush() retries
+        in_flight = 0;
+        busy.store(false);
+    }
+}
+
+// HAL callbacks (override the weak HAL definitions)
+extern "C" void HAL_UART_TxCpltCallback(UART_HandleTypeDef* huart) {
+    UartTxQueue* queue = find_queue(huart);
+    if (queue != nullptr) {
+        queue->on_tx_complete();
+    }
+}
+
+extern "C" void HAL_UART_ErrorCallback(UART_HandleTypeDef* huart) {
+    // Receive errors abort only the reception; a transfer the HAL still
+    // runs is not lost
+    UartTxQueue* queue = find_queue(huart);
+    if (queue != nullptr && queue->is_busy() &&
+        (HAL_UART_GetState(huart) & HAL_UART_STATE_BUSY_TX) != HAL_UART_STATE_BUSY_TX) {
+        queue->on_tx_error();
+    }
+    uart_rx_on_error(huart);
+}
+
+// Builds without a receive channel (uart_rx_channel.cpp) have nothing to restart
+__attribute__((weak)) void uart_rx_on_error(UART_HandleTypeDef* huart) {
+    (void)huart;
+}
@@ -0,0 +1,127 @@
+/**
+  ******************************************************************************
+  * @file           : calc_client.cpp
+  * @brief          : Host-side client of the binary calculation protocol
+  * @author         : STM32 Calculator Project
+  * @date           : 2024
+  ******************************************************************************
+  */
+
+#include "calc_client.h"
+#include <cstring>
+
+// Constructor
+CalcClient::CalcClient(Writer write, void* context)
+    : writer(write)
+    , writer_context(context)
+    , next_id(0)
+    , in_flight(0)
+    , sent_bytes(0)
+    , decoder()
+    , responses() {
+}
+
+int32_t CalcClient::send_batch(CalcOpcode opcode, CalcOperandFormat format,
+                               const double* a, const double* b, size_t count) {
+    size_t size = calc_operand_size(format);
+    if (opcode < CALC_OP_ADD || opcode > CALC_OP_DIVIDE || size == 0 ||
+        count > calc_batch_lanes_max(format)) {
+        return -1;
+    }
+    uint8_t operands[CALC_FRAME_PAYLOAD_MAX];
+    for (size_t i = 0; i < count; i++) {
+        calc_operand_put(format, a[i], operands + 2 * i * size);
+        calc_operand_put(format, b[i], operands + (2 * i + 1) * size);
+    }
+    return send(opcode, format, operands, 2 * count * size);
+}
+
+int32_t CalcClient::send_eval(const char* expression, CalcOperandFormat format) {
+    size_t length = strlen(expression);
+    if (length > CALC_FRAME_PAYLOAD_MAX - CALC_REQUEST_HEADER) {
+        return -1;
+    }
+    return send(CALC_OP_EVAL, format, (const uint8_t*)expression, length);
+}
+
+int32_t CalcClient::send_ping() {
+    return send(CALC_OP_PING, CALC_FORMAT_F64, nullptr, 0);
+}
+
+void CalcClient::receive(const uint8_t* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        if (decoder.push(data[i]) != CALC_FRAME_READY) {
+            continue;
+        }
+        CalcResponse response;
+        if (parse(decoder.payload(), decoder.payload_length(), response)) {
+            responses.push_back(response);
+            if (in_flight > 0) {
+                in_flight--;
+            }
+        }
+        decoder.release();
+    }
+}
+
+bool CalcClient::next_response(CalcResponse& response) {
+    if (responses.empty()) {
+        return false;
+    }
+    response = responses.front();
+    responses.pop_front();
+    return true;
+}
+
+// Private helper methods
+int32_t CalcClient::send(CalcOpcode opcode, CalcOperandFormat format, const uint8_t* operands, size_t length) {
+    uint8_t payload[CALC_FRAME_PAYLOAD_MAX];
+    uint8_t frame[CALC_FRAME_MAX];
+    uint16_t id = next_id++;
+    payload[0] = opcode;
+    payload[1] = format;
+    payload[2] = (uint8_t)id;
+    payload[3] = (uint8_t)(id >> 8);
+    if (length != 0) {
+        memcpy(payload + CALC_REQUEST_HEADER, operands, length);
+    }
+    size_t frame_length = calc_frame_encode(payload, CALC_REQUEST_HEADER + length, frame, sizeof(frame));
+    if (frame_length == 0) {
+        return -1;
+    }
+    writer(frame, frame_length, writer_context);
+    sent_bytes += frame_length;
+    in_flight++;
+    return id;
+}
+
+bool CalcClient::parse(const uint8_t* payload, size_t length, CalcResponse& response) {
+    if (length < CALC_RESPONSE_HEADER || (payload[0] & CALC_RESPONSE_FLAG) == 0) {
+        return false;
+    }
+    response.opcode = (CalcOpcode)(payload[0] & ~CALC_RESPONSE_FLAG);
+    response.format = (CalcOperandFormat)payload[1];
+    response.request_id = (uint16_t)(payload[2] | (payload[3] << 8));
+    response.status = (CalcFrameStatus)payload[4];
+    response.error = CALC_ERROR_NONE;
+    const uint8_t* body = payload + CALC_RESPONSE_HEADER;
+    size_t body_length = length - CALC_RESPONSE_HEADER;
+
+    if (response.status == CALC_STATUS_CALC_ERROR) {
+        response.error = body_length > 0 ? (CalcError)body[0] : CALC_ERROR_SYNTAX;
+        return true;
+    }
+    size_t size = calc_operand_size(response.format);
+    if (size == 0) {
+        return true;    // Format rejected: no results
+    }
+    // Lane errors: the results, then one status byte per result
+    size_t count = response.status == CALC_STATUS_LANE_ERRORS ? body_length / (size + 1) : body_length / size;
+    for (size_t i = 0; i < count; i++) {
+        response.results.push_back(calc_operand_get(response.format, body + i * size));
+    }
+    if (response.status == CALC_STATUS_LANE_ERRORS) {
+        response.lane_status.assign(body + count * size, body + count * (size + 1));
+    }
+    return true;
+}
@@ -0,0 +1,74 @@
+/**
+  ******************************************************************************
+  * @file           : calc_client.h
+  * @brief          : Host-side client of the binary calculation protocol
+  * @author         : STM32 Calculator Project
+  * @date           : 2024
+  ******************************************************************************
+  *
+  * Host only. Builds request frames (calc_protocol.h) and hands them to a
+  * transport, and turns the bytes read back into responses. Requests can
+  * be pipelined: responses carry the request id and come back in order.
+  * Bytes outside frames (text the firmware prints) are skipped.
+  */
+
+#ifndef __CALC_CLIENT_H
+#define __CALC_CLIENT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include "calc_protocol.h"
+
+struct CalcResponse {
+    uint16_t request_id;
+    CalcOpcode opcode;                  // Of the request
+    CalcOperandFormat format;
+    CalcFrameStatus status;
+    std::vector<double> results;
+    std::vector<uint8_t> lane_status;   // CALC_STATUS_LANE_ERRORS: one per result
+    CalcError error;                    // CALC_STATUS_CALC_ERROR
+};
+
+class CalcClient {
+public:
+    // Sends bytes to the device; the client does not wait for them to leave
+    typedef void (*Writer)(const uint8_t* data, size_t length, void* context);
+
+    // Constructor
+    CalcClient(Writer write, void* context);
+
+    // Each returns the request id, which wraps at 65536. A batch takes at
+    // most calc_batch_lanes_max(format) pairs; longer ones are not sent
+    // and return -1
+    int32_t send_batch(CalcOpcode opcode, CalcOperandFormat format,
+                       const double* a, const double* b, size_t count);
+    int32_t send_eval(const char* expression, CalcOperandFormat format);
+    int32_t send_ping();
+
+    // Bytes read from the device, any amount at a time
+    void receive(const uint8_t* data, size_t length);
+    bool next_response(CalcResponse& response);
+
+    // Requests sent and not answered yet
+    size_t pending() const { return in_flight; }
+    size_t bytes_sent() const { return sent_bytes; }
+    CalcFrameStats get_frame_stats() const { return decoder.get_stats(); }
+
+private:
+    // Private member variables
+    Writer writer;
+    void* writer_context;
+    uint16_t next_id;
+    size_t in_flight;
+    size_t sent_bytes;
+    CalcFrameDecoder decoder;
+    std::deque<CalcResponse> responses;
+
+    // Private helper methods
+    int32_t send(CalcOpcode opcode, CalcOperandFormat format, const uint8_t* operands, size_t length);
+    bool parse(const uint8_t* payload, size_t length, CalcResponse& response);
+};
+
+#endif // __CALC_CLIENT_H
@@ -0,0 +1,657 @@
+/**
+  ******************************************************************************
+  * @file           : calc_server.cpp
+  * @brief          : Calculator engine served over TCP and Unix domain sockets
+  * @author         : STM32 Calculator Project
+  * @date           : 2024
+  ******************************************************************************
+  *
+  * Host only (Linux). Runs the Calculator as a long-lived service. Every
+  * connection gets its own Calculator, so memory registers stay per client,
+  * and speaks the device's UART protocols: text lines (an expression or one
+  * of the commands below) answered " = <value>" or "ERROR: <text>", and
+  * binary frames from calc_protocol.h, told apart by the sync byte.
+  * Requests may be pipelined; replies come back in order.
+  *
+  * The main thread accepts connections and hands them round-robin to the
+  * workers. Each worker runs its own epoll loop over its connections, so a
+  * session is only ever touched by one thread and needs no locking.
+  *
+  * Text commands: MS, M+, M- (memory from the last result), MR, MC, PING,
+  * QUIT, and STATS: percentiles of the read-to-reply latency of every
+  * request so far, from HDR-style histograms kept per worker.
+  *
+  * Usage: calc_server [--tcp port] [--unix path] [--workers n]
+  */
+
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include "calculator.h"
+#include "calc_protocol.h"
+#include "number_format.h"
+
+// Text lines longer than this are answered with an error and skipped
+static const size_t LINE_MAX_BYTES = 1024;
+
+// Replies a client has not read yet; past this its requests wait unread
+static const size_t OUTPUT_HIGH_WATER = 64 * 1024;
+
+// Bytes read per readable event, so one busy client cannot starve the rest
+static const size_t READ_BUDGET = 64 * 1024;
+static const size_t READ_CHUNK = 16 * 1024;
+
+static const int EVENTS_PER_WAIT = 256;
+static const int WAIT_TIMEOUT_MS = 200;     // Checks for shutdown in between
+
+static std::atomic<bool> stopping(false);
+
+static uint64_t now_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+  * Log-linear histogram in the style of HdrHistogram: exact below 128 ns,
+  * then 64 sub-buckets per power of two, so every value is kept to within
+  * 1.6%. One thread records; any thread may read.
+  */
+class LatencyHistogram {
+public:
+    static const int SUB_BITS = 6;
+    static const size_t BUCKETS = (64 - SUB_BITS - 1) * (1u << SUB_BITS) + (2u << SUB_BITS);
+
+    // Constructor
+    LatencyHistogram() : counts() {
+    }
+
+    void record(uint64_t value) {
+        std::atomic<uint64_t>& count = counts[index(value)];
+        count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    void add_to(std::vector<uint64_t>& totals) const {
+        for (size_t i = 0; i < BUCKETS; i++) {
+            totals[i] += counts[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    static size_t index(uint64_t value) {
+        if (value < (2u << SUB_BITS)) {
+            return (size_t)value;
+        }
+        // The top SUB_BITS + 1 bits of the value
+        int shift = 63 - __builtin_clzll(value) - SUB_BITS;
+        return (size_t)shift * (1u << SUB_BITS) + (size_t)(value >> shift);
+    }
+
+    // Largest value that lands in bucket i
+    static uint64_t highest(size_t i) {
+        if (i < (2u << SUB_BITS)) {
+            return i;
+        }
+        int shift = (int)(i >> SUB_BITS) - 1;
+        uint64_t top = i - ((size_t)shift << SUB_BITS);
+        return (top << shift) + ((uint64_t)1 << shift) - 1;
+    }
+
+private:
+    std::atomic<uint64_t> counts[BUCKETS];
+};
+
+struct Session {
+    int fd;
+    uint32_t events;                // Registered with epoll
+    bool closing;                   // QUIT: close once the replies are out
+    bool discarding;                // Rest of a line too long to keep
+    Calculator calculator;
+    CalcFrameDecoder decoder;
+    std::vector<uint8_t> input;
+    size_t input_used;              // Front of input already handled
+    std::string output;
+    size_t output_sent;
+};
+
+class Worker;
+static std::vector<Worker*> workers;
+
+static void write_stats(std::string& out);
+
+class Worker {
+public:
+    // Constructor
+    Worker()
+        : connections(0)
+        , requests(0)
+        , latency()
+        , epoll_fd(-1)
+        , wake_fd(-1)
+        , handoff_lock()
+        , handoff()
+        , thread() {
+    }
+
+    bool start() {
+        epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (epoll_fd < 0 || wake_fd < 0) {
+            return false;
+        }
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.ptr = nullptr;   // The wake-up eventfd
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &event) != 0) {
+            return false;
+        }
+        thread = std::thread(&Worker::run, this);
+        return true;
+    }
+
+    // From the accepting thread: the worker owns fd from here on
+    void hand_over(int fd) {
+        {
+            std::lock_guard<std::mutex> guard(handoff_lock);
+            handoff.push_back(fd);
+        }
+        uint64_t one = 1;
+        ssize_t written = write(wake_fd, &one, sizeof(one));
+        (void)written;
+    }
+
+    void join() {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+
+    std::atomic<uint32_t> connections;
+    std::atomic<uint64_t> requests;
+    LatencyHistogram latency;
+
+private:
+    int epoll_fd;
+    int wake_fd;
+    std::mutex handoff_lock;
+    std::vector<int> handoff;
+    std::thread thread;
+    uint8_t frame_reply[CALC_FRAME_MAX];
+
+    void run() {
+        epoll_event events[EVENTS_PER_WAIT];
+        while (!stopping.load(std::memory_order_relaxed)) {
+            int count = epoll_wait(epoll_fd, events, EVENTS_PER_WAIT, WAIT_TIMEOUT_MS);
+            for (int i = 0; i < count; i++) {
+                Session* session = static_cast<Session*>(events[i].data.ptr);
+                if (session == nullptr) {
+                    accept_handoffs();
+                    continue;
+                }
+                uint32_t ready = events[i].events;
+                bool open = true;
+                if (ready & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                    open = on_readable(session);
+                }
+                if (open && (ready & EPOLLOUT)) {
+                    open = flush(session);
+                }
+                if (open) {
+                    open = update_events(session);
+                }
+                if (!open) {
+                    close_session(session);
+                }
+            }
+        }
+        close(epoll_fd);
+        close(wake_fd);
+    }
+
+    void accept_handoffs() {
+        uint64_t wakes;
+        ssize_t got = read(wake_fd, &wakes, sizeof(wakes));
+        (void)got;
+        std::vector<int> fds;
+        {
+            std::lock_guard<std::mutex> guard(handoff_lock);
+            fds.swap(handoff);
+        }
+        for (size_t i = 0; i < fds.size(); i++) {
+            Session* session = new Session();
+            session->fd = fds[i];
+            session->events = EPOLLIN | EPOLLRDHUP;
+            session->closing = false;
+            session->discarding = false;
+            session->input_used = 0;
+            session->output_sent = 0;
+            epoll_event event = {};
+            event.events = session->events;
+            event.data.ptr = session;
+            if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, session->fd, &event) != 0) {
+                close(session->fd);
+                delete session;
+                continue;
+            }
+            connections.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void close_session(Session* session) {
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, session->fd, nullptr);
+        close(session->fd);
+        delete session;
+        connections.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // Reads what has arrived and answers every complete request in it;
+    // false when the connection is done
+    bool on_readable(Session* session) {
+        if (session->output.size() - session->output_sent >= OUTPUT_HIGH_WATER) {
+            return true;    // Hang-up seen while stalled: flush() finds out
+        }
+        bool peer_closed = false;
+        size_t budget = READ_BUDGET;
+        while (budget > 0) {
+            size_t used = session->input.size();
+            session->input.resize(used + READ_CHUNK);
+            ssize_t got = read(session->fd, &session->input[used], READ_CHUNK);
+            session->input.resize(used + (got > 0 ? (size_t)got : 0));
+            if (got > 0) {
+                budget -= got < (ssize_t)budget ? (size_t)got : budget;
+                continue;
+            }
+            if (got == 0) {
+                peer_closed = true;
+            } else if (errno == EINTR) {
+                continue;
+            } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                return false;
+            }
+            break;
+        }
+        process(session, now_ns());
+        if (!flush(session)) {
+            return false;
+        }
+        // A half-closed client still gets its replies
+        return !peer_closed || session->output_sent < session->output.size();
+    }
+
+    void process(Session* session, uint64_t read_ns) {
+        const uint8_t* data = session->input.data();
+        size_t length = session->input.size();
+        size_t pos = session->input_used;
+        while (pos < length && !session->closing) {
+            CalcFrameDecoder& decoder = session->decoder;
+            if (!session->discarding && (decoder.in_frame() || data[pos] == CALC_FRAME_SYNC)) {
+                do {
+                    decoder.push(data[pos++]);
+                } while (pos < length && decoder.in_frame() && !decoder.is_ready());
+                if (decoder.is_ready()) {
+                    size_t reply = calc_protocol_serve(session->calculator, decoder.payload(),
+                                                       decoder.payload_length(), frame_reply, sizeof(frame_reply));
+                    decoder.release();
+                    session->output.append((const char*)frame_reply, reply);
+                    finish_request(read_ns);
+                }
+                continue;
+            }
+            if (!session->discarding && (data[pos] & 0x80) != 0) {
+                pos++;      // Not text, not a frame: noise
+                continue;
+            }
+            const uint8_t* newline = (const uint8_t*)memchr(data + pos, '\n', length - pos);
+            if (newline == nullptr) {
+                if (length - pos > LINE_MAX_BYTES && !session->discarding) {
+                    session->output += "ERROR: Line too long\r\n";
+                    finish_request(read_ns);
+                    session->discarding = true;
+                }
+                if (session->discarding) {
+                    pos = length;
+                }
+                break;
+            }
+            size_t end = newline - data;
+            if (session->discarding) {
+                session->discarding = false;
+            } else {
+                size_t line_end = end > pos && data[end - 1] == '\r' ? end - 1 : end;
+                if (line_end - pos > LINE_MAX_BYTES) {
+                    session->output += "ERROR: Line too long\r\n";
+                    finish_request(read_ns);
+                } else if (line_end > pos) {
+                    handle_line(session, std::string((const char*)data + pos, line_end - pos));
+                    finish_request(read_ns);
+                }
+            }
+            pos = end + 1;
+        }
+        // Keep only the unhandled tail
+        if (pos == length) {
+            session->input.clear();
+            pos = 0;
+        } else if (pos > READ_CHUNK) {
+            session->input.erase(session->input.begin(), session->input.begin() + pos);
+            pos = 0;
+        }
+        session->input_used = pos;
+    }
+
+    void finish_request(uint64_t read_ns) {
+        latency.record(now_ns() - read_ns);
+        requests.store(requests.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    void handle_line(Session* session, const std::string& line) {
+        Calculator& calculator = session->calculator;
+        std::string& out = session->output;
+        if (line == "PING") {
+            out += "PONG\r\n";
+        } else if (line == "MS") {
+            calculator.memory_store(calculator.get_last_result());
+            out += "OK\r\n";
+        } else if (line == "M+") {
+            calculator.memory_add(calculator.get_last_result());
+            out += "OK\r\n";
+        } else if (line == "M-") {
+            calculator.memory_subtract(calculator.get_last_result());
+            out += "OK\r\n";
+        } else if (line == "MC") {
+            calculator.memory_clear();
+            out += "OK\r\n";
+        } else if (line == "MR") {
+            append_result(out, calculator.memory_recall());
+        } else if (line == "STATS") {
+            write_stats(out);
+        } else if (line == "QUIT") {
+            out += "BYE\r\n";
+            session->closing = true;
+        } else {
+            calc_value_t result = calculator.evaluate(line.c_str());
+            if (calculator.is_error()) {
+                out += "ERROR: ";
+                out += calculator.get_last_error();
+                out += "\r\n";
+            } else {
+                append_result(out, result);
+            }
+        }
+    }
+
+    // As Display::print_result() on the UART
+    static void append_result(std::string& out, calc_value_t value) {
+        char number[NUMBER_FORMAT_MAX];
+        number_format_shortest(CalcNum::to_double(value), number, sizeof(number));
+        out += " = ";
+        out += number;
+        out += "\r\n";
+    }
+
+    // Sends what the socket takes; false when the connection is done
+    bool flush(Session* session) {
+        while (session->output_sent < session->output.size()) {
+            ssize_t sent = send(session->fd, session->output.data() + session->output_sent,
+                                session->output.size() - session->output_sent, MSG_NOSIGNAL);
+            if (sent > 0) {
+                session->output_sent += (size_t)sent;
+            } else if (sent < 0 && errno == EINTR) {
+                continue;
+            } else if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                return true;
+            } else {
+                return false;
+            }
+        }
+        session->output.clear();
+        session->output_sent = 0;
+        return !session->closing;
+    }
+
+    // Reads only while the client keeps up with its replies
+    bool update_events(Session* session) {
+        size_t unsent = session->output.size() - session->output_sent;
+        uint32_t wanted = 0;
+        if (unsent < OUTPUT_HIGH_WATER) {
+            wanted |= EPOLLIN | EPOLLRDHUP;
+        }
+        if (unsent > 0) {
+            wanted |= EPOLLOUT;
+        }
+        if (wanted == session->events) {
+            return true;
+        }
+        epoll_event event = {};
+        event.events = wanted;
+        event.data.ptr = session;
+        session->events = wanted;
+        return epoll_ctl(epoll_fd, EPOLL_CTL_MOD, session->fd, &event) == 0;
+    }
+};
+
+// Merged over the workers, as HdrHistogram prints a percentile distribution
+static void write_stats(std::string& out) {
+    std::vector<uint64_t> totals(LatencyHistogram::BUCKETS, 0);
+    uint64_t connections = 0;
+    uint64_t requests = 0;
+    for (size_t i = 0; i < workers.size(); i++) {
+        workers[i]->latency.add_to(totals);
+        connections += workers[i]->connections.load(std::memory_order_relaxed);
+        requests += workers[i]->requests.load(std::memory_order_relaxed);
+    }
+    uint64_t recorded = 0;
+    for (size_t i = 0; i < totals.size(); i++) {
+        recorded += totals[i];
+    }
+
+    char line[96];
+    snprintf(line, sizeof(line), "STATS workers=%u connections=%llu requests=%llu\r\n",
+             (unsigned)workers.size(), (unsigned long long)connections, (unsigned long long)requests);
+    out += line;
+    out += "   Value(us)   Percentile   TotalCount\r\n";
+    static const double percentiles[] = {0.5, 0.75, 0.9, 0.99, 0.999, 0.9999, 1.0};
+    size_t bucket = 0;
+    uint64_t seen = 0;
+    for (size_t p = 0; p < sizeof(percentiles) / sizeof(percentiles[0]) && recorded > 0; p++) {
+        uint64_t target = (uint64_t)(percentiles[p] * recorded + 0.5);
+        if (target == 0) {
+            target = 1;
+        }
+        while (bucket < totals.size() && seen + totals[bucket] < target) {
+            seen += totals[bucket++];
+        }
+        if (bucket == totals.size()) {
+            break;
+        }
+        snprintf(line, sizeof(line), "%12.3f %12.6f %12llu\r\n",
+                 LatencyHistogram::highest(bucket) / 1000.0, percentiles[p],
+                 (unsigned long long)(seen + totals[bucket]));
+        out += line;
+    }
+    out += "END\r\n";
+}
+
+static void on_signal(int signal_number) {
+    (void)signal_number;
+    stopping.store(true);
+}
+
+static int listen_tcp(uint16_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, (sockaddr*)&address, sizeof(address)) != 0 || listen(fd, SOMAXCONN) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int listen_unix(const char* path) {
+    sockaddr_un address = {};
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+    unlink(path);
+    if (bind(fd, (sockaddr*)&address, sizeof(address)) != 0 || listen(fd, SOMAXCONN) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Every connection is a descriptor: take all the kernel allows
+static void raise_fd_limit() {
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+int main(int argc, char** argv) {
+    int tcp_port = -1;
+    const char* unix_path = nullptr;
+    unsigned worker_count = std::thread::hardware_concurrency();
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--tcp") == 0 && i + 1 < argc) {
+            tcp_port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--unix") == 0 && i + 1 < argc) {
+            unix_path = argv[++i];
+        } else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            worker_count = (unsigned)strtoul(argv[++i], nullptr, 10);
+        } else {
+            fprintf(stderr, "usage: %s [--tcp port] [--unix path] [--workers n]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (tcp_port < 0 && unix_path == nullptr) {
+        tcp_port = 7878;
+    }
+    if (worker_count == 0) {
+        worker_count = 1;
+    }
+
+    raise_fd_limit();
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    calc_batch_active_isa();    // Pick the batch kernels before the workers race to
+
+    std::vector<int> listeners;
+    if (tcp_port >= 0) {
+        int fd = listen_tcp((uint16_t)tcp_port);
+        if (fd < 0) {
+            fprintf(stderr, "cannot listen on 127.0.0.1:%d: %s\n", tcp_port, strerror(errno));
+            return 1;
+        }
+        listeners.push_back(fd);
+    }
+    if (unix_path != nullptr) {
+        int fd = listen_unix(unix_path);
+        if (fd < 0) {
+            fprintf(stderr, "cannot listen on %s: %s\n", unix_path, strerror(errno));
+            return 1;
+        }
+        listeners.push_back(fd);
+    }
+
+    for (unsigned i = 0; i < worker_count; i++) {
+        Worker* worker = new Worker();
+        if (!worker->start()) {
+            fprintf(stderr, "cannot start worker: %s\n", strerror(errno));
+            return 1;
+        }
+        workers.push_back(worker);
+    }
+
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    for (size_t i = 0; i < listeners.size(); i++) {
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.fd = listeners[i];
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listeners[i], &event);
+    }
+    printf("calc_server: %u workers", worker_count);
+    if (tcp_port >= 0) {
+        printf(", tcp 127.0.0.1:%d", tcp_port);
+    }
+    if (unix_path != nullptr) {
+        printf(", unix %s", unix_path);
+    }
+    printf("\n");
+    fflush(stdout);
+
+    size_t next_worker = 0;
+    uint64_t accepted = 0;
+    epoll_event events[16];
+    while (!stopping.load()) {
+        int count = epoll_wait(epoll_fd, events, 16, WAIT_TIMEOUT_MS);
+        for (int i = 0; i < count; i++) {
+            int listener = events[i].data.fd;
+            for (;;) {
+                int fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if (fd < 0) {
+                    if (errno == EMFILE || errno == ENFILE) {
+                        // Out of descriptors: the backlog waits for closes
+                        fprintf(stderr, "calc_server: %s\n", strerror(errno));
+                        usleep(10000);
+                    }
+                    break;
+                }
+                if (listener == listeners[0] && tcp_port >= 0) {
+                    int on = 1;
+                    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+                }
+                workers[next_worker]->hand_over(fd);
+                next_worker = (next_worker + 1) % workers.size();
+                accepted++;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < workers.size(); i++) {
+        workers[i]->join();
+    }
+    for (size_t i = 0; i < listeners.size(); i++) {
+        close(listeners[i]);
+    }
+    if (unix_path != nullptr) {
+        unlink(unix_path);
+    }
+    std::string stats;
+    write_stats(stats);
+    printf("calc_server: %llu connections served\n%s", (unsigned long long)accepted, stats.c_str());
+    return 0;
+}
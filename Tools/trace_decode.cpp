@@ -0,0 +1,384 @@
+/**
+  ******************************************************************************
+  * @file           : trace_decode.cpp
+  * @brief          : Key-to-display latency report from a trace dump
+  * @author         : STM32 Calculator Project
+  * @date           : 2024
+  ******************************************************************************
+  *
+  * Host only. Reads the text written by trace_dump() (a serial console log
+  * is fine: other lines are skipped), follows each key stroke from detection
+  * through debounce, dispatch and process_input to the end of its display
+  * update, and prints per-stage percentiles and an end-to-end histogram for
+  * every dump in the input.
+  *
+  * A stroke's UART output is done when the transfer started after its last
+  * queued text has finished; its LCD output when the next refresh that
+  * writes cells has returned.
+  *
+  * Usage: trace_decode [--events] [dump file]     (stdin without a file)
+  */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "trace.h"
+
+// Repeated detections of one key within this window are contact bounce
+static const double BOUNCE_WINDOW_US = 50000;
+
+// Strokes still waiting for output; older ones are given up
+static const size_t MAX_OPEN_STROKES = 64;
+
+struct Event {
+    uint64_t time;              // Counter ticks, unwrapped
+    uint16_t arg;
+    uint8_t id;
+};
+
+struct Dump {
+    uint32_t hz;
+    uint32_t lost;
+    std::vector<Event> events;
+};
+
+struct Stroke {
+    uint16_t key;
+    bool has_detect;
+    bool has_debounced;
+    bool has_calc;
+    bool uart_queued;           // Text queued since the last transfer start
+    bool uart_started;          // A transfer carrying its text is in flight
+    uint64_t detect;
+    uint64_t debounced;
+    uint64_t dispatch;
+    uint64_t calc_done;
+    uint64_t done;
+};
+
+static bool parse_hex_record(const char* text, uint8_t* bytes) {
+    for (size_t i = 0; i < sizeof(TraceRecord); i++) {
+        char pair[3] = {text[2 * i], text[2 * i + 1], '\0'};
+        char* end;
+        unsigned long value = strtoul(pair, &end, 16);
+        if (end != pair + 2) {
+            return false;
+        }
+        bytes[i] = (uint8_t)value;
+    }
+    return true;
+}
+
+// Every "TRACE v1" ... "TRACE END" block, timestamps unwrapped
+static std::vector<Dump> read_dumps(FILE* file) {
+    std::vector<Dump> dumps;
+    char line[512];
+    bool inside = false;
+    uint32_t last_stamp = 0;
+    while (fgets(line, sizeof(line), file) != nullptr) {
+        unsigned long hz, records, lost;
+        if (sscanf(line, "TRACE v1 hz=%lu records=%lu lost=%lu", &hz, &records, &lost) == 3) {
+            Dump dump;
+            dump.hz = (uint32_t)hz;
+            dump.lost = (uint32_t)lost;
+            dumps.push_back(dump);
+            inside = true;
+            continue;
+        }
+        if (!inside) {
+            continue;
+        }
+        if (strncmp(line, "TRACE END", 9) == 0) {
+            inside = false;
+            continue;
+        }
+        Dump& dump = dumps.back();
+        const char* cursor = line;
+        while (*cursor != '\0') {
+            while (*cursor == ' ') {
+                cursor++;
+            }
+            uint8_t bytes[sizeof(TraceRecord)];
+            if (strlen(cursor) < 2 * sizeof(TraceRecord) || !parse_hex_record(cursor, bytes)) {
+                break;
+            }
+            cursor += 2 * sizeof(TraceRecord);
+            // Little-endian TraceRecord: timestamp, arg, event, reserved
+            uint32_t stamp = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+            Event event;
+            event.arg = (uint16_t)(bytes[4] | (bytes[5] << 8));
+            event.id = bytes[6];
+            // Slots are claimed before the stamp is read, so neighbours
+            // from different contexts may be a little out of order
+            if (dump.events.empty()) {
+                event.time = stamp;
+            } else {
+                event.time = dump.events.back().time + (int64_t)(int32_t)(stamp - last_stamp);
+            }
+            last_stamp = stamp;
+            dump.events.push_back(event);
+        }
+    }
+    return dumps;
+}
+
+static void print_events(const Dump& dump) {
+    uint64_t start = dump.events.empty() ? 0 : dump.events.front().time;
+    for (size_t i = 0; i < dump.events.size(); i++) {
+        const Event& event = dump.events[i];
+        double us = (double)(int64_t)(event.time - start) * 1e6 / dump.hz;
+        printf("%14.3f us  %-14s %u\n", us, trace_event_name((TraceEvent)event.id), (unsigned)event.arg);
+    }
+}
+
+// Follows the strokes through the events; finished ones are appended
+static void collect_strokes(const Dump& dump, std::vector<Stroke>& finished, size_t& unfinished) {
+    std::vector<Stroke> open;
+    bool armed_detect = false, armed_debounced = false;
+    uint16_t armed_key = 0;
+    uint64_t detect_time = 0, debounced_time = 0;
+    uint64_t bounce_ticks = (uint64_t)(BOUNCE_WINDOW_US * dump.hz / 1e6);
+    unfinished = 0;
+
+    for (size_t i = 0; i < dump.events.size(); i++) {
+        const Event& event = dump.events[i];
+        switch (event.id) {
+            case TRACE_KEY_DETECT:
+                // The first detection of a burst counts; a different key or a
+                // detection after the bounce window starts a new burst
+                if (!armed_detect || event.arg != armed_key || event.time - detect_time > bounce_ticks) {
+                    armed_detect = true;
+                    armed_key = event.arg;
+                    detect_time = event.time;
+                }
+                break;
+
+            case TRACE_KEY_DEBOUNCED:
+                if (!armed_debounced) {
+                    armed_debounced = true;
+                    debounced_time = event.time;
+                }
+                break;
+
+            case TRACE_KEY_DISPATCH: {
+                Stroke stroke;
+                memset(&stroke, 0, sizeof(stroke));
+                stroke.key = event.arg;
+                stroke.dispatch = event.time;
+                // Keys typed on the UART have no detection
+                if (armed_detect && armed_key == event.arg) {
+                    stroke.has_detect = true;
+                    stroke.detect = detect_time;
+                }
+                if (armed_debounced) {
+                    stroke.has_debounced = true;
+                    stroke.debounced = debounced_time;
+                }
+                armed_detect = armed_debounced = false;
+                if (open.size() == MAX_OPEN_STROKES) {
+                    open.erase(open.begin());
+                    unfinished++;
+                }
+                open.push_back(stroke);
+                break;
+            }
+
+            case TRACE_CALC_DONE:
+                if (!open.empty() && !open.back().has_calc) {
+                    open.back().has_calc = true;
+                    open.back().calc_done = event.time;
+                }
+                break;
+
+            case TRACE_UART_SEND:
+                // Text before the first key (welcome, dumps) belongs to no stroke
+                if (!open.empty()) {
+                    open.back().uart_queued = true;
+                    open.back().uart_started = false;
+                }
+                break;
+
+            case TRACE_UART_TX_START:
+                for (size_t s = 0; s < open.size(); s++) {
+                    if (open[s].uart_queued) {
+                        open[s].uart_queued = false;
+                        open[s].uart_started = true;
+                    }
+                }
+                break;
+
+            case TRACE_UART_TX_DONE:
+            case TRACE_LCD_REFRESH:
+                for (size_t s = 0; s < open.size();) {
+                    Stroke& stroke = open[s];
+                    bool done = event.id == TRACE_UART_TX_DONE
+                        ? stroke.uart_started && !stroke.uart_queued
+                        : !stroke.uart_started && !stroke.uart_queued;
+                    if (done) {
+                        stroke.done = event.time;
+                        finished.push_back(stroke);
+                        open.erase(open.begin() + s);
+                    } else {
+                        s++;
+                    }
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+    unfinished += open.size();
+}
+
+struct Stage {
+    const char* name;
+    std::vector<double> us;
+};
+
+static double percentile(const std::vector<double>& sorted, double fraction) {
+    size_t rank = (size_t)(fraction * sorted.size() + 0.5);
+    rank = std::min(std::max(rank, (size_t)1), sorted.size());
+    return sorted[rank - 1];
+}
+
+static void print_stage(Stage& stage) {
+    if (stage.us.empty()) {
+        printf("  %-30s %8s\n", stage.name, "-");
+        return;
+    }
+    std::sort(stage.us.begin(), stage.us.end());
+    printf("  %-30s %8u %12.1f %12.1f %12.1f %12.1f\n", stage.name, (unsigned)stage.us.size(),
+           percentile(stage.us, 0.50), percentile(stage.us, 0.90),
+           percentile(stage.us, 0.99), stage.us.back());
+}
+
+// Power-of-two microsecond buckets
+static void print_histogram(const std::vector<double>& us) {
+    if (us.empty()) {
+        return;
+    }
+    std::vector<uint32_t> buckets;
+    for (size_t i = 0; i < us.size(); i++) {
+        size_t bucket = 0;
+        while (bucket < 40 && us[i] >= (double)(1ull << (bucket + 1))) {
+            bucket++;
+        }
+        if (buckets.size() <= bucket) {
+            buckets.resize(bucket + 1, 0);
+        }
+        buckets[bucket]++;
+    }
+    uint32_t largest = *std::max_element(buckets.begin(), buckets.end());
+    size_t first = 0;
+    while (buckets[first] == 0) {
+        first++;
+    }
+    for (size_t bucket = first; bucket < buckets.size(); bucket++) {
+        unsigned bar = (unsigned)(buckets[bucket] * 50ull / largest);
+        printf("  %9llu .. %9llu us %7u ", bucket == 0 ? 0ull : 1ull << bucket, 1ull << (bucket + 1),
+               (unsigned)buckets[bucket]);
+        for (unsigned i = 0; i < bar; i++) {
+            putchar('#');
+        }
+        putchar('\n');
+    }
+}
+
+static void report(const Dump& dump, size_t index) {
+    std::vector<Stroke> strokes;
+    size_t unfinished;
+    collect_strokes(dump, strokes, unfinished);
+    printf("Dump %u: %u records (%u lost), counter %u Hz, %u strokes (%u without output)\n",
+           (unsigned)index, (unsigned)dump.events.size(), (unsigned)dump.lost, (unsigned)dump.hz,
+           (unsigned)strokes.size(), (unsigned)unfinished);
+    if (dump.lost != 0) {
+        printf("  (the ring overwrote its oldest records; the first strokes may lack their detection)\n");
+    }
+
+    double us_per_tick = 1e6 / dump.hz;
+    Stage detect_debounce = {"detect -> debounced", {}};
+    Stage to_dispatch = {"accepted -> dispatch", {}};
+    Stage calculate = {"dispatch -> calc done", {}};
+    Stage output = {"calc done -> output done", {}};
+    Stage dispatch_done = {"dispatch -> output done", {}};
+    Stage end_to_end = {"detect -> output done", {}};
+    for (size_t i = 0; i < strokes.size(); i++) {
+        const Stroke& s = strokes[i];
+        // Accepted: debounced in timer mode, detected in the other modes
+        uint64_t accepted = s.has_debounced ? s.debounced : s.detect;
+        if (s.has_detect && s.has_debounced) {
+            detect_debounce.us.push_back((double)(int64_t)(s.debounced - s.detect) * us_per_tick);
+        }
+        if (s.has_detect || s.has_debounced) {
+            to_dispatch.us.push_back((double)(int64_t)(s.dispatch - accepted) * us_per_tick);
+        }
+        if (s.has_calc) {
+            calculate.us.push_back((double)(int64_t)(s.calc_done - s.dispatch) * us_per_tick);
+            output.us.push_back((double)(int64_t)(s.done - s.calc_done) * us_per_tick);
+        }
+        dispatch_done.us.push_back((double)(int64_t)(s.done - s.dispatch) * us_per_tick);
+        if (s.has_detect) {
+            end_to_end.us.push_back((double)(int64_t)(s.done - s.detect) * us_per_tick);
+        }
+    }
+
+    printf("  %-30s %8s %12s %12s %12s %12s\n", "stage", "strokes", "p50 us", "p90 us", "p99 us", "max us");
+    print_stage(detect_debounce);
+    print_stage(to_dispatch);
+    print_stage(calculate);
+    print_stage(output);
+    print_stage(dispatch_done);
+    print_stage(end_to_end);
+
+    const Stage& shown = end_to_end.us.empty() ? dispatch_done : end_to_end;
+    if (!shown.us.empty()) {
+        printf("  Histogram, %s:\n", shown.name);
+        print_histogram(shown.us);
+    }
+}
+
+int main(int argc, char** argv) {
+    bool list_events = false;
+    const char* path = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--events") == 0) {
+            list_events = true;
+        } else if (path == nullptr && argv[i][0] != '-') {
+            path = argv[i];
+        } else {
+            fprintf(stderr, "usage: %s [--events] [dump file]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    FILE* file = path != nullptr ? fopen(path, "r") : stdin;
+    if (file == nullptr) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return 1;
+    }
+    std::vector<Dump> dumps = read_dumps(file);
+    if (file != stdin) {
+        fclose(file);
+    }
+    if (dumps.empty()) {
+        fprintf(stderr, "no trace dump found\n");
+        return 1;
+    }
+
+    for (size_t i = 0; i < dumps.size(); i++) {
+        if (dumps[i].hz == 0) {
+            fprintf(stderr, "dump %u: counter rate is 0\n", (unsigned)(i + 1));
+            return 1;
+        }
+        if (list_events) {
+            print_events(dumps[i]);
+        }
+        report(dumps[i], i + 1);
+    }
+    return 0;
+}
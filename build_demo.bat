@@ -29,35 +29,133 @@ if not exist build mkdir build
 
 REM Compile source files
 echo Compiling source files...
-g++ -std=c++11 -Wall -Wextra -g -ICore/Inc -c demo.cpp -o build/demo.o
+g++ -std=c++11 -Wall -Wextra -g -DCALC_ENABLE_BIGNUM -DCALC_PROFILE -DCALC_TRACE -ICore/Inc -c demo.cpp -o build/demo.o
 if %errorlevel% neq 0 (
     echo Error compiling demo.cpp
     pause
     exit /b 1
 )
 
-g++ -std=c++11 -Wall -Wextra -g -ICore/Inc -c Core/Src/calculator.cpp -o build/calculator.o
+g++ -std=c++11 -Wall -Wextra -g -DCALC_ENABLE_BIGNUM -DCALC_PROFILE -DCALC_TRACE -ICore/Inc -c Core/Src/calculator.cpp -o build/calculator.o
 if %errorlevel% neq 0 (
     echo Error compiling calculator.cpp
     pause
     exit /b 1
 )
 
-g++ -std=c++11 -Wall -Wextra -g -ICore/Inc -c Core/Src/display.cpp -o build/display.o
+g++ -std=c++11 -Wall -Wextra -g -DCALC_ENABLE_BIGNUM -DCALC_PROFILE -DCALC_TRACE -ICore/Inc -c Core/Src/calc_state.cpp -o build/calc_state.o
+if %errorlevel% neq 0 (
+    echo Error compiling calc_state.cpp
+    pause
+    exit /b 1
+)
+
+g++ -std=c++11 -Wall -Wextra -g -DCALC_ENABLE_BIGNUM -DCALC_PROFILE -DCALC_TRACE -ICore/Inc -c Core/Src/expression.cpp -o build/expression.o
+if %errorlevel% neq 0 (
+    echo Error compiling expression.cpp
+    pause
+    exit /b 1
+)
+
+g++ -std=c++11 -Wall -Wextra -g -DCALC_ENABLE_BIGNUM -DCALC_PROFILE -DCALC_TRACE -ICore/Inc -c Core/Src/calc_batch.cpp -o build/calc_batch.o
+if %errorlevel% neq 0 (
+    echo Error compiling calc_batch.cpp
+    pause
+    exit /b 1
+)
+
+g++ -std=c++11 -Wall -Wextra -g -DCALC_ENABLE_BIGNUM -DCALC_PROFILE -DCALC_TRACE -ICore/Inc -c Core/Src/fixed_point.cpp -o build/fixed_point.o
+if %errorlevel% neq 0 (
+    echo Error compiling fixed_point.cpp
+    pause
+    exit /b 1
+)
+
+g++ -std=c++11 -Wall -Wextra -g -DCALC_ENABLE_BIGNUM -DCALC_PROFILE -DCALC_TRACE -ICore/Inc -c Core/Src/bignum.cpp -o build/bignum.o
+if %errorlevel% neq 0 (
+    echo Error compiling bignum.cpp
+    pause
+    exit /b 1
+)
+
+g++ -std=c++11 -Wall -Wextra -g -DCALC_ENABLE_BIGNUM -DCALC_PROFILE -DCALC_TRACE -ICore/Inc -c Core/Src/number_format.cpp -o build/number_format.o
+if %errorlevel% neq 0 (
+    echo Error compiling number_format.cpp
+    pause
+    exit /b 1
+)
+
+g++ -std=c++11 -Wall -Wextra -g -DCALC_ENABLE_BIGNUM -DCALC_PROFILE -DCALC_TRACE -ICore/Inc -c Core/Src/uart_tx_queue.cpp -o build/uart_tx_queue.o
+if %errorlevel% neq 0 (
+    echo Error compiling uart_tx_queue.cpp
+    pause
+    exit /b 1
+)
+
+g++ -std=c++11 -Wall -Wextra -g -DCALC_ENABLE_BIGNUM -DCALC_PROFILE -DCALC_TRACE -ICore/Inc -c Core/Src/hd44780.cpp -o build/hd44780.o
+if %errorlevel% neq 0 (
+    echo Error compiling hd44780.cpp
+    pause
+    exit /b 1
+)
+
+g++ -std=c++11 -Wall -Wextra -g -DCALC_ENABLE_BIGNUM -DCALC_PROFILE -DCALC_TRACE -ICore/Inc -c Core/Src/display.cpp -o build/display.o
 if %errorlevel% neq 0 (
     echo Error compiling display.cpp
     pause
     exit /b 1
 )
 
-g++ -std=c++11 -Wall -Wextra -g -ICore/Inc -c Core/Src/keypad.cpp -o build/keypad.o
+g++ -std=c++11 -Wall -Wextra -g -DCALC_ENABLE_BIGNUM -DCALC_PROFILE -DCALC_TRACE -ICore/Inc -c Core/Src/keypad.cpp -o build/keypad.o
 if %errorlevel% neq 0 (
     echo Error compiling keypad.cpp
     pause
     exit /b 1
 )
 
-g++ -std=c++11 -Wall -Wextra -g -ICore/Inc -c mock_hal.cpp -o build/mock_hal.o
+g++ -std=c++11 -Wall -Wextra -g -DCALC_ENABLE_BIGNUM -DCALC_PROFILE -DCALC_TRACE -ICore/Inc -c Core/Src/scheduler.cpp -o build/scheduler.o
+if %errorlevel% neq 0 (
+    echo Error compiling scheduler.cpp
+    pause
+    exit /b 1
+)
+
+g++ -std=c++11 -Wall -Wextra -g -DCALC_ENABLE_BIGNUM -DCALC_PROFILE -DCALC_TRACE -ICore/Inc -c Core/Src/profiler.cpp -o build/profiler.o
+if %errorlevel% neq 0 (
+    echo Error compiling profiler.cpp
+    pause
+    exit /b 1
+)
+
+g++ -std=c++11 -Wall -Wextra -g -DCALC_ENABLE_BIGNUM -DCALC_PROFILE -DCALC_TRACE -ICore/Inc -c Core/Src/trace.cpp -o build/trace.o
+if %errorlevel% neq 0 (
+    echo Error compiling trace.cpp
+    pause
+    exit /b 1
+)
+
+g++ -std=c++11 -Wall -Wextra -g -DCALC_ENABLE_BIGNUM -DCALC_PROFILE -DCALC_TRACE -ICore/Inc -c Core/Src/uart_rx_channel.cpp -o build/uart_rx_channel.o
+if %errorlevel% neq 0 (
+    echo Error compiling uart_rx_channel.cpp
+    pause
+    exit /b 1
+)
+
+g++ -std=c++11 -Wall -Wextra -g -DCALC_ENABLE_BIGNUM -DCALC_PROFILE -DCALC_TRACE -ICore/Inc -c Core/Src/calc_protocol.cpp -o build/calc_protocol.o
+if %errorlevel% neq 0 (
+    echo Error compiling calc_protocol.cpp
+    pause
+    exit /b 1
+)
+
+g++ -std=c++11 -Wall -Wextra -g -DCALC_ENABLE_BIGNUM -DCALC_PROFILE -DCALC_TRACE -ICore/Inc -c Core/Src/session_table.cpp -o build/session_table.o
+if %errorlevel% neq 0 (
+    echo Error compiling session_table.cpp
+    pause
+    exit /b 1
+)
+
+g++ -std=c++11 -Wall -Wextra -g -DCALC_ENABLE_BIGNUM -DCALC_PROFILE -DCALC_TRACE -ICore/Inc -c mock_hal.cpp -o build/mock_hal.o
 if %errorlevel% neq 0 (
     echo Error compiling mock_hal.cpp
     pause
@@ -69,7 +167,7 @@ echo.
 
 REM Link object files
 echo Linking object files...
-g++ build/demo.o build/calculator.o build/display.o build/keypad.o build/mock_hal.o -o calculator_demo.exe
+g++ build/demo.o build/calculator.o build/calc_state.o build/expression.o build/calc_batch.o build/fixed_point.o build/bignum.o build/number_format.o build/uart_tx_queue.o build/hd44780.o build/display.o build/keypad.o build/scheduler.o build/profiler.o build/trace.o build/uart_rx_channel.o build/calc_protocol.o build/session_table.o build/mock_hal.o -o calculator_demo.exe
 if %errorlevel% neq 0 (
     echo Error linking program
     pause
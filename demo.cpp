@@ -9,17 +9,51 @@
 
 #include <iostream>
 #include <string>
+#include <cstring>
 #include "calculator.h"
 #include "display.h"
 #include "keypad.h"
+#include "scheduler.h"
+#include "profiler.h"
+#include "trace.h"
+#include "uart_rx_channel.h"
+#include "calc_protocol.h"
+#include "session_table.h"
 
 using namespace std;
 
 // Mock UART handle for testing
 UART_HandleTypeDef mock_huart;
 
+// Keypads serviced by the simulated column EXTI lines and scan timer
+static Keypad* exti_keypad = nullptr;
+static Keypad* timer_keypad = nullptr;
+
+// Scheduler woken by the scan timer when it queued key events
+static Scheduler* timer_scheduler = nullptr;
+static uint8_t timer_task = 0;
+static uint32_t idle_requests = 0;
+
+extern "C" void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin) {
+    if (exti_keypad != nullptr) {
+        exti_keypad->on_column_interrupt(GPIO_Pin);
+    }
+}
+
+extern "C" void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef* htim) {
+    (void)htim;
+    if (timer_keypad != nullptr) {
+        timer_keypad->timer_callback();
+        if (timer_scheduler != nullptr && timer_keypad->has_events()) {
+            timer_scheduler->notify(timer_task);
+        }
+    }
+}
+
 int main() {
     std::cout << "=== STM32 Calculator Demo ===" << std::endl;
+    profiler_init();
+    trace_init();
     
     // Test Calculator class
     std::cout << "\n--- Testing Calculator Class hahahahahahaha---" << std::endl;
@@ -59,6 +93,25 @@ int main() {
     calc.memory_add(50);
     std::cout << "Memory + 50 = " << calc.memory_recall() << std::endl;
     
+    // Memory recall and square root become the entry, as handle_key() uses them
+    for (const char* key = "2+"; *key != '\0'; key++) {
+        calc.process_input(*key);
+    }
+    calc.enter_value(calc.memory_recall());
+    calc.process_input('=');
+    calc_value_t recalled = calc.get_last_result();
+    for (const char* key = "9*"; *key != '\0'; key++) {
+        calc.process_input(*key);
+    }
+    calc.process_input('1');
+    calc.process_input('6');
+    calc.enter_value(calc.square_root(calc.get_current_value()));
+    calc.process_input('=');
+    calc_value_t rooted = calc.get_last_result();
+    bool entry_ok = CalcNum::to_double(recalled) == 52.0 && CalcNum::to_double(rooted) == 36.0;
+    std::cout << "2+MR= -> " << CalcNum::to_double(recalled) << ", 9*16 sqrt= -> "
+              << CalcNum::to_double(rooted) << (entry_ok ? " OK" : " FAILED") << std::endl;
+    
     // Test Display class
     std::cout << "\n--- Testing Display Class ---" << std::endl;
     Display display(&mock_huart);
@@ -68,16 +121,261 @@ int main() {
     display.print_number(3.14159);
     display.print_operation('+');
     display.print_result(42.0);
+    display.print_result(0.1f);  // Shortest float digits: " = 0.1"
+    display.flush(100);
+    
+    // Queued UART output: small prints leave together in one transfer
+    std::cout << "\n--- Testing UART TX Queue ---" << std::endl;
+    mock_uart_set_tx_mode(MOCK_UART_TX_MANUAL);
+    display.print("1");
+    display.print_operation('+');
+    display.print("2");
+    display.poll();
+    display.print_result(3.0);
+    std::cout << "Transfer pending: " << (mock_uart_tx_pending(&mock_huart) ? "Yes" : "No") << std::endl;
+    mock_uart_complete_tx(&mock_huart);
+    mock_uart_complete_tx(&mock_huart);
+    mock_uart_set_tx_mode(MOCK_UART_TX_IMMEDIATE);
+    UartTxStats tx_stats = display.get_tx_stats();
+    std::cout << "Queued " << tx_stats.bytes_queued << " bytes in " << tx_stats.transfers
+              << " transfers, dropped " << tx_stats.bytes_dropped << std::endl;
+    
+    // LCD shadow framebuffer: each refresh sends only the changed cells
+    std::cout << "\n--- Testing LCD Framebuffer ---" << std::endl;
+    // Driven through the HD44780 simulator on a 4-bit GPIO bus
+    Hd44780GpioPins lcd_pins = {GPIOB, GPIO_PIN_12, GPIO_PIN_13, GPIO_PIN_14,
+                                {GPIO_PIN_8, GPIO_PIN_9, GPIO_PIN_10, GPIO_PIN_11}};
+    mock_lcd_attach_gpio(lcd_pins.port, lcd_pins.rs, lcd_pins.rw, lcd_pins.e, lcd_pins.data);
+    Hd44780GpioBus lcd_bus(lcd_pins);
+    Hd44780 lcd_driver(lcd_bus);
+    Display lcd(nullptr, &lcd_driver);
+    std::cout << "LCD ready: " << (lcd.init_lcd() ? "Yes" : "No")
+              << " in " << lcd_driver.get_init_time_us() << " us (busy flag: "
+              << (lcd_driver.uses_busy_flag() ? "Yes" : "No") << ")" << std::endl;
+    const char* lcd_steps[] = {"12", "123", "123+", "123+4"};
+    lcd.show_calculator_mode();
+    for (int i = 0; i < 4; i++) {
+        lcd.set_cursor(1, 0);
+        lcd.print(lcd_steps[i]);
+        lcd.refresh();
+        LcdRefreshStats lcd_stats = lcd.get_lcd_stats();
+        std::cout << "[" << lcd.get_lcd_row(0) << "] [" << lcd.get_lcd_row(1) << "] "
+                  << lcd_stats.last_commands << " commands, "
+                  << lcd_stats.last_data_bytes << " data bytes" << std::endl;
+    }
+    char lcd_row[DISPLAY_LCD_COLS + 1] = {0};
+    mock_lcd_get_row(1, lcd_row, DISPLAY_LCD_COLS);
+    std::cout << "Controller row 1: [" << lcd_row << "], timing violations: "
+              << mock_lcd_violations() << std::endl;
+    
+    // Same controller behind a PCF8574 backpack, timed waits instead of the busy flag
+    I2C_HandleTypeDef mock_hi2c = {0, 0};
+    mock_lcd_attach_i2c(HD44780_I2C_ADDRESS);
+    Hd44780I2cBus lcd_i2c_bus(&mock_hi2c);
+    Hd44780 lcd_i2c_driver(lcd_i2c_bus);
+    Display lcd_i2c(nullptr, &lcd_i2c_driver);
+    lcd_i2c.init_lcd();
+    lcd_i2c.print_result(42.0);
+    lcd_i2c.refresh();
+    mock_lcd_get_row(1, lcd_row, DISPLAY_LCD_COLS);
+    std::cout << "I2C controller row 1: [" << lcd_row << "], timing violations: "
+              << mock_lcd_violations() << std::endl;
     
     // Test Keypad class
     std::cout << "\n--- Testing Keypad Class ---" << std::endl;
     Keypad keypad;
+    Keypad timer_pad;
     
     // Test key validation
     std::cout << "Is '5' valid? " << (keypad.is_valid_key('5') ? "Yes" : "No") << std::endl;
     std::cout << "Is '+' valid? " << (keypad.is_valid_key('+') ? "Yes" : "No") << std::endl;
     std::cout << "Is 'X' valid? " << (keypad.is_valid_key('X') ? "Yes" : "No") << std::endl;
     
+    // Interrupt mode on the simulated matrix: scans only run on column edges
+    const uint16_t keypad_rows[4] = {GPIO_PIN_0, GPIO_PIN_1, GPIO_PIN_2, GPIO_PIN_3};
+    const uint16_t keypad_cols[4] = {GPIO_PIN_4, GPIO_PIN_5, GPIO_PIN_6, GPIO_PIN_7};
+    mock_keypad_attach(GPIOA, keypad_rows, 4, GPIOA, keypad_cols, 4);
+    exti_keypad = &keypad;
+    keypad.init(KEYPAD_MODE_INTERRUPT);
+    std::string typed;
+    keypad.set_key_callback([](KeyCode key, void* text) {
+        *static_cast<std::string*>(text) += (char)key;
+    }, &typed);
+    for (int i = 0; i < 100; i++) {
+        keypad.handle_key_event();      // Idle: nothing scanned
+    }
+    mock_keypad_press(1, 1);            // '5', with a bounce on press
+    mock_keypad_release(1, 1);
+    mock_keypad_press(1, 1);
+    keypad.handle_key_event();
+    mock_keypad_release(1, 1);
+    std::cout << "Interrupt mode typed \"" << typed << "\" with "
+              << keypad.get_scan_count() << " scans" << std::endl;
+    exti_keypad = nullptr;
+    
+    // Timer mode: integrator debounce in the tick, events queued for the loop
+    TIM_HandleTypeDef mock_htim = {0, 0};
+    timer_keypad = &timer_pad;
+    timer_pad.set_timer(&mock_htim);
+    timer_pad.init(KEYPAD_MODE_TIMER);
+    mock_keypad_press(0, 0);            // '1' bouncing for 2 scans, then held 600 ms
+    mock_tim_elapse(&mock_htim, 1);
+    mock_keypad_release(0, 0);
+    mock_tim_elapse(&mock_htim, 1);
+    mock_keypad_press(0, 0);
+    mock_tim_elapse(&mock_htim, 120);
+    mock_keypad_release(0, 0);
+    mock_tim_elapse(&mock_htim, 20);
+    KeyEvent event;
+    const char* event_names[] = {"press", "release", "repeat"};
+    std::cout << "Timer mode events (" << timer_pad.get_timing().scan_period_ms << " ms scan):";
+    while (timer_pad.get_event(event)) {
+        std::cout << " " << event_names[event.type] << " '" << (char)event.key << "'";
+    }
+    std::cout << std::endl;
+    timer_keypad = nullptr;
+    
+    // Whole-port scan: every held key is reported, not just the first
+    Keypad port_pad;
+    port_pad.init(KEYPAD_MODE_POLLING);
+    mock_keypad_press(0, 0);            // '1', '6' and '=' together
+    mock_keypad_press(1, 2);
+    mock_keypad_press(3, 2);
+    uint16_t port_keys = port_pad.scan_keys();
+    port_pad.set_scan_method(KEYPAD_SCAN_PINS);
+    uint16_t pin_keys = port_pad.scan_keys();
+    char first_key = port_pad.scan_key();
+    mock_keypad_release(0, 0);
+    mock_keypad_release(1, 2);
+    mock_keypad_release(3, 2);
+    std::cout << "NKRO bitmap: 0x" << std::hex << port_keys << " (per-pin scan 0x"
+              << pin_keys << std::dec << "), first key '" << first_key << "'"
+              << std::endl;
+    
+    // Polling mode: the same integrator, one step per handle_key_event()
+    std::string polled;
+    port_pad.set_key_callback([](KeyCode key, void* text) {
+        *static_cast<std::string*>(text) += (char)key;
+    }, &polled);
+    uint32_t poll_start = HAL_GetTick();
+    mock_keypad_press(2, 1);            // '8': one bounce scan, then held
+    port_pad.handle_key_event();
+    mock_keypad_release(2, 1);
+    port_pad.handle_key_event();
+    mock_keypad_press(2, 1);
+    for (int i = 0; i < 12; i++) {
+        port_pad.handle_key_event();
+    }
+    mock_keypad_release(2, 1);
+    for (int i = 0; i < 12; i++) {
+        port_pad.handle_key_event();
+    }
+    std::cout << "Polling mode typed \"" << polled << "\" in " << HAL_GetTick() - poll_start
+              << " ms" << (polled == "8" ? " OK" : " FAILED") << std::endl;
+    
+    // Larger panels: 5x6 with function keys, 8x8 with every key code
+    const uint16_t panel_rows[5] = {GPIO_PIN_0, GPIO_PIN_1, GPIO_PIN_2, GPIO_PIN_3, GPIO_PIN_4};
+    const uint16_t panel_cols[6] = {GPIO_PIN_5, GPIO_PIN_6, GPIO_PIN_7, GPIO_PIN_8, GPIO_PIN_9, GPIO_PIN_10};
+    mock_keypad_attach(GPIOA, panel_rows, 5, GPIOA, panel_cols, 6);
+    BasicKeypad<5, 6> panel;
+    panel.init(KEYPAD_MODE_POLLING);
+    mock_keypad_press(0, 3);            // M+
+    KeyCode panel_key = panel.scan_key();
+    mock_keypad_release(0, 3);
+    std::cout << "5x6 panel: M+ reads as 0x" << std::hex << panel_key << std::dec
+              << (panel_key == KEY_MEMORY_ADD ? " (KEY_MEMORY_ADD)" : " (wrong key)") << std::endl;
+    
+    const uint16_t grid_rows[8] = {GPIO_PIN_0, GPIO_PIN_1, GPIO_PIN_2, GPIO_PIN_3,
+                                   GPIO_PIN_4, GPIO_PIN_5, GPIO_PIN_6, GPIO_PIN_7};
+    const uint16_t grid_cols[8] = {GPIO_PIN_8, GPIO_PIN_9, GPIO_PIN_10, GPIO_PIN_11,
+                                   GPIO_PIN_12, GPIO_PIN_13, GPIO_PIN_14, GPIO_PIN_15};
+    mock_keypad_attach(GPIOA, grid_rows, 8, GPIOA, grid_cols, 8);
+    BasicKeypad<8, 8> grid;
+    grid.init(KEYPAD_MODE_POLLING);
+    mock_keypad_press(0, 1);            // '1' and the far corner
+    mock_keypad_press(7, 7);
+    uint64_t grid_keys = grid.scan_keys();
+    KeyCode grid_first = grid.scan_key();
+    mock_keypad_release(0, 1);
+    mock_keypad_release(7, 7);
+    std::cout << "8x8 grid: bitmap 0x" << std::hex << grid_keys << std::dec
+              << ", first key '" << (char)grid_first << "'" << std::endl;
+    
+    // Cooperative scheduler: the keypad task only runs when the scan timer
+    // queued events, the heartbeat on its period, otherwise the idle hook
+    std::cout << "\n--- Testing Scheduler ---" << std::endl;
+    Scheduler scheduler;
+    uint32_t heartbeats = 0;
+    std::string scheduled_keys;
+    timer_pad.set_key_callback([](KeyCode key, void* text) {
+        *static_cast<std::string*>(text) += (char)key;
+    }, &scheduled_keys);
+    int8_t keypad_task = scheduler.add_task("keypad", [](void* pad) {
+        static_cast<Keypad*>(pad)->handle_key_event();
+    }, &timer_pad);
+    int8_t heartbeat_task = scheduler.add_task("heartbeat", [](void* count) {
+        (*static_cast<uint32_t*>(count))++;
+    }, &heartbeats, 2);
+    scheduler.set_idle_hook([](uint32_t sleep_ms) { (void)sleep_ms; idle_requests++; });
+    timer_scheduler = &scheduler;
+    timer_task = (uint8_t)keypad_task;
+    timer_keypad = &timer_pad;
+    mock_keypad_attach(GPIOA, keypad_rows, 4, GPIOA, keypad_cols, 4);
+    timer_pad.init(KEYPAD_MODE_TIMER);  // The 8x8 grid reconfigured PA4..PA7
+    mock_keypad_press(2, 0);            // '7'
+    mock_tim_elapse(&mock_htim, 12);
+    mock_keypad_release(2, 0);
+    mock_tim_elapse(&mock_htim, 12);
+    uint32_t run_start = HAL_GetTick();
+    while (HAL_GetTick() - run_start < 20) {
+        scheduler.run_once();
+    }
+    timer_keypad = nullptr;
+    timer_scheduler = nullptr;
+    SchedulerTaskStats keypad_stats = scheduler.get_task_stats((uint8_t)keypad_task);
+    SchedulerTaskStats heartbeat_stats = scheduler.get_task_stats((uint8_t)heartbeat_task);
+    std::cout << "Keypad task typed \"" << scheduled_keys << "\" in " << keypad_stats.runs
+              << " run(s) (" << keypad_stats.event_wakeups << " event wake-up(s))" << std::endl;
+    std::cout << "Heartbeat: " << heartbeats << " runs in 20 ms, max latency "
+              << heartbeat_stats.latency_us_max << " us; idle hook entered "
+              << (idle_requests > 0 ? "yes" : "no") << std::endl;
+    
+    // Virtual time: the scan timer fires on its own as the clock jumps from
+    // one interrupt to the next, keys come from a script
+    std::cout << "\n--- Testing Virtual-Time Simulator ---" << std::endl;
+    mock_clock_set_mode(MOCK_CLOCK_VIRTUAL);
+    std::string replayed;
+    timer_pad.set_key_callback([](KeyCode key, void* text) {
+        TRACE_EVENT(TRACE_KEY_DISPATCH, key);
+        *static_cast<std::string*>(text) += (char)key;
+    }, &replayed);
+    timer_keypad = &timer_pad;
+    timer_pad.init(KEYPAD_MODE_TIMER);
+    const char* script = "12+34=";
+    uint64_t script_start = mock_clock_now_us();
+    uint64_t key_time = script_start;
+    for (const char* k = script; *k != '\0'; k++) {
+        for (uint8_t row = 0; row < 4; row++) {
+            for (uint8_t col = 0; col < 4; col++) {
+                if (timer_pad.key_at(row, col) == (KeyCode)*k) {
+                    mock_keypad_schedule(key_time, row, col, true);
+                    mock_keypad_schedule(key_time + 60000, row, col, false);
+                }
+            }
+        }
+        key_time += 120000;
+    }
+    while (mock_keypad_scheduled() > 0) {
+        __WFI();
+        timer_pad.handle_key_event();
+    }
+    HAL_Delay(100);                     // Let the last release debounce
+    timer_pad.handle_key_event();
+    std::cout << "Script typed \"" << replayed << "\" in "
+              << (mock_clock_now_us() - script_start) / 1000 << " ms of virtual time" << std::endl;
+    timer_keypad = nullptr;
+    mock_clock_set_mode(MOCK_CLOCK_HOST);
+    
     // Test input processing
     std::cout << "\n--- Testing Input Processing ---" << std::endl;
     calc.clear();
@@ -114,6 +412,220 @@ int main() {
     
     std::cout << "(" << temp_result << ") * 2 = " << calc.get_last_result() << std::endl;
     
+    // Test operator precedence and expression compiler
+    std::cout << "\n--- Testing Expression Engine ---" << std::endl;
+    calc.clear();
+    const char* keys = "2+3*4=";
+    for (const char* k = keys; *k != '\0'; k++) {
+        calc.process_input(*k);
+    }
+    std::cout << "2+3*4 = " << calc.get_last_result() << std::endl;
+    // Dangling '(' at '=' is dropped with the operator in front of it
+    const char* const dangling_keys[] = {"5(=", "2+(=", "2*(3+(=", "2+3(="};
+    const double dangling_expected[] = {5, 2, 6, 5};
+    for (int i = 0; i < 4; i++) {
+        calc.clear();
+        for (const char* k = dangling_keys[i]; *k != '\0'; k++) {
+            calc.process_input(*k);
+        }
+        bool dangling_ok = !calc.is_error() && CalcNum::to_double(calc.get_last_result()) == dangling_expected[i];
+        std::cout << dangling_keys[i] << " -> " << calc.get_last_result()
+                  << (dangling_ok ? " OK" : " FAILED") << std::endl;
+    }
+    std::cout << "(2+3)*4 = " << calc.evaluate("(2+3)*4") << std::endl;
+    
+    Expression formula;
+    formula.compile("x^2 + 2*x + 1");
+    double vars[Expression::VARIABLE_COUNT] = {0};
+    for (int x = 1; x <= 3; x++) {
+        vars['x' - 'a'] = x;
+        std::cout << "x=" << x << ": x^2+2x+1 = " << calc.evaluate(formula, vars) << std::endl;
+    }
+    
+#ifdef CALC_ENABLE_BIGNUM
+    // Test arbitrary-precision backend
+    std::cout << "\n--- Testing Bignum Engine ---" << std::endl;
+    BasicCalculator<BigDecimal> big;
+    BigDecimal factorial(1);
+    for (int i = 1; i <= 30; i++) {
+        factorial = big.multiply(factorial, BigDecimal(i));
+    }
+    std::cout << "30! = " << factorial.to_string() << std::endl;
+    std::cout << "0.1+0.2 = " << big.evaluate("0.1+0.2").to_string() << std::endl;
+    std::cout << "2^100 = " << big.evaluate("2^100").to_string() << std::endl;
+    std::cout << "1/7 = " << big.divide(BigDecimal(1), BigDecimal(7)).to_string() << std::endl;
+    
+#endif
+    // Test batch arithmetic
+    std::cout << "\n--- Testing Batch Operations ---" << std::endl;
+    const double lhs[4] = {10.0, 20.0, 30.0, 40.0};
+    const double rhs[4] = {2.0, 0.0, 3.0, 8.0};
+    double quotients[4];
+    uint8_t lane_status[4];
+    size_t failed = Calculator::divide(lhs, rhs, quotients, 4, lane_status);
+    for (int i = 0; i < 4; i++) {
+        std::cout << lhs[i] << " / " << rhs[i] << " = " << quotients[i]
+                  << (lane_status[i] != CALC_LANE_OK ? " (error)" : "") << std::endl;
+    }
+    std::cout << "Failed lanes: " << failed << std::endl;
+    
+    // UART RX channel: lines cut out of the circular DMA buffer, each one
+    // evaluated as a whole expression and answered on the UART
+    std::cout << "\n--- Testing UART RX Channel ---" << std::endl;
+    UartRxChannel rx_channel(&mock_huart);
+    rx_channel.start();
+    Calculator line_calc;
+    char rx_line[UART_RX_LINE_MAX + 1];
+    const char* rx_bursts[] = {
+        "12+34\r\n2*(3+4)\n",
+        "9/0\n",
+        "7*6",                          // No line ending: the idle line ends it
+    };
+    for (size_t i = 0; i < sizeof(rx_bursts) / sizeof(rx_bursts[0]); i++) {
+        mock_uart_receive(&mock_huart, (const uint8_t*)rx_bursts[i], strlen(rx_bursts[i]));
+        while (rx_channel.read_line(rx_line, sizeof(rx_line))) {
+            std::cout << "Line \"" << rx_line << "\":";
+            calc_value_t line_value = line_calc.evaluate(rx_line);
+            if (line_calc.is_error()) {
+                display.print_uart_error(line_calc.get_last_error());
+            } else {
+                display.print_uart_result(line_value);
+            }
+            display.flush(100);
+        }
+    }
+    // A framing error restarts reception; the line it hit is dropped
+    mock_uart_receive(&mock_huart, (const uint8_t*)"1+", 2);
+    mock_uart_rx_error(&mock_huart);
+    mock_uart_receive(&mock_huart, (const uint8_t*)"1\n5-8\n", 6);
+    while (rx_channel.read_line(rx_line, sizeof(rx_line))) {
+        std::cout << "After error \"" << rx_line << "\"" << std::endl;
+    }
+    UartRxStats rx_stats = rx_channel.get_stats();
+    std::cout << "Received " << rx_stats.bytes_received << " bytes, " << rx_stats.lines
+              << " lines, " << rx_stats.errors << " errors, " << rx_stats.bytes_lost
+              << " bytes lost" << std::endl;
+    rx_channel.stop();
+    display.stop();
+    
+    // Binary protocol: one batch request framed, served and decoded back
+    std::cout << "\n--- Testing Binary Protocol ---" << std::endl;
+    uint8_t request[CALC_REQUEST_HEADER + 4 * 8] = {CALC_OP_DIVIDE, CALC_FORMAT_F32, 0x34, 0x12};
+    const double protocol_operands[4] = {1.0, 8.0, 5.0, 0.0};
+    for (size_t i = 0; i < 4; i++) {
+        calc_operand_put(CALC_FORMAT_F32, protocol_operands[i], request + CALC_REQUEST_HEADER + 4 * i);
+    }
+    uint8_t request_frame[CALC_FRAME_MAX];
+    size_t request_length = calc_frame_encode(request, CALC_REQUEST_HEADER + 4 * 4, request_frame,
+                                              sizeof(request_frame));
+    CalcFrameDecoder protocol_decoder;
+    for (size_t i = 0; i < request_length; i++) {
+        protocol_decoder.push(request_frame[i]);
+    }
+    uint8_t response_frame[CALC_FRAME_MAX];
+    size_t response_length = calc_protocol_serve(line_calc, protocol_decoder.payload(),
+                                                 protocol_decoder.payload_length(),
+                                                 response_frame, sizeof(response_frame));
+    protocol_decoder.release();
+    std::cout << "Request " << request_length << " bytes, response " << response_length << " bytes" << std::endl;
+    const uint8_t* response = response_frame + 2;
+    std::cout << "Request id 0x" << std::hex << (response[2] | (response[3] << 8)) << std::dec
+              << ", status " << (int)response[4] << ": 1/8 = "
+              << calc_operand_get(CALC_FORMAT_F32, response + CALC_RESPONSE_HEADER)
+              << ", 5/0 lane status " << (int)response[CALC_RESPONSE_HEADER + 2 * 4 + 1] << std::endl;
+    
+    // Session table: interleaved keys from several sessions, each session
+    // ending where a Calculator fed the same keys would
+    std::cout << "\n--- Testing Session Table ---" << std::endl;
+    static uint64_t session_storage[256];
+    SessionTable sessions;
+    bool sessions_ready = sessions.init(session_storage, sizeof(session_storage), 4, 4);
+    std::cout << "Init: " << (sessions_ready ? "OK" : "FAILED") << ", "
+              << SessionTable::storage_size(4, 4) << " bytes for 4 sessions and 4 stacks"
+              << " (Calculator: " << sizeof(Calculator) << " bytes each)" << std::endl;
+    const char* const session_keys[] = {"2+3*4=", "(1+2)*3=", "7/0=", "1.5*4="};
+    size_t session_key_pos[4] = {0, 0, 0, 0};
+    uint32_t session_ids[32];
+    char session_batch[32];
+    size_t session_batch_count = 0;
+    uint32_t peak_stacks = 0;
+    for (bool more = true; more;) {
+        more = false;
+        for (uint32_t s = 0; s < 4; s++) {
+            if (session_keys[s][session_key_pos[s]] != '\0') {
+                session_ids[session_batch_count] = s;
+                session_batch[session_batch_count++] = session_keys[s][session_key_pos[s]++];
+                more = true;
+            }
+        }
+        sessions.process_input(session_ids, session_batch, session_batch_count);
+        session_batch_count = 0;
+        peak_stacks = sessions.blocks_in_use() > peak_stacks ? sessions.blocks_in_use() : peak_stacks;
+    }
+    for (uint32_t s = 0; s < 4; s++) {
+        std::cout << "Session " << s << " \"" << session_keys[s] << "\": ";
+        if (sessions.is_error(s)) {
+            std::cout << "Error: " << calc_error_string(sessions.get_error_code(s)) << std::endl;
+        } else {
+            std::cout << CalcNum::to_double(sessions.get_last_result(s)) << std::endl;
+        }
+    }
+    std::cout << "Stacks in use at most " << peak_stacks << " of 4, now " << sessions.blocks_in_use() << std::endl;
+    
+    // Calculator state as a value: snapshots and pure transitions
+    std::cout << "\n--- Testing CalcState ---" << std::endl;
+    Calculator branching;
+    const char* const branch_prefix = "2+3*";
+    for (const char* key = branch_prefix; *key != '\0'; key++) {
+        branching.process_input(*key);
+    }
+    const CalcState snapshot = branching.get_state();
+    CalcState branch_a = snapshot;
+    CalcState branch_b = snapshot;
+    for (const char* key = "4="; *key != '\0'; key++) {
+        branch_a = calc_next(branch_a, *key);
+    }
+    for (const char* key = "(1+1)="; *key != '\0'; key++) {
+        branch_b = calc_next(branch_b, *key);
+    }
+    std::cout << branch_prefix << "4= -> " << CalcNum::to_double(branch_a.get_last_result())
+              << ", " << branch_prefix << "(1+1)= -> " << CalcNum::to_double(branch_b.get_last_result())
+              << ", snapshot still at " << CalcNum::to_double(snapshot.get_current_value()) << std::endl;
+    branching.set_state(branch_a);
+    std::cout << "Calculator restored from branch: " << CalcNum::to_double(branching.get_last_result())
+              << " (" << sizeof(CalcState) << "-byte state)" << std::endl;
+    CalcState applied = calc_apply(snapshot, '/', CalcNum::from_int(1), CalcNum::zero());
+    std::cout << "calc_apply 1/0: " << (applied.is_error() ? applied.get_last_error() : "no error")
+              << ", snapshot error: " << (snapshot.is_error() ? snapshot.get_last_error() : "none") << std::endl;
+    
+    // Test profiler: zones timed by everything above
+    std::cout << "\n--- Testing Profiler ---" << std::endl;
+    profiler_dump([](const char* line, void* context) {
+        *static_cast<std::ostream*>(context) << line << std::endl;
+    }, &std::cout);
+    
+    // Test event trace: the last scripted key stroke, detection to dispatch
+    std::cout << "\n--- Testing Event Trace ---" << std::endl;
+    std::cout << "Records: " << trace_count() << " (lost " << trace_lost() << ")" << std::endl;
+    static TraceRecord trace_records[TRACE_BUFFER_SIZE];
+    size_t traced = trace_snapshot(trace_records, TRACE_BUFFER_SIZE);
+    size_t dispatch = traced;
+    for (size_t i = 0; i < traced; i++) {
+        if (trace_records[i].event == TRACE_KEY_DISPATCH) {
+            dispatch = i;
+        }
+    }
+    size_t detect = dispatch;
+    while (detect > 0 && detect < traced && trace_records[detect].event != TRACE_KEY_DETECT) {
+        detect--;
+    }
+    for (size_t i = detect; i <= dispatch && i < traced; i++) {
+        uint32_t cycles = trace_records[i].timestamp - trace_records[detect].timestamp;
+        std::cout << "  +" << cycles / (SystemCoreClock / 1000000) << " us "
+                  << trace_event_name((TraceEvent)trace_records[i].event)
+                  << " '" << (char)trace_records[i].arg << "'" << std::endl;
+    }
+    
     std::cout << "print huhuhuuuuuu!" << std::endl; 
     std::cout << "\n=== Demo Complete ===" << std::endl;
     return 0;
@@ -7,35 +7,672 @@
   */
 
 #include "stm32f1xx_hal.h"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <deque>
 #include <iostream>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define MOCK_HAVE_TSC
+#endif
 
-// Mock GPIO ports
-GPIO_TypeDef* GPIOA = nullptr;
-GPIO_TypeDef* GPIOB = nullptr;
-GPIO_TypeDef* GPIOC = nullptr;
-GPIO_TypeDef* GPIOD = nullptr;
+// Mock GPIO ports (distinct objects so simulated devices can tell them apart)
+static GPIO_TypeDef mock_ports[4];
+GPIO_TypeDef* GPIOA = &mock_ports[0];
+GPIO_TypeDef* GPIOB = &mock_ports[1];
+GPIO_TypeDef* GPIOC = &mock_ports[2];
+GPIO_TypeDef* GPIOD = &mock_ports[3];
+
+// Mock core clock and DWT cycle counter
+uint32_t SystemCoreClock = 72000000;
+DWT_Type mock_dwt;
+CoreDebug_Type mock_core_debug;
+
+static uint64_t host_time_ns() {
+    typedef std::chrono::steady_clock Clock;
+    static const Clock::time_point start = Clock::now();
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+}
+
+// Clock behind HAL_GetTick and CYCCNT: host time, or virtual time that only
+// moves when the program waits (see the virtual time section below)
+static MockClockMode clock_mode = MOCK_CLOCK_HOST;
+static uint64_t virtual_ns = 0;
+static uint64_t host_offset_ns = 0;     // Virtual time run ahead of the host
+
+static uint64_t clock_ns() {
+    return clock_mode == MOCK_CLOCK_VIRTUAL ? virtual_ns : host_time_ns() + host_offset_ns;
+}
+
+static void clock_run_due();
+
+// Reads by the firmware cost a little virtual time, so busy-waits on the
+// tick or the cycle counter terminate, and interrupts that fall due run
+// as they would preempt the wait; simulated devices use clock_ns()
+static uint64_t clock_read_ns() {
+    if (clock_mode == MOCK_CLOCK_VIRTUAL) {
+        virtual_ns += MOCK_CLOCK_READ_NS;
+        clock_run_due();
+    }
+    return clock_ns();
+}
+
+// Echo of GPIO writes and UART transmits on stdout
+static bool console_echo = true;
+
+static uint32_t cycle_counter_offset = 0;
+
+MockCycleCounter::operator uint32_t() const {
+    uint64_t cycles = clock_read_ns() * (SystemCoreClock / 1000000) / 1000;
+    return (uint32_t)cycles + cycle_counter_offset;
+}
+
+MockCycleCounter& MockCycleCounter::operator=(uint32_t value) {
+    cycle_counter_offset = 0;
+    cycle_counter_offset = value - (uint32_t)*this;
+    return *this;
+}
+
+// Simulated HD44780 (see stm32f1xx_hal.h)
+struct MockLcd {
+    bool attached;
+    bool via_i2c;
+    uint16_t i2c_address;
+    GPIO_TypeDef* port;
+    uint16_t rs_pin, rw_pin, e_pin, data_pins[4];
+
+    // Bus levels driven by the MCU
+    bool rs, rw, e;
+    uint8_t data;
+    uint8_t expander_byte;
+
+    // Controller state
+    uint64_t power_on_us;
+    uint64_t busy_until_us;
+    int init_writes;
+    bool four_bit;
+    bool second_nibble;
+    uint8_t high_nibble;
+    bool read_second;
+    uint8_t read_nibble;
+    uint8_t ddram[128];
+    uint8_t address;
+    bool increment;
+
+    uint32_t instructions;
+    uint32_t violations;
+    const char* last_violation;
+};
+
+static MockLcd mock_lcd;
+
+static uint64_t lcd_time_us() {
+    return clock_ns() / 1000;
+}
+
+static void lcd_power_on() {
+    MockLcd& lcd = mock_lcd;
+    lcd.attached = true;
+    lcd.rs = lcd.rw = lcd.e = false;
+    lcd.data = 0;
+    lcd.expander_byte = 0;
+    // Powered together with the MCU: HAL_GetTick() 0 is the power-on point
+    lcd.power_on_us = 0;
+    lcd.busy_until_us = 0;
+    lcd.init_writes = 0;
+    lcd.four_bit = false;
+    lcd.second_nibble = false;
+    lcd.read_second = false;
+    lcd.read_nibble = 0;
+    memset(lcd.ddram, ' ', sizeof(lcd.ddram));
+    lcd.address = 0;
+    lcd.increment = true;
+    lcd.instructions = 0;
+    lcd.violations = 0;
+    lcd.last_violation = "";
+}
+
+static void lcd_violation(const char* what) {
+    mock_lcd.violations++;
+    mock_lcd.last_violation = what;
+}
+
+static void lcd_execute(uint8_t value, bool rs, uint64_t now) {
+    MockLcd& lcd = mock_lcd;
+    lcd.instructions++;
+    uint32_t busy_us = 37;
+    if (rs) {
+        lcd.ddram[lcd.address & 0x7F] = value;
+        lcd.address = lcd.increment ? lcd.address + 1 : lcd.address - 1;
+        // Two-line mode: 0x00-0x27 and 0x40-0x67
+        if (lcd.address == 0x28) {
+            lcd.address = 0x40;
+        } else if (lcd.address == 0x68) {
+            lcd.address = 0x00;
+        }
+        lcd.address &= 0x7F;
+        busy_us = 41;
+    } else if (value & 0x80) {
+        lcd.address = value & 0x7F;
+    } else if (value & 0x40) {
+        // CGRAM address: custom characters are not simulated
+    } else if (value & 0x20) {
+        if (value & 0x10) {
+            lcd.four_bit = false;
+        }
+    } else if (value & 0x18) {
+        // Cursor/display shift and display control: nothing to model
+    } else if (value & 0x04) {
+        lcd.increment = (value & 0x02) != 0;
+    } else if (value & 0x02) {
+        lcd.address = 0;
+        busy_us = 1520;
+    } else if (value == 0x01) {
+        memset(lcd.ddram, ' ', sizeof(lcd.ddram));
+        lcd.address = 0;
+        lcd.increment = true;
+        busy_us = 1520;
+    }
+    lcd.busy_until_us = now + busy_us;
+}
+
+static void lcd_latch() {
+    MockLcd& lcd = mock_lcd;
+    uint64_t now = lcd_time_us();
+    if (now - lcd.power_on_us < 40000) {
+        lcd_violation("write within 40 ms of power-on");
+    } else if (now < lcd.busy_until_us) {
+        lcd_violation("write while busy");
+    }
+
+    if (!lcd.four_bit) {
+        // 8-bit interface with D0-D3 unconnected: only function set matters
+        uint8_t value = (uint8_t)(lcd.data << 4);
+        lcd.instructions++;
+        if ((value & 0xF0) == 0x30) {
+            lcd.init_writes++;
+            lcd.busy_until_us = now + (lcd.init_writes == 1 ? 4100 : lcd.init_writes == 2 ? 100 : 37);
+        } else if ((value & 0xF0) == 0x20) {
+            lcd.four_bit = true;
+            lcd.second_nibble = false;
+            lcd.busy_until_us = now + 37;
+        }
+        return;
+    }
+    if (!lcd.second_nibble) {
+        lcd.high_nibble = lcd.data;
+        lcd.second_nibble = true;
+        return;
+    }
+    lcd.second_nibble = false;
+    lcd_execute((uint8_t)((lcd.high_nibble << 4) | lcd.data), lcd.rs, now);
+}
+
+static void lcd_set_levels(bool rs, bool rw, bool e, uint8_t data) {
+    MockLcd& lcd = mock_lcd;
+    bool rising = e && !lcd.e;
+    bool falling = !e && lcd.e;
+    lcd.rs = rs;
+    lcd.rw = rw;
+    lcd.e = e;
+    lcd.data = data & 0x0F;
+
+    if (rising && rw && !rs) {
+        // Status read: busy flag and address counter high bits, then low bits
+        bool busy = lcd_time_us() < lcd.busy_until_us;
+        if (!lcd.read_second) {
+            lcd.read_nibble = (uint8_t)((busy ? 0x08 : 0x00) | ((lcd.address >> 4) & 0x07));
+        } else {
+            lcd.read_nibble = lcd.address & 0x0F;
+        }
+        lcd.read_second = lcd.four_bit && !lcd.read_second;
+    } else if (falling && !rw) {
+        lcd_latch();
+    }
+}
+
+// Level the LCD data lines show while the MCU reads them
+static uint8_t lcd_data_lines() {
+    return (mock_lcd.rw && mock_lcd.e) ? mock_lcd.read_nibble : mock_lcd.data;
+}
+
+static bool lcd_owns_gpio(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin) {
+    const MockLcd& lcd = mock_lcd;
+    uint16_t mask = lcd.rs_pin | lcd.rw_pin | lcd.e_pin |
+                    lcd.data_pins[0] | lcd.data_pins[1] | lcd.data_pins[2] | lcd.data_pins[3];
+    return lcd.attached && !lcd.via_i2c && GPIOx == lcd.port && (GPIO_Pin & mask) != 0;
+}
+
+static void lcd_write_gpio(uint16_t GPIO_Pin, GPIO_PinState PinState) {
+    const MockLcd& lcd = mock_lcd;
+    bool level = (PinState == GPIO_PIN_SET);
+    bool rs = (GPIO_Pin & lcd.rs_pin) ? level : lcd.rs;
+    bool rw = (GPIO_Pin & lcd.rw_pin) ? level : lcd.rw;
+    bool e = (GPIO_Pin & lcd.e_pin) ? level : lcd.e;
+    uint8_t data = lcd.data;
+    for (int i = 0; i < 4; i++) {
+        if (GPIO_Pin & lcd.data_pins[i]) {
+            data = level ? (uint8_t)(data | (1 << i)) : (uint8_t)(data & ~(1 << i));
+        }
+    }
+    lcd_set_levels(rs, rw, e, data);
+}
+
+void mock_lcd_attach_gpio(GPIO_TypeDef* port, uint16_t rs, uint16_t rw, uint16_t e, const uint16_t* data) {
+    lcd_power_on();
+    mock_lcd.via_i2c = false;
+    mock_lcd.port = port;
+    mock_lcd.rs_pin = rs;
+    mock_lcd.rw_pin = rw;
+    mock_lcd.e_pin = e;
+    for (int i = 0; i < 4; i++) {
+        mock_lcd.data_pins[i] = data[i];
+    }
+}
+
+void mock_lcd_attach_i2c(uint16_t address) {
+    lcd_power_on();
+    mock_lcd.via_i2c = true;
+    mock_lcd.i2c_address = address;
+}
+
+void mock_lcd_get_row(uint8_t row, char* buffer, uint8_t length) {
+    uint8_t base = (row == 0) ? 0x00 : 0x40;
+    for (uint8_t i = 0; i < length; i++) {
+        buffer[i] = (char)mock_lcd.ddram[(base + i) & 0x7F];
+    }
+}
+
+uint32_t mock_lcd_instructions(void) {
+    return mock_lcd.instructions;
+}
+
+uint32_t mock_lcd_violations(void) {
+    return mock_lcd.violations;
+}
+
+const char* mock_lcd_last_violation(void) {
+    return mock_lcd.attached ? mock_lcd.last_violation : "";
+}
+
+// Pin modes and output levels per port, for simulated devices and EXTI
+static uint32_t port_modes[4][16];
+static uint16_t port_outputs[4];
+static uint16_t port_output_pins[4];    // Pins in an output mode
+static uint16_t port_pullups[4];        // Inputs with the pull-up enabled
+
+static int port_index(GPIO_TypeDef* GPIOx) {
+    for (int i = 0; i < 4; i++) {
+        if (GPIOx == &mock_ports[i]) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int pin_number(uint16_t pin) {
+    for (int i = 0; i < 16; i++) {
+        if (pin == (1u << i)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// EXTI lines: an edge on a pin in an IT mode sets its pending bit; pending
+// lines are serviced like the IRQ would, edges raised by the handler itself
+// are serviced after it returns
+static uint16_t exti_pending;
+static bool exti_in_handler;
+
+static void exti_dispatch() {
+    if (exti_in_handler) {
+        return;
+    }
+    exti_in_handler = true;
+    while (exti_pending != 0) {
+        uint16_t line = exti_pending & (uint16_t)-exti_pending;
+        HAL_GPIO_EXTI_IRQHandler(line);
+    }
+    exti_in_handler = false;
+}
+
+static void exti_edge(GPIO_TypeDef* GPIOx, uint16_t pin, bool rising) {
+    int port = port_index(GPIOx);
+    int number = pin_number(pin);
+    if (port < 0 || number < 0) {
+        return;
+    }
+    uint32_t mode = port_modes[port][number];
+    bool armed = rising ? (mode == GPIO_MODE_IT_RISING || mode == GPIO_MODE_IT_RISING_FALLING)
+                        : (mode == GPIO_MODE_IT_FALLING || mode == GPIO_MODE_IT_RISING_FALLING);
+    if (armed) {
+        exti_pending |= pin;
+    }
+}
+
+// Simulated key matrix: a pressed key connects its row and column, so a
+// column (pulled up) reads low while any pressed key's row is driven low
+struct MockKeypad {
+    bool attached;
+    GPIO_TypeDef* row_port;
+    GPIO_TypeDef* col_port;
+    uint16_t row_pins[8];
+    uint16_t col_pins[8];
+    uint8_t rows;
+    uint8_t cols;
+    uint8_t pressed[8];         // Column bitmask per row
+    uint8_t col_levels;         // Bit set = column high
+    uint16_t col_mask;          // Column pins, and those of them reading high,
+    uint16_t col_pin_levels;    // for the input register
+};
+
+static MockKeypad mock_keypad;
+
+static bool keypad_row_driven_low(uint8_t row) {
+    int port = port_index(mock_keypad.row_port);
+    if (port < 0) {
+        return false;
+    }
+    uint16_t pin = mock_keypad.row_pins[row];
+    return (port_output_pins[port] & pin) != 0 && (port_outputs[port] & pin) == 0;
+}
+
+static void keypad_update() {
+    MockKeypad& pad = mock_keypad;
+    if (!pad.attached) {
+        return;
+    }
+    uint8_t levels = (uint8_t)((1u << pad.cols) - 1);
+    for (uint8_t row = 0; row < pad.rows; row++) {
+        if (pad.pressed[row] != 0 && keypad_row_driven_low(row)) {
+            levels &= (uint8_t)~pad.pressed[row];
+        }
+    }
+    uint8_t changed = levels ^ pad.col_levels;
+    if (changed == 0) {
+        return;
+    }
+    pad.col_levels = levels;
+    for (uint8_t col = 0; col < pad.cols; col++) {
+        if (changed & (1u << col)) {
+            uint16_t pin = pad.col_pins[col];
+            bool high = (levels >> col) & 1;
+            pad.col_pin_levels = high ? (uint16_t)(pad.col_pin_levels | pin)
+                                      : (uint16_t)(pad.col_pin_levels & ~pin);
+            exti_edge(pad.col_port, pin, high);
+        }
+    }
+    exti_dispatch();
+}
+
+static bool keypad_owns_row(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin) {
+    const MockKeypad& pad = mock_keypad;
+    if (!pad.attached || GPIOx != pad.row_port) {
+        return false;
+    }
+    for (uint8_t row = 0; row < pad.rows; row++) {
+        if (GPIO_Pin & pad.row_pins[row]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void mock_keypad_attach(GPIO_TypeDef* row_port, const uint16_t* row_pins, uint8_t rows,
+                        GPIO_TypeDef* col_port, const uint16_t* col_pins, uint8_t cols) {
+    MockKeypad& pad = mock_keypad;
+    memset(&pad, 0, sizeof(pad));
+    pad.attached = true;
+    pad.row_port = row_port;
+    pad.col_port = col_port;
+    pad.rows = rows > 8 ? 8 : rows;
+    pad.cols = cols > 8 ? 8 : cols;
+    memcpy(pad.row_pins, row_pins, pad.rows * sizeof(uint16_t));
+    memcpy(pad.col_pins, col_pins, pad.cols * sizeof(uint16_t));
+    pad.col_levels = (uint8_t)((1u << pad.cols) - 1);
+    for (uint8_t col = 0; col < pad.cols; col++) {
+        pad.col_mask |= pad.col_pins[col];
+    }
+    pad.col_pin_levels = pad.col_mask;
+}
+
+void mock_keypad_press(uint8_t row, uint8_t col) {
+    if (row < mock_keypad.rows && col < mock_keypad.cols) {
+        mock_keypad.pressed[row] |= (uint8_t)(1u << col);
+        keypad_update();
+    }
+}
+
+void mock_keypad_release(uint8_t row, uint8_t col) {
+    if (row < mock_keypad.rows && col < mock_keypad.cols) {
+        mock_keypad.pressed[row] &= (uint8_t)~(1u << col);
+        keypad_update();
+    }
+}
+
+// Scripted key actions, applied in time order as the virtual clock passes them
+struct MockKeyAction {
+    uint64_t at_ns;
+    uint8_t row;
+    uint8_t col;
+    bool pressed;
+};
+
+static bool key_action_before(const MockKeyAction& a, const MockKeyAction& b) {
+    return a.at_ns < b.at_ns;
+}
+
+static std::vector<MockKeyAction> key_script;
+static size_t key_script_next = 0;
+
+void mock_keypad_schedule(uint64_t at_us, uint8_t row, uint8_t col, bool pressed) {
+    MockKeyAction action = {at_us * 1000, row, col, pressed};
+    // Scripts are usually written in order: append, else keep same-time
+    // actions in the order they were given
+    if (key_script.empty() || key_script.back().at_ns <= action.at_ns) {
+        key_script.push_back(action);
+    } else {
+        key_script.insert(std::upper_bound(key_script.begin() + key_script_next, key_script.end(),
+                                           action, key_action_before), action);
+    }
+}
+
+size_t mock_keypad_scheduled(void) {
+    return key_script.size() - key_script_next;
+}
+
+static bool key_script_due(uint64_t& at_ns) {
+    if (key_script_next == key_script.size()) {
+        return false;
+    }
+    at_ns = key_script[key_script_next].at_ns;
+    return true;
+}
+
+static void key_script_apply() {
+    MockKeyAction action = key_script[key_script_next++];
+    if (key_script_next == key_script.size()) {
+        key_script.clear();
+        key_script_next = 0;
+    }
+    if (action.pressed) {
+        mock_keypad_press(action.row, action.col);
+    } else {
+        mock_keypad_release(action.row, action.col);
+    }
+}
 
 // Mock GPIO functions
 HAL_StatusTypeDef HAL_GPIO_Init(GPIO_TypeDef* GPIOx, GPIO_InitTypeDef* GPIO_InitStruct) {
-    // Mock implementation - just return success
+    // Remember modes so simulated devices see outputs and armed EXTI lines
+    int port = port_index(GPIOx);
+    if (port >= 0) {
+        uint32_t mode = GPIO_InitStruct->Mode;
+        uint16_t pins = (uint16_t)GPIO_InitStruct->Pin;
+        for (int i = 0; i < 16; i++) {
+            if (pins & (1u << i)) {
+                port_modes[port][i] = mode;
+            }
+        }
+        bool output = (mode == GPIO_MODE_OUTPUT_PP || mode == GPIO_MODE_OUTPUT_OD);
+        bool pullup = !output && GPIO_InitStruct->Pull == GPIO_PULLUP;
+        port_output_pins[port] = output ? (uint16_t)(port_output_pins[port] | pins)
+                                        : (uint16_t)(port_output_pins[port] & ~pins);
+        port_pullups[port] = pullup ? (uint16_t)(port_pullups[port] | pins)
+                                    : (uint16_t)(port_pullups[port] & ~pins);
+        keypad_update();
+    }
     return HAL_OK;
 }
 
+// Input register of a port: outputs read back their level, simulated
+// devices drive their pins, other inputs follow their pull (floating and
+// pull-down read low)
+static uint16_t port_levels(int port) {
+    GPIO_TypeDef* GPIOx = &mock_ports[port];
+    uint16_t outputs = port_output_pins[port];
+    uint16_t levels = (uint16_t)((port_outputs[port] & outputs) | (port_pullups[port] & ~outputs));
+    
+    const MockKeypad& pad = mock_keypad;
+    if (pad.attached && GPIOx == pad.col_port) {
+        levels = (uint16_t)((levels & ~pad.col_mask) | pad.col_pin_levels);
+    }
+    if (lcd_owns_gpio(GPIOx, 0xFFFF)) {
+        uint8_t data = lcd_data_lines();
+        for (int i = 0; i < 4; i++) {
+            uint16_t pin = mock_lcd.data_pins[i];
+            if (!(outputs & pin)) {
+                levels = ((data >> i) & 1) ? (uint16_t)(levels | pin) : (uint16_t)(levels & ~pin);
+            }
+        }
+    }
+    return levels;
+}
+
 GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin) {
-    // Mock implementation - return random state for testing
-    static int counter = 0;
-    counter++;
-    return (counter % 2 == 0) ? GPIO_PIN_SET : GPIO_PIN_RESET;
+    int port = port_index(GPIOx);
+    if (port < 0) {
+        return GPIO_PIN_RESET;
+    }
+    return (port_levels(port) & GPIO_Pin) ? GPIO_PIN_SET : GPIO_PIN_RESET;
+}
+
+// Drives pins of one port; returns true when a simulated device took them
+static bool gpio_drive(GPIO_TypeDef* GPIOx, uint16_t set, uint16_t reset) {
+    bool simulated = false;
+    if (lcd_owns_gpio(GPIOx, set | reset)) {
+        if (reset != 0) {
+            lcd_write_gpio(reset, GPIO_PIN_RESET);
+        }
+        if (set != 0) {
+            lcd_write_gpio(set, GPIO_PIN_SET);
+        }
+        simulated = true;
+    }
+    
+    int port = port_index(GPIOx);
+    if (port >= 0) {
+        // BSRR semantics: set wins over reset
+        port_outputs[port] = (uint16_t)((port_outputs[port] & ~reset) | set);
+    }
+    if (keypad_owns_row(GPIOx, set | reset)) {
+        keypad_update();
+        simulated = true;
+    }
+    return simulated;
 }
 
 void HAL_GPIO_WritePin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState) {
-    // Mock implementation - just print the action
-    std::cout << "GPIO Write: Pin " << GPIO_Pin << " = " << (PinState == GPIO_PIN_SET ? "SET" : "RESET") << std::endl;
+    bool set = (PinState == GPIO_PIN_SET);
+    if (gpio_drive(GPIOx, set ? GPIO_Pin : 0, set ? 0 : GPIO_Pin)) {
+        // Simulated LCD and keypad traffic is not echoed
+        return;
+    }
+    
+    if (console_echo) {
+        std::cout << "GPIO Write: Pin " << GPIO_Pin << " = " << (PinState == GPIO_PIN_SET ? "SET" : "RESET") << '\n';
+    }
+}
+
+// Port registers: recover the port from the register's address
+template<typename Register>
+static GPIO_TypeDef* register_port(const Register* reg, size_t offset) {
+    return (GPIO_TypeDef*)((const char*)reg - offset);
+}
+
+MockGpioInput::operator uint32_t() const {
+    int port = port_index(register_port(this, offsetof(GPIO_TypeDef, IDR)));
+    return port >= 0 ? port_levels(port) : 0;
+}
+
+MockGpioOutput::operator uint32_t() const {
+    int port = port_index(register_port(this, offsetof(GPIO_TypeDef, ODR)));
+    return port >= 0 ? port_outputs[port] : 0;
+}
+
+MockGpioOutput& MockGpioOutput::operator=(uint32_t value) {
+    GPIO_TypeDef* GPIOx = register_port(this, offsetof(GPIO_TypeDef, ODR));
+    gpio_drive(GPIOx, (uint16_t)value, (uint16_t)~value);
+    return *this;
+}
+
+MockGpioSetReset& MockGpioSetReset::operator=(uint32_t value) {
+    GPIO_TypeDef* GPIOx = register_port(this, offsetof(GPIO_TypeDef, BSRR));
+    gpio_drive(GPIOx, (uint16_t)value, (uint16_t)(value >> 16));
+    return *this;
+}
+
+MockGpioReset& MockGpioReset::operator=(uint32_t value) {
+    GPIO_TypeDef* GPIOx = register_port(this, offsetof(GPIO_TypeDef, BRR));
+    gpio_drive(GPIOx, 0, (uint16_t)value);
+    return *this;
 }
 
 void HAL_GPIO_TogglePin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin) {
-    // Mock implementation - just print the action
-    std::cout << "GPIO Toggle: Pin " << GPIO_Pin << std::endl;
+    int port = port_index(GPIOx);
+    uint16_t high = port >= 0 ? (uint16_t)(port_outputs[port] & GPIO_Pin) : 0;
+    if (!gpio_drive(GPIOx, (uint16_t)(GPIO_Pin & ~high), high) && console_echo) {
+        std::cout << "GPIO Toggle: Pin " << GPIO_Pin << '\n';
+    }
+}
+
+// Mock EXTI functions
+void HAL_GPIO_EXTI_IRQHandler(uint16_t GPIO_Pin) {
+    // Like the HAL: clear the pending line, then run the callback
+    if (exti_pending & GPIO_Pin) {
+        exti_pending &= (uint16_t)~GPIO_Pin;
+        HAL_GPIO_EXTI_Callback(GPIO_Pin);
+    }
+}
+
+__attribute__((weak)) void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin) {
+    (void)GPIO_Pin;
+}
+
+void mock_exti_clear(uint16_t GPIO_Pin) {
+    exti_pending &= (uint16_t)~GPIO_Pin;
+}
+
+uint16_t mock_exti_pending(uint16_t GPIO_Pin) {
+    return exti_pending & GPIO_Pin;
+}
+
+// Mock NVIC functions
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority) {
+    (void)IRQn;
+    (void)PreemptPriority;
+    (void)SubPriority;
+}
+
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn) {
+    (void)IRQn;
+}
+
+void HAL_NVIC_DisableIRQ(IRQn_Type IRQn) {
+    (void)IRQn;
 }
 
 // Mock UART functions
@@ -44,7 +681,18 @@ HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef* huart) {
     return HAL_OK;
 }
 
+static uint32_t uart_tx_bytes = 0;
+static MockUartTxSink uart_tx_sink = nullptr;
+static void* uart_tx_sink_context = nullptr;
+
 HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef* huart, uint8_t* pData, uint16_t Size, uint32_t Timeout) {
+    uart_tx_bytes += Size;
+    if (uart_tx_sink != nullptr) {
+        uart_tx_sink(huart, pData, Size, uart_tx_sink_context);
+    }
+    if (!console_echo) {
+        return HAL_OK;
+    }
     // Mock implementation - print the data to console
     std::cout << "UART TX [" << Size << " bytes]: ";
     for (uint16_t i = 0; i < Size; i++) {
@@ -54,6 +702,326 @@ HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef* huart, uint8_t* pData, u
     return HAL_OK;
 }
 
+// Background transfers: one in flight per UART, finished per the TX mode
+static MockUartTxMode uart_tx_mode = MOCK_UART_TX_IMMEDIATE;
+
+static uint32_t uart_baud = 115200;
+
+struct MockUartTransfer {
+    UART_HandleTypeDef* huart;
+    uint8_t* data;
+    uint16_t size;
+    uint64_t done_ns;           // MOCK_UART_TX_TIMED: completion time
+};
+
+static const int MOCK_UART_COUNT = 4;
+static MockUartTransfer uart_transfers[MOCK_UART_COUNT];
+
+static MockUartTransfer* find_transfer(UART_HandleTypeDef* huart) {
+    for (int i = 0; i < MOCK_UART_COUNT; i++) {
+        if (uart_transfers[i].huart == huart) {
+            return &uart_transfers[i];
+        }
+    }
+    return nullptr;
+}
+
+static HAL_StatusTypeDef start_background_transmit(UART_HandleTypeDef* huart, uint8_t* pData, uint16_t Size) {
+    if (find_transfer(huart) != nullptr) {
+        return HAL_BUSY;
+    }
+    MockUartTransfer* transfer = find_transfer(nullptr);
+    if (transfer == nullptr || Size == 0) {
+        return HAL_ERROR;
+    }
+    transfer->huart = huart;
+    transfer->data = pData;
+    transfer->size = Size;
+    transfer->done_ns = clock_ns() + (uint64_t)Size * 10 * 1000000000ull / uart_baud;
+
+    if (uart_tx_mode == MOCK_UART_TX_IMMEDIATE ||
+        (uart_tx_mode == MOCK_UART_TX_TIMED && clock_mode != MOCK_CLOCK_VIRTUAL)) {
+        // Like an interrupt firing before the HAL call returns
+        mock_uart_complete_tx(huart);
+    }
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef* huart, uint8_t* pData, uint16_t Size) {
+    return start_background_transmit(huart, pData, Size);
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit_IT(UART_HandleTypeDef* huart, uint8_t* pData, uint16_t Size) {
+    return start_background_transmit(huart, pData, Size);
+}
+
+HAL_StatusTypeDef HAL_UART_AbortTransmit(UART_HandleTypeDef* huart) {
+    // Blocking abort: the transfer is dropped without a callback
+    MockUartTransfer* transfer = find_transfer(huart);
+    if (transfer != nullptr) {
+        transfer->huart = nullptr;
+    }
+    return HAL_OK;
+}
+
+// Default callbacks, replaced when the application defines its own
+__attribute__((weak)) void HAL_UART_TxCpltCallback(UART_HandleTypeDef* huart) {
+    (void)huart;
+}
+
+__attribute__((weak)) void HAL_UART_ErrorCallback(UART_HandleTypeDef* huart) {
+    (void)huart;
+}
+
+// Mock control functions
+void mock_uart_set_tx_mode(MockUartTxMode mode) {
+    uart_tx_mode = mode;
+}
+
+void mock_uart_set_baud(uint32_t baud) {
+    uart_baud = baud != 0 ? baud : 115200;
+}
+
+// One character on the wire: start bit, 8 data bits, stop bit
+static uint64_t uart_char_ns() {
+    return 10 * 1000000000ull / uart_baud;
+}
+
+// Circular DMA reception and the bytes on their way to it
+struct MockUartReceive {
+    UART_HandleTypeDef* huart;
+    uint8_t* buffer;            // nullptr: not receiving
+    uint16_t size;
+    uint16_t position;
+    uint32_t event_type;        // Of the latest HAL_UARTEx_RxEventCallback
+    std::deque<uint8_t> wire;
+    uint64_t next_byte_ns;
+    bool idle_pending;
+    uint64_t idle_ns;
+};
+
+static MockUartReceive uart_receivers[MOCK_UART_COUNT];
+
+static MockUartReceive* find_receiver(UART_HandleTypeDef* huart, bool create) {
+    MockUartReceive* free_slot = nullptr;
+    for (int i = 0; i < MOCK_UART_COUNT; i++) {
+        if (uart_receivers[i].huart == huart) {
+            return &uart_receivers[i];
+        }
+        if (uart_receivers[i].huart == nullptr && free_slot == nullptr) {
+            free_slot = &uart_receivers[i];
+        }
+    }
+    if (create && free_slot != nullptr) {
+        free_slot->huart = huart;
+    }
+    return create ? free_slot : nullptr;
+}
+
+static void uart_rx_event(MockUartReceive& rx, uint32_t type, uint16_t size) {
+    rx.event_type = type;
+    HAL_UARTEx_RxEventCallback(rx.huart, size);
+}
+
+// Moves one byte off the wire into the buffer, with the DMA interrupts
+static void uart_rx_deliver(MockUartReceive& rx) {
+    uint8_t byte = rx.wire.front();
+    rx.wire.pop_front();
+    rx.idle_pending = true;
+    rx.idle_ns = std::max(rx.next_byte_ns, clock_ns()) + uart_char_ns();
+    rx.next_byte_ns += uart_char_ns();
+    if (rx.buffer == nullptr) {
+        return;
+    }
+    rx.buffer[rx.position++] = byte;
+    if (rx.position == rx.size / 2) {
+        uart_rx_event(rx, HAL_UART_RXEVENT_HT, rx.position);
+    } else if (rx.position == rx.size) {
+        rx.position = 0;
+        uart_rx_event(rx, HAL_UART_RXEVENT_TC, rx.size);
+    }
+}
+
+static void uart_rx_idle(MockUartReceive& rx) {
+    rx.idle_pending = false;
+    // As the HAL: no idle event when the DMA has just wrapped
+    if (rx.buffer != nullptr && rx.position != 0) {
+        uart_rx_event(rx, HAL_UART_RXEVENT_IDLE, rx.position);
+    }
+}
+
+// Next byte or idle line of a receiver; false when its line is quiet
+static bool uart_rx_due(const MockUartReceive& rx, uint64_t& at_ns) {
+    if (rx.huart == nullptr) {
+        return false;
+    }
+    if (!rx.wire.empty()) {
+        at_ns = rx.next_byte_ns;
+        return true;
+    }
+    if (rx.idle_pending) {
+        at_ns = rx.idle_ns;
+        return true;
+    }
+    return false;
+}
+
+static void uart_rx_apply(MockUartReceive& rx) {
+    if (!rx.wire.empty()) {
+        uart_rx_deliver(rx);
+    } else {
+        uart_rx_idle(rx);
+    }
+}
+
+HAL_StatusTypeDef HAL_UARTEx_ReceiveToIdle_DMA(UART_HandleTypeDef* huart, uint8_t* pData, uint16_t Size) {
+    MockUartReceive* rx = find_receiver(huart, true);
+    if (rx == nullptr || pData == nullptr || Size == 0) {
+        return HAL_ERROR;
+    }
+    if (rx->buffer != nullptr) {
+        return HAL_BUSY;
+    }
+    rx->buffer = pData;
+    rx->size = Size;
+    rx->position = 0;
+    return HAL_OK;
+}
+
+uint32_t HAL_UARTEx_GetRxEventType(UART_HandleTypeDef* huart) {
+    MockUartReceive* rx = find_receiver(huart, false);
+    return rx != nullptr ? rx->event_type : HAL_UART_RXEVENT_TC;
+}
+
+HAL_StatusTypeDef HAL_UART_AbortReceive(UART_HandleTypeDef* huart) {
+    MockUartReceive* rx = find_receiver(huart, false);
+    if (rx != nullptr) {
+        rx->buffer = nullptr;
+    }
+    return HAL_OK;
+}
+
+uint32_t HAL_UART_GetState(UART_HandleTypeDef* huart) {
+    uint32_t state = HAL_UART_STATE_READY;
+    if (find_transfer(huart) != nullptr) {
+        state |= HAL_UART_STATE_BUSY_TX;
+    }
+    MockUartReceive* rx = find_receiver(huart, false);
+    if (rx != nullptr && rx->buffer != nullptr) {
+        state |= HAL_UART_STATE_BUSY_RX;
+    }
+    return state;
+}
+
+__attribute__((weak)) void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef* huart, uint16_t Size) {
+    (void)huart;
+    (void)Size;
+}
+
+void mock_uart_receive(UART_HandleTypeDef* huart, const uint8_t* data, size_t length) {
+    MockUartReceive* rx = find_receiver(huart, true);
+    if (rx == nullptr || length == 0) {
+        return;
+    }
+    if (rx->wire.empty()) {
+        rx->next_byte_ns = std::max(rx->next_byte_ns, clock_ns()) + uart_char_ns();
+    }
+    rx->wire.insert(rx->wire.end(), data, data + length);
+    if (clock_mode != MOCK_CLOCK_VIRTUAL) {
+        while (!rx->wire.empty()) {
+            uart_rx_deliver(*rx);
+        }
+        uart_rx_idle(*rx);
+    }
+}
+
+size_t mock_uart_rx_pending(UART_HandleTypeDef* huart) {
+    MockUartReceive* rx = find_receiver(huart, false);
+    return rx != nullptr ? rx->wire.size() : 0;
+}
+
+void mock_uart_rx_error(UART_HandleTypeDef* huart) {
+    MockUartReceive* rx = find_receiver(huart, false);
+    if (rx != nullptr && rx->buffer != nullptr) {
+        rx->buffer = nullptr;
+        HAL_UART_ErrorCallback(huart);
+    }
+}
+
+uint32_t mock_uart_tx_bytes(void) {
+    return uart_tx_bytes;
+}
+
+void mock_uart_set_tx_sink(MockUartTxSink sink, void* context) {
+    uart_tx_sink = sink;
+    uart_tx_sink_context = context;
+}
+
+bool mock_uart_tx_pending(UART_HandleTypeDef* huart) {
+    return find_transfer(huart) != nullptr;
+}
+
+void mock_uart_complete_tx(UART_HandleTypeDef* huart) {
+    MockUartTransfer* transfer = find_transfer(huart);
+    if (transfer == nullptr) {
+        return;
+    }
+    // Print, then free the slot so the callback can chain the next transfer
+    HAL_UART_Transmit(huart, transfer->data, transfer->size, 0);
+    transfer->huart = nullptr;
+    HAL_UART_TxCpltCallback(huart);
+}
+
+void mock_uart_fail_tx(UART_HandleTypeDef* huart) {
+    MockUartTransfer* transfer = find_transfer(huart);
+    if (transfer == nullptr) {
+        return;
+    }
+    transfer->huart = nullptr;
+    HAL_UART_ErrorCallback(huart);
+}
+
+// Mock tick: milliseconds of host or virtual time
+uint32_t HAL_GetTick(void) {
+    return (uint32_t)(clock_read_ns() / 1000000);
+}
+
+// Mock I2C functions: only the simulated LCD expander acknowledges
+HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef* hi2c) {
+    (void)hi2c;
+    return HAL_OK;
+}
+
+static bool i2c_lcd_addressed(uint16_t DevAddress) {
+    return mock_lcd.attached && mock_lcd.via_i2c && (DevAddress >> 1) == mock_lcd.i2c_address;
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Transmit(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint8_t* pData, uint16_t Size, uint32_t Timeout) {
+    (void)hi2c;
+    (void)Timeout;
+    if (!i2c_lcd_addressed(DevAddress)) {
+        return HAL_ERROR;
+    }
+    for (uint16_t i = 0; i < Size; i++) {
+        uint8_t pins = pData[i];
+        mock_lcd.expander_byte = pins;
+        lcd_set_levels((pins & 0x01) != 0, (pins & 0x02) != 0, (pins & 0x04) != 0, (uint8_t)(pins >> 4));
+    }
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Receive(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint8_t* pData, uint16_t Size, uint32_t Timeout) {
+    (void)hi2c;
+    (void)Timeout;
+    if (!i2c_lcd_addressed(DevAddress)) {
+        return HAL_ERROR;
+    }
+    for (uint16_t i = 0; i < Size; i++) {
+        pData[i] = (uint8_t)((mock_lcd.expander_byte & 0x0F) | (lcd_data_lines() << 4));
+    }
+    return HAL_OK;
+}
+
 // Mock Timer functions
 HAL_StatusTypeDef HAL_TIM_Base_Init(TIM_HandleTypeDef* htim) {
     // Mock implementation - just return success
@@ -70,6 +1038,268 @@ HAL_StatusTypeDef HAL_TIM_Base_Stop(TIM_HandleTypeDef* htim) {
     return HAL_OK;
 }
 
+// Timers with update interrupts (identified by handle)
+struct MockTimer {
+    TIM_HandleTypeDef* htim;
+    uint32_t autoreload;
+    bool running;
+    uint64_t next_ns;           // Next update event on the virtual clock
+};
+
+// Update period: ARR + 1 counts at MOCK_TIM_COUNTER_HZ
+static uint64_t timer_period_ns(const MockTimer& timer) {
+    return ((uint64_t)timer.autoreload + 1) * 1000000000ull / MOCK_TIM_COUNTER_HZ;
+}
+
+static const int MOCK_TIMER_COUNT = 4;
+static MockTimer mock_timers[MOCK_TIMER_COUNT];
+
+static MockTimer* find_timer(TIM_HandleTypeDef* htim, bool create) {
+    for (int i = 0; i < MOCK_TIMER_COUNT; i++) {
+        if (mock_timers[i].htim == htim) {
+            return &mock_timers[i];
+        }
+    }
+    if (create) {
+        for (int i = 0; i < MOCK_TIMER_COUNT; i++) {
+            if (mock_timers[i].htim == nullptr) {
+                mock_timers[i].htim = htim;
+                return &mock_timers[i];
+            }
+        }
+    }
+    return nullptr;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Start_IT(TIM_HandleTypeDef* htim) {
+    MockTimer* timer = find_timer(htim, true);
+    if (timer == nullptr) {
+        return HAL_ERROR;
+    }
+    timer->running = true;
+    timer->next_ns = clock_ns() + timer_period_ns(*timer);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Stop_IT(TIM_HandleTypeDef* htim) {
+    MockTimer* timer = find_timer(htim, false);
+    if (timer != nullptr) {
+        timer->running = false;
+    }
+    return HAL_OK;
+}
+
+__attribute__((weak)) void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef* htim) {
+    (void)htim;
+}
+
+void mock_tim_set_autoreload(TIM_HandleTypeDef* htim, uint32_t value) {
+    MockTimer* timer = find_timer(htim, true);
+    if (timer != nullptr) {
+        // No preload: the new period starts now
+        timer->autoreload = value;
+        timer->next_ns = clock_ns() + timer_period_ns(*timer);
+    }
+}
+
+uint32_t mock_tim_get_autoreload(TIM_HandleTypeDef* htim) {
+    MockTimer* timer = find_timer(htim, false);
+    return timer != nullptr ? timer->autoreload : 0;
+}
+
+void mock_tim_elapse(TIM_HandleTypeDef* htim, uint32_t periods) {
+    MockTimer* timer = find_timer(htim, false);
+    for (uint32_t i = 0; i < periods && timer != nullptr && timer->running; i++) {
+        HAL_TIM_PeriodElapsedCallback(htim);
+    }
+}
+
+// Virtual time: the clock jumps from one simulated interrupt (timer update,
+// scripted key action, timed UART completion) to the next instead of
+// waiting for it
+static bool clock_dispatching = false;
+
+// Earliest pending interrupt source; false when nothing is scheduled. A
+// timer, UART transfer or UART receiver is returned through its pointer,
+// none means the key script
+struct MockEventSource {
+    MockTimer* timer;
+    MockUartTransfer* transfer;
+    MockUartReceive* receiver;
+};
+
+static bool next_event(uint64_t& at_ns, MockEventSource& source) {
+    bool found = key_script_due(at_ns);
+    MockEventSource none = {nullptr, nullptr, nullptr};
+    source = none;
+    for (int i = 0; i < MOCK_TIMER_COUNT; i++) {
+        MockTimer& candidate = mock_timers[i];
+        if (candidate.htim == nullptr || !candidate.running) {
+            continue;
+        }
+        if (!found || candidate.next_ns < at_ns) {
+            at_ns = candidate.next_ns;
+            source = none;
+            source.timer = &candidate;
+            found = true;
+        }
+    }
+    if (uart_tx_mode == MOCK_UART_TX_TIMED) {
+        for (int i = 0; i < MOCK_UART_COUNT; i++) {
+            MockUartTransfer& candidate = uart_transfers[i];
+            if (candidate.huart != nullptr && (!found || candidate.done_ns < at_ns)) {
+                at_ns = candidate.done_ns;
+                source = none;
+                source.transfer = &candidate;
+                found = true;
+            }
+        }
+    }
+    for (int i = 0; i < MOCK_UART_COUNT; i++) {
+        uint64_t rx_ns;
+        if (uart_rx_due(uart_receivers[i], rx_ns) && (!found || rx_ns < at_ns)) {
+            at_ns = rx_ns;
+            source = none;
+            source.receiver = &uart_receivers[i];
+            found = true;
+        }
+    }
+    return found;
+}
+
+// Runs every event due up to target_ns in time order, then leaves the clock
+// at target_ns (or later, if the handlers read it)
+static void clock_advance_to(uint64_t target_ns) {
+    if (clock_dispatching) {
+        // Waiting inside a handler: time passes, interrupts wait for it
+        virtual_ns = std::max(virtual_ns, target_ns);
+        return;
+    }
+    clock_dispatching = true;
+    uint64_t at_ns;
+    MockEventSource source;
+    while (next_event(at_ns, source) && at_ns <= std::max(virtual_ns, target_ns)) {
+        virtual_ns = std::max(virtual_ns, at_ns);
+        if (source.timer != nullptr) {
+            source.timer->next_ns += timer_period_ns(*source.timer);
+            HAL_TIM_PeriodElapsedCallback(source.timer->htim);
+        } else if (source.transfer != nullptr) {
+            mock_uart_complete_tx(source.transfer->huart);
+        } else if (source.receiver != nullptr) {
+            uart_rx_apply(*source.receiver);
+        } else {
+            key_script_apply();
+        }
+    }
+    virtual_ns = std::max(virtual_ns, target_ns);
+    clock_dispatching = false;
+}
+
+static void clock_run_due() {
+    uint64_t at_ns;
+    MockEventSource source;
+    if (!clock_dispatching && next_event(at_ns, source) && at_ns <= virtual_ns) {
+        clock_advance_to(virtual_ns);
+    }
+}
+
+void mock_clock_set_mode(MockClockMode mode) {
+    if (mode == clock_mode) {
+        return;
+    }
+    // Carry the current time over so HAL_GetTick() stays monotonic
+    uint64_t now = clock_ns();
+    clock_mode = mode;
+    virtual_ns = now;
+    if (mode == MOCK_CLOCK_HOST) {
+        host_offset_ns = now - host_time_ns();
+    }
+    for (int i = 0; i < MOCK_TIMER_COUNT; i++) {
+        if (mock_timers[i].htim != nullptr) {
+            mock_timers[i].next_ns = now + timer_period_ns(mock_timers[i]);
+        }
+    }
+}
+
+uint64_t mock_clock_now_us(void) {
+    return clock_ns() / 1000;
+}
+
+void mock_clock_advance_us(uint64_t us) {
+    if (clock_mode == MOCK_CLOCK_VIRTUAL) {
+        clock_advance_to(virtual_ns + us * 1000);
+    }
+}
+
+void HAL_Delay(uint32_t Delay) {
+    // Host time does not sleep, as before: the demo only needs the delay
+    // to be harmless
+    if (clock_mode == MOCK_CLOCK_VIRTUAL) {
+        clock_advance_to(virtual_ns + (uint64_t)Delay * 1000000);
+    }
+}
+
+// Sleeps until the next interrupt or wake_ns, whichever comes first
+static void clock_sleep_until(uint64_t wake_ns) {
+    if (clock_mode != MOCK_CLOCK_VIRTUAL) {
+        return;
+    }
+    uint64_t at_ns;
+    MockEventSource source;
+    if (next_event(at_ns, source) && at_ns < wake_ns) {
+        wake_ns = std::max(at_ns, virtual_ns);
+    }
+    clock_advance_to(wake_ns);
+}
+
+void mock_wfi(void) {
+    // SysTick wakes the core every millisecond at the latest
+    clock_sleep_until((virtual_ns / 1000000 + 1) * 1000000);
+}
+
+void mock_wfi_tickless(uint32_t max_ms) {
+    // Nothing else to wake it: the core would sleep forever, stop at SysTick
+    uint64_t at_ns;
+    MockEventSource source;
+    if (max_ms == 0xFFFFFFFFu && !next_event(at_ns, source)) {
+        max_ms = 1;
+    }
+    clock_sleep_until(virtual_ns + (uint64_t)max_ms * 1000000);
+}
+
+void mock_set_console_echo(bool enabled) {
+    console_echo = enabled;
+}
+
+// Profiler time base
+uint32_t mock_profile_counter(void) {
+#ifdef MOCK_HAVE_TSC
+    return (uint32_t)__rdtsc();
+#else
+    return (uint32_t)host_time_ns();
+#endif
+}
+
+uint32_t mock_profile_counter_hz(void) {
+#ifdef MOCK_HAVE_TSC
+    // TSC rate measured once against steady_clock over 10 ms
+    static uint32_t hz = 0;
+    if (hz == 0) {
+        uint64_t start_ns = host_time_ns();
+        uint64_t start_tsc = __rdtsc();
+        uint64_t elapsed_ns;
+        do {
+            elapsed_ns = host_time_ns() - start_ns;
+        } while (elapsed_ns < 10000000);
+        uint64_t rate = (__rdtsc() - start_tsc) * 1000000000ull / elapsed_ns;
+        hz = rate > UINT32_MAX ? UINT32_MAX : (uint32_t)rate;
+    }
+    return hz;
+#else
+    return 1000000000u;
+#endif
+}
+
 // Mock RCC functions
 HAL_StatusTypeDef HAL_RCC_OscConfig(RCC_OscInitTypeDef* RCC_OscInitStruct) {
     // Mock implementation - just return success